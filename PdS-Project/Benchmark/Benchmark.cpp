@@ -0,0 +1,347 @@
+#ifdef _WIN32
+#pragma comment(lib,"Ws2_32.lib")
+#endif
+#include "Benchmark.hpp"
+#include "../Server/SocketStream.hpp"
+#include "../Server/Change.hpp"
+#include <chrono>
+#include <thread>
+#include <atomic>
+#include <iostream>
+#include <iomanip>
+#include <cstdlib>
+#include <cstring>
+#include <new>
+#include <algorithm>
+
+#define ICONBYTES 9640			// dimensione di un'icona 48x48 a 32 bit serializzata
+#define SENDWORK 16000			// applicazioni inviate per ogni misura (i round si adattano al numero di applicazioni)
+#define MINROUNDS 5
+#define OLDMAXLENGTH 2048		// dimensione massima di una send nella vecchia versione di SocketStream::sendData
+
+/*	Suite dei micro-benchmark del server: invio (questo file), confronto della lista (DiffBenchmark.cpp),
+*	enumerazione dei processi (EnumerationBenchmark.cpp) e serializzazione delle modifiche (SerializationBenchmark.cpp).
+*	I workload dipendono dal numero di applicazioni e dalla frazione che cambia ad ogni aggiornamento (churn);
+*	con --csv i risultati vengono scritti in formato CSV, in modo da poter confrontare le misure di commit diversi.
+*	Le allocazioni vengono contate sostituendo gli operatori new e delete globali.
+*/
+
+static std::atomic<unsigned long long> allocations(0);
+
+void* operator new(size_t size) {
+	allocations++;
+	void* p = malloc(size ? size : 1);
+	if (p == NULL)
+		throw std::bad_alloc();
+	return p;
+}
+
+void* operator new[](size_t size) {
+	return operator new(size);
+}
+
+/* Anche le versioni con dimensione e per array, altrimenti quelle della libreria rilascerebbero memoria di malloc */
+void operator delete(void* p) noexcept {
+	free(p);
+}
+
+void operator delete(void* p, size_t) noexcept {
+	free(p);
+}
+
+void operator delete[](void* p) noexcept {
+	free(p);
+}
+
+void operator delete[](void* p, size_t) noexcept {
+	free(p);
+}
+
+unsigned long long allocationCount() {
+	return allocations;
+}
+
+/* Applicazioni sostituite ad ogni aggiornamento: almeno una se il churn non e' nullo */
+size_t churnCount(size_t apps, double churn) {
+	if (churn <= 0)
+		return 0;
+	return std::max<size_t>((size_t) (apps * churn + 0.5), 1);
+}
+
+/* Intestazione dei risultati: riga di intestazione CSV o della tabella */
+void printHeader(const BenchmarkOptions& options) {
+	if (options.csv) {
+		std::cout << "benchmark,variant,apps,churn,rounds,us_per_op,allocs_per_op,bytes_per_op,syscalls_per_op" << std::endl;
+		return;
+	}
+	std::cout << std::left << std::setw(10) << "benchmark" << std::setw(14) << "variante"
+		<< std::right << std::setw(8) << "app" << std::setw(8) << "churn" << std::setw(8) << "round"
+		<< std::setw(14) << "us/op" << std::setw(12) << "alloc/op" << std::setw(14) << "byte/op" << std::setw(10) << "send/op" << std::endl;
+}
+
+void report(const BenchmarkOptions& options, const BenchmarkResult& r) {
+	if (options.csv) {
+		std::cout << r.benchmark << "," << r.variant << "," << r.apps << "," << r.churn << "," << r.rounds << ","
+			<< std::fixed << std::setprecision(3) << r.usPerOp << "," << r.allocsPerOp << "," << r.bytesPerOp << "," << r.syscallsPerOp
+			<< std::defaultfloat << std::endl;
+		return;
+	}
+	std::cout << std::left << std::setw(10) << r.benchmark << std::setw(14) << r.variant
+		<< std::right << std::setw(8) << r.apps << std::setw(8) << r.churn << std::setw(8) << r.rounds
+		<< std::fixed << std::setprecision(2) << std::setw(14) << r.usPerOp << std::setprecision(1) << std::setw(12) << r.allocsPerOp
+		<< std::setw(14) << r.bytesPerOp << std::setw(10) << r.syscallsPerOp << std::defaultfloat << std::endl;
+}
+
+/*	Benchmark dell'invio delle modifiche con SocketStream su loopback: confronta la vecchia modalita' (una sendData per ogni
+*	campo, spezzata in blocchi da OLDMAXLENGTH byte) con l'invio dell'intero ciclo in un FrameBatch (una sola scrittura vettoriale).
+*	Ogni round invia la lista completa (come alla connessione di un client); un thread lettore consuma i dati come farebbe il client.
+*/
+
+/* Coppia di socket connessi su loopback: server (lato SocketStream) e client (lato lettore) */
+static void connectPair(SOCKET& server, SOCKET& client) {
+	SOCKET listener = socket(AF_INET, SOCK_STREAM, IPPROTO_TCP);
+	struct sockaddr_in addr;
+	ZeroMemory(&addr, sizeof(addr));
+	addr.sin_family = AF_INET;
+	addr.sin_port = 0;
+	addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+	socklen_t addrLen = sizeof(addr);
+
+	if (listener == INVALID_SOCKET ||
+		bind(listener, (struct sockaddr*) &addr, sizeof(addr)) != 0 ||
+		listen(listener, 1) != 0 ||
+		getsockname(listener, (struct sockaddr*) &addr, &addrLen) != 0)
+		throw socket_exception("Creazione del socket di ascolto fallita");
+
+	client = socket(AF_INET, SOCK_STREAM, IPPROTO_TCP);
+	if (client == INVALID_SOCKET || connect(client, (struct sockaddr*) &addr, sizeof(addr)) != 0)
+		throw socket_exception("Connessione su loopback fallita");
+
+	server = accept(listener, NULL, NULL);
+	closesocket(listener);
+	if (server == INVALID_SOCKET)
+		throw socket_exception("Accettazione su loopback fallita");
+}
+
+/* Thread lettore: riceve e scarta i dati, contando i byte ricevuti */
+static void reader(SOCKET s, std::atomic<unsigned long long>& received) {
+	char buffer[65536];
+	int res;
+	while ((res = recv(s, buffer, sizeof(buffer), 0)) > 0)
+		received += res;
+}
+
+/* Dati sintetici delle applicazioni: nomi con la lunghezza tipica di un eseguibile ed icone di dimensione reale */
+static std::vector<Change> buildChanges(size_t apps) {
+	std::vector<Change> changes;
+	for (size_t i = 0; i < apps; i++) {
+		ApplicationItem app;
+		app.Name = std::make_shared<const std::wstring>(L"applicazione" + std::to_wstring(i) + L".exe");
+		app.Exec_name = std::make_shared<const std::wstring>(L"C:\\Program Files\\" + *app.Name);
+		changes.push_back(Change(1000 + (DWORD) i, app));
+	}
+	return changes;
+}
+
+/* Icona sintetica di dimensione reale, condivisa da tutte le applicazioni (come i buffer della IconCache) */
+static std::shared_ptr<const std::vector<char>> serializedIcon() {
+	static std::shared_ptr<const std::vector<char>> icon = std::make_shared<const std::vector<char>>(ICONBYTES, (char) 0x5A);
+	return icon;
+}
+
+/* Invio di un campo nella vecchia modalita': blocchi da OLDMAXLENGTH byte, una sendData per blocco */
+static void sendField(SocketStream& stream, char* buffer, int len) {
+	for (int sent = 0; sent < len; sent += OLDMAXLENGTH)
+		stream.sendData(buffer + sent, (len - sent > OLDMAXLENGTH) ? OLDMAXLENGTH : len - sent);
+}
+
+/* Vecchio percorso di ListHandler::sendToClient: ogni header, lunghezza, nome ed icona inviato separatamente */
+static size_t sendPerField(SocketStream& stream, std::vector<Change>& changes) {
+	size_t bytes = 0;
+	std::vector<char> buf;
+	std::shared_ptr<const std::vector<char>> icon = serializedIcon();
+	for (Change& c : changes) {
+		int length = c.getHeaderLength();
+		buf.resize(length);
+		c.writeHeader(buf.data());
+		sendField(stream, buf.data(), length);
+		bytes += length;
+
+		length = c.getNameLength();
+		buf.resize(length);
+		c.writeName(buf.data());
+		DWORD length_net = htonl(DWORD(length));
+		sendField(stream, (char*) &length_net, sizeof(DWORD));
+		sendField(stream, buf.data(), length);
+		bytes += sizeof(DWORD) + length;
+
+		length = (int) icon->size();
+		buf.assign(icon->begin(), icon->end());
+		length_net = htonl(DWORD(length));
+		sendField(stream, (char*) &length_net, sizeof(DWORD));
+		sendField(stream, buf.data(), length);
+		bytes += sizeof(DWORD) + length;
+	}
+	return bytes;
+}
+
+/*	Nuovo percorso: tutti i campi del ciclo scritti direttamente in un FrameBatch (memoria dal pool dei batch, icone condivise),
+*	inviato con una sola sendBatch. Le liste piu' grandi della coda di invio di una connessione (MAXPENDING) vengono divise in piu' batch.
+*/
+static size_t sendBatched(SocketStream& stream, std::vector<Change>& changes) {
+	FrameBatch batch;
+	size_t bytes = 0;
+	std::shared_ptr<const std::vector<char>> icon = serializedIcon();
+	for (Change& c : changes) {
+		if (batch.getBytes() > MAXPENDING / 2) {
+			stream.sendBatch(batch);
+			bytes += batch.getBytes();
+			batch.clear();
+			while (!stream.flush())
+				std::this_thread::yield();
+		}
+		int length = c.getHeaderLength();
+		c.writeHeader(batch.appendSpace(length));
+		length = c.getNameLength();
+		batch.appendLength(length);
+		c.writeName(batch.appendSpace(length));
+		batch.appendLength((int) icon->size());
+		batch.append(icon, icon->data(), (int) icon->size());
+	}
+	stream.sendBatch(batch);
+	return bytes + batch.getBytes();
+}
+
+/* Esecuzione dei round di invio: dopo ogni invio si completa la coda (come farebbe il reactor) e si attende la ricezione */
+static void runBenchmark(const BenchmarkOptions& options, const char* label, size_t apps,
+	size_t (*sendRound)(SocketStream&, std::vector<Change>&)) {
+	SOCKET server, client;
+	connectPair(server, client);
+
+	std::atomic<unsigned long long> received(0);
+	std::thread readerThread(reader, client, std::ref(received));
+
+	std::vector<Change> changes = buildChanges(apps);
+	int rounds = (int) std::max<size_t>(SENDWORK / apps, MINROUNDS);
+	unsigned long long expected = 0;
+	size_t roundBytes = 0;
+
+	try {
+		SocketStream stream(server);
+		unsigned long long allocs = allocationCount();
+		std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+
+		for (int r = 0; r < rounds; r++) {
+			roundBytes = sendRound(stream, changes);
+			expected += roundBytes;
+			while (!stream.flush())
+				std::this_thread::yield();
+			while (received < expected)
+				std::this_thread::yield();
+		}
+
+		std::chrono::microseconds elapsed = std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - start);
+		BenchmarkResult result = { "send", label, apps, 0, rounds, (double) elapsed.count() / rounds,
+			(double) (allocationCount() - allocs) / rounds, (double) roundBytes, (double) stream.getSendCalls() / rounds };
+		report(options, result);
+	}
+	catch (...) {
+		// il distruttore di SocketStream ha chiuso il socket del server: il lettore termina
+		readerThread.join();
+		closesocket(client);
+		throw;
+	}
+
+	// il distruttore di SocketStream ha chiuso il socket del server: il lettore riceve la chiusura e termina
+	readerThread.join();
+	closesocket(client);
+}
+
+/* Benchmark dell'invio: le due modalita' a confronto per ogni numero di applicazioni */
+void runSendBenchmark(const BenchmarkOptions& options) {
+	for (size_t apps : options.apps) {
+		runBenchmark(options, "per-campo", apps, sendPerField);
+		runBenchmark(options, "batch", apps, sendBatched);
+	}
+}
+
+/* Lettura di una lista di valori separati da virgole (es. 100,1000,10000) */
+template <typename T>
+static bool parseList(const char* text, std::vector<T>& values) {
+	values.clear();
+	const char* p = text;
+	while (*p != '\0') {
+		char* end;
+		double v = strtod(p, &end);
+		if (end == p || v < 0)
+			return false;
+		values.push_back((T) v);
+		p = (*end == ',') ? end + 1 : end;
+		if (*end != ',' && *end != '\0')
+			return false;
+	}
+	return !values.empty();
+}
+
+/*	Uso: Benchmark [--apps 100,1000,10000] [--churn 0,0.01] [--csv] [--only send|diff|enum|serial]
+*	Senza parametri vengono eseguiti tutti i benchmark con i workload predefiniti.
+*/
+
+int main(int argc, char* argv[]) {
+	BenchmarkOptions options;
+	options.apps = { 100, 1000, 10000 };
+	options.churn = { 0, 0.01 };
+	options.csv = false;
+
+	for (int i = 1; i < argc; i++) {
+		std::string arg = argv[i];
+		bool valid = true;
+		if (arg == "--csv")
+			options.csv = true;
+		else if (arg == "--apps" && i + 1 < argc)
+			valid = parseList(argv[++i], options.apps) &&
+				std::find(options.apps.begin(), options.apps.end(), (size_t) 0) == options.apps.end();
+		else if (arg == "--churn" && i + 1 < argc)
+			valid = parseList(argv[++i], options.churn) &&
+				*std::max_element(options.churn.begin(), options.churn.end()) <= 1;
+		else if (arg == "--only" && i + 1 < argc)
+			options.only = argv[++i];
+		else
+			valid = false;
+
+		if (!valid) {
+			std::cerr << "Uso: Benchmark [--apps 100,1000,10000] [--churn 0,0.01] [--csv] [--only send|diff|enum|serial]" << std::endl;
+			return 1;
+		}
+	}
+
+#ifdef _WIN32
+	WSADATA wsaData;
+	if (WSAStartup(MAKEWORD(2, 2), &wsaData) != 0) {
+		std::cerr << "Inizializzazione librerie Winsock fallita!" << std::endl;
+		return 1;
+	}
+#endif
+
+	int res = 0;
+	try {
+		printHeader(options);
+		if (options.only.empty() || options.only == "enum")
+			runEnumerationBenchmark(options);
+		if (options.only.empty() || options.only == "diff")
+			runDiffBenchmark(options);
+		if (options.only.empty() || options.only == "serial")
+			runSerializationBenchmark(options);
+		if (options.only.empty() || options.only == "send")
+			runSendBenchmark(options);
+	}
+	catch (std::exception& e) {
+		std::cerr << e.what() << std::endl;
+		res = 1;
+	}
+
+#ifdef _WIN32
+	WSACleanup();
+#endif
+	return res;
+}
@@ -0,0 +1,37 @@
+#pragma once
+#include <vector>
+#include <string>
+#include <cstddef>
+
+/* Parametri dei workload, letti dalla riga di comando (vedi main in Benchmark.cpp) */
+struct BenchmarkOptions {
+	std::vector<size_t> apps;		// numero di applicazioni di ogni workload
+	std::vector<double> churn;		// frazione delle applicazioni sostituite ad ogni aggiornamento
+	bool csv;						// risultati in formato CSV (per confrontarli tra un commit e l'altro) invece della tabella
+	std::string only;				// esecuzione di un solo benchmark (vuoto: tutti)
+};
+
+/* Risultato di una misura: i valori sono medie per operazione (round di invio, aggiornamento della lista, modifica serializzata) */
+struct BenchmarkResult {
+	const char* benchmark;
+	const char* variant;
+	size_t apps;
+	double churn;
+	int rounds;
+	double usPerOp;
+	double allocsPerOp;
+	double bytesPerOp;
+	double syscallsPerOp;
+};
+
+void printHeader(const BenchmarkOptions& options);
+void report(const BenchmarkOptions& options, const BenchmarkResult& result);
+size_t churnCount(size_t apps, double churn);
+unsigned long long allocationCount();
+
+/* Benchmark disponibili */
+
+void runSendBenchmark(const BenchmarkOptions& options);
+void runDiffBenchmark(const BenchmarkOptions& options);
+void runEnumerationBenchmark(const BenchmarkOptions& options);
+void runSerializationBenchmark(const BenchmarkOptions& options);
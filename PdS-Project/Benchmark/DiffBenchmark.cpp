@@ -0,0 +1,126 @@
+#include "Benchmark.hpp"
+#include "../Server/AppList.hpp"
+#include <map>
+#include <vector>
+#include <string>
+#include <chrono>
+#include <iostream>
+#include <algorithm>
+
+#define TICKWORK 2000000			// numero di elementi confrontati per ogni misura (i round si adattano alla dimensione della lista)
+
+/*	Benchmark del confronto tra due enumerazioni successive dei processi (il diff di UpdateAppList):
+*	- "map": vecchio approccio di UpdateAppList (nuova std::map ad ogni aggiornamento, copia degli elementi, erase e swap)
+*	- "flat": AppList (vettori ordinati per pid riusati, scansione parallela)
+*	Per ogni dimensione e churn, ad ogni aggiornamento terminano i processi piu' vecchi e ne partono altrettanti nuovi.
+*/
+
+/* Processo sintetico: i pid su Windows sono multipli di 4 */
+static ApplicationItem syntheticApp(DWORD pid) {
+	ApplicationItem app;
+	app.Name = std::make_shared<const std::wstring>(L"processo" + std::to_wstring(pid) + L".exe");
+	app.Exec_name = std::make_shared<const std::wstring>(L"C:\\Program Files\\Applicazione\\" + *app.Name);
+	return app;
+}
+
+static bool syntheticResolver(DWORD pid, ApplicationItem& app) {
+	app = syntheticApp(pid);
+	return true;
+}
+
+/* Enumerazione al round r: ad ogni round terminano i changed processi piu' vecchi e ne partono altrettanti */
+static void enumerate(std::vector<DWORD>& pids, size_t n, int round, size_t changed) {
+	pids.clear();
+	DWORD first = (DWORD) (round * changed);
+	for (size_t i = 0; i < n; i++)
+		pids.push_back((first + (DWORD) i + 1) * 4);
+}
+
+/* Vecchio approccio: la nuova lista e' una std::map costruita da zero, con gli ApplicationItem copiati */
+static void tickMap(std::map<DWORD, ApplicationItem>& applicationsList, const std::vector<DWORD>& pids,
+	const std::map<DWORD, ApplicationItem>& processes, size_t& changes) {
+	std::map<DWORD, ApplicationItem> newList;
+	for (DWORD pid : pids) {
+		std::map<DWORD, ApplicationItem>::const_iterator p = processes.find(pid);
+		ApplicationItem app = (p != processes.end()) ? p->second : syntheticApp(pid);
+		newList.insert(std::pair<DWORD, ApplicationItem>(pid, app));
+	}
+
+	for (std::pair<DWORD, ApplicationItem> app : newList) {
+		std::map<DWORD, ApplicationItem>::iterator i = applicationsList.find(app.first);
+		if (i != applicationsList.end())
+			applicationsList.erase(i);
+		else
+			changes++;
+	}
+	changes += applicationsList.size();
+	applicationsList.swap(newList);
+}
+
+/* Nuovo approccio: AppList */
+static void tickFlat(AppList& applicationsList, std::vector<DWORD>& snapshot, ListDelta& delta, size_t& changes) {
+	std::sort(snapshot.begin(), snapshot.end());
+	snapshot.erase(std::unique(snapshot.begin(), snapshot.end()), snapshot.end());
+	applicationsList.diff(snapshot, delta);
+	if (!delta.empty()) {
+		applicationsList.apply(delta, syntheticResolver);
+		changes += delta.added.size() + delta.removed.size();
+	}
+}
+
+static void report(const BenchmarkOptions& options, size_t n, double churn, const char* engine, int rounds,
+	std::chrono::steady_clock::duration elapsed, unsigned long long allocs) {
+	double us = (double) std::chrono::duration_cast<std::chrono::nanoseconds>(elapsed).count() / 1000.0 / rounds;
+	BenchmarkResult result = { "diff", engine, n, churn, rounds, us, (double) allocs / rounds, 0, 0 };
+	report(options, result);
+}
+
+static void runSize(const BenchmarkOptions& options, size_t n, double churn) {
+	int rounds = (int) std::max<size_t>(TICKWORK / n, 10);
+	size_t changed = churnCount(n, churn);
+	std::vector<DWORD> pids;
+	size_t changes = 0;
+
+	/* tabella dei processi usata dal vecchio approccio al posto di OpenProcess */
+	std::map<DWORD, ApplicationItem> processes;
+	for (size_t i = 0; i < n + rounds * changed + 1; i++)
+		processes[(DWORD) (i + 1) * 4] = syntheticApp((DWORD) (i + 1) * 4);
+
+	{
+		std::map<DWORD, ApplicationItem> applicationsList;
+		enumerate(pids, n, 0, changed);
+		tickMap(applicationsList, pids, processes, changes);
+
+		unsigned long long allocs = allocationCount();
+		std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+		for (int r = 1; r <= rounds; r++) {
+			enumerate(pids, n, r, changed);
+			tickMap(applicationsList, pids, processes, changes);
+		}
+		report(options, n, churn, "map", rounds, std::chrono::steady_clock::now() - start, allocationCount() - allocs);
+	}
+
+	{
+		AppList applicationsList;
+		ListDelta delta;
+		enumerate(pids, n, 0, changed);
+		tickFlat(applicationsList, pids, delta, changes);
+		// un secondo aggiornamento porta i vettori riusati alla capacita' di regime
+		enumerate(pids, n, 0, changed);
+		tickFlat(applicationsList, pids, delta, changes);
+
+		unsigned long long allocs = allocationCount();
+		std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+		for (int r = 1; r <= rounds; r++) {
+			enumerate(pids, n, r, changed);
+			tickFlat(applicationsList, pids, delta, changes);
+		}
+		report(options, n, churn, "flat", rounds, std::chrono::steady_clock::now() - start, allocationCount() - allocs);
+	}
+}
+
+void runDiffBenchmark(const BenchmarkOptions& options) {
+	for (size_t n : options.apps)
+		for (double churn : options.churn)
+			runSize(options, n, churn);
+}
@@ -0,0 +1,78 @@
+#include "Benchmark.hpp"
+#include "../Server/ListHandler.hpp"
+#include <vector>
+#include <chrono>
+#include <algorithm>
+
+#define ENUMWORK 2000000			// numero di pid enumerati per ogni misura (i round si adattano alla dimensione della lista)
+#define WINDOWSTRIDE 7919			// passo con cui la sorgente sintetica visita i processi (ordine delle finestre, non dei pid)
+#define EXTRAWINDOWS 4				// un processo ogni EXTRAWINDOWS ha una seconda finestra (pid ripetuto)
+
+/*	Benchmark di ListHandler::buildList con una sorgente di processi sintetica (al posto di enumerateProcesses):
+*	i pid arrivano nell'ordine delle finestre e con ripetizioni, come dall'enumerazione reale, e buildList li ordina
+*	ed elimina i duplicati. Ad ogni round cambia una frazione dei processi (churn). Viene misurata anche l'enumerazione
+*	reale della macchina su cui gira il benchmark (variante "sistema").
+*/
+
+/* buildList fa parte del nucleo del server, che richiede all'applicazione ospite questa funzione: il benchmark non esegue il server */
+void requestShutdown(int) {}
+
+static size_t syntheticApps = 0;			// stato della sorgente sintetica (buildList accetta solo una funzione)
+static size_t syntheticChanged = 0;
+static int syntheticRound = 0;
+
+static void syntheticEnumerate(std::vector<DWORD>& pids) {
+	DWORD first = (DWORD) (syntheticRound * syntheticChanged);
+	size_t position = 0;
+	for (size_t i = 0; i < syntheticApps; i++) {
+		position = (position + WINDOWSTRIDE) % syntheticApps;
+		DWORD pid = (first + (DWORD) position + 1) * 4;
+		pids.push_back(pid);
+		if (position % EXTRAWINDOWS == 0)
+			pids.push_back(pid);
+	}
+}
+
+static void runSize(const BenchmarkOptions& options, size_t n, double churn) {
+	int rounds = (int) std::max<size_t>(ENUMWORK / n, 10);
+	std::vector<DWORD> pids;
+
+	syntheticApps = n;
+	syntheticChanged = churnCount(n, churn);
+	syntheticRound = 0;
+	ListHandler::buildList(pids, syntheticEnumerate);		// il vettore raggiunge la capacita' di regime
+
+	unsigned long long allocs = allocationCount();
+	std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+	for (int r = 1; r <= rounds; r++) {
+		syntheticRound = r;
+		ListHandler::buildList(pids, syntheticEnumerate);
+	}
+	double us = (double) std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - start).count() / 1000.0 / rounds;
+
+	BenchmarkResult result = { "enum", "sintetica", pids.size(), churn, rounds, us, (double) (allocationCount() - allocs) / rounds, 0, 0 };
+	report(options, result);
+}
+
+/* Enumerazione reale: il numero di applicazioni e' quello della macchina, per cui si esegue una sola volta */
+static void runSystem(const BenchmarkOptions& options) {
+	const int rounds = 50;
+	std::vector<DWORD> pids;
+	ListHandler::buildList(pids);
+
+	unsigned long long allocs = allocationCount();
+	std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+	for (int r = 0; r < rounds; r++)
+		ListHandler::buildList(pids);
+	double us = (double) std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - start).count() / 1000.0 / rounds;
+
+	BenchmarkResult result = { "enum", "sistema", pids.size(), 0, rounds, us, (double) (allocationCount() - allocs) / rounds, 0, 0 };
+	report(options, result);
+}
+
+void runEnumerationBenchmark(const BenchmarkOptions& options) {
+	for (size_t n : options.apps)
+		for (double churn : options.churn)
+			runSize(options, n, churn);
+	runSystem(options);
+}
@@ -0,0 +1,86 @@
+#include "Benchmark.hpp"
+#include "../Server/Change.hpp"
+#include <vector>
+#include <string>
+#include <chrono>
+#include <algorithm>
+
+#define SERIALWORK 1000000			// modifiche serializzate per ogni misura (i round si adattano al numero di applicazioni)
+
+/*	Benchmark della serializzazione delle modifiche add (le piu' costose) in un FrameBatch: envelope e pid (writeHeader),
+*	nome (writeName), icona (getSerializedIcon, dalla IconCache) e messaggio completo (serialize). Il batch viene svuotato
+*	e riusato, come la memoria presa dal pool dei batch ad ogni ciclo: a regime non ci sono allocazioni. L'eseguibile delle applicazioni sintetiche e'
+*	il benchmark stesso, per cui l'icona viene misurata nel caso comune di regime: file gia' in cache e non modificato.
+*/
+
+/* Percorso dell'eseguibile del benchmark */
+static std::wstring executablePath() {
+#ifdef _WIN32
+	wchar_t path[MAX_PATH];
+	DWORD len = GetModuleFileNameW(NULL, path, MAX_PATH);
+	return std::wstring(path, len);
+#else
+	char path[4096];
+	ssize_t len = readlink("/proc/self/exe", path, sizeof(path));
+	return len > 0 ? fromUtf8(path, (size_t) len) : std::wstring();
+#endif
+}
+
+static std::vector<Change> buildChanges(size_t apps) {
+	std::vector<Change> changes;
+	std::shared_ptr<const std::wstring> exec = std::make_shared<const std::wstring>(executablePath());
+	for (size_t i = 0; i < apps; i++) {
+		ApplicationItem app;
+		app.Name = std::make_shared<const std::wstring>(L"applicazione" + std::to_wstring(i) + L".exe");
+		app.Exec_name = exec;
+		changes.push_back(Change(1000 + (DWORD) i, app));
+	}
+	return changes;
+}
+
+/* Misura di una funzione di serializzazione applicata a tutte le modifiche, per rounds volte */
+template <typename F>
+static void measure(const BenchmarkOptions& options, const char* variant, std::vector<Change>& changes, int rounds, F serialize) {
+	size_t bytes = 0;
+	unsigned long long allocs = allocationCount();
+	std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+	for (int r = 0; r < rounds; r++)
+		for (Change& c : changes)
+			bytes += serialize(c);
+	double ops = (double) rounds * changes.size();
+	double us = (double) std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - start).count() / 1000.0 / ops;
+
+	BenchmarkResult result = { "serial", variant, changes.size(), 0, rounds, us, (double) (allocationCount() - allocs) / ops, bytes / ops, 0 };
+	report(options, result);
+}
+
+void runSerializationBenchmark(const BenchmarkOptions& options) {
+	for (size_t n : options.apps) {
+		std::vector<Change> changes = buildChanges(n);
+		int rounds = (int) std::max<size_t>(SERIALWORK / n, 1);
+
+		FrameBatch batch;
+		measure(options, "tipo", changes, rounds, [&batch](Change& c) {
+			batch.clear();
+			int length = c.getHeaderLength();
+			c.writeHeader(batch.appendSpace(length));
+			return (size_t) length;
+		});
+		measure(options, "nome", changes, rounds, [&batch](Change& c) {
+			batch.clear();
+			int length = c.getNameLength();
+			c.writeName(batch.appendSpace(length));
+			return (size_t) length;
+		});
+		changes[0].getSerializedIcon();			// prima estrazione (poi l'icona e' in cache)
+		measure(options, "icona", changes, rounds, [](Change& c) {
+			IconBuffer icon = c.getSerializedIcon();
+			return icon ? icon->bytes.size() : (size_t) 0;
+		});
+		measure(options, "messaggio", changes, rounds, [&batch](Change& c) {
+			batch.clear();
+			c.serialize(batch);
+			return batch.getBytes();
+		});
+	}
+}
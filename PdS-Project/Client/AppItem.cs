@@ -31,9 +31,64 @@ namespace Client
         public String Name { get; set; }
 
         /// <summary>
-        /// Proprietà che incapsula l'icona dell'applicazione
+        /// Icona dell'applicazione
         /// </summary>
-        public ImageSource Icon { get; set; }
+        private ImageSource _icon;
+
+        /// <summary>
+        /// Proprietà che incapsula l'icona dell'applicazione e ne notifica eventuali variazioni all'interfaccia
+        /// (l'icona può arrivare dal server dopo l'applicazione)
+        /// </summary>
+        public ImageSource Icon
+        {
+            get { return _icon; }
+            set
+            {
+                if (value != _icon)
+                {
+                    _icon = value;
+                    NotifyPropertyUpdate();
+                }
+            }
+        }
+
+        /// <summary>
+        /// Uso delle risorse inviato dal server: CPU (percentuale) e working set (KB)
+        /// </summary>
+        private double _cpu = 0;
+        private uint _memory = 0;
+
+        /// <summary>
+        /// Proprietà che incapsula la percentuale di CPU usata dall'applicazione e ne notifica eventuali variazioni all'interfaccia
+        /// </summary>
+        public double Cpu
+        {
+            get { return _cpu; }
+            set
+            {
+                if (value != _cpu)
+                {
+                    _cpu = value;
+                    NotifyPropertyUpdate();
+                }
+            }
+        }
+
+        /// <summary>
+        /// Proprietà che incapsula il working set dell'applicazione (KB) e ne notifica eventuali variazioni all'interfaccia
+        /// </summary>
+        public uint Memory
+        {
+            get { return _memory; }
+            set
+            {
+                if (value != _memory)
+                {
+                    _memory = value;
+                    NotifyPropertyUpdate();
+                }
+            }
+        }
 
         /// <summary>
         /// Proprietà che incapsula il PID dell'applicazione
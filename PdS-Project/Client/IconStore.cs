@@ -0,0 +1,86 @@
+﻿using System;
+using System.Collections.Generic;
+using System.Windows;
+using System.Windows.Interop;
+using System.Windows.Media;
+using System.Windows.Media.Imaging;
+
+namespace Client
+{
+    /// <summary>
+    /// Cache delle icone ricevute dai server, indicizzate per hash del contenuto.
+    /// È condivisa da tutte le connessioni: un'icona già ricevuta non viene richiesta di nuovo,
+    /// né da un altro server né dopo una riconnessione.
+    /// </summary>
+    public static class IconStore
+    {
+        // Importazione delle librerie Windows utili ad interpretare l'icona inviata dal server
+        [System.Runtime.InteropServices.DllImport("user32.dll")]
+        extern static bool DestroyIcon(IntPtr handle);
+        [System.Runtime.InteropServices.DllImport("user32.dll")]
+        extern static IntPtr CreateIconFromResourceEx(IntPtr buffer, uint size, int isIcon, uint dwVer, int cx, int cy, uint flags);
+
+        /// <summary>
+        /// Icone note, indicizzate per hash
+        /// </summary>
+        private static Dictionary<ulong, ImageSource> Icons = new Dictionary<ulong, ImageSource>();
+
+        /// <summary>
+        /// Ricerca di un'icona già ricevuta
+        /// </summary>
+        /// <param name="hash">Hash del contenuto dell'icona</param>
+        /// <param name="icon">Icona trovata</param>
+        /// <returns>true se l'icona è nota</returns>
+        public static bool TryGet(ulong hash, out ImageSource icon)
+        {
+            lock (Icons)
+            {
+                return Icons.TryGetValue(hash, out icon);
+            }
+        }
+
+        /// <summary>
+        /// Memorizzazione di un'icona ricevuta
+        /// </summary>
+        public static void Add(ulong hash, ImageSource icon)
+        {
+            lock (Icons)
+            {
+                Icons[hash] = icon;
+            }
+        }
+
+        /// <summary>
+        /// Conversione dei byte dell'icona inviati dal server in un'immagine (congelata, per poterla usare da qualsiasi thread)
+        /// </summary>
+        /// <param name="BufferIcon">Risorsa icona serializzata dal server</param>
+        /// <param name="Size">Dimensione (pixel) delle icone negoziata con il server</param>
+        /// <returns>L'immagine, o null se i dati non sono validi</returns>
+        public static ImageSource Decode(Byte[] BufferIcon, int Size)
+        {
+            ImageSource result = null;
+
+            unsafe
+            {
+                fixed (byte* buffer = &BufferIcon[0])
+                {
+                    IntPtr Hicon = CreateIconFromResourceEx((IntPtr)buffer, (uint)BufferIcon.Length, 1, 0x00030000, Size, Size, 0);
+
+                    if (Hicon != IntPtr.Zero)
+                    {
+                        BitmapFrame bitmap = BitmapFrame.Create(Imaging.CreateBitmapSourceFromHIcon(Hicon, new Int32Rect(0, 0, Size, Size), BitmapSizeOptions.FromEmptyOptions()));
+                        if (bitmap.CanFreeze)
+                        {
+                            bitmap.Freeze();
+                            result = bitmap;
+                        }
+
+                        DestroyIcon(Hicon);
+                    }
+                }
+            }
+
+            return result;
+        }
+    }
+}
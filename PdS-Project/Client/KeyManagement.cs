@@ -1,6 +1,7 @@
 ﻿using System;
 using System.IO;
 using System.Net;
+using System.Text;
 using System.Windows;
 using System.Windows.Input;
 using System.Windows.Media;
@@ -65,61 +66,63 @@ namespace Client
             {
                 // Preparazione dei dati da inviare
                 int conv_key = KeyInterop.VirtualKeyFromKey(key);
-                byte[] buffer = new byte[1 + sizeof(int)];          // Struttura che conterrà (Modificatori + tasto)
+                byte[] buffer = new byte[1 + sizeof(int)];          // Struttura che conterrà (Modificatori + tasto): comando con una sola combinazione
                 buffer[0] = (byte)modifier;
                 BitConverter.GetBytes(IPAddress.HostToNetworkOrder(conv_key)).CopyTo(buffer, 1);
 
-                // Recupero l'applicazione che è in focus dall'elemento selezionato nella combobox
-
-                ForegroundApp appinfocus = ForegroundAppsBox.SelectedItem as ForegroundApp;
-                if (appinfocus == null)
-                {
-                    e.Handled = true;
-                    return;
-                }
-
-                // Se c'è almeno un app in focus, cerchiamo il tab o server a cui appartiene 
-                foreach (DynamicTabItem tab in ServerTabs)
-                {
-                    if (tab.ForegroundApp == appinfocus.Name)
-                    {
-                        ServerTabManagement s = tab.Content as ServerTabManagement;
-                        if (s != null)
-                            try
-                            {
-                                s.Stream.BeginWrite(buffer, 0, 1 + sizeof(int), new AsyncCallback(SendToServer), s);
-                            }
-                            catch (IOException)
-                            {
-                                ExceptionHandler.SendError(s);
-                            }
-                    }
-                }
-
+                SendToFocusedServer(ServerTabManagement.CommandKeys, buffer);
                 e.Handled = true;
             }
 
         } // ClientKeyPressed closing bracket
 
-
         /// <summary>
-        /// Metodo che gestisce la terminazione dell'invio di dati al server
+        /// Invio di un comando ai server la cui applicazione in focus è quella selezionata nella combobox
         /// </summary>
-        /// <param name="a"></param>
-        private void SendToServer (IAsyncResult a)
+        /// <param name="type">Tipo del comando</param>
+        /// <param name="payload">Payload del comando</param>
+        /// <remarks>I comandi di input portano il timestamp del client: il server restituisce i tempi misurati (vedi SocketListener)</remarks>
+        private void SendToFocusedServer(byte type, byte[] payload)
         {
-            ServerTabManagement s = (ServerTabManagement)a.AsyncState;
+            // Recupero l'applicazione che è in focus dall'elemento selezionato nella combobox
+            ForegroundApp appinfocus = ForegroundAppsBox.SelectedItem as ForegroundApp;
+            if (appinfocus == null)
+                return;
 
-            try
-            {
-                s.Stream.EndWrite(a);
-            }
-            catch (IOException)
+            // Se c'è almeno un app in focus, cerchiamo il tab o server a cui appartiene 
+            foreach (DynamicTabItem tab in ServerTabs)
             {
-                ExceptionHandler.SendError(s);
+                if (tab.ForegroundApp == appinfocus.Name)
+                {
+                    ServerTabManagement s = tab.Content as ServerTabManagement;
+                    if (s != null)
+                        try
+                        {
+                            s.SendCommand(type, payload, true);
+                        }
+                        catch (IOException)
+                        {
+                            ExceptionHandler.SendError(s);
+                        }
+                }
             }
         }
 
+        /// <summary>
+        /// Funzione richiamata dal pulsante Invia testo: il testo viene digitato nell'applicazione in focus con un unico comando
+        /// </summary>
+        /// <param name="sender"></param>
+        /// <param name="e"></param>
+        private void SendText_Click (object sender, RoutedEventArgs e)
+        {
+            if (txtSendText.Text.Length == 0)
+                return;
+
+            SendToFocusedServer(ServerTabManagement.CommandText, Encoding.Unicode.GetBytes(txtSendText.Text));
+            txtSendText.Clear();
+        }
+
+
         /// <summary>
         /// Funzione richiamata all'accorrere dell'evento di rilascio del tasto KeyReleased
         /// </summary>
@@ -1,7 +1,10 @@
 ﻿using System;
+using System.Collections.Generic;
 using System.Collections.ObjectModel;
 using System.Collections.Specialized;
+using System.Diagnostics;
 using System.Net.Sockets;
+using System.Text;
 using System.Threading;
 using System.Windows;
 using System.Windows.Controls;
@@ -31,6 +34,41 @@ namespace Client
         /// </summary>
         private NetworkStream _stream;
 
+        /// <summary>
+        /// Oggetto usato per non sovrapporre le scritture sullo stream (comandi dall'interfaccia e richieste di icone dal listener)
+        /// </summary>
+        private readonly object WriteLock = new object();
+
+        /// <summary>
+        /// Tipi dei comandi inviati al server: sequenza di combinazioni di tasti, testo UTF-16LE, richiesta di icona,
+        /// richiesta di ripresa, handshake delle capacità e sottoscrizione
+        /// </summary>
+        public const byte CommandKeys = 0;
+        public const byte CommandText = 1;
+        public const byte CommandIcon = 2;
+        public const byte CommandResume = 3;
+        public const byte CommandHello = 4;
+        public const byte CommandSubscribe = 5;
+
+        /// <summary>
+        /// Tipi di modifica di una sottoscrizione (bit 1 &lt;&lt; tipo): aggiunta, rimozione, cambio di focus ed uso delle risorse
+        /// </summary>
+        public const uint SubscribeAdd = 1;
+        public const uint SubscribeRemove = 2;
+        public const uint SubscribeFocus = 4;
+        public const uint SubscribeResources = 1 << 12;
+
+        /// <summary>
+        /// Versione del protocollo e dimensione dell'envelope dei comandi (versione, tipo, flag, lunghezza del payload)
+        /// </summary>
+        private const byte ProtocolVersion = 1;
+        private const int EnvelopeSize = 8;
+
+        /// <summary>
+        /// Flag dell'envelope: payload preceduto dal timestamp del client, che il server restituisce con i tempi misurati (messaggio echo)
+        /// </summary>
+        private const ushort FlagTimestamp = 2;
+
         /// <summary>
         /// Struttura che mantiene il timestamp della creazione del ServerTab
         /// </summary>
@@ -61,6 +99,13 @@ namespace Client
         /// </summary>
         private Thread ListenerThread;
 
+        /// <summary>
+        /// Epoca e sequenza dell'ultima modifica ricevuta dal server (0: lista mai ricevuta).
+        /// Vengono comunicate al server ad ogni connessione, per ricevere solo le modifiche perse invece della lista completa.
+        /// </summary>
+        public uint Epoch { get; set; }
+        public uint LastSequence { get; set; }
+
         /// <summary>
         /// Proprietà che incapsula le informazioni relative al socket
         /// </summary>
@@ -117,6 +162,70 @@ namespace Client
             BindingOperations.EnableCollectionSynchronization(Applications, Applications);
         }
 
+        /// <summary>
+        /// Invio di un messaggio al server: i messaggi inviati da thread diversi non vengono mescolati
+        /// </summary>
+        /// <param name="buffer">Messaggio da inviare</param>
+        public void SendToServer(byte[] buffer)
+        {
+            lock (WriteLock)
+            {
+                Stream.Write(buffer, 0, buffer.Length);
+            }
+        }
+
+        /// <summary>
+        /// Invio di un comando al server: envelope (versione, tipo, flag e lunghezza del payload in ordine di rete) seguito dal payload
+        /// </summary>
+        /// <param name="type">Tipo del comando</param>
+        /// <param name="payload">Payload del comando</param>
+        /// <param name="timed">Il comando porta il timestamp del client (Stopwatch), per misurarne la latenza</param>
+        public void SendCommand(byte type, byte[] payload, bool timed = false)
+        {
+            int stamp = timed ? sizeof(long) : 0;
+            byte[] buffer = new byte[EnvelopeSize + stamp + payload.Length];
+            buffer[0] = ProtocolVersion;
+            buffer[1] = type;
+            if (timed)
+            {
+                buffer[3] = (byte)FlagTimestamp;
+                long timestamp = Stopwatch.GetTimestamp();
+                for (int i = 0; i < sizeof(long); i++)
+                    buffer[EnvelopeSize + i] = (byte)(timestamp >> (56 - 8 * i));
+            }
+            for (int i = 0; i < sizeof(uint); i++)
+                buffer[4 + i] = (byte)((uint)(stamp + payload.Length) >> (24 - 8 * i));
+            payload.CopyTo(buffer, EnvelopeSize + stamp);
+            SendToServer(buffer);
+        }
+
+        /// <summary>
+        /// Sottoscrizione: il server invia solo le modifiche dei tipi indicati e, se sono indicati pid o espressioni,
+        /// solo quelle delle applicazioni con uno dei pid o con nome o percorso che soddisfano un'espressione (* e ?).
+        /// Il server risponde inviando di nuovo la lista, filtrata.
+        /// </summary>
+        /// <param name="types">Tipi di modifica richiesti (SubscribeAdd, SubscribeRemove, SubscribeFocus, SubscribeResources)</param>
+        /// <param name="pids">Pid delle applicazioni richieste</param>
+        /// <param name="patterns">Espressioni sul nome o sul percorso dell'eseguibile</param>
+        public void Subscribe(uint types, uint[] pids, string[] patterns)
+        {
+            List<byte> payload = new List<byte>();
+            Action<uint> append = (value) => { for (int i = 0; i < sizeof(uint); i++) payload.Add((byte)(value >> (24 - 8 * i))); };
+
+            append(types);
+            append((uint)pids.Length);
+            foreach (uint pid in pids)
+                append(pid);
+            append((uint)patterns.Length);
+            foreach (string pattern in patterns)
+            {
+                byte[] text = Encoding.Unicode.GetBytes(pattern);
+                append((uint)text.Length);
+                payload.AddRange(text);
+            }
+            SendCommand(CommandSubscribe, payload.ToArray());
+        }
+
         /// <summary>
         /// Funzione che inizia la raccolta delle informazioni dal server
         /// </summary>
@@ -1,12 +1,14 @@
 ﻿using System;
+using System.Collections.Generic;
 using System.Collections.Specialized;
+using System.Diagnostics;
 using System.IO;
 using System.Net;
 using System.Net.Sockets;
+using System.Text;
 using System.Threading;
 using System.Windows;
-using System.Windows.Interop;
-using System.Windows.Media.Imaging;
+using System.Windows.Media;
 using System.Windows.Threading;
 
 namespace Client
@@ -16,16 +18,56 @@ namespace Client
     /// </summary>
     public class SocketListener
     {
-        // Importazione delle librerie Windows utili ad interpretare l'icona inviata dal server
-        [System.Runtime.InteropServices.DllImport("user32.dll")]
-        extern static bool DestroyIcon(IntPtr handle);
-        [System.Runtime.InteropServices.DllImport("user32.dll")]
-        extern static IntPtr CreateIconFromResourceEx(IntPtr buffer, uint size, int isIcon, uint dwVer, int cx, int cy, uint flags);
+        /// <summary>
+        /// Capacità richieste al server con l'handshake (batch compressi, icone nella dimensione indicata, codifica compatta)
+        /// </summary>
+        private const uint CapCompression = 1;
+        private const uint CapIconSize = 2;
+        private const uint CapCompact = 4;
+
+        /// <summary>
+        /// Dimensione (pixel) delle icone richiesta al server, e dimensione accettata (48 se il server non la negozia)
+        /// </summary>
+        private const uint PreferredIconSize = 48;
+        private int IconSize = 48;
+
+        /// <summary>
+        /// Formato dei messaggi: versione, dimensione dell'envelope (versione, tipo, flag, lunghezza del payload),
+        /// tipo dei frame che raccolgono i messaggi di un ciclo e flag del payload compresso
+        /// </summary>
+        private const int ProtocolVersion = 1;
+        private const int EnvelopeSize = 8;
+        private const int FrameMessage = 8;
+        private const int FlagCompressed = 1;
+
+        /// <summary>
+        /// Codifica compatta: tipo dei frame, flag del record con l'hash dell'icona e codifica dei nomi
+        /// (testo da aggiungere alla tabella, testo da non aggiungere, indice nella tabella a partire da StringReference)
+        /// </summary>
+        private const int PackedMessage = 11;
+        private const int PackedHash = 0x20;
+        private const uint StringStored = 0;
+        private const uint StringReference = 2;
+
+        /// <summary>
+        /// Dimensione massima di un frame (anche dopo la decompressione)
+        /// </summary>
+        private const int MaxBatch = 8 * 1024 * 1024;
 
         private volatile bool stop = false;
         private NetworkStream Stream;
         private ServerTabManagement Item;
 
+        /// <summary>
+        /// Applicazioni in attesa di un'icona richiesta al server, indicizzate per hash dell'icona
+        /// </summary>
+        private Dictionary<ulong, List<AppItem>> PendingIcons = new Dictionary<ulong, List<AppItem>>();
+
+        /// <summary>
+        /// Nomi ricevuti in codifica compatta, nell'ordine in cui il server li ha aggiunti alla sua tabella
+        /// </summary>
+        private List<String> Names = new List<String>();
+
         /// <summary>
         /// Costruttore della classe SocketListener
         /// </summary>
@@ -49,311 +91,697 @@ namespace Client
         /// </summary>
         public void SocketThreadListen()
         {
-            int n = 0;
-
             try
             {
-                Byte[] readBuffer = new Byte[1024];
+                Byte[] header = new Byte[EnvelopeSize];
+
+                // Handshake delle capacità: il server può rispondere inviando i batch più grandi compressi
+                RequestCapabilities();
+
+                // Il server invia solo le modifiche perse se riconosce epoca e sequenza, altrimenti la lista completa
+                RequestResume();
 
                 while (!stop)
                 {
-                    Console.WriteLine("In attesa di ricevere dati dal server...");
+                    if (!ReadFrame(header))
+                        return;
+                }
+                Console.WriteLine("Thread - terminata ricezione dati dal server");
+            }
+            catch (NullReferenceException)
+            {
+                ExceptionHandler.ReceiveConnectionError(Item);
+            }
+            catch (IOException)
+            {
+                ExceptionHandler.ReceiveConnectionError(Item);
+            }
+            catch (ObjectDisposedException)
+            {
+                ExceptionHandler.ReceiveConnectionError(Item);
+            }
+            catch (ArgumentOutOfRangeException)
+            {
+                ExceptionHandler.ReceiveConnectionError(Item);
+            }
+            catch (IndexOutOfRangeException)
+            {
+                // Frame compresso non valido
+                ExceptionHandler.ReceiveConnectionError(Item);
+            }
+            catch (OutOfMemoryException)
+            {
+                ExceptionHandler.MemoryError(Item.ServerTab.MainWndw);
+            }
+        }
 
-                    // Ricezione del tipo di modifica effettuata
-                    n = Stream.Read(readBuffer, 0, sizeof(ushort));
 
-                    if (!readSuccessful(n, sizeof(ushort)))
-                        return;
+        /// <summary>
+        /// Lettura di un frame dal server: envelope (versione, tipo, flag e lunghezza del payload) seguito dal payload,
+        /// letto con una sola operazione. Il payload di un frame è la sequenza dei messaggi di un ciclo di aggiornamento,
+        /// eventualmente compressa. I messaggi di una versione sconosciuta vengono ignorati.
+        /// </summary>
+        /// <param name="header">Buffer per l'envelope</param>
+        /// <returns>false se la connessione è stata interrotta</returns>
+        private bool ReadFrame(Byte[] header)
+        {
+            Console.WriteLine("In attesa di ricevere dati dal server...");
 
-                    // Conversione del buffer nell'ordine dei byte dell'host (Precedentemente era in ordine di rete)
-                    ushort conv_mod = BitConverter.ToUInt16(readBuffer, 0);
-                    int ModificationType = IPAddress.NetworkToHostOrder((short)conv_mod);
-                    Console.WriteLine("Tipo della modifica: {0}", ModificationType);
+            if (!ReadFully(header, EnvelopeSize))
+            {
+                Console.WriteLine("Connessione interrotta durante la lettura");
+                return false;
+            }
 
-                    // Ricezione del PID del processo. E' una DWORD che ha dimensioni pari ad uint
-                    n = Stream.Read(readBuffer, 0, sizeof(uint));
+            int Version = header[0];
+            int Type = header[1];
+            int Flags = (header[2] << 8) | header[3];
+            int Length = (int)ReadUInt32(header, 4);
+            if (Length < 0 || Length > MaxBatch)
+                throw new IOException("Frame non valido");
 
-                    if (!readSuccessful(n, sizeof(uint)))
-                        return;
+            Byte[] Payload = new Byte[Length];
+            if (!ReadFully(Payload, Length))
+            {
+                Console.WriteLine("Connessione persa durante la lettura di un frame");
+                return false;
+            }
 
-                    uint PID = BitConverter.ToUInt32(readBuffer, 0);
+            if (Version != ProtocolVersion)
+            {
+                Console.WriteLine("Versione del protocollo sconosciuta: {0}", Version);
+                return true;
+            }
 
-                    Console.WriteLine("PID: {0}", PID);
+            if (Type != FrameMessage && Type != PackedMessage)
+            {
+                HandleMessage(Type, Payload, 0, Length);
+                return true;
+            }
 
-                    // Switch sul tipo di modifica
-                    switch (ModificationType)
-                    {
-                        // CASO 0: Aggiunta di una nuova applicazione
-                        case 0:
+            // Frame compresso: lunghezza del payload originale seguita dal blocco LZ4
+            if ((Flags & FlagCompressed) != 0)
+            {
+                int PlainLength = (int)ReadUInt32(Payload, 0);
+                if (PlainLength <= 0 || PlainLength > MaxBatch)
+                    throw new IOException("Frame compresso non valido");
+                Payload = DecompressBlock(Payload, sizeof(uint), PlainLength);
+            }
+
+            if (Type == PackedMessage)
+            {
+                HandlePacked(Payload);
+                return true;
+            }
+
+            // Messaggi contenuti nel frame, ciascuno con il proprio envelope
+            int Position = 0;
+            while (Position < Payload.Length)
+            {
+                if (Payload.Length - Position < EnvelopeSize)
+                    throw new IOException("Frame non valido");
+                int MessageLength = (int)ReadUInt32(Payload, Position + 4);
+                if (MessageLength < 0 || MessageLength > Payload.Length - Position - EnvelopeSize)
+                    throw new IOException("Frame non valido");
+                if (Payload[Position] == ProtocolVersion)
+                    HandleMessage(Payload[Position + 1], Payload, Position + EnvelopeSize, MessageLength);
+                Position += EnvelopeSize + MessageLength;
+            }
+            return true;
+        }
+
+        /// <summary>
+        /// Gestione di un frame in codifica compatta: ogni record viene riportato nel formato dei messaggi normali
+        /// e gestito da HandleMessage. Un record inizia con tipo e flag (un byte), seguiti dal PID come differenza
+        /// (zigzag varint) dal PID del record precedente, per le add dal nome e, con PackedHash, dall'hash dell'icona;
+        /// per l'uso delle risorse seguono CPU e working set (varint).
+        /// </summary>
+        /// <param name="Payload">Payload del frame (già decompresso)</param>
+        private void HandlePacked(Byte[] Payload)
+        {
+            int Position = 0;
+            uint LastPID = 0;
+            while (Position < Payload.Length)
+            {
+                int Header = Payload[Position++];
+                int Type = Header & 0x0F;
 
-                            // Lettura della lunghezza del nome dell'applicazione
-                            n = Stream.Read(readBuffer, 0, sizeof(int));
+                uint PID = 0;
+                if (Type <= 2 || Type == 10 || Type == 12)
+                {
+                    uint Zigzag = ReadVarint(Payload, ref Position);
+                    PID = LastPID + (uint)((int)(Zigzag >> 1) ^ -(int)(Zigzag & 1));
+                    LastPID = PID;
+                }
+
+                // Nome: indice nella tabella dei nomi oppure testo UTF-8 (aggiunto alla tabella se StringStored)
+                String Name = null;
+                if (Type == 0)
+                {
+                    uint Tag = ReadVarint(Payload, ref Position);
+                    if (Tag >= StringReference)
+                    {
+                        if (Tag - StringReference >= Names.Count)
+                            throw new IOException("Nome non valido");
+                        Name = Names[(int)(Tag - StringReference)];
+                    }
+                    else
+                    {
+                        int NameLength = (int)ReadVarint(Payload, ref Position);
+                        CheckLength(Payload.Length - Position, NameLength);
+                        Name = Encoding.UTF8.GetString(Payload, Position, NameLength);
+                        Position += NameLength;
+                        if (Tag == StringStored)
+                            Names.Add(Name);
+                    }
+                }
 
-                            if (!readSuccessful(n, sizeof(uint)))
-                                return;
+                ulong Hash = 0;
+                if ((Header & PackedHash) != 0)
+                {
+                    CheckLength(Payload.Length - Position, sizeof(ulong));
+                    Hash = ReadUInt64(Payload, Position);
+                    Position += sizeof(ulong);
+                }
 
-                            // Conversione della lunghezza del nome in ordine dell'host
-                            int conv_length = BitConverter.ToInt32(readBuffer, 0);
-                            Console.WriteLine("Lunghezza convertita: {0}", conv_length);
-                            int NameLength = IPAddress.NetworkToHostOrder(conv_length);
-                            Console.WriteLine("Lunghezza nome: {0}", NameLength);
+                // Messaggio equivalente nel formato normale
+                Byte[] Message;
+                switch (Type)
+                {
+                    case 0:
+                        Byte[] NameBytes = Encoding.Unicode.GetBytes(Name + "\0");
+                        Message = new Byte[2 * sizeof(uint) + NameBytes.Length + sizeof(ulong)];
+                        WriteUInt32(Message, 0, PID);
+                        WriteUInt32(Message, sizeof(uint), (uint)NameBytes.Length);
+                        Buffer.BlockCopy(NameBytes, 0, Message, 2 * sizeof(uint), NameBytes.Length);
+                        WriteUInt32(Message, 2 * sizeof(uint) + NameBytes.Length, (uint)(Hash >> 32));
+                        WriteUInt32(Message, 3 * sizeof(uint) + NameBytes.Length, (uint)Hash);
+                        break;
+                    case 1:
+                    case 2:
+                        Message = new Byte[sizeof(uint)];
+                        WriteUInt32(Message, 0, PID);
+                        break;
+                    case 5:
+                        Message = new Byte[2 * sizeof(uint)];
+                        WriteUInt32(Message, 0, ReadVarint(Payload, ref Position));
+                        WriteUInt32(Message, sizeof(uint), ReadVarint(Payload, ref Position));
+                        break;
+                    case 12:
+                        Message = new Byte[3 * sizeof(uint)];
+                        WriteUInt32(Message, 0, PID);
+                        WriteUInt32(Message, sizeof(uint), ReadVarint(Payload, ref Position));
+                        WriteUInt32(Message, 2 * sizeof(uint), ReadVarint(Payload, ref Position));
+                        break;
+                    case 10:
+                        Message = new Byte[sizeof(uint) + sizeof(ulong)];
+                        WriteUInt32(Message, 0, PID);
+                        WriteUInt32(Message, sizeof(uint), (uint)(Hash >> 32));
+                        WriteUInt32(Message, 2 * sizeof(uint), (uint)Hash);
+                        break;
+                    default:
+                        Message = new Byte[0];
+                        break;
+                }
+                HandleMessage(Type, Message, 0, Message.Length);
+            }
+        }
 
-                            Byte[] NameBuffer = new Byte[NameLength];
+        /// <summary>
+        /// Gestione di un messaggio: il payload è già stato letto e si trova nel buffer indicato.
+        /// I tipi sconosciuti vengono ignorati (la lunghezza è nota dall'envelope).
+        /// </summary>
+        /// <param name="ModificationType">Tipo del messaggio</param>
+        /// <param name="buffer">Buffer che contiene il payload</param>
+        /// <param name="offset">Inizio del payload nel buffer</param>
+        /// <param name="length">Lunghezza del payload</param>
+        private void HandleMessage(int ModificationType, Byte[] buffer, int offset, int length)
+        {
+            Console.WriteLine("Tipo della modifica: {0}", ModificationType);
 
-                            String AppName = String.Empty;
+            // Le modifiche add, remove, change focus, icona estratta ed uso delle risorse iniziano con il PID del processo (in ordine di rete)
+            uint PID = 0;
+            if (ModificationType <= 2 || ModificationType == 10 || ModificationType == 12)
+            {
+                CheckLength(length, sizeof(uint));
+                PID = ReadUInt32(buffer, offset);
+                Console.WriteLine("PID: {0}", PID);
+            }
 
-                            // Lettura del nome dell'applicazione
-                            n = Stream.Read(NameBuffer, 0, NameLength);
+            // Switch sul tipo di modifica
+            switch (ModificationType)
+            {
+                // CASO 0: Aggiunta di una nuova applicazione
+                case 0:
 
-                            if (!readSuccessful(n, NameLength))
-                                return;
+                    // Lunghezza del nome dell'applicazione, nome ed hash dell'icona
+                    CheckLength(length, 2 * sizeof(uint) + sizeof(ulong));
+                    int NameLength = (int)ReadUInt32(buffer, offset + sizeof(uint));
+                    CheckLength(length, 2 * sizeof(uint) + NameLength + sizeof(ulong));
+                    Console.WriteLine("Lunghezza nome: {0}", NameLength);
 
-                            try
-                            {
-                                // Conversione in stringa
-                                AppName = System.Text.UnicodeEncoding.Unicode.GetString(NameBuffer);
-                                AppName = AppName.Replace("\0", String.Empty);
-                            }
-                            catch (ArgumentException)
-                            {
-                                AppName = "Nessun nome";
-                            }
+                    String AppName = String.Empty;
 
-                            Console.WriteLine("Nome dell'applicazione: {0}", AppName);
+                    try
+                    {
+                        // Conversione in stringa
+                        AppName = System.Text.UnicodeEncoding.Unicode.GetString(buffer, offset + 2 * sizeof(uint), NameLength);
+                        AppName = AppName.Replace("\0", String.Empty);
+                    }
+                    catch (ArgumentException)
+                    {
+                        AppName = "Nessun nome";
+                    }
 
-                            // Lettura della lunghezza dell'icona
+                    Console.WriteLine("Nome dell'applicazione: {0}", AppName);
 
-                            n = Stream.Read(readBuffer, 0, sizeof(int));
+                    // Hash dell'icona: i byte dell'icona vengono richiesti al server solo se non è già nota
+                    ulong IconHash = ReadUInt64(buffer, offset + 2 * sizeof(uint) + NameLength);
 
-                            if (!readSuccessful(n, sizeof(uint)))
-                                return;
+                    AppItem app = new AppItem(Item.ServerTab.MainWndw.DefaultIcon);
+                    app.PID = PID;
+                    app.Name = AppName;
 
-                            AppItem app = new AppItem(Item.ServerTab.MainWndw.DefaultIcon);
-                            app.PID = PID;
-                            app.Name = AppName;
+                    Console.WriteLine("Hash dell'icona: {0:X16}", IconHash);
 
-                            int conv_icon = BitConverter.ToInt32(readBuffer, 0);
-                            int IconLength = IPAddress.HostToNetworkOrder(conv_icon);
-                            Console.WriteLine("Lunghezza dell'icona: {0}", IconLength);
+                    // Hash nullo: l'applicazione non ha un'icona (o è ancora in estrazione sul server, seguirà il caso 10)
+                    // e resta quella di default
+                    ImageSource KnownIcon = LookupIcon(IconHash, app);
+                    if (KnownIcon != null)
+                        app.Icon = KnownIcon;
 
-                            // Se la dimensione è valida la si sostituisce a quella di default
-                            if (IconLength != 0 && IconLength < 1048576)
-                            {
-                                Console.WriteLine("Icona valida trovata");
+                    // Aggiunta di una nuova applicazione e notifica del cambiamento nella lista
+                    Item.Dispatcher.Invoke(DispatcherPriority.Send, new Action(() =>
+                   {
+                       lock (Item.Applications)
+                       {
+                           Item.Applications.Add(app);
+                       }
+                   }));
 
-                                // Lettura dell'icona dallo stream in blocchi da 1024 byte
-                                Byte[] BufferIcon = new Byte[IconLength];
+                    Item.Dispatcher.Invoke(DispatcherPriority.Send, new Action(() =>
+                    {
+                        Item.ApplistRerrangeView(Item.Applist, new NotifyCollectionChangedEventArgs(NotifyCollectionChangedAction.Add, app));
+                    }));
 
-                                int TotalRead = 0;
-                                int ToRead = 1024;
+                    break;
 
-                                while (TotalRead != IconLength)
-                                {
-                                    if (ToRead > IconLength - TotalRead)
-                                        ToRead = IconLength - TotalRead;
+                // Caso 1: rimozione di un'applicazione
+                case 1:
+                    Console.WriteLine("Modifica: Rimozione");
 
-                                    n = Stream.Read(BufferIcon, TotalRead, ToRead);
+                    // Rimozione dell'applicazione dalla lista
+                    Monitor.Enter(Item.Applications);
+                    foreach (AppItem appItem in Item.Applications)
+                    {
+                        if (appItem.PID == PID)
+                        {
+                            Console.WriteLine("Rimozione applicazione: {0}", appItem.Name);
+                            Monitor.Exit(Item.Applications);
+                            this.Item.Dispatcher.Invoke(DispatcherPriority.Send,
+                                new Action(() => { lock (Item.Applications) { this.Item.Applications.Remove(appItem); } }));
+                            Monitor.Enter(Item.Applications);
+                            break;
+                        }
+                    }
+                    Monitor.Exit(Item.Applications);
+                    break;
 
-                                    if (n == 0)
-                                    {
-                                        Console.WriteLine("Connessione persa durante la lettura dell'icona");
-                                        return;
-                                    }
+                // Caso 3: cambio di focus
+                case 2:
+                    Console.WriteLine("Modifica: Change Focus");
 
-                                    TotalRead += n;
+                    // Pulizia della selezione precedente
+                    this.Item.ServerTab.MainWndw.Dispatcher.Invoke(DispatcherPriority.Send, new Action(() => { this.Item.Applist.SelectedItem = null; }));
 
-                                }
 
-                                if (TotalRead != IconLength)
+                    // Applicazione che perde il focus
+                    this.Item.ServerTab.MainWndw.Dispatcher.Invoke(DispatcherPriority.Send,
+                                new Action(() =>
                                 {
-                                    Console.WriteLine("Si è verificato un errore durante la lettura dell'icona");
-                                    Item.ServerTab.MainWndw.Dispatcher.BeginInvoke(DispatcherPriority.Normal, new Action(() =>
-                                   {
-                                       Item.ServerTab.MainWndw.CloseTab(Item.ServerTab);
-                                   }));
-                                }
-
-                                unsafe
+                                    // Aggiornamento lista app in foreground
+                                    int index = this.Item.ServerTab.MainWndw.ForegroundApps.IndexOf(new ForegroundApp(Item.ServerTab.ForegroundApp, 0));
+                                    if (index != -1)
+                                    {
+                                        if (--this.Item.ServerTab.MainWndw.ForegroundApps[index].Count <= 0)
+                                            this.Item.ServerTab.MainWndw.ForegroundApps.RemoveAt(index);
+                                    }
+                                }));
+                    // Ricerca delle applicazioni coinvolte nel cambiamento
+                    Monitor.Enter(Item.Applications);
+                    foreach (AppItem appItem in Item.Applications)
+                    {
+                        // Applicazione che guadagna il focus
+                        if (appItem.PID == PID)
+                        {
+                            Console.WriteLine("Pid: {0} - applicazione: {1}", PID, appItem.Name);
+                            Monitor.Exit(Item.Applications);
+                            this.Item.ServerTab.MainWndw.Dispatcher.Invoke(DispatcherPriority.Send,
+                                new Action(() =>
                                 {
-                                    fixed (byte* buffer = &BufferIcon[0])
+                                    lock (Item.Applications)
                                     {
-                                        IntPtr Hicon = CreateIconFromResourceEx((IntPtr)buffer, (uint)IconLength, 1, 0x00030000, 48, 48, 0);
-
-                                        if (Hicon != null)
+                                        // Evidenziazione elemento nella tab
+                                        appItem.HasFocus = true;
+                                        this.Item.Applist.SelectedItem = appItem;
+                                        this.Item.ServerTab.ForegroundApp = appItem.Name;
+                                        // Aggiornamento lista delle app in foreground
+                                        int index = this.Item.ServerTab.MainWndw.ForegroundApps.IndexOf(new ForegroundApp(appItem.Name, 0));
+                                        if (index != -1)
+                                            this.Item.ServerTab.MainWndw.ForegroundApps[index].Count++;
+                                        else
                                         {
-                                            BitmapFrame bitmap = BitmapFrame.Create(Imaging.CreateBitmapSourceFromHIcon(Hicon, new Int32Rect(0, 0, 48, 48), BitmapSizeOptions.FromEmptyOptions()));
-                                            if (bitmap.CanFreeze)
-                                            {
-                                                bitmap.Freeze();
-                                                app.Icon = bitmap;
-                                            }
-
-                                            DestroyIcon(Hicon);
+                                            ForegroundApp newapp = new ForegroundApp(appItem.Name, 1);
+                                            this.Item.ServerTab.MainWndw.ForegroundApps.Add(newapp);
+                                            if (!this.Item.ServerTab.MainWndw.ForegroundAppsBox.IsEnabled)
+                                                this.Item.ServerTab.MainWndw.ForegroundAppsBox.SelectedItem = newapp;
                                         }
                                     }
-                                }
-                            }
-
+                                }));
+                            Monitor.Enter(Item.Applications);
+                        }
+                        else if (appItem.HasFocus)
+                            appItem.HasFocus = false;
+                    }
+                    Monitor.Exit(Item.Applications);
+                    // Aggiornamento delle percentuali
+                    Item.Dispatcher.Invoke(DispatcherPriority.Send,
+                                     new Action(() => { Item.PercentageRefresh(); }));
+                    break;
+
+                case 3:
+                    break;
+
+                // Caso 4: icona richiesta dal client (hash, lunghezza e byte dell'icona)
+                case 4:
+                    CheckLength(length, sizeof(ulong) + sizeof(uint));
+                    ulong Hash = ReadUInt64(buffer, offset);
+                    int IconLength = (int)ReadUInt32(buffer, offset + sizeof(ulong));
+                    CheckLength(length, sizeof(ulong) + sizeof(uint) + IconLength);
+                    Console.WriteLine("Icona {0:X16}, lunghezza: {1}", Hash, IconLength);
+
+                    ImageSource Icon = null;
+
+                    // Lunghezza nulla: il server non ha più l'icona, resta quella di default
+                    if (IconLength != 0 && IconLength < 1048576)
+                    {
+                        Byte[] BufferIcon = new Byte[IconLength];
+                        Buffer.BlockCopy(buffer, offset + sizeof(ulong) + sizeof(uint), BufferIcon, 0, IconLength);
 
-                            // Aggiunta di una nuova applicazione e notifica del cambiamento nella lista
-                            Item.Dispatcher.Invoke(DispatcherPriority.Send, new Action(() =>
-                           {
-                               lock (Item.Applications)
-                               {
-                                   Item.Applications.Add(app);
-                               }
-                           }));
+                        Icon = IconStore.Decode(BufferIcon, IconSize);
+                        if (Icon != null)
+                            IconStore.Add(Hash, Icon);
+                    }
 
+                    // Aggiornamento delle applicazioni in attesa di questa icona
+                    List<AppItem> Waiting;
+                    if (PendingIcons.TryGetValue(Hash, out Waiting))
+                    {
+                        PendingIcons.Remove(Hash);
+                        if (Icon != null)
                             Item.Dispatcher.Invoke(DispatcherPriority.Send, new Action(() =>
                             {
-                                Item.ApplistRerrangeView(Item.Applist, new NotifyCollectionChangedEventArgs(NotifyCollectionChangedAction.Add, app));
+                                foreach (AppItem waitingApp in Waiting)
+                                    waitingApp.Icon = Icon;
                             }));
+                    }
+                    break;
+
+                // Caso 5: sequenza dell'ultima modifica inviata (epoca e sequenza in ordine di rete)
+                case 5:
+                    CheckLength(length, 2 * sizeof(uint));
+                    Item.Epoch = ReadUInt32(buffer, offset);
+                    Item.LastSequence = ReadUInt32(buffer, offset + sizeof(uint));
+                    Console.WriteLine("Sequenza: {0}", Item.LastSequence);
+                    break;
+
+                // Caso 6: il server sta per inviare la lista completa, quella corrente viene svuotata
+                case 6:
+                    Item.Dispatcher.Invoke(DispatcherPriority.Send, new Action(() =>
+                    {
+                        lock (Item.Applications)
+                        {
+                            Item.Applications.Clear();
+                        }
+                    }));
+                    break;
+
+                // Caso 7: capacità accettate dal server (con CapIconSize seguite dalla dimensione delle icone)
+                case 7:
+                    CheckLength(length, sizeof(uint));
+                    uint Accepted = ReadUInt32(buffer, offset);
+                    if ((Accepted & CapIconSize) != 0)
+                    {
+                        CheckLength(length, 2 * sizeof(uint));
+                        IconSize = (int)ReadUInt32(buffer, offset + sizeof(uint));
+                    }
+                    Console.WriteLine("Capacità accettate dal server: {0}, icone {1}x{1}", Accepted, IconSize);
+                    break;
+
+                // Caso 9: tempi di un comando con timestamp (timestamp del client, attesa ed iniezione sul server in microsecondi)
+                case 9:
+                    CheckLength(length, sizeof(ulong) + 2 * sizeof(uint));
+                    long Sent = (long)ReadUInt64(buffer, offset);
+                    double Total = (Stopwatch.GetTimestamp() - Sent) * 1000000.0 / Stopwatch.Frequency;
+                    uint QueueMicros = ReadUInt32(buffer, offset + sizeof(ulong));
+                    uint InjectMicros = ReadUInt32(buffer, offset + sizeof(ulong) + sizeof(uint));
+                    Console.WriteLine("Latenza del comando: {0:F0} us (server: attesa {1} us, iniezione {2} us, rete {3:F0} us)",
+                        Total, QueueMicros, InjectMicros, Total - QueueMicros - InjectMicros);
+                    break;
+
+                // Caso 10: icona di un'applicazione già ricevuta, estratta dal server in background (hash nullo: icona di default)
+                case 10:
+                    CheckLength(length, sizeof(uint) + sizeof(ulong));
+                    ulong UpdatedHash = ReadUInt64(buffer, offset + sizeof(uint));
+                    Console.WriteLine("Icona dell'applicazione {0}: {1:X16}", PID, UpdatedHash);
+
+                    AppItem Updated = null;
+                    lock (Item.Applications)
+                    {
+                        foreach (AppItem appItem in Item.Applications)
+                            if (appItem.PID == PID)
+                                Updated = appItem;
+                    }
+                    if (Updated != null)
+                    {
+                        ImageSource UpdatedIcon = LookupIcon(UpdatedHash, Updated) ?? Item.ServerTab.MainWndw.DefaultIcon;
+                        Item.Dispatcher.Invoke(DispatcherPriority.Send, new Action(() => { Updated.Icon = UpdatedIcon; }));
+                    }
+                    break;
 
-                            break;
-
-                        // Caso 1: rimozione di un'applicazione
-                        case 1:
-                            Console.WriteLine("Modifica: Rimozione");
-
-                            // Rimozione dell'applicazione dalla lista
-                            Monitor.Enter(Item.Applications);
-                            foreach (AppItem appItem in Item.Applications)
-                            {
-                                if (appItem.PID == PID)
-                                {
-                                    Console.WriteLine("Rimozione applicazione: {0}", appItem.Name);
-                                    Monitor.Exit(Item.Applications);
-                                    this.Item.Dispatcher.Invoke(DispatcherPriority.Send,
-                                        new Action(() => { lock (Item.Applications) { this.Item.Applications.Remove(appItem); } }));
-                                    Monitor.Enter(Item.Applications);
-                                    break;
-                                }
-                            }
-                            Monitor.Exit(Item.Applications);
-                            break;
+                // Caso 12: uso delle risorse di un'applicazione (CPU in centesimi di punto percentuale, working set in KB)
+                case 12:
+                    CheckLength(length, 3 * sizeof(uint));
+                    double Cpu = ReadUInt32(buffer, offset + sizeof(uint)) / 100.0;
+                    uint Memory = ReadUInt32(buffer, offset + 2 * sizeof(uint));
 
-                        // Caso 3: cambio di focus
-                        case 2:
-                            Console.WriteLine("Modifica: Change Focus");
+                    AppItem Sampled = null;
+                    lock (Item.Applications)
+                    {
+                        foreach (AppItem appItem in Item.Applications)
+                            if (appItem.PID == PID)
+                                Sampled = appItem;
+                    }
+                    if (Sampled != null)
+                        Item.Dispatcher.Invoke(DispatcherPriority.Send, new Action(() => { Sampled.Cpu = Cpu; Sampled.Memory = Memory; }));
+                    break;
 
-                            // Pulizia della selezione precedente
-                            this.Item.ServerTab.MainWndw.Dispatcher.Invoke(DispatcherPriority.Send, new Action(() => { this.Item.Applist.SelectedItem = null; }));
+                default:
+                    Console.WriteLine("Modifica sconosciuta");
+                    break;
+            }
+        }
 
+        /// <summary>
+        /// Verifica che il payload di un messaggio contenga almeno i campi attesi
+        /// </summary>
+        private static void CheckLength(int length, int expected)
+        {
+            if (expected < 0 || length < expected)
+                throw new IOException("Messaggio non valido");
+        }
 
-                            // Applicazione che perde il focus
-                            this.Item.ServerTab.MainWndw.Dispatcher.Invoke(DispatcherPriority.Send,
-                                        new Action(() =>
-                                        {
-                                            // Aggiornamento lista app in foreground
-                                            int index = this.Item.ServerTab.MainWndw.ForegroundApps.IndexOf(new ForegroundApp(Item.ServerTab.ForegroundApp, 0));
-                                            if (index != -1)
-                                            {
-                                                if (--this.Item.ServerTab.MainWndw.ForegroundApps[index].Count <= 0)
-                                                    this.Item.ServerTab.MainWndw.ForegroundApps.RemoveAt(index);
-                                            }
-                                        }));
-                            // Ricerca delle applicazioni coinvolte nel cambiamento
-                            Monitor.Enter(Item.Applications);
-                            foreach (AppItem appItem in Item.Applications)
-                            {
-                                // Applicazione che guadagna il focus
-                                if (appItem.PID == PID)
-                                {
-                                    Console.WriteLine("Pid: {0} - applicazione: {1}", PID, appItem.Name);
-                                    Monitor.Exit(Item.Applications);
-                                    this.Item.ServerTab.MainWndw.Dispatcher.Invoke(DispatcherPriority.Send,
-                                        new Action(() =>
-                                        {
-                                            lock (Item.Applications)
-                                            {
-                                                // Evidenziazione elemento nella tab
-                                                appItem.HasFocus = true;
-                                                this.Item.Applist.SelectedItem = appItem;
-                                                this.Item.ServerTab.ForegroundApp = appItem.Name;
-                                                // Aggiornamento lista delle app in foreground
-                                                int index = this.Item.ServerTab.MainWndw.ForegroundApps.IndexOf(new ForegroundApp(appItem.Name, 0));
-                                                if (index != -1)
-                                                    this.Item.ServerTab.MainWndw.ForegroundApps[index].Count++;
-                                                else
-                                                {
-                                                    ForegroundApp newapp = new ForegroundApp(appItem.Name, 1);
-                                                    this.Item.ServerTab.MainWndw.ForegroundApps.Add(newapp);
-                                                    if (!this.Item.ServerTab.MainWndw.ForegroundAppsBox.IsEnabled)
-                                                        this.Item.ServerTab.MainWndw.ForegroundAppsBox.SelectedItem = newapp;
-                                                }
-                                            }
-                                        }));
-                                    Monitor.Enter(Item.Applications);
-                                }
-                                else if (appItem.HasFocus)
-                                    appItem.HasFocus = false;
-                            }
-                            Monitor.Exit(Item.Applications);
-                            // Aggiornamento delle percentuali
-                            Item.Dispatcher.Invoke(DispatcherPriority.Send,
-                                             new Action(() => { Item.PercentageRefresh(); }));
-                            break;
+        /// <summary>
+        /// Lettura di un intero a 32 bit in ordine di rete
+        /// </summary>
+        private static uint ReadUInt32(Byte[] buffer, int offset)
+        {
+            return ((uint)buffer[offset] << 24) | ((uint)buffer[offset + 1] << 16) | ((uint)buffer[offset + 2] << 8) | buffer[offset + 3];
+        }
 
-                        case 3:
-                            break;
-                        default:
-                            Console.WriteLine("Modifica sconosciuta");
-                            break;
-                    }
-                }
-                Console.WriteLine("Thread - terminata ricezione dati dal server");
-            }
-            catch (NullReferenceException)
-            {
-                ExceptionHandler.ReceiveConnectionError(Item);
-            }
-            catch (IOException)
-            {
-                ExceptionHandler.ReceiveConnectionError(Item);
-            }
-            catch (ObjectDisposedException)
+        /// <summary>
+        /// Lettura di un varint (7 bit per byte, dal gruppo meno significativo) della codifica compatta
+        /// </summary>
+        private static uint ReadVarint(Byte[] buffer, ref int offset)
+        {
+            uint value = 0;
+            for (int shift = 0; shift < 35; shift += 7)
             {
-                ExceptionHandler.ReceiveConnectionError(Item);
+                if (offset >= buffer.Length)
+                    throw new IOException("Varint non valido");
+                byte b = buffer[offset++];
+                value |= (uint)(b & 0x7F) << shift;
+                if ((b & 0x80) == 0)
+                    return value;
             }
-            catch (ArgumentOutOfRangeException)
+            throw new IOException("Varint non valido");
+        }
+
+        /// <summary>
+        /// Scrittura di un intero a 32 bit in ordine di rete
+        /// </summary>
+        private static void WriteUInt32(Byte[] buffer, int offset, uint value)
+        {
+            for (int i = 0; i < sizeof(uint); i++)
+                buffer[offset + i] = (byte)(value >> (24 - 8 * i));
+        }
+
+        /// <summary>
+        /// Lettura di un hash a 64 bit in ordine di rete
+        /// </summary>
+        private static ulong ReadUInt64(Byte[] buffer, int offset)
+        {
+            return ((ulong)ReadUInt32(buffer, offset) << 32) | ReadUInt32(buffer, offset + sizeof(uint));
+        }
+
+        /// <summary>
+        /// Lettura di esattamente count byte dallo stream (una Read può restituire meno byte di quelli richiesti)
+        /// </summary>
+        /// <param name="buffer">Buffer di destinazione</param>
+        /// <param name="count">Numero di byte da leggere</param>
+        /// <returns>false se la connessione è stata chiusa</returns>
+        private bool ReadFully(Byte[] buffer, int count)
+        {
+            int TotalRead = 0;
+            while (TotalRead != count)
             {
-                ExceptionHandler.ReceiveConnectionError(Item);
+                int n = Stream.Read(buffer, TotalRead, count - TotalRead);
+                if (n == 0)
+                    return false;
+                TotalRead += n;
             }
-            catch (OutOfMemoryException)
+            return true;
+        }
+
+        /// <summary>
+        /// Icona con l'hash indicato, se già nota. Un'icona sconosciuta viene richiesta al server (una sola volta anche se
+        /// più applicazioni la condividono) e l'applicazione viene aggiornata all'arrivo dei byte (caso 4).
+        /// </summary>
+        /// <param name="IconHash">Hash dell'icona (0: nessuna icona)</param>
+        /// <param name="app">Applicazione che usa l'icona</param>
+        /// <returns>Icona nota, oppure null (icona di default o in arrivo)</returns>
+        private ImageSource LookupIcon(ulong IconHash, AppItem app)
+        {
+            if (IconHash == 0)
+                return null;
+
+            ImageSource KnownIcon;
+            if (IconStore.TryGet(IconHash, out KnownIcon))
+                return KnownIcon;
+
+            List<AppItem> waiting;
+            if (!PendingIcons.TryGetValue(IconHash, out waiting))
             {
-                ExceptionHandler.MemoryError(Item.ServerTab.MainWndw);
+                waiting = new List<AppItem>();
+                PendingIcons[IconHash] = waiting;
+                RequestIcon(IconHash);
             }
+            waiting.Add(app);
+            return null;
         }
 
+        /// <summary>
+        /// Richiesta al server dei byte di un'icona: hash in ordine di rete
+        /// </summary>
+        private void RequestIcon(ulong hash)
+        {
+            byte[] request = new byte[sizeof(ulong)];
+            for (int i = 0; i < sizeof(ulong); i++)
+                request[i] = (byte)(hash >> (56 - 8 * i));
+            Item.SendCommand(ServerTabManagement.CommandIcon, request);
+        }
 
         /// <summary>
-        /// Metodo per verificare la corretta lettura dal server.
+        /// Handshake delle capacità: capacità richieste e dimensione delle icone, in ordine di rete
         /// </summary>
-        /// <param name="byteread">Numero di byte letti</param>
-        /// <param name="bytetoread">Numero di byte che bisognava leggere</param>
-        /// <returns></returns>
-        private bool readSuccessful(int byteread, int bytetoread)
+        private void RequestCapabilities()
         {
-            if (byteread == 0)
+            byte[] request = new byte[2 * sizeof(uint)];
+            for (int i = 0; i < sizeof(uint); i++)
             {
-                Console.WriteLine("Connessione interrotta durante la lettura");
-                return false;
+                request[i] = (byte)((CapCompression | CapIconSize | CapCompact) >> (24 - 8 * i));
+                request[sizeof(uint) + i] = (byte)(PreferredIconSize >> (24 - 8 * i));
             }
+            Item.SendCommand(ServerTabManagement.CommandHello, request);
+        }
 
-            else if (byteread != bytetoread)
+        /// <summary>
+        /// Decompressione di un blocco LZ4: sequenze di letterali seguite da un riferimento all'indietro (distanza e lunghezza)
+        /// </summary>
+        /// <param name="source">Buffer che contiene il blocco compresso</param>
+        /// <param name="offset">Inizio del blocco nel buffer (il blocco termina con il buffer)</param>
+        /// <param name="length">Lunghezza dei dati decompressi</param>
+        /// <returns>Dati decompressi</returns>
+        private static Byte[] DecompressBlock(Byte[] source, int offset, int length)
+        {
+            Byte[] output = new Byte[length];
+            int ip = offset, op = 0;
+
+            while (ip < source.Length)
             {
-                Console.WriteLine("La lettura non ha avuto successo");
-                MessageBox.Show("Server" + Item.ServerTab.Header as String + ": Connessione interrotta");
-                Item.ServerTab.MainWndw.Dispatcher.BeginInvoke(DispatcherPriority.Normal, new Action(() =>
-               {
-                   Item.ServerTab.MainWndw.CloseTab(Item.ServerTab);
-               }));
+                int token = source[ip++];
 
-                return false;
+                // Letterali: lunghezza nel nibble alto del token, più eventuali byte aggiuntivi
+                int literals = token >> 4;
+                if (literals == 15)
+                {
+                    int b;
+                    do { b = source[ip++]; literals += b; } while (b == 255);
+                }
+                if (op + literals > length || ip + literals > source.Length)
+                    throw new IOException("Frame compresso non valido");
+                Buffer.BlockCopy(source, ip, output, op, literals);
+                ip += literals;
+                op += literals;
+
+                // L'ultima sequenza contiene solo letterali
+                if (ip >= source.Length)
+                    break;
+
+                int distance = source[ip] | (source[ip + 1] << 8);
+                ip += 2;
+                int match = token & 15;
+                if (match == 15)
+                {
+                    int b;
+                    do { b = source[ip++]; match += b; } while (b == 255);
+                }
+                match += 4;
+                if (distance == 0 || distance > op || op + match > length)
+                    throw new IOException("Frame compresso non valido");
 
+                // Copia byte per byte: il riferimento può sovrapporsi ai dati che sta producendo
+                for (int i = 0; i < match; i++, op++)
+                    output[op] = output[op - distance];
             }
 
-            return true;
+            if (op != length)
+                throw new IOException("Frame compresso non valido");
+            return output;
+        }
+
+        /// <summary>
+        /// Richiesta di ripresa: epoca e sequenza dell'ultima modifica ricevuta, in ordine di rete
+        /// </summary>
+        private void RequestResume()
+        {
+            byte[] request = new byte[2 * sizeof(uint)];
+            for (int i = 0; i < sizeof(uint); i++)
+            {
+                request[i] = (byte)(Item.Epoch >> (24 - 8 * i));
+                request[sizeof(uint) + i] = (byte)(Item.LastSequence >> (24 - 8 * i));
+            }
+            Item.SendCommand(ServerTabManagement.CommandResume, request);
         }
     }// Class closing bracket
 
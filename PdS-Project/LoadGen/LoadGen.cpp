@@ -0,0 +1,572 @@
+#ifdef _WIN32
+#pragma comment(lib,"Ws2_32.lib")
+#endif
+#include "../Server/Platform.hpp"
+#include "../Server/Poller.hpp"
+#include "../Server/LatencyHistogram.hpp"
+#include "../Server/SocketStream.hpp"
+#include "../Server/Compression.hpp"
+#include "../Server/CompactEncoding.hpp"
+#include <vector>
+#include <string>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <atomic>
+#include <thread>
+#include <chrono>
+#include <random>
+#include <iostream>
+#include <iomanip>
+#include <cstdlib>
+#include <cstring>
+#include <algorithm>
+
+#define MSGADD 0						// tipi dei messaggi del server (vedi changeType in Change.hpp)
+#define MSGSEQ 5
+#define MSGFRAME 8
+#define MSGECHO 9
+#define MSGPACKED 11
+#define CMDKEYS 0						// tipi dei comandi del client (vedi commandType in ListHandler.hpp)
+#define CMDRESUME 3
+#define CMDHELLO 4
+#define MAXFRAME (8 * 1024 * 1024)		// frame piu' grande accettato (come il client)
+#define STALLTIMEOUT 5000				// ms senza frame dopo i quali il server e' considerato bloccato (heartbeat ogni 2 s)
+#define WORKERTICK 10					// attesa massima (ms) del Poller di un worker
+#define RECVLENGTH 65536
+
+/*	Generatore di carico e soak test del server.
+*	Apre N client simulati verso la porta del server, distribuiti su alcuni thread worker (ognuno con il proprio Poller).
+*	Ogni client legge e verifica lo stream della lista (envelope, frame e messaggi), invia comandi da tastiera con timestamp
+*	alla frequenza richiesta (il server risponde con un echo: si misura la latenza del comando) e, se richiesto, si disconnette
+*	dopo una durata casuale e si riconnette chiedendo la ripresa dall'ultima sequenza ricevuta.
+*	Con --caps i client richiedono le capacita' indicate (es. 5: compressione e codifica compatta): i frame compressi
+*	vengono decompressi ed i frame packed decodificati record per record, verificando anche i riferimenti alla tabella dei nomi.
+*	Ogni secondo vengono riportati throughput, latenze ed errori; un client che non riceve nulla per STALLTIMEOUT ms
+*	(nemmeno l'heartbeat) indica un server bloccato, ad esempio per un deadlock di serverManagementList.
+*	Uso: LoadGen [--host 127.0.0.1] [--port 2000] [--clients 100] [--duration 30] [--rate 10] [--lifetime 0]
+*	             [--reconnect 100] [--threads 4] [--caps 0]
+*/
+
+typedef std::chrono::steady_clock Clock;
+
+struct LoadOptions {
+	std::string host = "127.0.0.1";
+	int port = 2000;
+	int clients = 100;
+	int duration = 30;				// durata del test (s)
+	double rate = 10;				// comandi al secondo per client (0: nessun comando)
+	double lifetime = 0;			// durata media (s) di una connessione prima della disconnessione (0: mai)
+	int reconnect = 100;			// attesa (ms) prima di riconnettersi
+	int threads = 4;
+	DWORD caps = 0;					// capacita' richieste all'handshake (0: nessun handshake)
+};
+
+/* Contatori condivisi dai worker: il thread principale li legge ogni secondo */
+struct LoadCounters {
+	std::atomic<unsigned long long> connects{ 0 }, disconnects{ 0 }, frames{ 0 }, messages{ 0 }, bytes{ 0 }, commands{ 0 }, echoes{ 0 };
+	std::atomic<unsigned long long> compressedFrames{ 0 }, packedFrames{ 0 };
+	std::atomic<unsigned long long> connectErrors{ 0 }, protocolErrors{ 0 }, serverCloses{ 0 }, sendErrors{ 0 }, stalls{ 0 };
+	std::atomic<long long> connected{ 0 };
+	std::mutex latencyMutex;
+	LatencyHistogram interval, total;			// latenza dei comandi (invio -> echo), in microsecondi
+};
+
+/* Client simulato: stato della connessione e posizione nello stream della lista */
+struct SimClient {
+	SOCKET s = INVALID_SOCKET;
+	std::vector<char> in;			// dati ricevuti non ancora analizzati
+	std::string out;				// comandi non ancora accettati dal kernel
+	std::vector<char> plain;		// payload decompresso dell'ultimo frame compresso
+	DWORD names = 0;				// nomi memorizzati nella tabella della connessione (codifica compatta)
+	Clock::time_point nextCommand, disconnectAt, reconnectAt, lastFrame;
+	bool resume = false;			// ha ricevuto almeno una sequenza: alla riconnessione chiede la ripresa
+	DWORD epoch = 0, sequence = 0;
+	int key = 0;
+};
+
+static std::atomic_bool running(true);
+
+static DWORD readDword(const char* p) {
+	DWORD v;
+	memcpy(&v, p, sizeof(v));
+	return ntohl(v);
+}
+
+static unsigned long long nowNanos() {
+	return (unsigned long long) std::chrono::duration_cast<std::chrono::nanoseconds>(Clock::now().time_since_epoch()).count();
+}
+
+/* Comando con l'envelope del protocollo; con timed il payload e' preceduto dal timestamp (echo dal server) */
+static void appendCommand(std::string& out, unsigned char type, const char* payload, DWORD length, bool timed) {
+	char header[ENVELOPESIZE];
+	DWORD total = length + (timed ? 8 : 0);
+	header[0] = PROTOCOLVERSION;
+	header[1] = (char) type;
+	u_short flags = htons(timed ? FLAGTIMESTAMP : 0);
+	memcpy(header + 2, &flags, sizeof(flags));
+	DWORD netLength = htonl(total);
+	memcpy(header + 4, &netLength, sizeof(netLength));
+	out.append(header, ENVELOPESIZE);
+	if (timed) {
+		unsigned long long stamp = nowNanos();
+		for (int i = 7; i >= 0; i--)
+			out.push_back((char) (stamp >> (8 * i)));
+	}
+	out.append(payload, length);
+}
+
+class Worker {
+	const LoadOptions& options;
+	LoadCounters& counters;
+	struct sockaddr_in addr;
+	std::vector<SimClient> clients;
+	std::map<SOCKET, size_t> bySocket;
+	Poller poller;
+	std::mt19937 random;
+
+	void connectClient(SimClient& c, Clock::time_point now);
+	void closeClient(SimClient& c, Clock::time_point now);
+	void readClient(SimClient& c, Clock::time_point now);
+	bool parseFrames(SimClient& c, Clock::time_point now);
+	bool parseMessages(SimClient& c, const char* p, const char* end);
+	bool parsePacked(SimClient& c, const char* p, const char* end);
+	void recordEcho(const char* payload);
+	void flush(SimClient& c, Clock::time_point now);
+
+public:
+	Worker(const LoadOptions& o, LoadCounters& k, const struct sockaddr_in& a, int count, unsigned seed)
+		: options(o), counters(k), addr(a), clients(count), random(seed) {}
+	void run(Clock::time_point end);
+};
+
+/* Connessione (bloccante, poi il socket diventa non bloccante) e richiesta di ripresa se il client conosce gia' una sequenza */
+void Worker::connectClient(SimClient& c, Clock::time_point now) {
+	SOCKET s = socket(AF_INET, SOCK_STREAM, IPPROTO_TCP);
+	u_long nonBlocking = 1;
+	if (s == INVALID_SOCKET || connect(s, (struct sockaddr*) &addr, sizeof(addr)) != 0 ||
+		ioctlsocket(s, FIONBIO, &nonBlocking) == SOCKET_ERROR) {
+		if (s != INVALID_SOCKET)
+			closesocket(s);
+		counters.connectErrors++;
+		c.reconnectAt = now + std::chrono::milliseconds(options.reconnect);
+		return;
+	}
+
+	c.s = s;
+	c.in.clear();
+	c.out.clear();
+	c.names = 0;
+	c.lastFrame = now;
+	c.nextCommand = now;
+	c.disconnectAt = Clock::time_point::max();
+	if (options.lifetime > 0) {
+		std::exponential_distribution<double> life(1.0 / options.lifetime);
+		c.disconnectAt = now + std::chrono::microseconds((long long) (life(random) * 1e6));
+	}
+	bySocket[s] = &c - clients.data();
+	poller.add(s, POLLER_READ);
+	counters.connects++;
+	counters.connected++;
+
+	/* handshake prima della richiesta di ripresa: la lista arriva gia' nella codifica richiesta */
+	if (options.caps != 0) {
+		DWORD caps = htonl(options.caps);
+		appendCommand(c.out, CMDHELLO, (const char*) &caps, sizeof(caps), false);
+	}
+	if (c.resume) {
+		char request[8];
+		DWORD epoch = htonl(c.epoch), sequence = htonl(c.sequence);
+		memcpy(request, &epoch, 4);
+		memcpy(request + 4, &sequence, 4);
+		appendCommand(c.out, CMDRESUME, request, sizeof(request), false);
+	}
+}
+
+void Worker::closeClient(SimClient& c, Clock::time_point now) {
+	if (c.s == INVALID_SOCKET)
+		return;
+	poller.remove(c.s);
+	bySocket.erase(c.s);
+	closesocket(c.s);
+	c.s = INVALID_SOCKET;
+	c.reconnectAt = now + std::chrono::milliseconds(options.reconnect);
+	counters.disconnects++;
+	counters.connected--;
+}
+
+/* Invio dei comandi in coda: quelli che il kernel non accetta restano per il prossimo giro */
+void Worker::flush(SimClient& c, Clock::time_point now) {
+	while (!c.out.empty()) {
+		int n = send(c.s, c.out.data(), (int) c.out.size(), MSG_NOSIGNAL);
+		if (n == SOCKET_ERROR) {
+			if (WSAGetLastError() == WSAEWOULDBLOCK)
+				return;
+			counters.sendErrors++;
+			closeClient(c, now);
+			return;
+		}
+		c.out.erase(0, n);
+	}
+}
+
+/* Lettura di tutti i dati disponibili ed analisi dei frame completi */
+void Worker::readClient(SimClient& c, Clock::time_point now) {
+	char buffer[RECVLENGTH];
+	while (c.s != INVALID_SOCKET) {
+		int n = recv(c.s, buffer, sizeof(buffer), 0);
+		if (n == 0) {
+			counters.serverCloses++;
+			closeClient(c, now);
+			return;
+		}
+		if (n == SOCKET_ERROR) {
+			if (WSAGetLastError() != WSAEWOULDBLOCK) {
+				counters.serverCloses++;
+				closeClient(c, now);
+			}
+			break;
+		}
+		counters.bytes += n;
+		c.in.insert(c.in.end(), buffer, buffer + n);
+	}
+
+	if (c.s != INVALID_SOCKET && !parseFrames(c, now)) {
+		counters.protocolErrors++;
+		closeClient(c, now);
+	}
+}
+
+/* Latenza di un comando: il payload dell'echo inizia con il timestamp del comando */
+void Worker::recordEcho(const char* payload) {
+	unsigned long long stamp = 0;
+	for (int i = 0; i < 8; i++)
+		stamp = (stamp << 8) | (unsigned char) payload[i];
+	unsigned long long elapsed = (nowNanos() - stamp) / 1000;
+	std::lock_guard<std::mutex> lock(counters.latencyMutex);
+	counters.interval.record((unsigned long) std::min<unsigned long long>(elapsed, 0xFFFFFFFFULL));
+	counters.total.record((unsigned long) std::min<unsigned long long>(elapsed, 0xFFFFFFFFULL));
+	counters.echoes++;
+}
+
+/* Messaggi di un frame, ognuno con il proprio envelope: si memorizza la sequenza e si misura la latenza degli echo */
+bool Worker::parseMessages(SimClient& c, const char* p, const char* end) {
+	while (p < end) {
+		if (end - p < ENVELOPESIZE)
+			return false;
+		unsigned char type = (unsigned char) p[1];
+		DWORD size = readDword(p + 4);
+		if ((DWORD) (end - p - ENVELOPESIZE) < size)
+			return false;
+		const char* payload = p + ENVELOPESIZE;
+
+		if (type == MSGSEQ && size == 8) {
+			c.epoch = readDword(payload);
+			c.sequence = readDword(payload + 4);
+			c.resume = true;
+		}
+		else if (type == MSGECHO && size == 16)
+			recordEcho(payload);
+		counters.messages++;
+		p = payload + size;
+	}
+	return true;
+}
+
+/* Lettura di un varint: false se il record termina prima o il valore supera 32 bit */
+static bool readVarint(const char*& p, const char* end, DWORD& value) {
+	value = 0;
+	for (int shift = 0; shift < 7 * MAXVARINT; shift += 7) {
+		if (p >= end)
+			return false;
+		unsigned char b = (unsigned char) *p++;
+		value |= (DWORD) (b & 0x7F) << shift;
+		if ((b & 0x80) == 0)
+			return true;
+	}
+	return false;
+}
+
+/*	Record di un frame packed (vedi CompactEncoding.hpp): tipo e flag in un byte, pid come differenza zigzag, per le add il nome
+*	(riferimento ad un nome gia' ricevuto o testo UTF-8), hash se presente, per seq e res due varint.
+*/
+bool Worker::parsePacked(SimClient& c, const char* p, const char* end) {
+	while (p < end) {
+		unsigned char header = (unsigned char) *p++;
+		unsigned char type = header & COMPACTTYPEMASK;
+		DWORD value, second;
+		if (type <= 2 || type == 10 || type == 12) {
+			if (!readVarint(p, end, value))
+				return false;
+		}
+		if (type == MSGADD) {
+			if (!readVarint(p, end, value))
+				return false;
+			if (value >= STRINGREFERENCE) {
+				if (value - STRINGREFERENCE >= c.names)
+					return false;			// nome mai ricevuto su questa connessione
+			}
+			else {
+				if (!readVarint(p, end, second) || (DWORD) (end - p) < second)
+					return false;
+				p += second;
+				if (value == STRINGSTORED)
+					c.names++;
+			}
+		}
+		if (header & COMPACTHASH) {
+			if (end - p < 8)
+				return false;
+			p += 8;
+		}
+		if (type == MSGSEQ || type == 12) {
+			if (!readVarint(p, end, value) || !readVarint(p, end, second))
+				return false;
+			if (type == MSGSEQ) {
+				c.epoch = value;
+				c.sequence = second;
+				c.resume = true;
+			}
+		}
+		counters.messages++;
+	}
+	return true;
+}
+
+/*	Verifica dei frame ricevuti: i frame compressi vengono decompressi, poi i messaggi di un frame vengono letti con il loro
+*	envelope (o come record compatti in un frame packed). Restituisce false se lo stream non rispetta il protocollo.
+*/
+bool Worker::parseFrames(SimClient& c, Clock::time_point now) {
+	size_t offset = 0;
+	while (c.in.size() - offset >= ENVELOPESIZE) {
+		const char* header = c.in.data() + offset;
+		DWORD length = readDword(header + 4);
+		u_short flags;
+		memcpy(&flags, header + 2, sizeof(flags));
+		unsigned char type = (unsigned char) header[1];
+		if ((unsigned char) header[0] != PROTOCOLVERSION || (type != MSGFRAME && type != MSGPACKED) || length > MAXFRAME)
+			return false;
+		if (c.in.size() - offset < ENVELOPESIZE + length)
+			break;					// frame non ancora completo
+
+		const char* p = header + ENVELOPESIZE;
+		const char* end = p + length;
+		if (ntohs(flags) & FLAGCOMPRESSED) {
+			if (length < sizeof(DWORD))
+				return false;
+			DWORD original = readDword(p);
+			if (original > MAXFRAME)
+				return false;
+			c.plain.resize(original);
+			int n = decompressBlock(p + sizeof(DWORD), (int) (length - sizeof(DWORD)), c.plain.data(), (int) original);
+			if (n != (int) original)
+				return false;
+			p = c.plain.data();
+			end = p + original;
+			counters.compressedFrames++;
+		}
+
+		if (!(type == MSGPACKED ? parsePacked(c, p, end) : parseMessages(c, p, end)))
+			return false;
+		if (type == MSGPACKED)
+			counters.packedFrames++;
+
+		counters.frames++;
+		c.lastFrame = now;
+		offset += ENVELOPESIZE + length;
+	}
+	c.in.erase(c.in.begin(), c.in.begin() + offset);
+	return true;
+}
+
+/* Ciclo del worker: connessioni, comandi, disconnessioni casuali, rilevazione dei blocchi e lettura dello stream */
+void Worker::run(Clock::time_point end) {
+	std::vector<PollEvent> ready;
+	std::chrono::microseconds commandInterval(options.rate > 0 ? (long long) (1e6 / options.rate) : 0);
+	Clock::time_point now = Clock::now();
+	for (SimClient& c : clients)
+		c.reconnectAt = now;
+
+	while (running && now < end) {
+		for (SimClient& c : clients) {
+			if (c.s == INVALID_SOCKET) {
+				if (now >= c.reconnectAt)
+					connectClient(c, now);
+				if (c.s == INVALID_SOCKET)
+					continue;
+			}
+
+			if (now >= c.disconnectAt) {
+				closeClient(c, now);
+				continue;
+			}
+			if (now - c.lastFrame > std::chrono::milliseconds(STALLTIMEOUT)) {
+				counters.stalls++;
+				closeClient(c, now);
+				continue;
+			}
+
+			if (options.rate > 0 && now >= c.nextCommand) {
+				char chord[5];
+				DWORD key = htonl('A' + (c.key++ % 26));
+				chord[0] = 0;
+				memcpy(chord + 1, &key, sizeof(key));
+				appendCommand(c.out, CMDKEYS, chord, sizeof(chord), true);
+				counters.commands++;
+				c.nextCommand += commandInterval;
+				if (c.nextCommand < now - std::chrono::seconds(1))
+					c.nextCommand = now;		// client in ritardo: niente raffiche per recuperare
+			}
+			flush(c, now);
+		}
+
+		if (bySocket.empty())
+			std::this_thread::sleep_for(std::chrono::milliseconds(WORKERTICK));
+		else
+			poller.wait(ready, WORKERTICK);
+
+		now = Clock::now();
+		for (PollEvent& e : ready) {
+			std::map<SOCKET, size_t>::iterator i = bySocket.find(e.fd);
+			if (i != bySocket.end())
+				readClient(clients[i->second], now);
+		}
+		ready.clear();
+	}
+
+	for (SimClient& c : clients)
+		closeClient(c, now);
+}
+
+static void printLatency(const char* label, const LatencyHistogram& h) {
+	std::cout << label << " p50/p99/max " << h.percentile(0.5) << "/" << h.percentile(0.99) << "/" << h.getMax() << " us";
+}
+
+/* Lettura dei parametri: restituisce false (e stampa l'uso) se non sono validi */
+static bool parseOptions(int argc, char* argv[], LoadOptions& o) {
+	for (int i = 1; i < argc; i++) {
+		std::string arg = argv[i];
+		if (i + 1 >= argc)
+			return false;
+		const char* value = argv[++i];
+		if (arg == "--host")
+			o.host = value;
+		else if (arg == "--port")
+			o.port = atoi(value);
+		else if (arg == "--clients")
+			o.clients = atoi(value);
+		else if (arg == "--duration")
+			o.duration = atoi(value);
+		else if (arg == "--rate")
+			o.rate = atof(value);
+		else if (arg == "--lifetime")
+			o.lifetime = atof(value);
+		else if (arg == "--reconnect")
+			o.reconnect = atoi(value);
+		else if (arg == "--threads")
+			o.threads = atoi(value);
+		else if (arg == "--caps")
+			o.caps = (DWORD) strtoul(value, nullptr, 0);
+		else
+			return false;
+	}
+	return o.port > 0 && o.port <= 65535 && o.clients > 0 && o.duration > 0 && o.rate >= 0 && o.lifetime >= 0 &&
+		o.reconnect >= 0 && o.threads > 0;
+}
+
+int main(int argc, char* argv[]) {
+	LoadOptions options;
+	if (!parseOptions(argc, argv, options)) {
+		std::cerr << "Uso: LoadGen [--host 127.0.0.1] [--port 2000] [--clients 100] [--duration 30] [--rate 10] [--lifetime 0]"
+			" [--reconnect 100] [--threads 4] [--caps 0]" << std::endl;
+		return 1;
+	}
+
+#ifdef _WIN32
+	WSADATA wsaData;
+	if (WSAStartup(MAKEWORD(2, 2), &wsaData) != 0) {
+		std::cerr << "Inizializzazione librerie Winsock fallita!" << std::endl;
+		return 1;
+	}
+#endif
+
+	struct sockaddr_in addr;
+	ZeroMemory(&addr, sizeof(addr));
+	addr.sin_family = AF_INET;
+	addr.sin_port = htons(options.port);
+	if (inet_pton(AF_INET, options.host.c_str(), &addr.sin_addr) != 1) {
+		std::cerr << "Indirizzo non valido: " << options.host << std::endl;
+		return 1;
+	}
+
+	LoadCounters counters;
+	options.threads = std::min(options.threads, options.clients);
+	std::vector<std::unique_ptr<Worker>> workers;
+	for (int t = 0; t < options.threads; t++) {
+		int count = options.clients / options.threads + (t < options.clients % options.threads ? 1 : 0);
+		workers.emplace_back(new Worker(options, counters, addr, count, 12345u + t));
+	}
+
+	std::cout << "Carico: " << options.clients << " client su " << options.threads << " thread, " << options.rate
+		<< " comandi/s per client, durata " << options.duration << " s" << std::endl;
+
+	int res = 0;
+	Clock::time_point start = Clock::now(), end = start + std::chrono::seconds(options.duration);
+	std::vector<std::thread> threads;
+	try {
+		for (std::unique_ptr<Worker>& w : workers)
+			threads.emplace_back(&Worker::run, w.get(), end);
+
+		/* riepilogo di ogni secondo: valori dell'intervallo */
+		unsigned long long lastFrames = 0, lastBytes = 0, lastCommands = 0;
+		for (int second = 1; second <= options.duration; second++) {
+			std::this_thread::sleep_until(start + std::chrono::seconds(second));
+			LatencyHistogram interval;
+			{
+				std::lock_guard<std::mutex> lock(counters.latencyMutex);
+				interval = counters.interval;
+				counters.interval = LatencyHistogram();
+			}
+			unsigned long long frames = counters.frames, bytes = counters.bytes, commands = counters.commands;
+			unsigned long long errors = counters.connectErrors + counters.protocolErrors + counters.serverCloses +
+				counters.sendErrors + counters.stalls;
+			std::cout << std::setw(4) << second << " s: " << counters.connected << " connessi, " << (frames - lastFrames) << " frame/s, "
+				<< (bytes - lastBytes) / 1024 << " KB/s, " << (commands - lastCommands) << " comandi/s, ";
+			printLatency("latenza", interval);
+			std::cout << ", errori " << errors << std::endl;
+			lastFrames = frames;
+			lastBytes = bytes;
+			lastCommands = commands;
+		}
+	}
+	catch (std::exception& e) {
+		std::cerr << e.what() << std::endl;
+		running = false;
+		res = 1;
+	}
+	for (std::thread& t : threads)
+		t.join();
+
+	double seconds = std::chrono::duration<double>(Clock::now() - start).count();
+	std::cout << "Totale: " << counters.connects << " connessioni, " << counters.disconnects << " disconnessioni, "
+		<< counters.frames << " frame (" << std::fixed << std::setprecision(1) << counters.frames / seconds << "/s), "
+		<< counters.messages << " messaggi, " << counters.bytes / (1024.0 * seconds) << " KB/s, "
+		<< counters.commands << " comandi, " << counters.echoes << " echo" << std::endl;
+	if (options.caps != 0)
+		std::cout << "Capacita' " << options.caps << ": " << counters.compressedFrames << " frame compressi, "
+			<< counters.packedFrames << " frame packed" << std::endl;
+	printLatency("Latenza dei comandi:", counters.total);
+	std::cout << std::endl;
+	std::cout << "Errori: connessione " << counters.connectErrors << ", protocollo " << counters.protocolErrors
+		<< ", chiusure del server " << counters.serverCloses << ", invio " << counters.sendErrors
+		<< ", server bloccato " << counters.stalls << std::endl;
+
+	unsigned long long errors = counters.connectErrors + counters.protocolErrors + counters.serverCloses + counters.sendErrors + counters.stalls;
+	if (errors > 0 || counters.echoes + options.clients * 2 * options.rate < counters.commands)
+		res = res ? res : 2;			// errori, o comandi senza risposta oltre quelli ancora in volo
+
+#ifdef _WIN32
+	WSACleanup();
+#endif
+	return res;
+}
@@ -0,0 +1,85 @@
+#include "AppList.hpp"
+#include <algorithm>
+
+void ListDelta::clear() {
+	added.clear();
+	removed.clear();
+}
+
+bool ListDelta::empty() const {
+	return added.empty() && removed.empty();
+}
+
+/*	Confronto tra la lista corrente e la nuova enumerazione (pid ordinati e senza ripetizioni).
+*	I due vettori vengono scorsi in parallelo: un pid presente solo nella nuova enumerazione e' un'applicazione nuova,
+*	un pid presente solo nella lista corrente e' un'applicazione terminata.
+*/
+
+void AppList::diff(const std::vector<DWORD>& snapshot, ListDelta& delta) const {
+	delta.clear();
+	size_t i = 0, j = 0;
+
+	while (i < entries.size() && j < snapshot.size()) {
+		if (entries[i].pid == snapshot[j]) {
+			i++;
+			j++;
+		}
+		else if (entries[i].pid < snapshot[j])
+			delta.removed.push_back(entries[i++].pid);
+		else
+			delta.added.push_back(snapshot[j++]);
+	}
+	for (; i < entries.size(); i++)
+		delta.removed.push_back(entries[i].pid);
+	for (; j < snapshot.size(); j++)
+		delta.added.push_back(snapshot[j]);
+}
+
+/*	Applicazione delle differenze: la nuova lista viene costruita nel vettore next (spostando gli elementi che restano,
+*	senza copiarne le stringhe) e poi scambiata con quella corrente. Solo i processi nuovi vengono letti tramite resolve.
+*/
+
+void AppList::apply(const ListDelta& delta, ProcessResolver resolve) {
+	if (delta.empty())
+		return;
+
+	next.clear();
+	next.reserve(entries.size() + delta.added.size());
+	size_t i = 0, a = 0, r = 0;
+
+	while (i < entries.size() || a < delta.added.size()) {
+		if (a == delta.added.size() || (i < entries.size() && entries[i].pid < delta.added[a])) {
+			// elemento della lista corrente: viene mantenuto se non e' tra quelli terminati
+			while (r < delta.removed.size() && delta.removed[r] < entries[i].pid)
+				r++;
+			if (r == delta.removed.size() || delta.removed[r] != entries[i].pid)
+				next.push_back(std::move(entries[i]));
+			i++;
+		}
+		else {
+			AppEntry e;
+			e.pid = delta.added[a++];
+			e.valid = resolve(e.pid, e.app);
+			next.push_back(std::move(e));
+		}
+	}
+
+	entries.swap(next);
+}
+
+/* Ricerca binaria di un pid nella lista */
+const AppEntry* AppList::find(DWORD pid) const {
+	std::vector<AppEntry>::const_iterator i = std::lower_bound(entries.begin(), entries.end(), pid,
+		[](const AppEntry& e, DWORD p) { return e.pid < p; });
+	if (i == entries.end() || i->pid != pid)
+		return nullptr;
+	return &*i;
+}
+
+const std::vector<AppEntry>& AppList::getEntries() const {
+	return entries;
+}
+
+size_t AppList::size() const {
+	return entries.size();
+}
@@ -0,0 +1,42 @@
+#pragma once
+#include "Change.hpp"
+#include <vector>
+
+
+/* Elemento della lista delle applicazioni */
+struct AppEntry {
+	DWORD pid;
+	bool valid;						// false se non e' stato possibile leggere le informazioni del processo: non viene inviata ai client
+	ApplicationItem app;
+};
+
+/*	Differenza tra la lista corrente ed una nuova enumerazione dei processi.
+*	I vettori vengono svuotati ma non rilasciati tra un aggiornamento e l'altro, per cui a regime non allocano memoria.
+*/
+
+struct ListDelta {
+	std::vector<DWORD> added;		// pid nuovi, in ordine crescente
+	std::vector<DWORD> removed;		// pid terminati, in ordine crescente
+	void clear();
+	bool empty() const;
+};
+
+/* Funzione che legge le informazioni di un processo nuovo: restituisce false se non e' possibile */
+typedef bool (*ProcessResolver)(DWORD pid, ApplicationItem& app);
+
+/*	Lista delle applicazioni, mantenuta in un vettore ordinato per pid.
+*	Il confronto con una nuova enumerazione (anch'essa ordinata) avviene con una scansione parallela dei due vettori (merge),
+*	in tempo lineare e senza allocazioni: solo se ci sono differenze la lista viene ricostruita, riusando un secondo vettore.
+*/
+
+class AppList {
+	std::vector<AppEntry> entries;	// lista corrente, ordinata per pid
+	std::vector<AppEntry> next;		// vettore riusato per la ricostruzione della lista
+
+public:
+	void diff(const std::vector<DWORD>& snapshot, ListDelta& delta) const;
+	void apply(const ListDelta& delta, ProcessResolver resolve);
+	const AppEntry* find(DWORD pid) const;
+	const std::vector<AppEntry>& getEntries() const;
+	size_t size() const;
+};
@@ -1,5 +1,8 @@
+#ifdef _WIN32
 #pragma comment(lib,"Ws2_32.lib")
+#endif
 #include "Change.hpp"
+#include <cstring>
 
 /*	Costruttori del tipo di modifica. I parametri sono il tipo di modifica e il pID del processo applicativo.
 *	L'idea  di definire un costruttore ad hoc per il tipo "add", perch esso ricever anche l'ApplicationItem.	
@@ -13,194 +16,228 @@ Change::Change(changeType t, DWORD id) : changeT(t), pID(id) {
 /* Costruttore add */
 Change::Change(DWORD id, ApplicationItem a) : changeT(add), pID(id), app(a) {};
 
-/* Funzione che si occupa della serializzazione del tipo di modifica (changeType) e del pID.
-*  Viene usata per ogni tipo di modifica da inviare (al contrario delle successive due funzioni che riguardano solo la modifica add).
+/*	Costruttore remove ed icu: la remove conserva nome e percorso dell'applicazione terminata, che non vengono serializzati
+*	ma servono a filtrare la modifica per i client con una sottoscrizione (vedi Subscription); l'icu usa il percorso
+*	dell'eseguibile per leggere l'icona dalla cache.
 */
+Change::Change(changeType t, DWORD id, ApplicationItem a) : changeT(t), pID(id), app(a) {
+	if (changeT != rem && changeT != icu)
+		throw std::invalid_argument("Costruttore sbagliato per la modifica di remove o icu!");
+}
 
-char* Change::getSerializedChangeType(int& length) {
-	length = dimShort + dimWord;		// dimensione di un u_short (per memorizzare il changeType) + quella di un DWORD (per il pID)
-										//	N.B. la dimensione di un enum  tipicamente di un integer
-	char* buffer = (char*) malloc(length);
-	if (buffer == NULL)
-		throw std::bad_alloc();
-
-	/*	htons converte un u_short in una sequenza di bit ordinata per comunicazione su rete TCP/IP. 
-	*	In particolare converte da little Endian a Big Endian, che  l'ordine usato per comunicazione su rete.
-	*	In questo caso viene trasformato in una stringa di bit l'identificatore della modifica (changeT)
-	*	E viene memorizzato nel buffer, che riceve il cast, passando da char* a u_short*
-	*/
-	*(u_short*)buffer = htons(u_short(changeT));
-	
-	//	Aggiungiamo al buffer il PID del processo relativo, utilizzando come displacement dimShort, che permette
-	//	di "skippare" la parte iniziale contenente il changeType, appena inserito.
-	*(PDWORD)(buffer + dimShort) = pID;
+/* Costruttore res */
+Change::Change(DWORD id, ResourceUsage u) : changeT(res), pID(id), usage(u) {}
 
-	return buffer;
+/* Modifiche che riguardano un'applicazione e ne contengono il pid */
+static bool carriesPid(changeType t) {
+	return t == add || t == rem || t == chf || t == icu || t == res;
 }
 
-/* Funzione per serializzare il nome dell'applicazione in esecuzione.
-*  Per modifiche diverse da add, questa funzione non viene usata.
+/*	Dimensione dell'envelope del messaggio e del pID (solo per le modifiche add, remove, change_focus, icu e res: gli altri messaggi non hanno pID) */
+
+int Change::getHeaderLength() {
+	return ENVELOPESIZE + (carriesPid(changeT) ? dimWord : 0);
+}
+
+/*	Serializzazione dell'envelope del messaggio e del pID in destination (getHeaderLength byte).
+*	L'envelope contiene versione del protocollo, tipo di modifica (changeType), flag e lunghezza del payload: il payload
+*	e' il pID per le modifiche add, remove, change_focus, icu e res, seguito per le add da lunghezza del nome, nome ed hash dell'icona,
+*	per le icu dal solo hash e per le res da CPU e working set (vedi serialize). Viene usata per ogni tipo di modifica da inviare (al contrario di writeName
+*	che riguarda solo la modifica add). flags: FLAGICONPENDING se l'icona e' ancora in estrazione.
 */
 
-char* Change::getSerializedName(int& length) {
-	if (changeT != add)
-		return nullptr;
-
-	// Impostiamo la lunghezza pari alla dimensione del nome dell'applicazione + terminatore (Moltiplicato per la dimensione di wchar_t)
-	length = (app.Name.size() + 1) * sizeof(wchar_t);
-	char* buffer = (char*) malloc(length);
-	if (buffer == NULL)
-		throw std::bad_alloc();
-
-	// Si copia il nome dell'applicazione nel buffer tramite il metodo memcpy_s per poterlo poi inviare su rete.
-	if (memcpy_s(buffer, length, app.Name.c_str(), length) != 0) {
-		free(buffer);
-		throw std::overflow_error("Errore: non si puo' copiare il nome dell'applicazione");
+void Change::writeHeader(char* destination, u_short flags) {
+	bool hasPid = carriesPid(changeT);
+	int payload = hasPid ? dimWord : 0;
+	if (changeT == add)
+		payload += dimWord + getNameLength() + dimHash;		// lunghezza del nome, nome ed hash dell'icona
+	else if (changeT == icu)
+		payload += dimHash;
+	else if (changeT == res)
+		payload += 2 * dimWord;								// CPU e working set
+
+	/*	htons ed htonl convertono i valori nell'ordine dei byte usato per la comunicazione su rete (Big Endian).
+	*	Versione e tipo occupano un byte ciascuno, seguono i flag (u_short) e la lunghezza del payload (DWORD).
+	*/
+	u_short networkFlags = htons(flags);
+	DWORD length = htonl(DWORD(payload));
+	destination[0] = PROTOCOLVERSION;
+	destination[1] = (char) changeT;
+	memcpy(destination + 2, &networkFlags, dimShort);
+	memcpy(destination + 4, &length, dimWord);
+
+	//	Aggiungiamo il PID del processo relativo, subito dopo l'envelope
+	if (hasPid) {
+		DWORD id = htonl(pID);
+		memcpy(destination + ENVELOPESIZE, &id, dimWord);
 	}
-	return buffer;
 }
 
+/* Lunghezza in byte del nome serializzato (UTF-16, compreso il terminatore): 0 per modifiche diverse da add */
 
-/*	Funzione che serializza l'icona per renderla adatta all'invio sulla rete. 
-*	Deve essere lanciata solo per operazioni di ADD, in quanto per operazioni di modifica non  necessario serializzare nuovamente l'icona,
-*	che sar gi stata serializzata ed inviata (ed ormai memorizzata dal client) in precedenza.
-*/
+int Change::getNameLength() {
+	if (changeT != add)
+		return 0;
+
+#ifdef _WIN32
+	return int((app.Name->size() + 1) * sizeof(wchar_t));
+#else
+	int units = 1;
+	for (wchar_t c : *app.Name)
+		units += ((unsigned long) c >= 0x10000) ? 2 : 1;
+	return units * 2;
+#endif
+}
 
-char* Change::getSerializedIcon(int& length) {
+/*	Serializzazione del nome dell'applicazione in destination (getNameLength byte).
+*	Per modifiche diverse da add, questa funzione non scrive nulla.
+*/
 
+void Change::writeName(char* destination) {
 	if (changeT != add)
-		return nullptr;
-
-	HRSRC resource = NULL;
-	LPTSTR groupIconName = NULL;
+		return;
+
+#ifdef _WIN32
+	// Il nome e' gia' in UTF-16: si copia compreso il terminatore
+	memcpy(destination, app.Name->c_str(), getNameLength());
+#else
+	// Su Linux wchar_t contiene un carattere UTF-32: il nome viene codificato in UTF-16 little endian (la codifica attesa dal client),
+	// con le coppie surrogate per i caratteri oltre U+FFFF
+	unsigned char* p = (unsigned char*) destination;
+	for (wchar_t w : *app.Name) {
+		unsigned long c = (unsigned long) w;
+		if (c >= 0x10000) {
+			c -= 0x10000;
+			unsigned long high = 0xD800 | (c >> 10), low = 0xDC00 | (c & 0x3FF);
+			*p++ = (unsigned char) high; *p++ = (unsigned char) (high >> 8);
+			*p++ = (unsigned char) low; *p++ = (unsigned char) (low >> 8);
+		}
+		else {
+			*p++ = (unsigned char) c; *p++ = (unsigned char) (c >> 8);
+		}
+	}
+	*p++ = 0; *p++ = 0;
+#endif
+}
 
-	/*	La funzione LoadLibraryEx ci permette di caricare l'eseguibile/libreria (in generale il modulo) dell'applicazione nello spazio di memoria
-	*	del nostro processo in formato binario per recuperare l'icona.
-	*	In particolare il parametro LOAD_LIBRARY_AS_DATAFILE indica che il sistema "mappa" il file dentro lo spazio di indirizzamento virtuale 
-	*	del processo chiamante come se in esso ci fosse un data file.
-	*/
+/*	Serializzazione dell'intero messaggio direttamente nel batch, senza buffer intermedi: envelope e pid e, per le add,
+*	lunghezza del nome, nome ed hash dell'icona (per le icu solo l'hash). Su Windows il nome (gia' in UTF-16) non viene
+*	copiato: il batch mantiene un riferimento alla stringa internata. Se viene lanciata un'eccezione non resta nulla da rilasciare.
+*/
 
-	HMODULE hExe = LoadLibraryEx(app.Exec_name.c_str(), NULL, LOAD_LIBRARY_AS_DATAFILE);
-	if (hExe != NULL) {
-		// La funzione EnumResourceNames enumera (scansiona una per volta) tutte le risorse di un certo tipo specificato come parametro.
-		// Nel nostro caso, vengono enumerate le icone (RT_GROUP_ICON) che sono la risorsa che vogliamo estrarre e serializzare.
-		// Il primo parametro  l'handle al modulo (libreria) in cui si deve cercare (se NULL, si considera il processo corrente).
-		// Il terzo parametro  un puntatore alla funzione di call back che deve essere chiamata ogni volta per enumerare le risorse.
-		// (in maniera pi formale "A pointer to the callback function to be called for each enumerated resource name or ID").
-		// In questo caso facciamo uso di una funzione lambda che restituisce un Bool.
-		// Il quarto parametro  passato alla funzione di Callback (la lambda).
-		// La funzione di callback in generale prende come parametri di hModule, lpszType e lParam i parametri specificati nella EnumResourceName (hExe, RT_GROUP_ICON, groupIconName).
-		// per ogni risorsa di tipo RT_GROUP_ICON
-
-		EnumResourceNames(hExe, RT_GROUP_ICON, [](HMODULE hModule, LPCTSTR lpszType, LPTSTR lpszName, LONG_PTR lparam)-> BOOL {
-			/* si memorizza la prima risorsa disponibile */
-			if (lpszName != NULL) {
-				LPTSTR* name = (LPTSTR*)lparam;	// name sar il puntatore ad lparam, che non  altro che groupIconName passato per riferimento
-				*name = lpszName;				// in questo modo, deferenziando name, e assegnando il valore lpszName, groupIconName assumer quel valore
-				// appena la troviamo interrompiamo la funzione EnumResourceNames.
-				// infatti, similmente alla EnumWindows del ListManage, la funzione di callback viene lanciata finch quest'ultima non ritorna false. 
-				// (oppure finch non viene enumerata l'ultima risorsa del tipo specificato).
-				return FALSE;
-			}
-			return TRUE;
-		}, (LONG_PTR)&groupIconName);
-
-		/* in questo modo, con EnumResourceNames, abbiamo estratto il nome della risorsa (salvato in groupIconName), informazione che ci servir per estrarre la posizione */
-
-		// FindResource definisce la posizione di una risorsa di un determinato tipo (RT_GROUP_ICON), con un determinato nome (groupIconName)
-		// in un determinato modulo exe (hExe).
-		resource = FindResource(hExe, groupIconName, RT_GROUP_ICON);
-	}
-	/* Se non riusciamo a caricare la libreria o non troviamo un gruppo_icona valido verr caricata sul client l'icona di default */
-	if (hExe == NULL || resource == NULL) {
-			FreeLibrary(hExe);
-			return nullptr;
+void Change::serialize(FrameBatch& batch, int iconSize) {
+	if (changeT != add && changeT != icu) {
+		writeHeader(batch.appendSpace(getHeaderLength()));
+		if (changeT == res) {
+			batch.appendLength((int) usage.cpu);
+			batch.appendLength((int) usage.memory);
+		}
+		return;
 	}
 
-	/* Impostiamo length pari alla dimensione della risorsa alla locazione res (icona) */
-	length = SizeofResource(hExe, resource);
-	if (length == 0) {
-		FreeLibrary(hExe);
-		return nullptr;
+	/* icona: viene inviato solo l'hash del contenuto (0 se l'applicazione non ha un'icona).
+	*  Il client richiede i byte dell'icona solo se non la conosce gia' (vedi CommandsFromClient).
+	*  Se l'icona e' ancora in estrazione l'hash e' 0 ed il flag FLAGICONPENDING annuncia un messaggio icu */
+	bool waiting;
+	IconBuffer icon = getSerializedIcon(waiting, iconSize);
+	writeHeader(batch.appendSpace(getHeaderLength()), waiting ? FLAGICONPENDING : 0);
+
+	if (changeT == add) {
+		int length = getNameLength();
+		batch.appendLength(length);
+#ifdef _WIN32
+		batch.append(app.Name, (const char*) app.Name->c_str(), length);
+#else
+		writeName(batch.appendSpace(length));
+#endif
 	}
+	batch.appendHash(icon ? icon->hash : 0);
+}
 
-	// Carichiamo la risorsa, ovvero creiamo un puntatore ad essa
-	// LoadResource: Riceve un handle che pu essere usata (in combinazione con il metodo lockResource) per ottenere un puntatore al primo
-	// byte di una specifica resource in memoria.
 
-	HGLOBAL resourcePtr = LoadResource(hExe, resource);
-	if (resourcePtr == NULL) {
-		FreeLibrary(hExe);
-		return nullptr;
-	}
-	
-	// Prendiamo un puntatore alla risorsa indicata da resourceptr (il grouppo_icona)
-	// La risorsa non viene bloccata, ma viene solo acquisito un puntatore ad essa
-	LPVOID icon = LockResource(resourcePtr);
-	if (icon == NULL) {
-		FreeLibrary(hExe);
-		return nullptr;
-	}
+/*	Serializzazione dell'intero messaggio in codifica compatta (vedi CompactEncoding.hpp): tipo e flag in un byte, pid come
+*	differenza da lastPid (il pid del record precedente nel frame, aggiornato qui), nome dalla tabella della connessione
+*	ed hash dell'icona solo se diverso da 0; per le res CPU e working set come varint.
+*/
 
-	// Cerchiamo l'ID dal gruppo_icona di un'icona di queste dimensioni
-	// LookupIconIdFromDirectoryEx: Cerca un'icona che si adatta meglio al display del device corrente
-	//  - (PBYTE) icon: L'icona o la directory
-	//  - TRUE: Indica che si sta cercando un'icona (FALSE indica un cursore)
-	//  - 48, 48: Dimensioni desiderate dell'icona
-	//  - LR_DEFAULTCOLOR: Flag che indica che il colore scelto  quello di default
-
-	int idIcon = LookupIconIdFromDirectoryEx((PBYTE) icon, TRUE, 48, 48, LR_DEFAULTCOLOR);
-	if (idIcon == 0) {
-		FreeLibrary(hExe);
-		return nullptr;
+void Change::serializeCompact(FrameBatch& batch, int iconSize, StringTable& strings, DWORD& lastPid) {
+	bool hasPid = carriesPid(changeT);
+	bool waiting = false;
+	IconBuffer icon;
+	if (changeT == add || changeT == icu)
+		icon = getSerializedIcon(waiting, iconSize);
+	unsigned long long hash = icon ? icon->hash : 0;
+
+	char* field = batch.appendSpace(1 + MAXVARINT);
+	field[0] = (char) (changeT | (waiting ? COMPACTICONPENDING : 0) | (hash != 0 ? COMPACTHASH : 0));
+	int used = 1;
+	if (hasPid) {
+		used += writeVarint(field + 1, zigzagDelta(pID, lastPid));
+		lastPid = pID;
 	}
+	batch.discard(1 + MAXVARINT - used);
 
-	/* Ora che abbiamo l'ID dell'icona e non pi il gruppo_icona in generale, si pu passare all'estrazione di essa */
-	
-	// Restituisce un puntatore alla risorsa icona con quell'ID (Appena ottenuto)
-	// FindResource usa la MAKEINTRESOURCE macro con l'identifier idIcon (ottenuto da Lookup..) per localizzare la risorsa presente nel modulo.
-		
-	resource = FindResource(hExe, MAKEINTRESOURCE(idIcon), RT_ICON);
-	if (hExe == NULL || resource == NULL) {
-		FreeLibrary(hExe);
-		return nullptr;
+	if (changeT == add)
+		strings.appendString(batch, *app.Name);
+	if (hash != 0)
+		batch.appendHash(hash);
+	if (changeT == res) {
+		appendVarint(batch, usage.cpu);
+		appendVarint(batch, usage.memory);
 	}
+}
 
-	/* Come prima si estrae la dimensione della risorsa (questa volta l'icona) */
-	length = SizeofResource(hExe, resource);
-	if (length == 0) {
-		FreeLibrary(hExe);
-		return nullptr;
-	}
-	
-	resourcePtr = LoadResource(hExe, resource);
-	if (resourcePtr == NULL) {
-		FreeLibrary(hExe);
-		return nullptr;
-	}
 
-	icon = LockResource(resourcePtr);
-	if (icon == NULL) {
-		FreeLibrary(hExe);
-		return nullptr;
-	}
+/* Tipo della modifica */
 
-	/* Dopo aver ottenuto il puntatore all'icona corretta, si alloca il buffer per poterla inviare sulla rete */
-	char* buffer = (char*)malloc(length);
-	if (buffer == NULL) {
-		FreeLibrary(hExe);
-		throw std::bad_alloc();
-	}
+changeType Change::getType() const {
+	return changeT;
+}
 
-	/* Copio il contenuto dell'icona nel buffer, per poterlo inviare in rete */
-	if (memcpy_s(buffer, length, icon, length) != 0) {
-		FreeLibrary(hExe);
-		free(buffer);
-		return nullptr;
-	}
+/* Pid del processo (0 per i messaggi senza pid) ed applicazione (valida per le modifiche add e, se nota, per le remove) */
+
+DWORD Change::getPid() const {
+	return pID;
+}
+
+const ApplicationItem& Change::getApplication() const {
+	return app;
+}
+
+/* Uso delle risorse (valido solo per le modifiche res) */
+
+const ResourceUsage& Change::getUsage() const {
+	return usage;
+}
 
-	FreeLibrary(hExe);
 
-	//restituiamo i byte dell'icona
-	return buffer;
+/*	Nome dell'applicazione senza copie: la stringa internata puo' essere inviata direttamente (compreso il terminatore).
+*	Per modifiche diverse da add restituisce nullptr.
+*/
+
+InternedString Change::getName() {
+	if (changeT != add)
+		return InternedString();
+	return app.Name;
+}
+
+
+/*	Funzione che restituisce l'icona serializzata, pronta per l'invio sulla rete. 
+*	Deve essere lanciata solo per operazioni di ADD (o per le icu), in quanto per operazioni di modifica non  necessario serializzare nuovamente l'icona,
+*	che sar gi stata serializzata ed inviata (ed ormai memorizzata dal client) in precedenza.
+*	L'icona viene presa dalla cache (vedi IconCache): il buffer  condiviso e non deve essere modificato n liberato.
+*	L'icona ha la dimensione iconSize richiesta dal client. La chiamata non attende l'estrazione: se l'icona non e' ancora disponibile restituisce nullptr e waiting diventa true.
+*/
+
+IconBuffer Change::getSerializedIcon(bool& waiting, int iconSize) {
+	waiting = false;
+	if (changeT != add && changeT != icu)
+		return IconBuffer();
+
+	return IconCache::instance().requestIcon(*app.Exec_name, iconSize, waiting);
+}
+
+IconBuffer Change::getSerializedIcon(int iconSize) {
+	bool waiting;
+	return getSerializedIcon(waiting, iconSize);
 }
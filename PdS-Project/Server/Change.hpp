@@ -2,21 +2,38 @@
 
 #include <string>
 #include <exception>
-#include <Windows.h>
+#include <memory>
+#include "Platform.hpp"
+#include "IconCache.hpp"
+#include "FrameBatch.hpp"
+#include "CompactEncoding.hpp"
 
 
 #define dimShort sizeof(u_short)
 #define dimWord sizeof(DWORD)
+#define dimHash sizeof(unsigned long long)
 
 
+/* Stringa immutabile condivisa (vedi StringPool in ProcessCache.hpp): i nomi non vengono copiati ad ogni modifica */
+typedef std::shared_ptr<const std::wstring> InternedString;
+
 /* Struct che contiene le inforamzioni su un'applicazione */
 struct ApplicationItem {
-	std::wstring Name;		//Nome dell'applicazione
-	std::wstring Exec_name;
+	InternedString Name;		//Nome dell'applicazione
+	InternedString Exec_name;
+};
+
+/* Uso delle risorse di un'applicazione (vedi ResourceMonitor): CPU in centesimi di punto percentuale, working set in KB */
+struct ResourceUsage {
+	DWORD cpu;
+	DWORD memory;
 };
 
-	//Tipo di modifica alla lista
-	enum changeType { add, rem, chf, heartbeat };
+	//Tipo di modifica alla lista (seq: ultima sequenza inviata, vedi ChangeLog; reset: il client svuota la lista prima di riceverla completa;
+	//caps: capacita' accettate dal server; frame: messaggi di un ciclo, vedi FrameBatch.hpp; echo: tempi di un comando con timestamp;
+	//icu: icona di un'applicazione gia' inviata, estratta in background; packed: frame in codifica compatta, vedi CompactEncoding.hpp;
+	//res: uso delle risorse di un'applicazione, vedi ResourceMonitor)
+	enum changeType { add, rem, chf, heartbeat, ico, seq, reset, caps, frame, echo, icu, packed, res };
 
 	/* la classe che rappresenta una modifica alla lista */
 	class Change {
@@ -24,11 +41,24 @@ struct ApplicationItem {
 		changeType changeT;
 		DWORD pID;
 		ApplicationItem app;
+		ResourceUsage usage = {};
 
 	public:
 		Change(changeType t, DWORD id);         // Costruttore di modifica change_focus o remove
 		Change(DWORD id, ApplicationItem a);	// Costruttore modifica add
-		char * getSerializedChangeType(int& length);
-		char * getSerializedName(int& length);
-		char * getSerializedIcon(int& length);
+		Change(changeType t, DWORD id, ApplicationItem a);	// Costruttore modifiche remove ed icu (con l'applicazione)
+		Change(DWORD id, ResourceUsage u);		// Costruttore modifica res
+		int getHeaderLength();
+		void writeHeader(char* destination, u_short flags = 0);
+		int getNameLength();
+		void writeName(char* destination);
+		void serialize(FrameBatch& batch, int iconSize = ICONSIZE);
+		void serializeCompact(FrameBatch& batch, int iconSize, StringTable& strings, DWORD& lastPid);
+		changeType getType() const;
+		DWORD getPid() const;
+		const ApplicationItem& getApplication() const;
+		const ResourceUsage& getUsage() const;
+		InternedString getName();
+		IconBuffer getSerializedIcon(int iconSize = ICONSIZE);
+		IconBuffer getSerializedIcon(bool& waiting, int iconSize = ICONSIZE);
 	};
\ No newline at end of file
@@ -0,0 +1,102 @@
+#include "ChangeBacklog.hpp"
+
+/* Fusione delle modifiche di un ciclo (o di una sequenza di cicli) con quelle gia' in attesa */
+void ChangeBacklog::merge(const std::deque<Change>& changes) {
+	if (overflow)
+		return;
+
+	for (const Change& c : changes) {
+		switch (c.getType()) {
+		case rem: {
+			std::map<DWORD, Entry>::iterator i = entries.find(c.getPid());
+			if (i == entries.end()) {
+				Entry e;
+				e.removed = true;
+				e.added = false;
+				e.icon = false;
+				e.resources = false;
+				entries[c.getPid()] = e;
+			}
+			else if (i->second.removed || !i->second.added) {
+				i->second.removed = true;		// remove + add + remove, o icu/res + remove: resta solo la remove
+				i->second.added = false;
+				i->second.icon = false;
+				i->second.resources = false;
+			}
+			else
+				entries.erase(i);				// add + remove: il client non ha mai saputo dell'applicazione
+			break;
+		}
+		case add: {
+			Entry& e = entries[c.getPid()];		// nuova voce: removed resta false (il client non conosce il pid)
+			e.added = true;
+			e.icon = false;
+			e.app = c.getApplication();
+			break;
+		}
+		case icu: {
+			Entry& e = entries[c.getPid()];
+			if (!e.added) {						// una add in attesa viene serializzata con l'icona gia' estratta
+				e.icon = true;
+				e.app = c.getApplication();
+			}
+			break;
+		}
+		case res: {
+			Entry& e = entries[c.getPid()];
+			e.resources = true;
+			e.usage = c.getUsage();
+			break;
+		}
+		case chf:
+			focus = c.getPid();
+			focusChanged = true;
+			break;
+		default:
+			break;								// heartbeat e messaggi senza stato: il client riceve comunque dati
+		}
+	}
+
+	if (entries.size() > BACKLOGSIZE) {
+		overflow = true;
+		entries.clear();
+		focusChanged = false;
+	}
+}
+
+/*	Modifiche fuse, pronte per l'invio: prima tutte le remove, poi le add, le icone, l'uso delle risorse ed infine il focus, in modo che un pid riusato
+*	venga rimosso prima di essere aggiunto di nuovo. Il backlog viene svuotato.
+*/
+void ChangeBacklog::collect(std::deque<Change>& changes) {
+	changes.clear();
+	for (std::pair<const DWORD, Entry>& e : entries)
+		if (e.second.removed)
+			changes.push_back(Change(rem, e.first));
+	for (std::pair<const DWORD, Entry>& e : entries)
+		if (e.second.added)
+			changes.push_back(Change(e.first, e.second.app));
+	for (std::pair<const DWORD, Entry>& e : entries)
+		if (e.second.icon)
+			changes.push_back(Change(icu, e.first, e.second.app));
+	for (std::pair<const DWORD, Entry>& e : entries)
+		if (e.second.resources)
+			changes.push_back(Change(e.first, e.second.usage));
+	if (focusChanged)
+		changes.push_back(Change(chf, focus));
+
+	entries.clear();
+	focusChanged = false;
+}
+
+/* Il backlog ha superato BACKLOGSIZE applicazioni: le modifiche sono state scartate */
+bool ChangeBacklog::overflowed() const {
+	return overflow;
+}
+
+bool ChangeBacklog::empty() const {
+	return entries.empty() && !focusChanged;
+}
+
+size_t ChangeBacklog::size() const {
+	return entries.size();
+}
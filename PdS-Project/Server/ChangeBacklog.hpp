@@ -0,0 +1,39 @@
+#pragma once
+#include "Change.hpp"
+#include <deque>
+#include <map>
+
+
+#define BACKLOGSIZE 4096					// applicazioni con modifiche fuse oltre le quali il client riceve di nuovo la lista completa
+
+/*	Modifiche in attesa per un client che non riesce a riceverle (socket congestionato, vedi ListHandler::sendToClient)
+*	o perse da un client che si riconnette. Invece di accodare tutta la storia, le modifiche vengono fuse per pid:
+*	un'applicazione aggiunta e poi terminata si annulla, una terminata e poi ricomparsa (pid riusato) diventa remove + add,
+*	i cambi di focus si riducono all'ultimo, un'icona estratta (icu) si annulla con la add che la contiene gia',
+*	dell'uso delle risorse (res) resta l'ultimo valore e gli heartbeat vengono scartati.
+*	La memoria occupata e' limitata: oltre BACKLOGSIZE applicazioni le modifiche vengono scartate ed il client deve
+*	ricevere la lista completa (overflowed).
+*/
+
+class ChangeBacklog {
+	struct Entry {
+		bool removed;						// il client conosce il pid: va inviata la remove
+		bool added;							// il pid e' (di nuovo) un'applicazione attiva: va inviata la add
+		bool icon;							// il client conosce il pid ma non l'icona definitiva: va inviata la icu
+		bool resources;						// va inviato l'ultimo uso delle risorse (usage)
+		ApplicationItem app;
+		ResourceUsage usage;
+	};
+
+	std::map<DWORD, Entry> entries;			// modifiche fuse, per pid
+	DWORD focus = 0;						// ultimo cambio di focus
+	bool focusChanged = false;
+	bool overflow = false;
+
+public:
+	void merge(const std::deque<Change>& changes);
+	void collect(std::deque<Change>& changes);
+	bool overflowed() const;
+	bool empty() const;
+	size_t size() const;
+};
@@ -0,0 +1,49 @@
+#include "ChangeLog.hpp"
+#include <random>
+#include <chrono>
+
+/* L'epoca e' casuale e mai nulla: 0 e' riservato ai client che non hanno ancora ricevuto nulla */
+ChangeLog::ChangeLog(size_t capacity) : capacity(capacity) {
+	std::random_device device;
+	epoch = DWORD(device() ^ std::chrono::steady_clock::now().time_since_epoch().count());
+	if (epoch == 0)
+		epoch = 1;
+}
+
+/* Registrazione di una modifica: restituisce la sua sequenza. Oltre la capacita' si scarta la modifica piu' vecchia */
+DWORD ChangeLog::append(const Change& c) {
+	if (entries.size() >= capacity)
+		entries.pop_front();
+	entries.push_back(c);
+	return ++lastSequence;
+}
+
+/*	Modifiche successive alla sequenza indicata, nell'ordine di invio.
+*	Restituisce false se non e' possibile ricostruirle (epoca diversa, sequenza sconosciuta o modifiche gia' scartate):
+*	in quel caso il client deve ricevere la lista completa.
+*/
+
+bool ChangeLog::collect(DWORD clientEpoch, DWORD sequence, std::deque<Change>& missed) const {
+	missed.clear();
+	if (clientEpoch != epoch || sequence > lastSequence)
+		return false;
+
+	DWORD count = lastSequence - sequence;	// modifiche perse dal client
+	if (count > entries.size())
+		return false;
+
+	missed.insert(missed.end(), entries.end() - count, entries.end());
+	return true;
+}
+
+DWORD ChangeLog::getEpoch() const {
+	return epoch;
+}
+
+DWORD ChangeLog::getLastSequence() const {
+	return lastSequence;
+}
+
+size_t ChangeLog::size() const {
+	return entries.size();
+}
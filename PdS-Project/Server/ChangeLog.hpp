@@ -0,0 +1,30 @@
+#pragma once
+#include "Change.hpp"
+#include <deque>
+
+
+#define CHANGELOGSIZE 4096					// massimo numero di modifiche memorizzate per i client che si riconnettono
+
+/*	Registro delle ultime modifiche inviate ai client, numerate con una sequenza crescente (la prima modifica ha numero 1).
+*	Un client che si riconnette comunica l'ultima sequenza ricevuta: se le modifiche successive sono ancora nel registro
+*	riceve solo quelle, altrimenti (registro sovrascritto, o server riavviato) deve ricevere di nuovo la lista completa.
+*	L'epoca identifica l'istanza del registro: le sequenze di un'altra esecuzione del server non sono confrontabili.
+*	Vengono registrate solo le modifiche alla lista (add, remove e cambi di focus): icone estratte ed uso delle risorse
+*	vengono inviati a chi riprende con i valori correnti (vedi ListHandler::appendCurrentState).
+*	Le modifiche condividono nomi ed icone con la lista, per cui il registro occupa poca memoria.
+*/
+
+class ChangeLog {
+	std::deque<Change> entries;				// ultime modifiche, dalla piu' vecchia
+	size_t capacity;
+	DWORD epoch;
+	DWORD lastSequence = 0;					// sequenza dell'ultima modifica registrata (0: nessuna)
+
+public:
+	ChangeLog(size_t capacity = CHANGELOGSIZE);
+	DWORD append(const Change& c);
+	bool collect(DWORD clientEpoch, DWORD sequence, std::deque<Change>& missed) const;
+	DWORD getEpoch() const;
+	DWORD getLastSequence() const;
+	size_t size() const;
+};
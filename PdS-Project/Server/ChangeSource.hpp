@@ -0,0 +1,21 @@
+#pragma once
+#include <functional>
+#include <memory>
+
+
+/*	Sorgente degli eventi che possono modificare la lista delle applicazioni (avvio e terminazione dei processi,
+*	creazione e chiusura delle finestre, cambio del focus).
+*	La sorgente non costruisce la lista: segnala soltanto che qualcosa e' cambiato, invocando la funzione onChange
+*	da un proprio thread. Il ListHandler ricalcola allora la lista, invece di ricostruirla continuamente.
+*	Gli eventi possono essere raggruppati o persi: il ListHandler esegue comunque una riconciliazione periodica completa.
+*/
+
+class ChangeSource {
+public:
+	virtual ~ChangeSource() {}
+	virtual void start(std::function<void()> onChange) = 0;
+	virtual void stop() = 0;
+};
+
+/* Creazione della sorgente di eventi della piattaforma corrente */
+std::unique_ptr<ChangeSource> createChangeSource();
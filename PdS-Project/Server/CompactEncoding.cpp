@@ -0,0 +1,116 @@
+#include "CompactEncoding.hpp"
+#include <cstring>
+
+/* Scrittura di un varint in destination (almeno MAXVARINT byte): restituisce il numero di byte scritti */
+
+int writeVarint(char* destination, DWORD value) {
+	int n = 0;
+	while (value >= 0x80) {
+		destination[n++] = (char) (value | 0x80);
+		value >>= 7;
+	}
+	destination[n++] = (char) value;
+	return n;
+}
+
+/* Aggiunta di un varint al batch: lo spazio riservato e non usato viene restituito subito */
+
+void appendVarint(FrameBatch& batch, DWORD value) {
+	char* field = batch.appendSpace(MAXVARINT);
+	batch.discard(MAXVARINT - writeVarint(field, value));
+}
+
+/*	Differenza tra due pid codificata zigzag: le differenze piccole, positive o negative, diventano valori piccoli
+*	(0, -1, 1, -2... diventano 0, 1, 2, 3...) e quindi varint di un solo byte.
+*/
+
+DWORD zigzagDelta(DWORD value, DWORD previous) {
+	int delta = (int) (value - previous);
+	return ((DWORD) delta << 1) ^ (DWORD) (delta >> 31);
+}
+
+/*	Conversione in UTF-8 di un nome in destination (almeno MAXUTF8 byte per carattere): restituisce i byte scritti.
+*	I nomi sono quasi sempre ASCII: i caratteri vengono controllati a blocchi di 4 con un solo confronto (OR dei valori),
+*	e un blocco tutto ASCII viene copiato senza diramazioni per carattere. Le coppie surrogate (Windows) vengono
+*	ricomposte; surrogati isolati e valori non validi diventano U+FFFD.
+*/
+
+int encodeUtf8(const std::wstring& text, char* destination) {
+	unsigned char* p = (unsigned char*) destination;
+	const wchar_t* s = text.data();
+	size_t n = text.size(), i = 0;
+
+	while (i < n) {
+		while (i + 4 <= n && (unsigned long) (s[i] | s[i + 1] | s[i + 2] | s[i + 3]) < 0x80) {
+			p[0] = (unsigned char) s[i];
+			p[1] = (unsigned char) s[i + 1];
+			p[2] = (unsigned char) s[i + 2];
+			p[3] = (unsigned char) s[i + 3];
+			p += 4;
+			i += 4;
+		}
+		if (i == n)
+			break;
+
+		unsigned long c = (unsigned long) s[i++];
+		if (c >= 0xD800 && c < 0xE000) {
+			unsigned long low = i < n ? (unsigned long) s[i] : 0;
+			if (sizeof(wchar_t) == 2 && c < 0xDC00 && low >= 0xDC00 && low < 0xE000) {
+				c = 0x10000 + ((c - 0xD800) << 10) + (low - 0xDC00);
+				i++;
+			}
+			else
+				c = 0xFFFD;
+		}
+		else if (c > 0x10FFFF)
+			c = 0xFFFD;
+
+		if (c < 0x80)
+			*p++ = (unsigned char) c;
+		else if (c < 0x800) {
+			*p++ = (unsigned char) (0xC0 | (c >> 6));
+			*p++ = (unsigned char) (0x80 | (c & 0x3F));
+		}
+		else if (c < 0x10000) {
+			*p++ = (unsigned char) (0xE0 | (c >> 12));
+			*p++ = (unsigned char) (0x80 | ((c >> 6) & 0x3F));
+			*p++ = (unsigned char) (0x80 | (c & 0x3F));
+		}
+		else {
+			*p++ = (unsigned char) (0xF0 | (c >> 18));
+			*p++ = (unsigned char) (0x80 | ((c >> 12) & 0x3F));
+			*p++ = (unsigned char) (0x80 | ((c >> 6) & 0x3F));
+			*p++ = (unsigned char) (0x80 | (c & 0x3F));
+		}
+	}
+	return (int) (p - (unsigned char*) destination);
+}
+
+/*	Aggiunta di un nome al batch: indice (varint, + STRINGREFERENCE) se il nome e' gia' stato inviato su questa connessione,
+*	altrimenti STRINGSTORED o STRINGLITERAL seguito da lunghezza (varint) e testo UTF-8. Il testo viene convertito
+*	direttamente nel batch, dopo lo spazio per la lunghezza, e spostato indietro se il varint e' piu' corto del previsto.
+*/
+
+void StringTable::appendString(FrameBatch& batch, const std::wstring& text) {
+	std::unordered_map<std::wstring, DWORD>::iterator i = indices.find(text);
+	if (i != indices.end()) {
+		appendVarint(batch, i->second + STRINGREFERENCE);
+		return;
+	}
+
+	bool store = indices.size() < STRINGTABLESIZE;
+	int reserved = 1 + MAXVARINT + (int) (text.size() * MAXUTF8);
+	char* field = batch.appendSpace(reserved);
+	int length = encodeUtf8(text, field + 1 + MAXVARINT);
+	field[0] = store ? STRINGSTORED : STRINGLITERAL;
+	int lengthBytes = writeVarint(field + 1, (DWORD) length);
+	memmove(field + 1 + lengthBytes, field + 1 + MAXVARINT, length);
+	batch.discard(reserved - (1 + lengthBytes + length));
+
+	if (store)
+		indices.emplace(text, (DWORD) indices.size());
+}
+
+size_t StringTable::size() const {
+	return indices.size();
+}
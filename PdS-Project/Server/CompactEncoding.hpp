@@ -0,0 +1,43 @@
+#pragma once
+#include "Platform.hpp"
+#include "FrameBatch.hpp"
+#include <string>
+#include <unordered_map>
+
+
+#define MAXVARINT 5							// byte massimi di un intero a 32 bit codificato come varint
+#define MAXUTF8 (sizeof(wchar_t) == 2 ? 3 : 4)	// byte UTF-8 massimi per ogni wchar_t (UTF-16 su Windows, UTF-32 su Linux)
+#define STRINGTABLESIZE 1024				// nomi memorizzati nella tabella di una connessione
+#define COMPACTTYPEMASK 0x0F				// primo byte di un record: tipo della modifica (changeType) nei 4 bit bassi
+#define COMPACTICONPENDING 0x10				// flag del record: icona in estrazione (come FLAGICONPENDING)
+#define COMPACTHASH 0x20					// flag del record: segue l'hash dell'icona (senza il flag l'hash e' 0)
+#define STRINGSTORED 0						// nome: testo, aggiunto alla tabella del client
+#define STRINGLITERAL 1						// nome: testo, non aggiunto (tabella piena)
+#define STRINGREFERENCE 2					// nome: indice nella tabella + STRINGREFERENCE
+
+/*	Codifica compatta delle modifiche, per i client che la richiedono con l'handshake delle capacita' (CAPCOMPACT).
+*	Le modifiche di un ciclo vengono inviate in un frame di tipo packed, senza envelope per ogni messaggio: ogni record
+*	inizia con un byte (tipo e flag), seguito per add, remove, change_focus ed icu dal pid come differenza (zigzag varint)
+*	dal pid del record precedente nel frame, per le add dal nome (vedi StringTable) e, con COMPACTHASH, dall'hash
+*	dell'icona (8 byte in formato network); il marcatore di sequenza ha epoca e sequenza come varint.
+*	I varint hanno 7 bit per byte, dal gruppo meno significativo; il bit alto indica che segue un altro byte.
+*/
+
+int writeVarint(char* destination, DWORD value);
+void appendVarint(FrameBatch& batch, DWORD value);
+DWORD zigzagDelta(DWORD value, DWORD previous);
+int encodeUtf8(const std::wstring& text, char* destination);
+
+/*	Tabella dei nomi gia' inviati su una connessione: un nome ripetuto (es. lo stesso eseguibile in piu' processi, o
+*	un'applicazione che termina e ricompare) viene inviato una sola volta in UTF-8, poi solo il suo indice.
+*	Il client costruisce la stessa tabella aggiungendo i nomi STRINGSTORED nell'ordine di arrivo, per cui la tabella
+*	va usata solo dal thread della lista, nello stesso ordine in cui i batch vengono accodati alla connessione.
+*/
+
+class StringTable {
+	std::unordered_map<std::wstring, DWORD> indices;
+
+public:
+	void appendString(FrameBatch& batch, const std::wstring& text);
+	size_t size() const;
+};
@@ -0,0 +1,238 @@
+#include "Compression.hpp"
+#include "Change.hpp"
+#include <cstdlib>
+#include <cstring>
+#include <algorithm>
+
+#define MINMATCH 4							// lunghezza minima di un riferimento
+#define LASTLITERALS 5						// gli ultimi byte del blocco sono sempre letterali
+#define MFLIMIT 12							// un riferimento non puo' iniziare negli ultimi MFLIMIT byte
+#define MAXOFFSET 65535						// distanza massima di un riferimento
+#define HASHLOG 12							// dimensione (log2) della tabella delle posizioni
+
+static std::atomic<unsigned long long> compressedInput(0);
+static std::atomic<unsigned long long> compressedOutput(0);
+
+/* Dimensione massima del blocco compresso per len byte di ingresso (dati non comprimibili) */
+int compressBound(int len) {
+	return len + len / 255 + 16;
+}
+
+static inline DWORD read32(const unsigned char* p) {
+	DWORD v;
+	memcpy(&v, p, sizeof(v));
+	return v;
+}
+
+static inline unsigned hash32(DWORD v) {
+	return (v * 2654435761U) >> (32 - HASHLOG);
+}
+
+/* Scrittura di una lunghezza oltre il nibble del token: byte da 255 seguiti dal resto */
+static inline unsigned char* writeLength(unsigned char* op, int len) {
+	while (len >= 255) {
+		*op++ = 255;
+		len -= 255;
+	}
+	*op++ = (unsigned char) len;
+	return op;
+}
+
+/* Scrittura di una sequenza: token, letterali e (se matchLen > 0) distanza e lunghezza del riferimento */
+static unsigned char* writeSequence(unsigned char* op, const unsigned char* literals, int literalLen, int offset, int matchLen) {
+	unsigned char* token = op++;
+	*token = (unsigned char) ((literalLen >= 15 ? 15 : literalLen) << 4);
+	if (literalLen >= 15)
+		op = writeLength(op, literalLen - 15);
+	memcpy(op, literals, literalLen);
+	op += literalLen;
+
+	if (matchLen > 0) {
+		*op++ = (unsigned char) offset;
+		*op++ = (unsigned char) (offset >> 8);
+		int extra = matchLen - MINMATCH;
+		*token |= (unsigned char) (extra >= 15 ? 15 : extra);
+		if (extra >= 15)
+			op = writeLength(op, extra - 15);
+	}
+	return op;
+}
+
+/*	Compressione di un blocco (formato LZ4): per ogni posizione si cerca nella tabella l'ultima occorrenza degli stessi 4 byte
+*	e, se abbastanza vicina, la si estende il piu' possibile. Restituisce la dimensione compressa, 0 se non c'e' spazio.
+*/
+
+int compressBlock(const char* source, int len, char* destination, int capacity) {
+	if (capacity < compressBound(len))
+		return 0;
+
+	const unsigned char* base = (const unsigned char*) source;
+	const unsigned char* ip = base;
+	const unsigned char* anchor = base;				// inizio dei letterali non ancora scritti
+	const unsigned char* end = base + len;
+	unsigned char* op = (unsigned char*) destination;
+
+	if (len > MFLIMIT) {
+		int table[1 << HASHLOG];
+		for (int& t : table)
+			t = -1;
+
+		const unsigned char* matchLimit = end - LASTLITERALS;
+		const unsigned char* searchLimit = end - MFLIMIT;
+
+		while (ip < searchLimit) {
+			DWORD sequence = read32(ip);
+			unsigned h = hash32(sequence);
+			int candidate = table[h];
+			table[h] = int(ip - base);
+
+			if (candidate < 0 || ip - (base + candidate) > MAXOFFSET || read32(base + candidate) != sequence) {
+				ip++;
+				continue;
+			}
+
+			const unsigned char* match = base + candidate;
+			const unsigned char* scan = ip + MINMATCH;
+			const unsigned char* ref = match + MINMATCH;
+			while (scan < matchLimit && *scan == *ref) {
+				scan++;
+				ref++;
+			}
+
+			op = writeSequence(op, anchor, int(ip - anchor), int(ip - match), int(scan - ip));
+			ip = anchor = scan;
+		}
+	}
+
+	/* ultima sequenza: solo letterali */
+	op = writeSequence(op, anchor, int(end - anchor), 0, 0);
+	return int(op - (unsigned char*) destination);
+}
+
+/*	Decompressione di un blocco (formato LZ4) in destination (capacity byte): restituisce la dimensione decompressa,
+*	-1 se il blocco non e' valido (lunghezze oltre i limiti dei buffer o riferimenti prima dell'inizio dei dati).
+*	E' quella del client (vedi SocketListener.cs): serve al generatore di carico per verificare i frame compressi.
+*/
+
+int decompressBlock(const char* source, int len, char* destination, int capacity) {
+	const unsigned char* ip = (const unsigned char*) source;
+	const unsigned char* end = ip + len;
+	unsigned char* base = (unsigned char*) destination;
+	unsigned char* op = base;
+	unsigned char* limit = base + capacity;
+
+	while (ip < end) {
+		unsigned token = *ip++;
+
+		/* letterali */
+		size_t literalLen = token >> 4;
+		if (literalLen == 15) {
+			unsigned char b;
+			do {
+				if (ip >= end)
+					return -1;
+				b = *ip++;
+				literalLen += b;
+			} while (b == 255);
+		}
+		if (literalLen > (size_t) (end - ip) || literalLen > (size_t) (limit - op))
+			return -1;
+		memcpy(op, ip, literalLen);
+		ip += literalLen;
+		op += literalLen;
+		if (ip == end)
+			break;					// l'ultima sequenza non ha riferimento
+
+		/* riferimento: distanza (2 byte little endian) e lunghezza */
+		if (end - ip < 2)
+			return -1;
+		size_t offset = ip[0] | (ip[1] << 8);
+		ip += 2;
+		if (offset == 0 || offset > (size_t) (op - base))
+			return -1;
+		size_t matchLen = (token & 15);
+		if (matchLen == 15) {
+			unsigned char b;
+			do {
+				if (ip >= end)
+					return -1;
+				b = *ip++;
+				matchLen += b;
+			} while (b == 255);
+		}
+		matchLen += MINMATCH;
+		if (matchLen > (size_t) (limit - op))
+			return -1;
+
+		/* copia byte per byte: il riferimento puo' sovrapporsi ai byte che sta producendo */
+		const unsigned char* match = op - offset;
+		for (size_t i = 0; i < matchLen; i++)
+			op[i] = match[i];
+		op += matchLen;
+	}
+	return int(op - base);
+}
+
+/*	Compressione di un frame (vedi FrameBatch::openFrame): il payload del frame viene copiato in un buffer contiguo e compresso
+*	direttamente nel batch di destinazione. Entrambi i buffer vengono dal pool dei batch, per cui a regime non si alloca memoria.
+*	Il risultato e' un frame dello stesso tipo (frame o packed) con il flag FLAGCOMPRESSED, il cui payload e' la lunghezza
+*	del payload originale seguita dal blocco compresso.
+*	Restituisce false se il frame e' troppo piccolo (o troppo grande) o se la compressione non ne riduce la dimensione:
+*	in quel caso va inviato in chiaro.
+*/
+
+bool compressBatch(const FrameBatch& batch, FrameBatch& compressed) {
+	size_t bytes = batch.getBytes();
+	if (bytes < COMPRESSMIN || bytes > COMPRESSMAX)
+		return false;
+
+	try {
+		/* payload del frame: tutti i byte dopo l'envelope iniziale, che viene conservato per il tipo del frame */
+		FrameBatch plainBatch;
+		size_t plainBytes = bytes - ENVELOPESIZE;
+		char* plain = plainBatch.appendSpace((int) plainBytes);
+		char envelope[ENVELOPESIZE];
+		size_t position = 0, skip = ENVELOPESIZE;
+		for (const Segment& s : batch.getSegments()) {
+			size_t from = std::min(skip, (size_t) s.len);
+			memcpy(envelope + (ENVELOPESIZE - skip), s.data, from);
+			skip -= from;
+			memcpy(plain + position, s.data + from, s.len - from);
+			position += s.len - from;
+		}
+
+		int header = ENVELOPESIZE + sizeof(DWORD);
+		int bound = compressBound((int) plainBytes);
+		compressed.clear();
+		char* frame = compressed.appendSpace(header + bound);
+
+		int len = compressBlock(plain, (int) plainBytes, frame + header, bound);
+		if (len == 0 || len + header >= (int) bytes)
+			return false;
+		compressed.discard(bound - len);
+
+		/* envelope del frame compresso e lunghezza del payload originale, in formato network */
+		u_short flags = htons(FLAGCOMPRESSED);
+		DWORD payload = htonl(DWORD(sizeof(DWORD) + len)), original = htonl(DWORD(plainBytes));
+		frame[0] = PROTOCOLVERSION;
+		frame[1] = envelope[1];				// stesso tipo del frame in chiaro (frame o packed)
+		memcpy(frame + 2, &flags, sizeof(flags));
+		memcpy(frame + 4, &payload, sizeof(payload));
+		memcpy(frame + ENVELOPESIZE, &original, sizeof(original));
+
+		compressedInput += bytes;
+		compressedOutput += header + len;
+	}
+	catch (std::bad_alloc&) {
+		return false;
+	}
+	return true;
+}
+
+unsigned long long getCompressedInput() {
+	return compressedInput;
+}
+
+unsigned long long getCompressedOutput() {
+	return compressedOutput;
+}
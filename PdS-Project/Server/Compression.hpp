@@ -0,0 +1,24 @@
+#pragma once
+#include "Platform.hpp"
+#include "FrameBatch.hpp"
+#include <atomic>
+
+
+#define COMPRESSMIN 512						// dimensione minima (byte) di un batch da comprimere: heartbeat e cambi di focus restano in chiaro
+#define COMPRESSMAX (8 * 1024 * 1024)		// dimensione massima (byte) di un batch da comprimere
+
+/*	Compressione dei batch inviati ai client che l'hanno richiesta (vedi CAPCOMPRESSION in ListHandler.cpp).
+*	Il formato e' quello dei blocchi LZ4 (sequenze di letterali e riferimenti all'indietro, senza entropy coding):
+*	la compressione e' molto veloce e riduce soprattutto nomi UTF-16 ed icone non compresse.
+*	Viene compresso il payload di un frame (i messaggi di un ciclo): il frame compresso ha il flag FLAGCOMPRESSED, ed il client
+*	lo decomprime e legge i messaggi contenuti come se fossero arrivati in chiaro.
+*/
+
+int compressBound(int len);
+int compressBlock(const char* source, int len, char* destination, int capacity);
+int decompressBlock(const char* source, int len, char* destination, int capacity);
+bool compressBatch(const FrameBatch& batch, FrameBatch& compressed);
+
+/* Byte totali dei batch compressi, prima e dopo la compressione */
+unsigned long long getCompressedInput();
+unsigned long long getCompressedOutput();
@@ -0,0 +1,372 @@
+#include "ConnectionManager.hpp"
+#include "Metrics.hpp"
+#include <iostream>
+#include <algorithm>
+
+/* Costruttore della classe che si occupa:
+*  1. Inizializzare la libreria Winsock (solo su Windows)
+*  2. definire il Socket del Server (tipo di indirizzi, tipo di protocollo)
+*  3. binding del socket con la struttura dati che contiene indirizzi e porta (per poter permettere al S.O. di poter inoltrare correttamente al Server i messaggi)
+*  4. setting del socket in modalit di ascolto (non bloccante) per attendere eventuali connessioni.
+*  5. creazione del socket di risveglio del reactor.
+*/
+
+ConnectionManager::ConnectionManager(int port) : running(true) {
+
+	/* Impostazione dei socket come non validi per default */
+	serverSocket = INVALID_SOCKET;
+	wakeupSocket = INVALID_SOCKET;
+
+	/* Inizializzazione libreria Winsock con metodo WSAStartup, con parametri:
+	*  - wVersionRequested: Una WORD che indica la versione che bisogna inizializzare. Il BYTE di minor importanza indica il numero
+	*  - di versione maggiore mentre il BYTE pi significativo indica il numero di versione minore. Usiamo Winsock 2.2.
+	*  - lpWSAData: Un puntatore alla struttura WSADATA che riceve i dettagli della libreria Winsock.
+	*/
+
+#ifdef _WIN32
+	if (WSAStartup(MAKEWORD(2, 2), &wsaData) != 0)
+		throw socket_exception("Inizializzazione librerie Winsock fallita!");
+#endif
+
+	/* Per inviare e ricevere dati abbiamo bisogno di creare un socket. Dopo che il S.O. ne ha creato uno per noi ci ritorna un intero che
+	*  lo identifica. Per contenere l'intero viene utilizzato il tipo di dato SOCKET. Per farlo dobbiamo chiamare la funzione di nome
+	*  socket definita con i seguenti parametri:
+	*  - __in  int af: indica il tipo di indirizzi che utilizza (con AF_INET si intende indirizzi IPv4).
+	*  - __in  int type: il tipo di protocollo di trasporto da utilizzare (con SOCK_STREAM si specifica di voler usare protocolli che simulano il flusso dati di TCP).
+	*  - __in  int protocol: indica strettamente il tipo di protocollo da usare (se TCP o UDP).
+	*/
+
+	serverSocket = socket(AF_INET, SOCK_STREAM, IPPROTO_TCP);
+	if (serverSocket == INVALID_SOCKET)
+		throw socket_exception("Costruzione del socket fallita!");
+
+	/* Preparazione della struttura per fare il binding:
+	*  L'applicazione server deve rimanere in ascolto per nuove connessioni da un client, per far questo, bisogna dire al S.O. quali sono
+	*  i pacchetti destinati a noi (applicazione server). Quindi dobbiamo settare una porta per la nostra applicazione, per far in modo che
+	*  i messaggi dei client che specificano la nostra porta vengono inoltrati a noi. Questo lavoro  fatto dalla funzione di Bind.
+	*/
+
+#ifndef _WIN32
+	/* su Linux la porta resterebbe occupata per qualche minuto dopo la terminazione del server (connessioni in TIME_WAIT) */
+	int reuse = 1;
+	setsockopt(serverSocket, SOL_SOCKET, SO_REUSEADDR, (const char*) &reuse, sizeof(reuse));
+#endif
+
+	ZeroMemory(&sockAddr, sizeof(sockAddr));		// Riempie di "zeri" una certa struttura dati passata come parametro, in questo caso sockAddr
+
+	sockAddr.sin_family = AF_INET;					// Tipologia di famiglia che indirizza.
+	sockAddr.sin_port = htons(port);				// Numero della porta scelta dal server (e che i client dovranno specificare per parlare con esso)
+	sockAddr.sin_addr.s_addr = htonl(INADDR_ANY);	// Indirizzo locale (con INADDR_ANY non  necessario specificarne uno). Utile quando ci sono pi interfacce su server ect..
+
+	/* La funzione bind prende come parametri:
+	*  - __in  SOCKET s: Il socket da bindare.
+	*  - __in  const struct sockaddr *name: il puntatore a una struttura sockaddr che contiene le informazioni sulla porta e l'indirizzo locale.
+	*  - __in  int namelen: La lunghezza in byte della struttura sockaddr
+	*/
+	if (bind(serverSocket, (struct sockaddr*) &sockAddr, sizeof(sockAddr)) != 0) {
+		closesocket(serverSocket);
+		throw socket_exception("Ascolto fallito da parte del Server");
+	}
+
+	/* Dopo aver effettuato il binding tra il socket e la struttura sockAddr che memorizza la porta e le altre informazioni, bisogna mettere
+	* il socket in posizione d'ascolto con la funzione Listen che specifica:
+	* il socket da mettere in ascolto.
+	* lunghezza della coda di connessioni che possono essere messe in attesa (SOMAXCONN: pi client possono connettersi contemporaneamente).
+	*/
+
+	if (listen(serverSocket, PENDINGQUEUE) == SOCKET_ERROR) {
+		closesocket(serverSocket);
+		throw socket_exception("Ascolto fallito");
+	}
+
+	/* Il socket in ascolto  non bloccante: la accept viene chiamata solo quando il Poller segnala una connessione in arrivo */
+	u_long nonBlocking = 1;
+	if (ioctlsocket(serverSocket, FIONBIO, &nonBlocking) == SOCKET_ERROR) {
+		closesocket(serverSocket);
+		throw socket_exception("Impostazione del socket non bloccante fallita");
+	}
+
+	/*	Socket di risveglio: un socket UDP legato ad una porta effimera di loopback.
+	*	Inviando un datagramma a se stesso, un altro thread interrompe l'attesa del reactor (ad esempio quando ci sono nuovi dati da inviare).
+	*/
+
+	wakeupSocket = socket(AF_INET, SOCK_DGRAM, IPPROTO_UDP);
+	if (wakeupSocket == INVALID_SOCKET) {
+		closesocket(serverSocket);
+		throw socket_exception("Costruzione del socket di risveglio fallita!");
+	}
+
+	ZeroMemory(&wakeupAddr, sizeof(wakeupAddr));
+	wakeupAddr.sin_family = AF_INET;
+	wakeupAddr.sin_port = 0;
+	wakeupAddr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+	socklen_t wakeupLen = sizeof(wakeupAddr);
+
+	if (bind(wakeupSocket, (struct sockaddr*) &wakeupAddr, sizeof(wakeupAddr)) != 0 ||
+		getsockname(wakeupSocket, (struct sockaddr*) &wakeupAddr, &wakeupLen) != 0 ||
+		ioctlsocket(wakeupSocket, FIONBIO, &nonBlocking) == SOCKET_ERROR) {
+		closesocket(wakeupSocket);
+		closesocket(serverSocket);
+		throw socket_exception("Inizializzazione del socket di risveglio fallita");
+	}
+
+	poller.add(serverSocket, POLLER_READ);
+	poller.add(wakeupSocket, POLLER_READ);
+}
+
+/* Il distruttore chiude tutte le connessioni ancora aperte ed i socket del server */
+ConnectionManager::~ConnectionManager() {
+	for (auto& c : connections)
+		c.second->setStatus(false);
+	connections.clear();
+	closesocket(wakeupSocket);
+	closesocket(serverSocket);
+}
+
+/* Impostazione delle funzioni invocate alla connessione di un client e alla ricezione di dati */
+void ConnectionManager::setHandlers(std::function<void(std::shared_ptr<SocketStream>)> connect, std::function<void(SocketStream&)> data) {
+	onConnect = connect;
+	onData = data;
+}
+
+/*	Ciclo degli eventi del reactor: eseguito da un unico thread fino alla chiamata di stop().
+*	Ad ogni iterazione si inviano i batch accodati dal thread della lista, si attendono gli eventi sui socket e si gestiscono:
+*	- nuove connessioni sul socket in ascolto
+*	- dati in arrivo (comandi) dai client
+*	- socket tornati scrivibili, per completare gli invii pendenti
+*/
+
+void ConnectionManager::run() {
+	std::vector<PollEvent> ready;
+	char discard[64];
+
+	while (running) {
+		sendQueued();
+		updateInterest();
+		poller.wait(ready, resumeAccepts());
+
+		for (PollEvent& e : ready) {
+			if (e.fd == serverSocket) {
+				acceptConnections();
+				continue;
+			}
+
+			if (e.fd == wakeupSocket) {
+				// si svuota il socket di risveglio: il suo unico scopo  interrompere la wait
+				while (recv(wakeupSocket, discard, sizeof(discard), 0) > 0);
+				continue;
+			}
+
+			std::map<SOCKET, std::shared_ptr<SocketStream>>::iterator i = connections.find(e.fd);
+			if (i == connections.end())
+				continue;
+			std::shared_ptr<SocketStream> connection = i->second;
+
+			if (e.events & POLLER_ERROR) {
+				closeConnection(e.fd);
+				continue;
+			}
+
+			if (e.events & POLLER_WRITE) {
+				try {
+					connection->flush();
+				}
+				catch (socket_exception& ex) {
+					std::wcerr << "Invio fallito: " << ex.what() << std::endl;
+					closeConnection(e.fd);
+					continue;
+				}
+			}
+
+			if (e.events & POLLER_READ)
+				readConnection(connection);
+		}
+	}
+}
+
+/* Terminazione del ciclo degli eventi: pu essere chiamata da qualsiasi thread */
+void ConnectionManager::stop() {
+	running = false;
+	wakeup();
+}
+
+/* Risveglio del reactor: invio di un byte al socket di risveglio */
+void ConnectionManager::wakeup() {
+	char c = 0;
+	sendto(wakeupSocket, &c, 1, 0, (struct sockaddr*) &wakeupAddr, sizeof(wakeupAddr));
+}
+
+/*	La funzione accept accetta una connessione in entrata su un certo socket.
+*	Il Poller segnala il socket in ascolto come leggibile quando ci sono connessioni in coda: si accettano tutte
+*	finch la accept non restituisce WSAEWOULDBLOCK (coda vuota). Gli altri errori (es. troppi descrittori aperti, o connessione
+*	interrotta dal client prima dell'accettazione) non sono fatali: vengono segnalati, le accettazioni vengono sospese per
+*	ACCEPTPAUSE ms (vedi resumeAccepts) ed il reactor continua a servire i client gia' connessi.
+*	Il valore di ritorno dalla funzione accept  un socket che identifica il client, con il quale  possibile inviare e ricevere dati.
+*/
+
+void ConnectionManager::acceptConnections() {
+	struct sockaddr_in clientSockAddr;
+	socklen_t clientAddrLen;
+
+	while (true) {
+		clientAddrLen = sizeof(clientSockAddr);
+		SOCKET clientSocket = accept(serverSocket, (struct sockaddr*)&clientSockAddr, &clientAddrLen);
+
+		if (clientSocket == INVALID_SOCKET) {
+			int error = WSAGetLastError();
+			if (error == WSAEWOULDBLOCK)
+				return;
+
+			/* il socket in ascolto resterebbe leggibile: senza una pausa il reactor ripeterebbe subito la accept */
+			std::wcerr << "Accettazione del Client fallita (errore " << error << "): nuova accettazione tra " << ACCEPTPAUSE << " ms" << std::endl;
+			poller.modify(serverSocket, 0);
+			acceptPaused = true;
+			acceptResume = std::chrono::steady_clock::now() + std::chrono::milliseconds(ACCEPTPAUSE);
+			return;
+		}
+
+		std::shared_ptr<SocketStream> connection;
+		try {
+			connection = std::make_shared<SocketStream>(clientSocket);
+		}
+		catch (socket_exception& e) {
+			std::wcerr << e.what() << std::endl;		// il costruttore di SocketStream ha gia' chiuso il socket
+			continue;
+		}
+		catch (std::bad_alloc&) {
+			std::wcerr << "Connessione rifiutata: memoria esaurita" << std::endl;
+			closesocket(clientSocket);
+			continue;
+		}
+
+		/* se la connessione non puo' essere registrata nel Poller, il distruttore di SocketStream chiude il socket */
+		try {
+			poller.add(clientSocket, POLLER_READ);
+		}
+		catch (std::exception& e) {
+			std::wcerr << "Connessione rifiutata: " << e.what() << std::endl;
+			continue;
+		}
+
+		connections[clientSocket] = connection;
+		interests[clientSocket] = POLLER_READ;
+		Metrics::instance().acceptedConnections++;
+
+		if (onConnect)
+			onConnect(connection);
+	}
+}
+
+/*	Ripresa delle accettazioni sospese dopo un errore della accept, se la pausa e' terminata.
+*	Restituisce il timeout (ms) della prossima attesa del Poller: durante la pausa non oltre la sua fine.
+*/
+int ConnectionManager::resumeAccepts() {
+	if (!acceptPaused)
+		return POLLTIMEOUT;
+	std::chrono::steady_clock::time_point now = std::chrono::steady_clock::now();
+	if (now >= acceptResume) {
+		poller.modify(serverSocket, POLLER_READ);
+		acceptPaused = false;
+		return POLLTIMEOUT;
+	}
+	long long remaining = std::chrono::duration_cast<std::chrono::milliseconds>(acceptResume - now).count() + 1;
+	return (int) std::min<long long>(remaining, POLLTIMEOUT);
+}
+
+/* Lettura di tutti i dati disponibili sulla connessione e consegna all'handler dei comandi */
+void ConnectionManager::readConnection(std::shared_ptr<SocketStream> connection) {
+	SOCKET s = connection->getSocket();
+	try {
+		if (connection->fillReadBuffer() == 0) {
+			// il client ha chiuso la connessione
+			closeConnection(s);
+			return;
+		}
+		if (onData)
+			onData(*connection);
+	}
+	catch (std::exception& e) {
+		std::wcerr << "Client close connection: " << e.what() << std::endl;
+		closeConnection(s);
+	}
+}
+
+/* Rimozione della connessione dal Poller e chiusura del socket */
+void ConnectionManager::closeConnection(SOCKET s) {
+	std::map<SOCKET, std::shared_ptr<SocketStream>>::iterator i = connections.find(s);
+	if (i == connections.end())
+		return;
+	poller.remove(s);
+	interests.erase(s);
+	i->second->setStatus(false);
+	try {
+		i->second->closeConnection();
+	}
+	catch (socket_exception& e) {
+		std::wcerr << e.what() << std::endl;
+	}
+	connections.erase(i);
+	Metrics::instance().closedConnections++;
+}
+
+/*	Stadio di invio: i batch accodati dal thread della lista vengono inviati ad ogni connessione con scritture vettoriali;
+*	la parte che il kernel non accetta resta nel buffer di scrittura e viene completata quando il socket torna scrivibile.
+*	Una connessione il cui invio fallisce viene chiusa.
+*/
+
+void ConnectionManager::sendQueued() {
+	std::vector<SOCKET> failed;
+	unsigned long long calls = 0;
+	size_t bytes = 0;
+	for (auto& c : connections) {
+		if (!c.second->getStatus() || c.second->getQueuedBatches() == 0)
+			continue;
+		calls -= c.second->getSendCalls();
+		try {
+			bytes += c.second->sendQueued();
+		}
+		catch (socket_exception& e) {
+			std::wcerr << "Invio al client fallito: " << e.what() << std::endl;
+			failed.push_back(c.first);
+		}
+		calls += c.second->getSendCalls();
+	}
+	for (SOCKET s : failed)
+		closeConnection(s);
+
+	if (bytes > 0) {
+		Metrics& metrics = Metrics::instance();
+		metrics.bytesSent += bytes;
+		metrics.sendSyscalls.record((unsigned long) calls);
+	}
+}
+
+/*	Aggiornamento degli eventi di interesse: si chiede di essere notificati della scrivibilit solo per le connessioni
+*	che hanno dati in attesa di invio. Le connessioni chiuse da altri thread (setStatus(false)) vengono rimosse.
+*/
+
+void ConnectionManager::updateInterest() {
+	std::vector<SOCKET> closed;
+	long long pending = 0, queued = 0;
+	for (auto& c : connections) {
+		if (!c.second->getStatus()) {
+			closed.push_back(c.first);
+			continue;
+		}
+		size_t bytes = c.second->getPendingBytes();
+		pending += (long long) bytes;
+		queued += (long long) c.second->getQueuedBatches();
+		int events = bytes > 0 ? POLLER_READ | POLLER_WRITE : POLLER_READ;
+		if (interests[c.first] != events) {
+			poller.modify(c.first, events);
+			interests[c.first] = events;
+		}
+	}
+	for (SOCKET s : closed)
+		closeConnection(s);
+
+	Metrics& metrics = Metrics::instance();
+	metrics.pendingBytes = pending;
+	metrics.queuedBatches = queued;
+	metrics.connections = (long long) connections.size();
+}
@@ -0,0 +1,52 @@
+#pragma once
+#include "SocketStream.hpp"
+#include "Poller.hpp"
+#include <map>
+#include <memory>
+#include <functional>
+#include <chrono>
+
+
+#define PENDINGQUEUE SOMAXCONN
+#define POLLTIMEOUT 1000					// timeout (ms) dell'attesa degli eventi, per controllare periodicamente la terminazione
+#define ACCEPTPAUSE 100						// pausa (ms) delle accettazioni dopo un errore della accept (es. descrittori esauriti)
+
+/*	Reactor che gestisce tutte le connessioni dei client.
+*	Un unico thread (quello che esegue run) accetta le nuove connessioni, legge i comandi e completa gli invii pendenti,
+*	per cui il numero di thread del server non dipende dal numero di client connessi.
+*	E' anche lo stadio di invio: i batch accodati dal thread della lista (vedi SocketStream::enqueue) vengono inviati
+*	dal reactor, che il thread della lista sveglia tramite wakeup().
+*/
+
+class ConnectionManager {
+#ifdef _WIN32
+	WSADATA wsaData;						// per poter usare le Winsock bisogna inizializzare la libreria
+#endif
+	SOCKET serverSocket;					// socket (oggetto che rappresenta una connessione) in attesa di nuovi client
+	SOCKET wakeupSocket;					// socket UDP su loopback usato per interrompere l'attesa del reactor
+	struct sockaddr_in	sockAddr, wakeupAddr;	// struttura dati che contiene informazioni sulla famiglia di indirizzi (se Ipv4 o Ipv6), indirizzo IP locale e Porta
+	Poller poller;
+	std::map<SOCKET, std::shared_ptr<SocketStream>> connections;	// connessioni attive indicizzate per socket
+	std::map<SOCKET, int> interests;								// eventi attualmente registrati nel Poller per ogni connessione
+	std::atomic_bool running;
+	bool acceptPaused = false;										// accettazioni sospese dopo un errore della accept
+	std::chrono::steady_clock::time_point acceptResume;				// istante in cui riprendono le accettazioni
+
+	std::function<void(std::shared_ptr<SocketStream>)> onConnect;	// invocata per ogni nuovo client
+	std::function<void(SocketStream&)> onData;						// invocata quando ci sono nuovi dati da un client
+
+	void acceptConnections();
+	int resumeAccepts();
+	void readConnection(std::shared_ptr<SocketStream> connection);
+	void closeConnection(SOCKET s);
+	void sendQueued();
+	void updateInterest();
+
+public:
+	ConnectionManager(int port);
+	~ConnectionManager();
+	void setHandlers(std::function<void(std::shared_ptr<SocketStream>)> connect, std::function<void(SocketStream&)> data);
+	void run();
+	void stop();
+	void wakeup();
+};
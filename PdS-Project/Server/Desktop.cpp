@@ -0,0 +1,154 @@
+#include "Desktop.hpp"
+#include <stdexcept>
+
+#ifdef _WIN32
+
+/*
+Funzione che viene richiamata per ogni finestra rilevata da EnumWindow() (vedi dopo)
+Se la finestra non e' visibile ritorna subito;
+altrimenti aggiunge il pid del processo che possiede la finestra al vettore passato come parametro.
+I pid ripetuti (piu' finestre dello stesso processo) vengono eliminati da ListHandler::buildList.
+*/
+
+BOOL CALLBACK MyWindowProc(__in HWND hwnd, __in LPARAM lparam) {
+
+	/* Finestra non visibile */
+	if (!IsWindowVisible(hwnd)) {
+		return TRUE;
+	}
+
+	DWORD procID;
+	GetWindowThreadProcessId(hwnd, &procID);		// ottenimento del pid
+	((std::vector<DWORD>*) lparam)->push_back(procID);
+
+	return TRUE;
+}
+
+/*
+Enumerazione dei processi che possiedono almeno una finestra visibile, richiamando la funzione EnumWindows()
+Alla funzione viene passata la callback ed il vettore dei pid (non ordinato, con eventuali ripetizioni).
+*/
+
+void enumerateProcesses(std::vector<DWORD>& pids) {
+
+	/* Per ogni applicazione in foreground eseguiamo la MyWindowsProc passando il vettore dei pid
+	*  Enumera tutte le top-level windows sullo schermo passando l'handle ad ogni window, a turno, ad una application-defined callback function.
+	*  EnumWindows continua finche' l'ultima top-level window non viene enumerata o se la callback function ritorna FALSE (per questo restituisce true la func mywind).
+	*/
+	if (!EnumWindows(MyWindowProc, (LPARAM)&pids))
+		throw std::runtime_error("Fallimento nella enumerazione delle Windows");
+}
+
+/*	La funzione GetForegroundWindow() prende (restituisce) l'HANDLE della window in foreground
+*	la funzione getwindowthreadprocessID restituisce il pid del processo che la possiede
+*/
+
+DWORD getForegroundProcess() {
+	DWORD foreground = 0;
+	GetWindowThreadProcessId(GetForegroundWindow(), &foreground);
+	return foreground;
+}
+
+/* Aggiunta di un evento di tastiera (pressione o rilascio) al vettore degli input */
+
+static void appendInput(std::vector<INPUT>& inputs, WORD key, WORD scan, DWORD flags) {
+	INPUT input;
+	ZeroMemory(&input, sizeof(input));
+	input.type = INPUT_KEYBOARD;			// evento INPUT_KEYBOARD
+	input.ki.wVk = key;
+	input.ki.wScan = scan;
+	input.ki.dwFlags = flags;				// pressione (0) o rilascio (KEYEVENTF_KEYUP); il timestamp e' quello del sistema
+	inputs.push_back(input);
+}
+
+/*	Invio all'applicazione in foreground di una sequenza di tasti, ciascuno con i propri modificatori.
+*	Per ogni combinazione si premono i modificatori, si preme e rilascia il tasto e si rilasciano i modificatori;
+*	tutti gli eventi della sequenza vengono inviati con una sola SendInput, per cui non si mescolano con l'input locale.
+*/
+
+void sendKeys(const std::vector<KeyChord>& chords) {
+	std::vector<INPUT> inputs;
+	inputs.reserve(chords.size() * 8);		// al piu' 4 pressioni + 4 rilasci di tasti (3 modificatori e un key) per combinazione
+
+	for (const KeyChord& c : chords) {
+		/* in input salviamo i modificatori premuti (ricevuti dal client) */
+		if ((c.modifier & MODSHIFT) != 0)
+			appendInput(inputs, VK_SHIFT, 0, 0);
+		if ((c.modifier & MODCTRL) != 0)
+			appendInput(inputs, VK_CONTROL, 0, 0);
+		if ((c.modifier & MODALT) != 0)
+			appendInput(inputs, VK_MENU, 0, 0);
+
+		/* concateniamo sia la pressione sia il rilascio del tasto */
+		appendInput(inputs, (WORD) c.key, 0, 0);
+		appendInput(inputs, (WORD) c.key, 0, KEYEVENTF_KEYUP);
+
+		/* concateniamo i rilasci dei modificatori eventualmente premuti */
+		if ((c.modifier & MODSHIFT) != 0)
+			appendInput(inputs, VK_SHIFT, 0, KEYEVENTF_KEYUP);
+		if ((c.modifier & MODCTRL) != 0)
+			appendInput(inputs, VK_CONTROL, 0, KEYEVENTF_KEYUP);
+		if ((c.modifier & MODALT) != 0)
+			appendInput(inputs, VK_MENU, 0, KEYEVENTF_KEYUP);
+	}
+
+	/* funzione che invia direttamente all'app in foreground il vettore degli eventi */
+	if (!inputs.empty())
+		SendInput((UINT) inputs.size(), inputs.data(), sizeof(INPUT));
+}
+
+/*	Invio all'applicazione in foreground di un testo: ogni unita' UTF-16 viene inviata come carattere (KEYEVENTF_UNICODE),
+*	indipendentemente dal layout della tastiera; le coppie surrogate vengono inviate come due unita' consecutive.
+*	Come per i tasti, tutto il testo viene inviato con una sola SendInput.
+*/
+
+void sendText(const std::u16string& text) {
+	std::vector<INPUT> inputs;
+	inputs.reserve(text.size() * 2);
+
+	for (char16_t c : text) {
+		appendInput(inputs, 0, (WORD) c, KEYEVENTF_UNICODE);
+		appendInput(inputs, 0, (WORD) c, KEYEVENTF_UNICODE | KEYEVENTF_KEYUP);
+	}
+
+	if (!inputs.empty())
+		SendInput((UINT) inputs.size(), inputs.data(), sizeof(INPUT));
+}
+
+#else
+
+#include <dirent.h>
+#include <cstdlib>
+
+/*	Implementazione Linux: non ci sono finestre, per cui vengono elencati tutti i processi (le directory numeriche di /proc).
+*	I processi senza eseguibile (thread del kernel) vengono scartati da ProcessCache::resolve.
+*/
+
+void enumerateProcesses(std::vector<DWORD>& pids) {
+	DIR* proc = opendir("/proc");
+	if (proc == NULL)
+		throw std::runtime_error("Apertura di /proc fallita");
+
+	struct dirent* entry;
+	while ((entry = readdir(proc)) != NULL) {
+		char* end;
+		unsigned long pid = strtoul(entry->d_name, &end, 10);
+		if (*end == '\0' && end != entry->d_name)
+			pids.push_back((DWORD) pid);
+	}
+	closedir(proc);
+}
+
+/* Il server headless non ha un'applicazione in foreground: non vengono mai inviate modifiche di focus */
+DWORD getForegroundProcess() {
+	return 0;
+}
+
+/* Senza una sessione grafica i comandi non possono essere inoltrati: vengono ignorati (CommandsFromClient li ha gia' registrati) */
+void sendKeys(const std::vector<KeyChord>&) {
+}
+
+void sendText(const std::u16string&) {
+}
+
+#endif
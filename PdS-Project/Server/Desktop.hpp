@@ -0,0 +1,29 @@
+#pragma once
+#include "Platform.hpp"
+#include <vector>
+#include <string>
+
+
+/* Modificatori dei comandi da tastiera inviati dal client (combinabili in OR) */
+#define MODSHIFT 1
+#define MODCTRL 2
+#define MODALT 4
+
+/* Tasto (virtual key) con i modificatori da tenere premuti */
+struct KeyChord {
+	char modifier;
+	int key;
+};
+
+/*	Interazione con la sessione dell'utente: processi con finestre visibili, applicazione in foreground ed input da tastiera.
+*	Su Windows si usano le finestre del desktop; su Linux il server e' senza interfaccia (headless): vengono elencati
+*	tutti i processi di /proc, non c'e' un'applicazione in foreground e i comandi da tastiera (tasti e testo) vengono solo registrati.
+*/
+
+/* Funzione che elenca i pid dei processi visibili (anche ripetuti): enumerateProcesses, o una sorgente sintetica nei benchmark */
+typedef void (*ProcessEnumerator)(std::vector<DWORD>& pids);
+
+void enumerateProcesses(std::vector<DWORD>& pids);
+DWORD getForegroundProcess();
+void sendKeys(const std::vector<KeyChord>& chords);
+void sendText(const std::u16string& text);
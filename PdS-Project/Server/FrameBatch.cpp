@@ -0,0 +1,194 @@
+#include "FrameBatch.hpp"
+#include <mutex>
+#include <cstring>
+
+/*	Pool dei buffer dei batch: i buffer restituiti conservano la capacita' gia' allocata, per cui il ciclo successivo
+*	(o l'invio di un'icona, un echo...) li riusa senza allocare. Il pool e' condiviso da tutti i thread.
+*/
+
+/* il pool ha gia' la capacita' massima: restituire un buffer (anche dal distruttore di un batch) non alloca mai */
+static std::vector<BatchStorage*> createPool() {
+	std::vector<BatchStorage*> p;
+	p.reserve(BATCHPOOLSIZE);
+	return p;
+}
+
+static std::mutex poolMutex;
+static std::vector<BatchStorage*> pool = createPool();
+
+static BatchStorage* acquireStorage() {
+	{
+		std::lock_guard<std::mutex> lock(poolMutex);
+		if (!pool.empty()) {
+			BatchStorage* storage = pool.back();
+			pool.pop_back();
+			return storage;
+		}
+	}
+	return new BatchStorage();
+}
+
+/* Restituzione di un buffer al pool: i riferimenti ai buffer condivisi vengono rilasciati subito */
+static void releaseStorage(BatchStorage* storage) {
+	storage->arena.clear();
+	storage->segments.clear();
+	storage->local.clear();
+	storage->shared.clear();
+	if (storage->arena.capacity() <= BATCHPOOLMAXBYTES) {
+		std::lock_guard<std::mutex> lock(poolMutex);
+		if (pool.size() < BATCHPOOLSIZE) {
+			pool.push_back(storage);
+			return;
+		}
+	}
+	delete storage;
+}
+
+/* Il distruttore restituisce la memoria al pool */
+FrameBatch::~FrameBatch() {
+	if (storage != nullptr)
+		releaseStorage(storage);
+}
+
+BatchStorage& FrameBatch::getStorage() {
+	if (storage == nullptr)
+		storage = acquireStorage();
+	return *storage;
+}
+
+/*	Aggiunta di len byte in fondo all'arena, restituiti al chiamante per scriverci direttamente (il puntatore resta valido
+*	fino alla successiva aggiunta). Se anche l'ultimo segmento e' nell'arena, viene esteso invece di aggiungerne uno nuovo.
+*/
+char* FrameBatch::appendSpace(int len) {
+	BatchStorage& s = getStorage();
+	size_t position = s.arena.size();
+	bool extend = !s.local.empty() && s.local.back().first == s.segments.size() - 1;
+
+	/* in caso di eccezione il batch resta com'era prima dell'aggiunta */
+	if (!extend) {
+		s.segments.push_back(Segment{ nullptr, 0 });
+		try {
+			s.local.push_back(std::make_pair(s.segments.size() - 1, position));
+		}
+		catch (...) {
+			s.segments.pop_back();
+			throw;
+		}
+	}
+	try {
+		s.arena.resize(position + len);
+	}
+	catch (...) {
+		if (!extend) {
+			s.segments.pop_back();
+			s.local.pop_back();
+		}
+		throw;
+	}
+
+	s.segments.back().len += len;
+	bytes += len;
+	return s.arena.data() + position;
+}
+
+/* Rimozione degli ultimi len byte scritti con appendSpace (es. spazio riservato e non usato dalla compressione) */
+void FrameBatch::discard(int len) {
+	if (storage == nullptr || storage->local.empty() || storage->local.back().first != storage->segments.size() - 1)
+		return;
+	Segment& last = storage->segments.back();
+	len = len < last.len ? len : last.len;
+	last.len -= len;
+	storage->arena.resize(storage->arena.size() - len);
+	bytes -= len;
+}
+
+/* Aggiunta di una copia dei dati (campi piccoli o convertiti, es. il nome UTF-16 su Linux) */
+void FrameBatch::append(const char* data, int len) {
+	if (len <= 0)
+		return;
+	memcpy(appendSpace(len), data, len);
+}
+
+/* Aggiunta di un buffer condiviso: i dati non vengono copiati, il batch mantiene solo un riferimento al proprietario */
+void FrameBatch::append(std::shared_ptr<const void> owner, const char* data, int len) {
+	BatchStorage& s = getStorage();
+	s.shared.push_back(owner);
+	if (len <= 0)
+		return;
+	s.segments.push_back(Segment{ data, len });
+	bytes += len;
+}
+
+/* Aggiunta di un campo lunghezza (4 byte in formato network) */
+void FrameBatch::appendLength(int len) {
+	DWORD field = htonl(DWORD(len));
+	memcpy(appendSpace(sizeof(DWORD)), &field, sizeof(DWORD));
+}
+
+/* Aggiunta di un hash a 64 bit (8 byte in formato network, dal byte piu' significativo) */
+void FrameBatch::appendHash(unsigned long long hash) {
+	unsigned char* field = (unsigned char*) appendSpace(8);
+	for (int i = 0; i < 8; i++)
+		field[i] = (unsigned char) (hash >> (56 - 8 * i));
+}
+
+/* Aggiunta di un envelope: versione, tipo e flag del messaggio, seguiti dalla lunghezza del payload in formato network */
+void FrameBatch::appendEnvelope(unsigned char type, int payload, u_short flags) {
+	char* field = appendSpace(ENVELOPESIZE);
+	u_short netFlags = htons(flags);
+	DWORD netPayload = htonl(DWORD(payload));
+	field[0] = PROTOCOLVERSION;
+	field[1] = (char) type;
+	memcpy(field + 2, &netFlags, sizeof(netFlags));
+	memcpy(field + 4, &netPayload, sizeof(netPayload));
+}
+
+/*	Apertura di un frame: l'envelope viene aggiunto subito, la lunghezza del payload (i messaggi aggiunti fino a closeFrame)
+*	viene scritta alla chiusura. L'arena puo' essere riallocata, per cui dell'envelope si ricorda la posizione.
+*/
+void FrameBatch::openFrame(unsigned char type) {
+	appendEnvelope(type, 0);
+	frameEnvelope = storage->arena.size() - ENVELOPESIZE;
+	frameStart = bytes;
+	frameOpen = true;
+}
+
+void FrameBatch::closeFrame() {
+	if (!frameOpen)
+		return;
+	DWORD length = htonl(DWORD(bytes - frameStart));
+	memcpy(storage->arena.data() + frameEnvelope + 4, &length, sizeof(length));
+	frameOpen = false;
+}
+
+/* Segmenti da inviare: quelli nell'arena vengono risolti qui, dato che l'arena puo' essere stata riallocata dopo la loro aggiunta */
+const std::vector<Segment>& FrameBatch::getSegments() const {
+	static const std::vector<Segment> none;
+	if (storage == nullptr)
+		return none;
+	for (const std::pair<size_t, size_t>& l : storage->local)
+		storage->segments[l.first].data = storage->arena.data() + l.second;
+	return storage->segments;
+}
+
+size_t FrameBatch::getBytes() const {
+	return bytes;
+}
+
+bool FrameBatch::empty() const {
+	return storage == nullptr || storage->segments.empty();
+}
+
+/* Svuotamento del batch: la memoria resta al batch per essere riusata */
+void FrameBatch::clear() {
+	if (storage != nullptr) {
+		storage->arena.clear();
+		storage->segments.clear();
+		storage->local.clear();
+		storage->shared.clear();
+	}
+	bytes = 0;
+	frameOpen = false;
+	frameStart = 0;
+	frameEnvelope = 0;
+}
@@ -0,0 +1,72 @@
+#pragma once
+#include "Platform.hpp"
+#include <vector>
+#include <memory>
+#include <utility>
+
+
+#define PROTOCOLVERSION 1					// versione del formato dei messaggi
+#define ENVELOPESIZE 8						// dimensione dell'envelope: versione (1 byte), tipo (1), flag (2), lunghezza del payload (4)
+#define FLAGCOMPRESSED 1					// flag dell'envelope: payload compresso (vedi Compression.hpp)
+#define FLAGTIMESTAMP 2						// flag dell'envelope di un comando: payload preceduto dal timestamp del client (vedi CommandsFromClient)
+#define FLAGICONPENDING 4					// flag dell'envelope di una add: icona in estrazione, seguira' un messaggio icu (vedi IconCache)
+#define BATCHPOOLSIZE 16					// massimo numero di buffer dei batch conservati per essere riusati
+#define BATCHPOOLMAXBYTES (1024 * 1024)		// buffer piu' grandi (es. snapshot di liste enormi) vengono rilasciati invece che conservati
+
+/* Porzione contigua di memoria da inviare con una scrittura vettoriale */
+
+struct Segment {
+	const char* data;
+	int len;
+};
+
+/*	Memoria di un batch: viene presa da un pool alla prima scrittura e restituita (svuotata, ma con la capacita' gia' allocata)
+*	alla distruzione del batch, per cui a regime la serializzazione di un ciclo non alloca memoria.
+*/
+
+struct BatchStorage {
+	std::vector<char> arena;							// campi serializzati dal batch (envelope, pid, lunghezze, nomi, hash)
+	std::vector<Segment> segments;						// segmenti nell'ordine di invio
+	std::vector<std::pair<size_t, size_t>> local;		// segmenti che puntano nell'arena: indice del segmento e posizione nell'arena
+	std::vector<std::shared_ptr<const void>> shared;	// buffer condivisi (es. icone della IconCache) mantenuti fino alla fine dell'invio
+};
+
+/*	Insieme dei messaggi (modifiche) prodotti in un ciclo di aggiornamento della lista.
+*	I campi vengono scritti direttamente in un'arena contigua (campi consecutivi formano un solo segmento), mentre i buffer
+*	condivisi (nomi ed icone) non vengono copiati: il batch ne mantiene solo un riferimento. L'intero ciclo puo' cosi' essere
+*	inviato ad ogni client con un'unica scrittura vettoriale (vedi SocketStream::sendBatch).
+*	Ogni messaggio inizia con un envelope (versione, tipo, flag e lunghezza del payload, in formato network), per cui un client
+*	puo' saltare i messaggi che non conosce. I messaggi di un ciclo sono raccolti in un frame, a sua volta un messaggio
+*	il cui payload e' la sequenza dei messaggi contenuti (openFrame/closeFrame): il client legge un frame con una sola lettura.
+*	Il batch non possiede memoria allocata a parte, per cui un'eccezione durante la serializzazione non lascia buffer da rilasciare.
+*/
+
+class FrameBatch {
+	BatchStorage* storage = nullptr;		// memoria presa dal pool (nullptr finche' il batch e' vuoto)
+	size_t bytes = 0;						// dimensione totale del batch
+	size_t frameStart = 0;					// dimensione del batch all'apertura del frame
+	size_t frameEnvelope = 0;				// posizione nell'arena dell'envelope del frame aperto
+	bool frameOpen = false;
+
+	BatchStorage& getStorage();
+
+public:
+	FrameBatch() {}
+	~FrameBatch();
+	FrameBatch(const FrameBatch&) = delete;
+	FrameBatch& operator=(const FrameBatch&) = delete;
+
+	char* appendSpace(int len);
+	void discard(int len);
+	void append(const char* data, int len);
+	void append(std::shared_ptr<const void> owner, const char* data, int len);
+	void appendLength(int len);
+	void appendHash(unsigned long long hash);
+	void appendEnvelope(unsigned char type, int payload, u_short flags = 0);
+	void openFrame(unsigned char type);
+	void closeFrame();
+	const std::vector<Segment>& getSegments() const;
+	size_t getBytes() const;
+	bool empty() const;
+	void clear();
+};
@@ -0,0 +1,101 @@
+#include "ListHandler.hpp"
+#include <csignal>
+#include <cstdlib>
+#include <condition_variable>
+#define PORT 2000
+#define SIGNALCHECK 200					// intervallo (ms) di controllo dei segnali ricevuti
+
+/*
+* Server senza interfaccia (headless): lo stesso server dell'applicazione nella tray area, eseguito da console.
+* Su Linux usa la lista dei processi di /proc (vedi Desktop.cpp); serve per eseguire profiling, benchmark e test di carico
+* anche fuori da un desktop Windows. Termina con Ctrl+C (SIGINT) o SIGTERM.
+* Uso: pds-server [porta] [intervallo minimo (ms)] [intervallo massimo (ms)] [porta delle metriche (0: disattivate)]
+*      [soglia CPU (centesimi di %)] [soglia memoria (KB)]
+*/
+
+static std::mutex shutdownMutex;
+static std::condition_variable shutdownCondition;
+static bool shutdownRequested = false;
+static int exitCode = 0;
+static volatile std::sig_atomic_t signalReceived = 0;
+
+/* Gestore dei segnali: puo' solo impostare un flag, controllato periodicamente dal thread principale */
+static void onSignal(int) {
+	signalReceived = 1;
+}
+
+/* Terminazione richiesta dal server: viene considerato solo il primo codice */
+void requestShutdown(int code) {
+	std::lock_guard<std::mutex> lock(shutdownMutex);
+	if (!shutdownRequested)
+		exitCode = code;
+	shutdownRequested = true;
+	shutdownCondition.notify_all();
+}
+
+int main(int argc, char* argv[]) {
+	// su Linux i messaggi del server usano sia wcout/wcerr sia cout/cerr: senza sincronizzazione con stdio possono convivere
+	std::ios_base::sync_with_stdio(false);
+
+	int port = PORT;
+	if (argc > 1) {
+		port = atoi(argv[1]);
+		if (port <= 0 || port > 65535) {
+			std::cerr << "Porta non valida: " << argv[1] << std::endl;
+			return 1;
+		}
+	}
+	long minRefresh = MINREFRESHINTERVAL, maxRefresh = MAXREFRESHINTERVAL;
+	if (argc > 3) {
+		minRefresh = atol(argv[2]);
+		maxRefresh = atol(argv[3]);
+	}
+	int metricsPort = METRICSPORT;
+	if (argc > 4)
+		metricsPort = atoi(argv[4]);
+	long cpuThreshold = CPUTHRESHOLD, memoryThreshold = MEMORYTHRESHOLD;
+	if (argc > 6) {
+		cpuThreshold = atol(argv[5]);
+		memoryThreshold = atol(argv[6]);
+	}
+
+	signal(SIGINT, onSignal);
+	signal(SIGTERM, onSignal);
+
+	std::atomic_bool continua(true);		//finche' rimane a true, il server rimane in comunicazione o attesa del client
+
+	try {
+		ConnectionManager manager(port);
+		std::wcout << "Server in ascolto sulla porta " << port << std::endl;
+
+		/* il thread della lista termina da solo se il reactor fallisce: in quel caso termina anche il server */
+		std::thread ThreadManager([&manager, &continua, minRefresh, maxRefresh, metricsPort, cpuThreshold, memoryThreshold]() {
+			serverManagementList(manager, continua, minRefresh, maxRefresh, metricsPort, cpuThreshold, memoryThreshold);
+			requestShutdown(0);
+		});
+
+		{
+			std::unique_lock<std::mutex> lock(shutdownMutex);
+			while (!shutdownRequested && !signalReceived)
+				shutdownCondition.wait_for(lock, std::chrono::milliseconds(SIGNALCHECK));
+		}
+
+		continua = false;
+		manager.stop();				//terminazione del reactor: le connessioni con i client vengono chiuse
+		ThreadManager.join();
+	}
+	catch (socket_exception& e) {
+		std::cerr << "Errore del socket: " << e.what() << std::endl;
+		return 1;
+	}
+	catch (std::system_error& e) {
+		std::cerr << "Impossibile creare un nuovo thread: " << e.what() << std::endl;
+		return 1;
+	}
+
+#ifdef _WIN32
+	WSACleanup();					// liberazione delle risorse Winsock
+#endif
+	std::wcout << "Server terminato" << std::endl;
+	return exitCode;
+}
@@ -0,0 +1,664 @@
+#include "IconCache.hpp"
+#include "Metrics.hpp"
+#include <algorithm>
+#include <cstring>
+#include <system_error>
+
+#ifndef _WIN32
+#include <sys/stat.h>
+#endif
+
+#ifdef _WIN32
+
+#define FNVOFFSET 14695981039346656037ULL
+#define FNVPRIME 1099511628211ULL
+
+/*	Hash del contenuto dell'icona (FNV-1a a 64 bit): identifica l'icona indipendentemente dall'eseguibile da cui proviene.
+*	Il valore 0 e' riservato per indicare "nessuna icona".
+*/
+
+static unsigned long long iconHash(const std::vector<char>& bytes) {
+	unsigned long long hash = FNVOFFSET;
+	for (char c : bytes) {
+		hash ^= (unsigned char) c;
+		hash *= FNVPRIME;
+	}
+	return hash != 0 ? hash : 1;
+}
+
+/* Larghezza dell'immagine di una risorsa RT_ICON: PNG (larghezza nell'header IHDR) oppure DIB (BITMAPINFOHEADER) */
+static int iconWidth(const BYTE* data, DWORD length) {
+	static const BYTE png[] = { 0x89, 'P', 'N', 'G' };
+	if (length >= 24 && memcmp(data, png, sizeof(png)) == 0)
+		return (data[16] << 24) | (data[17] << 16) | (data[18] << 8) | data[19];
+	if (length >= sizeof(BITMAPINFOHEADER)) {
+		BITMAPINFOHEADER header;
+		memcpy(&header, data, sizeof(header));
+		return header.biWidth;
+	}
+	return 0;
+}
+
+/*	Ridimensionamento di un'icona piu' grande di quella richiesta (es. solo 256x256 per un client che chiede 32x32):
+*	l'icona viene disegnata da Windows nella dimensione size e riletta come DIB a 32 bit (colori BGRA seguiti dalla maschera
+*	AND ad 1 bit), lo stesso formato di una risorsa RT_ICON. Restituisce un vettore vuoto se la conversione non riesce:
+*	in quel caso viene inviata l'icona originale.
+*/
+
+static std::vector<char> scaleIcon(const BYTE* data, DWORD length, int size) {
+	std::vector<char> result;
+	HICON scaled = CreateIconFromResourceEx((PBYTE) data, length, TRUE, 0x00030000, size, size, LR_DEFAULTCOLOR);
+	if (scaled == NULL)
+		return result;
+
+	ICONINFO info;
+	if (!GetIconInfo(scaled, &info)) {
+		DestroyIcon(scaled);
+		return result;
+	}
+
+	DWORD colorBytes = size * size * 4;
+	DWORD maskStride = ((size + 31) / 32) * 4;		// righe della maschera allineate a 32 bit
+	DWORD maskBytes = maskStride * size;
+
+	BITMAPINFOHEADER header = {};
+	header.biSize = sizeof(BITMAPINFOHEADER);
+	header.biWidth = size;
+	header.biHeight = size;
+	header.biPlanes = 1;
+	header.biBitCount = 32;
+	header.biCompression = BI_RGB;
+
+	result.resize(sizeof(BITMAPINFOHEADER) + colorBytes + maskBytes);
+	HDC dc = CreateCompatibleDC(NULL);
+	bool ok = dc != NULL && info.hbmColor != NULL &&
+		GetDIBits(dc, info.hbmColor, 0, size, &result[sizeof(BITMAPINFOHEADER)], (BITMAPINFO*) &header, DIB_RGB_COLORS) == size;
+
+	if (ok) {
+		/* maschera monocromatica: BITMAPINFO con spazio per la tavolozza a 2 colori richiesta da GetDIBits */
+		struct {
+			BITMAPINFOHEADER header;
+			RGBQUAD colors[2];
+		} mask = {};
+		mask.header = header;
+		mask.header.biBitCount = 1;
+		ok = GetDIBits(dc, info.hbmMask, 0, size, &result[sizeof(BITMAPINFOHEADER) + colorBytes], (BITMAPINFO*) &mask, DIB_RGB_COLORS) == size;
+	}
+
+	if (dc != NULL)
+		DeleteDC(dc);
+	if (info.hbmColor != NULL)
+		DeleteObject(info.hbmColor);
+	DeleteObject(info.hbmMask);
+	DestroyIcon(scaled);
+
+	if (!ok) {
+		result.clear();
+		return result;
+	}
+
+	/* nelle risorse RT_ICON l'altezza comprende la maschera */
+	header.biHeight = size * 2;
+	header.biSizeImage = colorBytes + maskBytes;
+	memcpy(&result[0], &header, sizeof(header));
+	return result;
+}
+
+/*	Estrazione dell'icona (size x size) dalle risorse dell'eseguibile.
+*	Viene eseguita solo quando l'icona non  presente in cache (o l'eseguibile  stato modificato).
+*	Restituisce un buffer vuoto (nullptr) se l'eseguibile non ha un'icona: verr caricata sul client l'icona di default.
+*/
+
+static IconBuffer loadIcon(const std::wstring& path, int size) {
+
+	DWORD length = 0;
+	HRSRC resource = NULL;
+	LPTSTR groupIconName = NULL;
+
+	/*	La funzione LoadLibraryEx ci permette di caricare l'eseguibile/libreria (in generale il modulo) dell'applicazione nello spazio di memoria
+	*	del nostro processo in formato binario per recuperare l'icona.
+	*	In particolare il parametro LOAD_LIBRARY_AS_DATAFILE indica che il sistema "mappa" il file dentro lo spazio di indirizzamento virtuale 
+	*	del processo chiamante come se in esso ci fosse un data file.
+	*/
+
+	HMODULE hExe = LoadLibraryEx(path.c_str(), NULL, LOAD_LIBRARY_AS_DATAFILE);
+	if (hExe != NULL) {
+		// La funzione EnumResourceNames enumera (scansiona una per volta) tutte le risorse di un certo tipo specificato come parametro.
+		// Nel nostro caso, vengono enumerate le icone (RT_GROUP_ICON) che sono la risorsa che vogliamo estrarre e serializzare.
+		// Il primo parametro  l'handle al modulo (libreria) in cui si deve cercare (se NULL, si considera il processo corrente).
+		// Il terzo parametro  un puntatore alla funzione di call back che deve essere chiamata ogni volta per enumerare le risorse.
+		// (in maniera pi formale "A pointer to the callback function to be called for each enumerated resource name or ID").
+		// In questo caso facciamo uso di una funzione lambda che restituisce un Bool.
+		// Il quarto parametro  passato alla funzione di Callback (la lambda).
+		// La funzione di callback in generale prende come parametri di hModule, lpszType e lParam i parametri specificati nella EnumResourceName (hExe, RT_GROUP_ICON, groupIconName).
+		// per ogni risorsa di tipo RT_GROUP_ICON
+
+		EnumResourceNames(hExe, RT_GROUP_ICON, [](HMODULE hModule, LPCTSTR lpszType, LPTSTR lpszName, LONG_PTR lparam)-> BOOL {
+			/* si memorizza la prima risorsa disponibile */
+			if (lpszName != NULL) {
+				LPTSTR* name = (LPTSTR*)lparam;	// name sar il puntatore ad lparam, che non  altro che groupIconName passato per riferimento
+				*name = lpszName;				// in questo modo, deferenziando name, e assegnando il valore lpszName, groupIconName assumer quel valore
+				// appena la troviamo interrompiamo la funzione EnumResourceNames.
+				// infatti, similmente alla EnumWindows del ListManage, la funzione di callback viene lanciata finch quest'ultima non ritorna false. 
+				// (oppure finch non viene enumerata l'ultima risorsa del tipo specificato).
+				return FALSE;
+			}
+			return TRUE;
+		}, (LONG_PTR)&groupIconName);
+
+		/* in questo modo, con EnumResourceNames, abbiamo estratto il nome della risorsa (salvato in groupIconName), informazione che ci servir per estrarre la posizione */
+
+		// FindResource definisce la posizione di una risorsa di un determinato tipo (RT_GROUP_ICON), con un determinato nome (groupIconName)
+		// in un determinato modulo exe (hExe).
+		resource = FindResource(hExe, groupIconName, RT_GROUP_ICON);
+	}
+	/* Se non riusciamo a caricare la libreria o non troviamo un gruppo_icona valido verr caricata sul client l'icona di default */
+	if (hExe == NULL || resource == NULL) {
+			FreeLibrary(hExe);
+			return IconBuffer();
+	}
+
+	/* Impostiamo length pari alla dimensione della risorsa alla locazione res (icona) */
+	length = SizeofResource(hExe, resource);
+	if (length == 0) {
+		FreeLibrary(hExe);
+		return IconBuffer();
+	}
+
+	// Carichiamo la risorsa, ovvero creiamo un puntatore ad essa
+	// LoadResource: Riceve un handle che pu essere usata (in combinazione con il metodo lockResource) per ottenere un puntatore al primo
+	// byte di una specifica resource in memoria.
+
+	HGLOBAL resourcePtr = LoadResource(hExe, resource);
+	if (resourcePtr == NULL) {
+		FreeLibrary(hExe);
+		return IconBuffer();
+	}
+	
+	// Prendiamo un puntatore alla risorsa indicata da resourceptr (il grouppo_icona)
+	// La risorsa non viene bloccata, ma viene solo acquisito un puntatore ad essa
+	LPVOID icon = LockResource(resourcePtr);
+	if (icon == NULL) {
+		FreeLibrary(hExe);
+		return IconBuffer();
+	}
+
+	// Cerchiamo l'ID dal gruppo_icona di un'icona di queste dimensioni
+	// LookupIconIdFromDirectoryEx: Cerca un'icona che si adatta meglio al display del device corrente
+	//  - (PBYTE) icon: L'icona o la directory
+	//  - TRUE: Indica che si sta cercando un'icona (FALSE indica un cursore)
+	//  - size, size: Dimensioni desiderate dell'icona (richieste dal client)
+	//  - LR_DEFAULTCOLOR: Flag che indica che il colore scelto  quello di default
+
+	int idIcon = LookupIconIdFromDirectoryEx((PBYTE) icon, TRUE, size, size, LR_DEFAULTCOLOR);
+	if (idIcon == 0) {
+		FreeLibrary(hExe);
+		return IconBuffer();
+	}
+
+	/* Ora che abbiamo l'ID dell'icona e non pi il gruppo_icona in generale, si pu passare all'estrazione di essa */
+	
+	// Restituisce un puntatore alla risorsa icona con quell'ID (Appena ottenuto)
+	// FindResource usa la MAKEINTRESOURCE macro con l'identifier idIcon (ottenuto da Lookup..) per localizzare la risorsa presente nel modulo.
+		
+	resource = FindResource(hExe, MAKEINTRESOURCE(idIcon), RT_ICON);
+	if (hExe == NULL || resource == NULL) {
+		FreeLibrary(hExe);
+		return IconBuffer();
+	}
+
+	/* Come prima si estrae la dimensione della risorsa (questa volta l'icona) */
+	length = SizeofResource(hExe, resource);
+	if (length == 0) {
+		FreeLibrary(hExe);
+		return IconBuffer();
+	}
+	
+	resourcePtr = LoadResource(hExe, resource);
+	if (resourcePtr == NULL) {
+		FreeLibrary(hExe);
+		return IconBuffer();
+	}
+
+	icon = LockResource(resourcePtr);
+	if (icon == NULL) {
+		FreeLibrary(hExe);
+		return IconBuffer();
+	}
+
+	/* Dopo aver ottenuto il puntatore all'icona corretta, la si copia in un buffer che rester in cache dopo il rilascio del modulo */
+	std::shared_ptr<IconData> buffer;
+	try {
+		buffer = std::make_shared<IconData>();
+		/* se l'eseguibile non ha un'immagine abbastanza piccola si invia l'icona ridimensionata */
+		if (iconWidth((const BYTE*) icon, length) > size)
+			buffer->bytes = scaleIcon((const BYTE*) icon, length, size);
+		if (buffer->bytes.empty())
+			buffer->bytes.assign((const char*) icon, (const char*) icon + length);
+		buffer->hash = iconHash(buffer->bytes);
+	}
+	catch (...) {
+		FreeLibrary(hExe);
+		throw;
+	}
+
+	FreeLibrary(hExe);
+
+	//restituiamo i byte dell'icona
+	return buffer;
+}
+
+/* Identit del file: dimensione e data di ultima modifica. Restituisce false se il file non  accessibile */
+static bool fileIdentity(const std::wstring& path, ULONGLONG& size, ULONGLONG& lastWrite) {
+	WIN32_FILE_ATTRIBUTE_DATA attributes;
+	if (!GetFileAttributesEx(path.c_str(), GetFileExInfoStandard, &attributes))
+		return false;
+	size = (ULONGLONG(attributes.nFileSizeHigh) << 32) | attributes.nFileSizeLow;
+	lastWrite = (ULONGLONG(attributes.ftLastWriteTime.dwHighDateTime) << 32) | attributes.ftLastWriteTime.dwLowDateTime;
+	return true;
+}
+
+#else
+
+/*	Su Linux gli eseguibili non contengono icone: il server headless invia sempre l'hash 0 (icona di default sul client).
+*	La cache memorizza comunque l'esito, per cui il costo per ogni add resta una sola stat.
+*/
+
+static IconBuffer loadIcon(const std::wstring&, int) {
+	return IconBuffer();
+}
+
+static bool fileIdentity(const std::wstring& path, ULONGLONG& size, ULONGLONG& lastWrite) {
+	struct stat attributes;
+	if (stat(toUtf8(path).c_str(), &attributes) != 0)
+		return false;
+	size = (ULONGLONG) attributes.st_size;
+	lastWrite = (ULONGLONG) attributes.st_mtim.tv_sec * 1000000000ULL + attributes.st_mtim.tv_nsec;
+	return true;
+}
+
+#endif
+
+/* Istanza unica della cache, condivisa da tutte le modifiche */
+IconCache& IconCache::instance() {
+	static IconCache cache(ICONCACHEBUDGET);
+	return cache;
+}
+
+/*	Restituzione dell'icona dell'eseguibile path nella dimensione size, attendendo l'eventuale estrazione.
+*	Se il file non  cambiato dall'ultima estrazione viene restituito il buffer in cache (senza copie), altrimenti l'icona viene
+*	estratta di nuovo. L'estrazione avviene senza tenere il lock, in modo da non bloccare gli altri utilizzatori della cache.
+*/
+
+IconBuffer IconCache::getIcon(const std::wstring& path, int size) {
+	IconKey key = { path, size };
+	ULONGLONG fileSize, lastWrite;
+	if (!fileIdentity(path, fileSize, lastWrite)) {
+		std::lock_guard<std::mutex> lock(cacheMutex);
+		misses++;
+		Metrics::instance().iconCacheMisses++;
+		return IconBuffer();
+	}
+
+	{
+		std::lock_guard<std::mutex> lock(cacheMutex);
+		std::map<IconKey, Entry>::iterator i = entries.find(key);
+		if (i != entries.end() && i->second.fileSize == fileSize && i->second.lastWrite == lastWrite) {
+			hits++;
+			Metrics::instance().iconCacheHits++;
+			lruList.splice(lruList.begin(), lruList, i->second.lru);	// l'icona diventa la pi recente
+			return i->second.icon;
+		}
+		misses++;
+		Metrics::instance().iconCacheMisses++;
+	}
+
+	std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+	IconBuffer icon = loadIcon(path, size);
+	Metrics::instance().iconExtraction.record(Metrics::elapsedMicros(start));
+
+	std::lock_guard<std::mutex> lock(cacheMutex);
+	store(key, fileSize, lastWrite, icon);
+	return icon;
+}
+
+/*	Memorizzazione di un'icona estratta (da chiamare con cacheMutex acquisito).
+*	Si sostituisce l'eventuale versione precedente (eseguibile modificato, o inserita nel frattempo da un altro thread).
+*/
+
+void IconCache::store(const IconKey& key, ULONGLONG fileSize, ULONGLONG lastWrite, IconBuffer icon) {
+	std::map<IconKey, Entry>::iterator i = entries.find(key);
+	if (i != entries.end())
+		removeEntry(i);
+
+	lruList.push_front(key);
+	Entry e;
+	e.fileSize = fileSize;
+	e.lastWrite = lastWrite;
+	e.icon = icon;
+	e.lru = lruList.begin();
+	e.checked = std::chrono::steady_clock::now();
+	entries[key] = e;
+	if (icon) {
+		bytes += icon->bytes.size();
+		HashEntry& h = byHash[icon->hash];
+		if (h.references++ == 0)
+			h.icon = icon;
+	}
+
+	evict();
+}
+
+/*	Icona dell'eseguibile path nella dimensione size senza attese (thread della lista, durante la serializzazione delle modifiche).
+*	Un'icona in cache viene restituita senza controllare il file: se l'ultimo controllo e' piu' vecchio di ICONREVALIDATE ms
+*	il controllo viene affidato ad un worker, che segnala l'icona solo se e' cambiata. Un'icona non in cache viene affidata
+*	ad un worker: la funzione restituisce nullptr e waiting diventa true, finche' l'estrazione non termina o non scade
+*	(vedi collectCompleted); dopo la scadenza si usa l'icona di default (nullptr, waiting false).
+*	Senza worker avviati (es. benchmark) l'icona viene estratta subito, come con getIcon.
+*/
+
+IconBuffer IconCache::requestIcon(const std::wstring& path, int size, bool& waiting) {
+	IconKey key = { path, size };
+	waiting = false;
+	{
+		std::lock_guard<std::mutex> lock(cacheMutex);
+		if (!workers.empty()) {
+			std::chrono::steady_clock::time_point now = std::chrono::steady_clock::now();
+			std::map<IconKey, Entry>::iterator i = entries.find(key);
+			if (i != entries.end()) {
+				hits++;
+				Metrics::instance().iconCacheHits++;
+				lruList.splice(lruList.begin(), lruList, i->second.lru);	// l'icona diventa la pi recente
+				if (now - i->second.checked >= std::chrono::milliseconds(ICONREVALIDATE) && pending.find(key) == pending.end()) {
+					i->second.checked = now;
+					enqueue(key, true);
+				}
+				return i->second.icon;
+			}
+
+			std::map<IconKey, PendingIcon>::iterator p = pending.find(key);
+			if (p == pending.end()) {
+				misses++;
+				Metrics::instance().iconCacheMisses++;
+				enqueue(key, false);
+				waiting = true;
+			}
+			else if (p->second.revalidate) {
+				/* icona scartata dalla cache durante il controllo: chi la chiede ora e' in attesa dell'esito */
+				p->second.revalidate = false;
+				p->second.announced = 0;
+				p->second.deadline = now + std::chrono::milliseconds(ICONTIMEOUT);
+				waiting = true;
+			}
+			else
+				waiting = !p->second.timedOut;
+			return IconBuffer();
+		}
+	}
+	return getIcon(path, size);
+}
+
+/* Estrazione (o controllo) affidata ai worker (da chiamare con cacheMutex acquisito) */
+
+void IconCache::enqueue(const IconKey& key, bool revalidate) {
+	PendingIcon& p = pending[key];
+	p.deadline = std::chrono::steady_clock::now() + std::chrono::milliseconds(ICONTIMEOUT);
+	p.revalidate = revalidate;
+	if (revalidate) {
+		std::map<IconKey, Entry>::iterator i = entries.find(key);
+		p.announced = (i != entries.end() && i->second.icon) ? i->second.icon->hash : 0;
+	}
+	queue.push_back(key);
+	queueCondition.notify_one();
+}
+
+/*	Funzione eseguita dai worker: controllo dell'identita' del file ed eventuale estrazione dell'icona, senza tenere il lock.
+*	Anche l'esito negativo (file non accessibile o senza icona) viene memorizzato, fino al prossimo controllo.
+*	L'esito viene comunicato (onCompleted) se qualcuno lo sta attendendo, oppure se l'icona gia' comunicata ai client
+*	(quella precedente, o quella di default dopo la scadenza) e' cambiata. Un worker bloccato su un'estrazione lenta
+*	(es. eseguibile su una condivisione di rete) non blocca gli altri ne' il thread della lista; se viene sostituito
+*	(vedi replaceStuckWorkers) memorizza comunque l'esito quando si sblocca, e poi termina.
+*/
+
+void IconCache::worker(std::shared_ptr<WorkerState> state) {
+	std::unique_lock<std::mutex> lock(cacheMutex);
+	while (true) {
+		queueCondition.wait(lock, [this]() { return stopping || !queue.empty(); });
+		if (stopping)
+			return;
+		IconKey key = queue.front();
+		queue.pop_front();
+		state->busy = true;
+		state->since = std::chrono::steady_clock::now();
+		lock.unlock();
+
+		ULONGLONG fileSize = 0, lastWrite = 0;
+		bool accessible = fileIdentity(key.path, fileSize, lastWrite);
+
+		lock.lock();
+		IconBuffer icon;
+		std::map<IconKey, Entry>::iterator i = entries.find(key);
+		bool unchanged = accessible && i != entries.end() && i->second.fileSize == fileSize && i->second.lastWrite == lastWrite;
+		if (unchanged) {
+			i->second.checked = std::chrono::steady_clock::now();
+			icon = i->second.icon;
+		}
+		lock.unlock();
+
+		if (accessible && !unchanged) {
+			std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+			try {
+				icon = loadIcon(key.path, key.size);
+			}
+			catch (std::exception&) {
+				icon = IconBuffer();		// memoria esaurita: icona di default
+			}
+			Metrics::instance().iconExtraction.record(Metrics::elapsedMicros(start));
+		}
+
+		lock.lock();
+		state->busy = false;
+		if (!unchanged)
+			store(key, fileSize, lastWrite, icon);
+
+		bool notify = false;
+		std::map<IconKey, PendingIcon>::iterator p = pending.find(key);
+		if (p != pending.end()) {
+			unsigned long long hash = icon ? icon->hash : 0;
+			notify = (!p->second.revalidate && !p->second.timedOut) || hash != p->second.announced;
+			if (notify)
+				completed.push_back(key.path);
+			pending.erase(p);
+		}
+
+		/* la notifica acquisisce il lock del thread della lista: viene eseguita senza tenere quello della cache */
+		if (notify && onCompleted) {
+			lock.unlock();
+			onCompleted();
+			lock.lock();
+		}
+
+		if (state->abandoned) {
+			stuckWorkers--;
+			Metrics::instance().iconStuckWorkers = stuckWorkers;
+			return;
+		}
+	}
+}
+
+/*	Sostituzione dei worker bloccati da piu' di ICONSTUCK ms (da chiamare con cacheMutex acquisito): il thread viene
+*	staccato e ne viene avviato uno nuovo. L'eseguibile bloccato resta tra le estrazioni in corso, per cui non viene
+*	riaccodato finche' l'estrazione non si sblocca (i client hanno gia' ricevuto l'icona di default alla scadenza).
+*	Oltre ICONMAXSTUCK worker abbandonati i worker bloccati restano nel pool: il numero di thread resta limitato.
+*/
+
+void IconCache::replaceStuckWorkers(std::chrono::steady_clock::time_point now) {
+	for (Worker& w : workers) {
+		if (stuckWorkers >= ICONMAXSTUCK)
+			return;
+		if (!w.state || !w.state->busy || now - w.state->since < std::chrono::milliseconds(ICONSTUCK))
+			continue;
+		w.state->abandoned = true;
+		w.thread.detach();
+		stuckWorkers++;
+		Metrics::instance().iconStuckWorkers = stuckWorkers;
+		w.state = std::make_shared<WorkerState>();
+		try {
+			w.thread = std::thread(&IconCache::worker, this, w.state);
+		}
+		catch (std::system_error&) {
+			w.state.reset();		// thread non creato: il pool resta con un worker in meno
+		}
+	}
+}
+
+/*	Avvio dei worker (thread della lista): notify viene chiamata da un worker quando ci sono esiti da raccogliere
+*	con collectCompleted. Se i worker sono gia' avviati la chiamata non ha effetto.
+*/
+
+void IconCache::startWorkers(std::function<void()> notify) {
+	std::lock_guard<std::mutex> lock(cacheMutex);
+	if (!workers.empty())
+		return;
+	onCompleted = notify;
+	stopping = false;
+	for (int i = 0; i < ICONWORKERS; i++) {
+		Worker w;
+		w.state = std::make_shared<WorkerState>();
+		w.thread = std::thread(&IconCache::worker, this, w.state);
+		workers.push_back(std::move(w));
+	}
+}
+
+/*	Terminazione dei worker: si attende la fine delle estrazioni in corso (un'estrazione bloccata ritarda la terminazione
+*	del server, tranne quelle dei worker gia' abbandonati). Le richieste in coda vengono scartate; da questo momento
+*	requestIcon estrae le icone direttamente.
+*/
+
+void IconCache::stopWorkers() {
+	std::vector<Worker> running;
+	{
+		std::lock_guard<std::mutex> lock(cacheMutex);
+		stopping = true;
+		running.swap(workers);
+		queueCondition.notify_all();
+	}
+	for (Worker& w : running)
+		if (w.thread.joinable())
+			w.thread.join();
+
+	std::lock_guard<std::mutex> lock(cacheMutex);
+	queue.clear();
+	pending.clear();
+	completed.clear();
+	onCompleted = nullptr;
+	stopping = false;
+}
+
+/*	Percorsi degli eseguibili la cui icona e' cambiata rispetto a quella comunicata ai client: estrazioni terminate
+*	ed estrazioni scadute (si usa l'icona di default; se l'estrazione termina piu' tardi viene comunicata di nuovo).
+*	Qui vengono anche sostituiti i worker bloccati.
+*/
+
+void IconCache::collectCompleted(std::vector<std::wstring>& paths) {
+	paths.clear();
+	std::lock_guard<std::mutex> lock(cacheMutex);
+	std::chrono::steady_clock::time_point now = std::chrono::steady_clock::now();
+	replaceStuckWorkers(now);
+	for (std::pair<const IconKey, PendingIcon>& p : pending)
+		if (!p.second.revalidate && !p.second.timedOut && p.second.deadline <= now) {
+			p.second.timedOut = true;
+			timeouts++;
+			Metrics::instance().iconTimeouts++;
+			paths.push_back(p.first.path);
+		}
+	paths.insert(paths.end(), completed.begin(), completed.end());
+	completed.clear();
+
+	/* lo stesso eseguibile puo' comparire piu' volte (piu' dimensioni): una sola modifica icu per applicazione */
+	std::sort(paths.begin(), paths.end());
+	paths.erase(std::unique(paths.begin(), paths.end()), paths.end());
+	Metrics::instance().iconPending = (long long) pending.size();
+}
+
+/* Scadenza della prima estrazione in attesa (il thread della lista si risveglia per usare l'icona di default) */
+
+std::chrono::steady_clock::time_point IconCache::nextTimeout() {
+	std::chrono::steady_clock::time_point first = std::chrono::steady_clock::time_point::max();
+	std::lock_guard<std::mutex> lock(cacheMutex);
+	for (std::pair<const IconKey, PendingIcon>& p : pending)
+		if (!p.second.revalidate && !p.second.timedOut)
+			first = std::min(first, p.second.deadline);
+	return first;
+}
+
+/*	Eliminazione delle icone usate meno di recente fino a rientrare nel budget (da chiamare con cacheMutex acquisito).
+*	I buffer ancora in uso da un invio restano validi: vengono rilasciati quando l'ultimo shared_ptr viene distrutto.
+*/
+
+void IconCache::evict() {
+	while (bytes > budget && !lruList.empty())
+		removeEntry(entries.find(lruList.back()));
+}
+
+/* Rimozione di un eseguibile dalla cache (da chiamare con cacheMutex acquisito) */
+void IconCache::removeEntry(std::map<IconKey, Entry>::iterator i) {
+	if (i->second.icon) {
+		bytes -= i->second.icon->bytes.size();
+		std::map<unsigned long long, HashEntry>::iterator h = byHash.find(i->second.icon->hash);
+		if (h != byHash.end() && --h->second.references == 0)
+			byHash.erase(h);
+	}
+	lruList.erase(i->second.lru);
+	entries.erase(i);
+}
+
+/*	Ricerca di un'icona tramite l'hash del contenuto (richiesta di un client).
+*	Restituisce nullptr se nessun eseguibile in cache ha quell'icona (ad esempio perche' e' stata scartata nel frattempo).
+*/
+
+IconBuffer IconCache::findByHash(unsigned long long hash) {
+	std::lock_guard<std::mutex> lock(cacheMutex);
+	std::map<unsigned long long, HashEntry>::iterator h = byHash.find(hash);
+	if (h == byHash.end())
+		return IconBuffer();
+	return h->second.icon;
+}
+
+void IconCache::setBudget(size_t b) {
+	std::lock_guard<std::mutex> lock(cacheMutex);
+	budget = b;
+	evict();
+}
+
+/* Contatori della cache: richieste servite dalla cache e richieste che hanno richiesto l'estrazione */
+unsigned long long IconCache::getHits() {
+	std::lock_guard<std::mutex> lock(cacheMutex);
+	return hits;
+}
+
+unsigned long long IconCache::getMisses() {
+	std::lock_guard<std::mutex> lock(cacheMutex);
+	return misses;
+}
+
+size_t IconCache::getBytes() {
+	std::lock_guard<std::mutex> lock(cacheMutex);
+	return bytes;
+}
+
+size_t IconCache::getEntries() {
+	std::lock_guard<std::mutex> lock(cacheMutex);
+	return entries.size();
+}
+
+/* Estrazioni in coda o in corso, ed estrazioni scadute (icona di default inviata ai client) */
+size_t IconCache::getPending() {
+	std::lock_guard<std::mutex> lock(cacheMutex);
+	return pending.size();
+}
+
+unsigned long long IconCache::getTimeouts() {
+	std::lock_guard<std::mutex> lock(cacheMutex);
+	return timeouts;
+}
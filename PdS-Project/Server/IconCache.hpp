@@ -0,0 +1,139 @@
+#pragma once
+#include "Platform.hpp"
+#include <string>
+#include <vector>
+#include <list>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <deque>
+#include <thread>
+#include <chrono>
+#include <functional>
+#include <condition_variable>
+
+
+#define ICONCACHEBUDGET (8 * 1024 * 1024)		// massimo numero di byte di icone mantenuti in memoria
+#define ICONSIZE 48								// dimensione (pixel) delle icone per i client che non ne richiedono un'altra
+#define ICONMINSIZE 16							// dimensioni accettate nella richiesta del client (vedi acceptCapabilities)
+#define ICONMAXSIZE 256
+#define ICONWORKERS 2							// thread che estraggono le icone in background
+#define ICONTIMEOUT 2000						// attesa massima (ms) di un'estrazione, dopo la quale si usa l'icona di default
+#define ICONSTUCK 10000							// durata (ms) oltre la quale un'estrazione e' considerata bloccata: il worker viene sostituito
+#define ICONMAXSTUCK 8							// massimo numero di worker bloccati abbandonati (thread che restano in vita)
+#define ICONREVALIDATE 10000					// intervallo (ms) dopo il quale un'icona in cache viene ricontrollata (eseguibile aggiornato)
+
+/* Icona serializzata ed hash del suo contenuto, con cui il client la identifica */
+struct IconData {
+	std::vector<char> bytes;
+	unsigned long long hash;
+};
+
+/* Icona immutabile condivisa tra la cache e gli invii in corso */
+typedef std::shared_ptr<const IconData> IconBuffer;
+
+/* Chiave della cache: percorso dell'eseguibile e dimensione dell'icona */
+struct IconKey {
+	std::wstring path;
+	int size;
+
+	bool operator<(const IconKey& other) const {
+		return size != other.size ? size < other.size : path < other.path;
+	}
+};
+
+/*	Cache delle icone delle applicazioni, unica per tutto il processo.
+*	L'estrazione di un'icona richiede di caricare l'eseguibile e di scorrere le sue risorse: il risultato viene quindi memorizzato
+*	per percorso dell'eseguibile e dimensione richiesta (i client possono chiedere icone piu' piccole, vedi ICONSIZE), insieme
+*	all'identita' del file (dimensione e data di ultima modifica), in modo che un eseguibile aggiornato venga riletto. Quando la dimensione totale supera il budget vengono scartate le icone usate meno di recente (LRU).
+*	Viene memorizzato anche l'esito negativo (eseguibile senza icona), per non ripetere l'estrazione ad ogni add.
+*	Le icone sono indicizzate anche per hash del contenuto: piu' eseguibili possono condividere la stessa icona,
+*	ed il client richiede le icone che non conosce tramite il loro hash (vedi CommandsFromClient).
+*	Con i worker avviati (startWorkers) l'estrazione non blocca mai chi chiede l'icona: requestIcon restituisce subito
+*	l'icona in cache, oppure segnala che e' in corso e la affida ad un worker. Le estrazioni terminate (o scadute dopo
+*	ICONTIMEOUT ms) vengono raccolte con collectCompleted, per inviare ai client l'icona definitiva.
+*	Un worker bloccato in un'estrazione da piu' di ICONSTUCK ms viene abbandonato e sostituito (fino a ICONMAXSTUCK worker
+*	abbandonati), in modo che le estrazioni bloccate non esauriscano i worker.
+*/
+
+class IconCache {
+	struct Entry {
+		ULONGLONG fileSize;						// identita' del file al momento dell'estrazione
+		ULONGLONG lastWrite;
+		IconBuffer icon;						// nullptr se l'eseguibile non ha un'icona
+		std::list<IconKey>::iterator lru;		// posizione nella lista LRU
+		std::chrono::steady_clock::time_point checked;	// ultimo controllo dell'identita' del file
+	};
+
+	/* Estrazione affidata ai worker */
+	struct PendingIcon {
+		std::chrono::steady_clock::time_point deadline;	// scadenza dell'attesa: poi si usa l'icona di default
+		bool timedOut = false;					// scadenza gia' comunicata (collectCompleted)
+		bool revalidate = false;				// icona gia' in cache da ricontrollare: chi la chiede non e' in attesa
+		unsigned long long announced = 0;		// hash gia' comunicato ai client (0: icona di default)
+	};
+
+	/* Stato di un worker, condiviso con il suo thread (protetto da cacheMutex) */
+	struct WorkerState {
+		bool busy = false;						// estrazione in corso, iniziata all'istante since
+		std::chrono::steady_clock::time_point since;
+		bool abandoned = false;					// worker sostituito: termina appena l'estrazione si sblocca
+	};
+
+	struct Worker {
+		std::thread thread;
+		std::shared_ptr<WorkerState> state;
+	};
+
+	struct HashEntry {
+		IconBuffer icon;
+		int references = 0;						// numero di eseguibili in cache con questa icona
+	};
+
+	std::map<IconKey, Entry> entries;			// icone indicizzate per percorso dell'eseguibile e dimensione
+	std::map<unsigned long long, HashEntry> byHash;	// icone indicizzate per hash del contenuto
+	std::list<IconKey> lruList;					// chiavi dalla piu' alla meno recente
+	size_t bytes = 0;							// dimensione totale delle icone memorizzate
+	size_t budget;
+	unsigned long long hits = 0;
+	unsigned long long misses = 0;
+	std::mutex cacheMutex;
+
+	std::map<IconKey, PendingIcon> pending;		// estrazioni in coda o in corso
+	std::deque<IconKey> queue;					// estrazioni in attesa di un worker
+	std::vector<std::wstring> completed;		// eseguibili con estrazioni terminate o scadute, non ancora raccolte
+	std::vector<Worker> workers;
+	int stuckWorkers = 0;						// worker abbandonati ancora bloccati in un'estrazione
+	std::condition_variable queueCondition;
+	std::function<void()> onCompleted;			// notifica al thread della lista (dal thread del worker)
+	bool stopping = false;
+	unsigned long long timeouts = 0;
+
+	IconCache(size_t budget) : budget(budget) {}
+	void evict();
+	void removeEntry(std::map<IconKey, Entry>::iterator i);
+	void store(const IconKey& key, ULONGLONG fileSize, ULONGLONG lastWrite, IconBuffer icon);
+	void enqueue(const IconKey& key, bool revalidate);
+	void worker(std::shared_ptr<WorkerState> state);
+	void replaceStuckWorkers(std::chrono::steady_clock::time_point now);
+
+public:
+	IconCache(const IconCache&) = delete;
+	IconCache& operator=(const IconCache&) = delete;
+
+	static IconCache& instance();
+	IconBuffer getIcon(const std::wstring& path, int size = ICONSIZE);
+	IconBuffer requestIcon(const std::wstring& path, int size, bool& waiting);
+	void startWorkers(std::function<void()> notify);
+	void stopWorkers();
+	void collectCompleted(std::vector<std::wstring>& paths);
+	std::chrono::steady_clock::time_point nextTimeout();
+	IconBuffer findByHash(unsigned long long hash);
+	void setBudget(size_t budget);
+	unsigned long long getHits();
+	unsigned long long getMisses();
+	size_t getBytes();
+	size_t getEntries();
+	size_t getPending();
+	unsigned long long getTimeouts();
+};
@@ -0,0 +1,82 @@
+#include "LatencyHistogram.hpp"
+
+/* Intervallo che contiene il valore: i primi LATENCYSUBBUCKETS sono esatti, poi LATENCYSUBBUCKETS per potenza di 2 */
+
+int LatencyHistogram::bucketOf(unsigned long value) {
+	if (value < LATENCYSUBBUCKETS)
+		return (int) value;
+
+	int msb = 0;
+	for (unsigned long v = value; v > 1; v >>= 1)
+		msb++;
+	int shift = msb - 3;					// LATENCYSUBBUCKETS = 2^3: i 3 bit dopo il piu' significativo scelgono l'intervallo
+	int bucket = (shift + 1) * LATENCYSUBBUCKETS + (int) ((value >> shift) & (LATENCYSUBBUCKETS - 1));
+	return bucket < LATENCYBUCKETS ? bucket : LATENCYBUCKETS - 1;
+}
+
+/* Valore massimo contenuto nell'intervallo (i percentili vengono approssimati per eccesso) */
+
+unsigned long LatencyHistogram::upperBound(int bucket) {
+	if (bucket < LATENCYSUBBUCKETS)
+		return (unsigned long) bucket;
+
+	int shift = bucket / LATENCYSUBBUCKETS - 1;
+	unsigned long long bound = ((unsigned long long) (LATENCYSUBBUCKETS + bucket % LATENCYSUBBUCKETS + 1) << shift) - 1;
+	return bound > 0xFFFFFFFFULL ? 0xFFFFFFFFUL : (unsigned long) bound;
+}
+
+void LatencyHistogram::record(unsigned long micros) {
+	buckets[bucketOf(micros)]++;
+	count++;
+	sum += micros;
+	if (micros > maxValue)
+		maxValue = micros;
+}
+
+/* Percentile p (tra 0 e 1) dei valori registrati: 0 se l'istogramma e' vuoto; non supera mai il massimo registrato */
+
+unsigned long LatencyHistogram::percentile(double p) const {
+	if (count == 0)
+		return 0;
+
+	unsigned long long rank = (unsigned long long) (p * count);
+	if (rank >= count)
+		rank = count - 1;
+
+	unsigned long long seen = 0;
+	for (int i = 0; i < LATENCYBUCKETS; i++) {
+		seen += buckets[i];
+		if (seen > rank)
+			return upperBound(i) < maxValue ? upperBound(i) : maxValue;
+	}
+	return maxValue;
+}
+
+unsigned long LatencyHistogram::getMax() const {
+	return maxValue;
+}
+
+unsigned long long LatencyHistogram::getCount() const {
+	return count;
+}
+
+unsigned long long LatencyHistogram::getSum() const {
+	return sum;
+}
+
+
+void CommandLatency::record(unsigned long queueMicros, unsigned long injectMicros) {
+	std::lock_guard<std::mutex> lock(mutex);
+	queue.record(queueMicros);
+	inject.record(injectMicros);
+	total.record(queueMicros + injectMicros);
+}
+
+/* Copia coerente dei tre istogrammi, per esporli senza tenere il lock durante la scrittura */
+
+void CommandLatency::snapshot(LatencyHistogram& queueCopy, LatencyHistogram& injectCopy, LatencyHistogram& totalCopy) const {
+	std::lock_guard<std::mutex> lock(mutex);
+	queueCopy = queue;
+	injectCopy = inject;
+	totalCopy = total;
+}
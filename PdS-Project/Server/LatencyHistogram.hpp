@@ -0,0 +1,42 @@
+#pragma once
+#include <mutex>
+
+
+#define LATENCYSUBBUCKETS 8					// intervalli per ogni potenza di 2 (errore massimo del 12.5%)
+#define LATENCYBUCKETS 256					// intervalli dell'istogramma (valori in microsecondi fino a 2^32)
+
+/*	Istogramma delle latenze (in microsecondi) con intervalli di ampiezza crescente: i valori fino a LATENCYSUBBUCKETS
+*	sono esatti, quelli successivi vengono raggruppati in LATENCYSUBBUCKETS intervalli per ogni potenza di 2.
+*	La memoria occupata e' fissa e la registrazione costa poche operazioni, per cui puo' essere eseguita per ogni comando.
+*/
+
+class LatencyHistogram {
+	unsigned long long buckets[LATENCYBUCKETS] = {};
+	unsigned long long count = 0;
+	unsigned long long sum = 0;
+	unsigned long maxValue = 0;
+
+	static int bucketOf(unsigned long value);
+	static unsigned long upperBound(int bucket);
+
+public:
+	void record(unsigned long micros);
+	unsigned long percentile(double p) const;
+	unsigned long getMax() const;
+	unsigned long long getCount() const;
+	unsigned long long getSum() const;
+};
+
+/*	Latenze dei comandi di input di una connessione, dalla ricezione dei dati all'iniezione (vedi CommandsFromClient):
+*	attesa (ricezione -> decodifica), iniezione (decodifica -> fine di SendInput) e totale.
+*	Viene aggiornata dal reactor e letta dal thread delle metriche (vedi Metrics), per cui e' protetta da un mutex.
+*/
+
+class CommandLatency {
+	mutable std::mutex mutex;
+	LatencyHistogram queue, inject, total;
+
+public:
+	void record(unsigned long queueMicros, unsigned long injectMicros);
+	void snapshot(LatencyHistogram& queueCopy, LatencyHistogram& injectCopy, LatencyHistogram& totalCopy) const;
+};
@@ -1,367 +1,1069 @@
 #include "ListHandler.hpp"
-#define MAXSTR 100
-#define MAXEXT 10
-#define pair std::pair<DWORD, ApplicationItem>
-#define SHIFT 1
-#define CTRL 2
-#define ALT 4
+#include "Compression.hpp"
+#include "Metrics.hpp"
+#include <algorithm>
+#define CAPCOMPRESSION 1			// capacita': batch compressi (vedi Compression.hpp)
+#define CAPICONSIZE 2				// capacita': icone nella dimensione richiesta dal client (vedi IconCache)
+#define CAPCOMPACT 4				// capacita': modifiche in codifica compatta (vedi CompactEncoding.hpp)
+#define SERVERCAPS (CAPCOMPRESSION | CAPICONSIZE | CAPCOMPACT)	// capacita' supportate dal server
+#define HASHSIZE 8
+#define CHORDSIZE 5					// 1 byte di modificatori + tasto (4 byte)
 
 /*
-Funzione che viene richiamata per ogni finestra rilevata da EnumWindow() (vedi dopo)
-Se la finestra non  visibile o se il suo nome  vuoto, ritorna subito;
-altrimenti crea una struttura ApplicationItem con i parametri della finestra
-e la inserisce nella lista passata come parametro. Ci viene fatto per ogni finestra (applicazione) aperta
+Lettura delle informazioni di un processo nuovo (nome dell'eseguibile e percorso completo).
+Viene chiamata solo per i pid che non erano presenti nella lista (vedi AppList::apply); le informazioni sono memorizzate
+in ProcessCache, per cui un processo gia' visto (es. finestra nascosta e mostrata di nuovo) non viene riletto.
 */
 
-BOOL CALLBACK MyWindowProc(__in HWND hwnd, __in LPARAM lparam) {
-	
-	/* Finestra non visibile */
-	if (!IsWindowVisible(hwnd)) {
-		return TRUE;
-	}
-
-	/* Ottenimento del pid del processo e verifica che esso sia stato gi inserito nella lista delle applicazioni */
-
-	DWORD procID;
-	GetWindowThreadProcessId(hwnd, &procID);		// ottenimento del pid
-
-	// se find() = end() significa che la pair con key "proc" (il pid) non  presente nella lista
-	if (((std::map<DWORD, ApplicationItem>*) lparam)->find(procID) != ((std::map<DWORD, ApplicationItem>*)lparam)->end())
-		return TRUE;
-
-	/* Arrivati qui significa che il processo non  presente nella lista 
-	* Si vuole ottenere l'handle del processo tramite il pID ottenuto, ottenendo i giusti permessi per poter ottenere le informazioni sul nome
-	*/
-	
-	HANDLE process = OpenProcess(PROCESS_QUERY_INFORMATION | PROCESS_VM_READ, FALSE, procID);
-	if (process == NULL)
-		return TRUE;
-	
-	TCHAR* file_name = new TCHAR[MAXSTR];
-	DWORD maxstr = MAXSTR;
-	/* la funzione QueryFullProcessImageName prende l'handle del process, e estrae il path del processo, salvandolo in file_name, riuscendoci grazie ai "diritti" definiti con OpenProcess */
-
-	if (QueryFullProcessImageName(process, 0, file_name, &maxstr) == 0 || maxstr >= MAXSTR) {
-		CloseHandle(process);
-		delete[] file_name;
-		return TRUE;
-	}
-
-	/* Dopo essere riusciti ad estrarre il path dell'applicazione, posso aggiungerla alla lista */
-	ApplicationItem app;
-
-	TCHAR* buff = new TCHAR[MAXSTR + 1];
-	TCHAR* ext = new TCHAR[MAXEXT + 1];
-
-	/* Prendiamo dal nome completo del file il nome dell'eseguibile
-	*  gli altri due parametri sono a NULL e 0 perch non servono quelle informazioni
-	*  vedendo la documentazione, in buff ci finisce il nome del file senza estensione, in ext ci finisce l'estensione
-	*  se torna 0 ha avuto successo
-	*/
-
-	if (splitpath(file_name, NULL, 0, NULL, 0, buff, MAXSTR, ext, MAXEXT) != 0) {
-		delete[] buff;
-		delete[] ext;
-		delete[] file_name;
-		CloseHandle(process);
-		return TRUE;
-	}
-
-	/* il campo Name dell'appplicazione lo costruisco come nome file + estensione */
-	app.Name = buff;
-	app.Name += ext;
-	app.Exec_name = file_name;
-
-	((std::map<DWORD, ApplicationItem>*)lparam)->insert(pair(procID, app));
-	delete[] buff; delete[] ext; delete[] file_name;
-	CloseHandle(process);
-
-	return TRUE;
+static bool queryProcess(DWORD procID, ApplicationItem& app) {
+	return ProcessCache::instance().resolve(procID, app);
 }
 
 /*
-Creazione della lista da zero, semplicemente richiamando la funzione EnumWindows()
-Alla funzione viene passata la callback e la lista
+Enumerazione dei processi visibili (vedi Desktop.cpp): il vettore dei pid viene poi ordinato e privato dei duplicati
+(pi finestre dello stesso processo). Il vettore viene riusato ad ogni chiamata, per cui a regime non alloca memoria.
+La sorgente dei pid puo' essere sostituita (benchmark con processi sintetici).
 */
 
-void ListHandler::buildList(std::map<DWORD,ApplicationItem>& ApplicationList) {
-
-	ApplicationList.clear();
-
-	/* Per ogni applicazione in foreground eseguiamo la MyWindowsProc passando la lista delle app
-	*  Enumera tutte le top-level windows sullo schermo passando l'handle ad ogni window, a turno, ad una application-defined callback function.
-	*  EnumWindows continua finch l'ultima top-level window non viene enumerata o se la callback function ritorna FALSE (per questo restituisce true la func mywind).
-	*/
-	if (!EnumWindows(MyWindowProc, (LPARAM)&ApplicationList))
-		throw std::runtime_error("Fallimento nella enumerazione delle Windows");
+void ListHandler::buildList(std::vector<DWORD>& pids, ProcessEnumerator enumerate) {
+	pids.clear();
+	enumerate(pids);
+	std::sort(pids.begin(), pids.end());
+	pids.erase(std::unique(pids.begin(), pids.end()), pids.end());
 }
 
 /*
 * Funzione principale della classe ListHandler, eseguita dal thread che gestisce la lista.
-* Fino a che il programma non viene terminato, viene richiesta una nuova lista di applicazioni ogni refreshTime millisecondi; 
+* Fino a che il programma non viene terminato, la lista delle applicazioni viene ricalcolata quando la sorgente di eventi
+* (vedi ChangeSource) segnala un cambiamento, ed in ogni caso alla scadenza fissata dal RefreshScheduler (riconciliazione
+* periodica, frequente dopo un cambiamento e sempre pi rara finch la lista resta stabile);
 * questa lista viene confrontata con quella del ListManager per determinare i programmi nuovi e quelli terminati, per
-* poi sostituire la vecchia lista. I dati poi devono essere inviati al client.
+* poi sostituire la vecchia lista. Le modifiche vengono calcolate una sola volta ed inviate a tutti i client connessi,
+* mentre i client appena connessi ricevono la lista completa, oppure solo le modifiche perse se si stanno riconnettendo
+* (vedi ChangeLog): un client nuovo viene servito alla richiesta di ripresa o dopo RESUMETIMEOUT ms.
+* Ogni RESOURCEINTERVAL ms viene campionato anche l'uso delle risorse delle applicazioni (vedi ResourceMonitor).
 */
 
 void ListHandler::UpdateAppList() {
 	
-	std::map<DWORD, ApplicationItem> newList;
+	std::vector<DWORD> snapshot;
+	ListDelta delta;
+	std::vector<JoiningClient> joining;
 	DWORD newForeground = 0;
-	int count = 0;
+	std::chrono::steady_clock::time_point lastSent = std::chrono::steady_clock::now();
 
-	/* il ciclo viene interrotto quando il client chiude la connessione */
+	changeSource->start([this]() { notifyChange(); });
+	IconCache::instance().startWorkers([this]() { notifyChange(); });
+
+	/* il ciclo viene interrotto alla terminazione del server */
 	
-	while (socket.getStatus() == true) {
-		count++;
-		buildList(newList);		//lista temporanea
-
-		/* Creazione della strutture delle modifiche da inviare al Client */
-		
-		for each(pair app in newList) {
-			std::map<DWORD, ApplicationItem>::iterator i = applicationsList.find(app.first);
-			if (i != applicationsList.end()) {
-				//L'applicazione esiste gi nella lista applicationsList, percui la cancello (non sar una modifica da inviare)
-				applicationsList.erase(i);
-			}
-			else {
-				/* In caso contrario, significa che c' una nuova applicazione che prima non era presente, percui bisogna aggiungere la modifica di tipo add */
-				Change	c(app.first,app.second);
-				changeList.push_back(c);
-				count = 0;
-			}
+	while (true) {
+		{
+			/* se non ci sono client connessi non serve aggiornare la lista: si attende il primo client */
+			std::unique_lock<std::mutex> lock(clientsMutex);
+			clients.erase(std::remove_if(clients.begin(), clients.end(),
+				[](std::shared_ptr<SocketStream>& c) { return !c->getStatus(); }), clients.end());
+			clientsCondition.wait(lock, [this]() { return stopped || !clients.empty() || !newClients.empty(); });
+
+			/* si attende un evento, un nuovo client pronto o la scadenza della riconciliazione (o dell'heartbeat) */
+			std::chrono::steady_clock::time_point deadline = std::min(scheduler.nextDeadline(), lastSent + std::chrono::milliseconds(HEARTBEATINTERVAL));
+			deadline = std::min(deadline, firstJoinDeadline());
+			deadline = std::min(deadline, IconCache::instance().nextTimeout());
+			deadline = std::min(deadline, resources.nextDeadline());
+			clientsCondition.wait_until(lock, deadline,
+				[this]() { return stopped || changePending || !subscriptionRequests.empty() || firstJoinDeadline() <= std::chrono::steady_clock::now(); });
+			if (stopped)
+				break;
+			changePending = false;
+
+			/* i client pronti (richiesta di ripresa ricevuta o attesa scaduta) vengono serviti in questo aggiornamento */
+			std::chrono::steady_clock::time_point now = std::chrono::steady_clock::now();
+			for (JoiningClient& j : newClients)
+				if (j.deadline <= now)
+					joining.push_back(j);
+			newClients.erase(std::remove_if(newClients.begin(), newClients.end(),
+				[now](JoiningClient& j) { return j.deadline <= now; }), newClients.end());
+
+			/* sottoscrizioni ricevute dal reactor: un client che cambia sottoscrizione riceve di nuovo la lista (filtrata) */
+			applySubscriptions(joining);
 		}
 
-		/* A questo punto si aggiungono le le modifiche di tipo remove per tutte le applicazioni terminate 
-		* (non trovate nella lista nuova, e che sono state lasciate in applicationsList nel for each precedente)
+		Metrics& metrics = Metrics::instance();
+		std::chrono::steady_clock::time_point tickStart = std::chrono::steady_clock::now();
+		try {
+			buildList(snapshot);		//pid dei processi con finestre visibili
+		}
+		catch (std::runtime_error& e) {
+			/* enumerazione fallita (es. descrittori esauriti): la lista resta quella precedente e si riprova al prossimo aggiornamento */
+			std::cerr << e.what() << std::endl;
+			scheduler.tick(tickStart, false);
+			std::this_thread::sleep_until(scheduler.earliestTick());
+			continue;
+		}
+		metrics.buildList.record(Metrics::elapsedMicros(tickStart));
+
+		/* Creazione della strutture delle modifiche da inviare al Client:
+		*  confronto della nuova enumerazione con la lista corrente (senza allocazioni se non  cambiato nulla)
 		*/
 
-		for each(pair app in applicationsList) {
-			Change c(rem, app.first);
-			changeList.push_back(c);
-			count = 0;
-		}
+		std::chrono::steady_clock::time_point diffStart = std::chrono::steady_clock::now();
+		applicationsList.diff(snapshot, delta);
+		metrics.diff.record(Metrics::elapsedMicros(diffStart));
+		if (!delta.empty()) {
+
+			/* modifiche di tipo remove per tutte le applicazioni terminate (note ai client) */
+			for (DWORD pid : delta.removed) {
+				const AppEntry* e = applicationsList.find(pid);
+				if (e != nullptr && e->valid)
+					changeList.push_back(Change(rem, pid, e->app));
+				resources.remove(pid);
+			}
 
-		/* Memorizzo la nuova lista */
-		applicationsList.swap(newList);
+			/* aggiornamento della lista: vengono lette solo le informazioni dei processi nuovi */
+			applicationsList.apply(delta, queryProcess);
 
-		/* vedo se  cambiata l'applicazione col focus
-		*  la funzione GetForegroundWindow() prende (restituisce) l'HANDLE della window in foreground
-		*  la funzione getwindowthreadprocessID mi salva dentro newForeground il pid del HANDLE della window in foreground
-		*/
+			/* modifiche di tipo add per le nuove applicazioni */
+			for (DWORD pid : delta.added) {
+				const AppEntry* e = applicationsList.find(pid);
+				if (e != nullptr && e->valid)
+					changeList.push_back(Change(pid, e->app));
+			}
+		}
 
-		GetWindowThreadProcessId(GetForegroundWindow(), &newForeground);
+		/* vedo se  cambiata l'applicazione col focus (pid del processo che possiede la window in foreground) */
+
+		newForeground = getForegroundProcess();
 		if (newForeground != focusedApplication) {				// focusedApplication: PID della window in foreground(see Application.hpp)
 			focusedApplication = newForeground;
 			Change c(chf, focusedApplication);
 			changeList.push_back(c);
-			count = 0;
 		}
 
-		if (count == 10) {
-			count = 0;
+		/* il prossimo aggiornamento  tanto pi vicino quanto pi la lista sta cambiando (icone ed uso delle risorse esclusi) */
+		bool changed = !changeList.empty();
+		scheduler.tick(tickStart, changed);
+		metrics.refreshInterval = scheduler.getInterval();
+		metrics.refreshRate = scheduler.getRate();
+
+		/* icone estratte in background dall'ultimo aggiornamento */
+		collectIcons();
+
+		/* uso delle risorse: le variazioni oltre la soglia non rendono pi frequenti gli aggiornamenti della lista */
+		resources.sample(applicationsList, changeList);
+
+		/* se non ci sono modifiche da troppo tempo si invia un heartbeat, per evitare il timeout di lettura del client */
+		std::chrono::steady_clock::time_point now = std::chrono::steady_clock::now();
+		if (!changeList.empty())
+			lastSent = now;
+		else if (now - lastSent >= std::chrono::milliseconds(HEARTBEATINTERVAL)) {
+			lastSent = now;
 			Change c(heartbeat, 0);
 			changeList.push_back(c);
 		}
 
-		/* invio modifiche al client */
-		sendToClient();
+		metrics.ticks++;
+		metrics.changesPerTick.record((unsigned long) changeList.size());
+		metrics.changeQueue = (long long) changeList.size();
+
+		/* modifiche accodate ai client gi connessi (l'invio  eseguito dal reactor) */
+		sendToClient(clients);
+
+		/* modifiche fuse per i client congestionati che si sono liberati (o lista completa se il backlog  pieno) */
+		flushBacklogs(joining);
+
+		/* i nuovi client ricevono la lista aggiornata (o le modifiche perse) e da questo momento anche le modifiche */
+		if (!joining.empty()) {
+			sendSnapshot(joining);
+			std::lock_guard<std::mutex> lock(clientsMutex);
+			for (JoiningClient& j : joining)
+				clients.push_back(j.client);
+			joining.clear();
+		}
+
+		/* il reactor invia i batch accodati e chiude le connessioni fallite */
+		manager.wakeup();
+
+		/* pausa minima tra due aggiornamenti: gli eventi arrivati nel frattempo vengono gestiti insieme */
+		std::this_thread::sleep_until(scheduler.earliestTick());
+	}
+
+	changeSource->stop();
+	IconCache::instance().stopWorkers();
+}
+
+/*	Icone estratte dai worker della IconCache (o la cui estrazione e' scaduta): per ogni applicazione con quell'eseguibile
+*	viene accodata una modifica icu, serializzata con l'icona ora in cache (0 dopo la scadenza: icona di default).
+*	Le add inviate prima avevano il flag FLAGICONPENDING, quelle inviate da ora in poi hanno gia' l'icona.
+*/
+
+void ListHandler::collectIcons() {
+	IconCache::instance().collectCompleted(completedIcons);
+	for (const std::wstring& path : completedIcons)
+		for (const AppEntry& e : applicationsList.getEntries())
+			if (e.valid && e.app.Exec_name && *e.app.Exec_name == path)
+				changeList.push_back(Change(icu, e.pid, e.app));
+}
+
+/* Funzione invocata dalla sorgente di eventi (dal suo thread): risveglia il ciclo di aggiornamento */
+
+void ListHandler::notifyChange() {
+	std::lock_guard<std::mutex> lock(clientsMutex);
+	changePending = true;
+	clientsCondition.notify_one();
+}
+
+/* Limiti (ms) dell'intervallo tra due aggiornamenti: restituisce false se non sono validi */
+
+bool ListHandler::setRefreshBounds(long minMs, long maxMs) {
+	return scheduler.setBounds(minMs, maxMs);
+}
+
+/* Soglie di variazione dell'uso delle risorse (vedi ResourceMonitor::setThresholds): restituisce false se non sono valide */
+
+bool ListHandler::setResourceThresholds(long cpu, long memory) {
+	return resources.setThresholds(cpu, memory);
+}
+
+/* Frequenza effettiva degli aggiornamenti (al secondo) ed intervallo corrente (ms) */
+
+double ListHandler::getRefreshRate() const {
+	return scheduler.getRate();
+}
+
+long ListHandler::getRefreshInterval() const {
+	return scheduler.getInterval();
+}
+
+/* Versione compressa di un batch: batch vuoto se la compressione non riduce il batch (va inviato in chiaro) */
+struct CompressedBatch {
+	FrameBatch batch;
+	bool attempted = false;			// compressione gia' tentata
+};
+
+/*	Invio di un batch ad un client: compresso se il client lo ha richiesto e se la compressione riduce il batch.
+*	La compressione viene calcolata al piu' una volta (al primo client che la richiede) e riusata per gli altri.
+*/
+
+static size_t sendToStream(SocketStream& client, FrameBatch& batch, CompressedBatch& compressed) {
+	if (client.getCompression()) {
+		if (!compressed.attempted) {
+			compressed.attempted = true;
+			if (!compressBatch(batch, compressed.batch))
+				compressed.batch.clear();
+		}
+		if (!compressed.batch.empty()) {
+			client.sendBatch(compressed.batch);
+			return compressed.batch.getBytes();
+		}
+	}
+	client.sendBatch(batch);
+	return batch.getBytes();
+}
+
+/*	Consegna del batch a tutti i client destinatari: il batch viene compresso (una sola volta) se qualche destinatario
+*	lo ha richiesto, poi viene accodato ad ogni connessione senza chiamate di sistema. L'invio vero e proprio e' eseguito
+*	dal reactor (vedi ConnectionManager::sendQueued), per cui un client lento non rallenta l'aggiornamento della lista.
+*	Una connessione con la coda piena viene chiusa. Restituisce il numero di byte accodati su tutte le connessioni.
+*/
 
-		/* il thread  messo in pausa per tot millisecondi */
-		std::this_thread::sleep_for(std::chrono::microseconds(refreshTime));
+static size_t broadcastBatch(std::vector<std::shared_ptr<SocketStream>>& destinations, std::shared_ptr<OutgoingBatch> batch) {
+	for (std::shared_ptr<SocketStream>& client : destinations)
+		if (client->getStatus() && client->getCompression()) {
+			if (!compressBatch(batch->plain, batch->compressed))
+				batch->compressed.clear();
+			break;
+		}
+
+	size_t bytes = 0;
+	for (std::shared_ptr<SocketStream>& client : destinations) {
+		if (!client->getStatus())
+			continue;
+		if (!client->enqueue(batch)) {
+			std::wcerr << "Invio al client fallito: coda di invio piena" << std::endl;
+			Metrics::instance().queueOverflows++;
+			client->setStatus(false);	// la connessione verr chiusa dal reactor
+			continue;
+		}
+		bytes += (client->getCompression() && !batch->compressed.empty()) ? batch->compressed.getBytes() : batch->plain.getBytes();
 	}
+	return bytes;
+}
+
+/*	Serializzazione di una lista di modifiche in un frame: ogni modifica scrive tutti i suoi campi (envelope, pid, lunghezze,
+*	nomi ed hash delle icone) direttamente nel batch (vedi Change::serialize), senza buffer allocati per ogni campo.
+*	Se richiesto, il batch termina con la sequenza dell'ultima modifica registrata (vedi ChangeLog), che il client
+*	memorizza per poter riprendere dalla stessa posizione dopo una riconnessione.
+*	Gli hash delle icone si riferiscono alla dimensione iconSize richiesta dai destinatari del batch.
+*	Con strings (un solo destinatario, che ha chiesto CAPCOMPACT) il frame e' in codifica compatta e i nomi vengono
+*	presi dalla tabella della connessione (vedi CompactEncoding.hpp).
+*	Restituisce false se la serializzazione fallisce (es. allocazione di memoria fallita): la memoria del batch
+*	torna comunque al pool alla sua distruzione.
+*/
+
+bool ListHandler::serializeChanges(std::deque<Change>& changes, bool sequence, FrameBatch& batch, int iconSize, StringTable* strings) {
+	try {
+		if (strings != nullptr) {
+			DWORD lastPid = 0;
+			batch.openFrame(packed);
+			for (Change& c : changes)
+				c.serializeCompact(batch, iconSize, *strings, lastPid);
+			if (sequence) {
+				char* field = batch.appendSpace(1 + 2 * MAXVARINT);
+				field[0] = (char) seq;
+				int used = 1 + writeVarint(field + 1, log.getEpoch());
+				used += writeVarint(field + used, log.getLastSequence());
+				batch.discard(1 + 2 * MAXVARINT - used);
+			}
+			batch.closeFrame();
+			return true;
+		}
+
+		batch.openFrame(frame);
+		for (Change& c : changes)
+			c.serialize(batch, iconSize);
 
+		/* marcatore di sequenza: epoca e sequenza dell'ultima modifica (4 byte ciascuna in formato network) */
+		if (sequence) {
+			batch.appendEnvelope(seq, 2 * dimWord);
+			batch.appendLength((int) log.getEpoch());
+			batch.appendLength((int) log.getLastSequence());
+		}
+		batch.closeFrame();
+	}
+	catch (std::exception& e) {
+		std::wcerr << e.what() << std::endl;
+		return false;
+	}
+	return true;
 }
 
-void ListHandler::setRefreshTime(unsigned long time) {
-	if (time > 500 && time < 10000) {
-		refreshTime = time;
+/*	Invio della stessa lista di modifiche a piu' client: le modifiche vengono serializzate una volta per ogni dimensione
+*	delle icone richiesta dai destinatari (di solito una sola), ed ogni batch viene accodato ai client con quella dimensione.
+*	I client in codifica compatta hanno ciascuno la propria tabella dei nomi e ricevono un batch serializzato solo per loro.
+*	I client di un batch la cui serializzazione fallisce vengono disconnessi. Svuota destinations e restituisce
+*	il numero di byte accodati.
+*/
+
+size_t ListHandler::broadcastChanges(std::deque<Change>& changes, bool sequence, std::vector<std::shared_ptr<SocketStream>>& destinations) {
+	size_t bytes = 0;
+	size_t shared = 0;
+	for (size_t i = 0; i < destinations.size(); i++) {
+		if (destinations[i]->getCompact())
+			bytes += enqueueChanges(destinations[i], changes, sequence);
+		else
+			destinations[shared++] = destinations[i];
+	}
+	destinations.resize(shared);
+
+	while (!destinations.empty()) {
+
+		/* la dimensione di ogni client viene letta una sola volta: il reactor puo' cambiarla (comando hello) */
+		int iconSize = 0;
+		size_t remaining = 0;
+		sizeGroup.clear();
+		for (std::shared_ptr<SocketStream>& client : destinations) {
+			int size = client->getIconSize();
+			if (sizeGroup.empty())
+				iconSize = size;
+			if (size == iconSize)
+				sizeGroup.push_back(client);
+			else
+				destinations[remaining++] = client;
+		}
+		destinations.resize(remaining);
+
+		std::shared_ptr<OutgoingBatch> batch = std::make_shared<OutgoingBatch>();
+		if (serializeChanges(changes, sequence, batch->plain, iconSize))
+			bytes += broadcastBatch(sizeGroup, batch);
+		else {
+			/* i client non possono pi ricevere una lista coerente: si forza la chiusura delle loro connessioni */
+			for (std::shared_ptr<SocketStream>& client : sizeGroup)
+				client->setStatus(false);
+		}
 	}
+	sizeGroup.clear();
+	return bytes;
+}
+
+/* Client congestionato: il reactor non riesce a smaltire i dati gia' accodati per questa connessione */
+
+static bool isCongested(SocketStream& client) {
+	return client.getPendingBytes() >= BACKLOGBYTES || client.getQueuedBatches() >= BACKLOGBATCHES;
+}
+
+/*	Modifiche alla lista registrate nel ChangeLog: icone estratte (icu) ed uso delle risorse (res) descrivono lo stato corrente
+*	delle applicazioni, non la storia della lista. Campionate di continuo, sposterebbero fuori dal registro le modifiche
+*	necessarie alla ripresa: chi riprende ne riceve i valori correnti (vedi appendCurrentState).
+*/
+
+static bool isLogged(changeType type) {
+	return type == add || type == rem || type == chf;
 }
 
-/* Invio della lista al client */
+/*	Invio della lista delle modifiche ai client: ogni modifica viene serializzata una sola volta per tutti i destinatari.
+*	Tutti i campi delle modifiche del ciclo vengono raccolti in un unico batch condiviso, accodato ad ogni connessione
+*	ed inviato dal reactor con una sola scrittura vettoriale: il thread della lista non esegue chiamate di sistema di invio.
+*	I client con una sottoscrizione ricevono solo le modifiche che passano il loro filtro, valutato prima della serializzazione:
+*	una modifica scartata da tutti non costa ne' estrazione dell'icona ne' banda (vedi filterChanges).
+*	Ai client congestionati (o che hanno gia' modifiche in attesa) le modifiche non vengono accodate ma fuse nel loro
+*	ChangeBacklog, inviato quando il socket si libera (vedi flushBacklogs): la memoria usata per un client lento resta limitata.
+*	Le modifiche alla lista (vedi isLogged) vengono registrate nel ChangeLog anche se non ci sono destinatari.
+*/
 
-void ListHandler::sendToClient() {
+void ListHandler::sendToClient(std::vector<std::shared_ptr<SocketStream>>& destinations) {
 	
 	if (changeList.empty())
 		return;
 
-	char* send_buf = nullptr;
-	int length = 0;
-	bool noIcon = false;
-	int nOfChange = changeList.size();
+	bool logged = false;
+	for (Change& c : changeList)
+		if (isLogged(c.getType())) {
+			log.append(c);
+			logged = true;
+		}
+	if (logged) {
+		Metrics::instance().changeLogSize = (long long) log.size();
+		Metrics::instance().changeLogSequence = log.getLastSequence();
+	}
 
-	try {
-		for each(Change c in changeList) {
-
-			/* tipo di modifica + pid :sono le info da inviare sempre per tutti i tipi di modifica */
-			
-			send_buf =c.getSerializedChangeType(length);	//see Change.cpp
-			if (send_buf != nullptr) {
-				socket.sendData(send_buf, length);
-				length = 0;
-				free(send_buf);
-			}
+	readyClients.clear();
+	std::chrono::steady_clock::time_point now = std::chrono::steady_clock::now();
+	for (std::shared_ptr<SocketStream>& client : destinations) {
+		if (!client->getStatus())
+			continue;
+		bool waiting = backlogs.find(client) != backlogs.end() || isCongested(*client);
+		std::map<std::shared_ptr<SocketStream>, ClientFilter>::iterator f = subscriptions.find(client);
+		if (f == subscriptions.end()) {
+			if (waiting)
+				backlogs[client].merge(changeList);
+			else
+				readyClients.push_back(client);
+			continue;
+		}
+
+		/* client con una sottoscrizione: solo le modifiche che passano il filtro */
+		Metrics::instance().filteredChanges += filterChanges(f->second.subscription, changeList, filteredChanges);
+		if (waiting) {
+			backlogs[client].merge(filteredChanges);
+			continue;
+		}
+		/* tutte le modifiche scartate: heartbeat dopo meta' intervallo, perche' nei cicli senza modifiche e' l'heartbeat
+		*  di tutti i client ad arrivare, fino ad HEARTBEATINTERVAL ms dopo l'ultima modifica (al piu' 3 s senza dati) */
+		if (filteredChanges.empty()) {
+			if (now - f->second.lastSent < std::chrono::milliseconds(HEARTBEATINTERVAL / 2))
+				continue;
+			filteredChanges.push_back(Change(heartbeat, 0));
+		}
+		f->second.lastSent = now;
+		sendFiltered(client, filteredChanges, logged);
+	}
+
+	if (readyClients.empty()) {
+		changeList.clear();
+		return;
+	}
 
-			/* Modifica ADD: solo se  un Modification di tipo add il getSerializedName restituisce un valore diverso da nullptr 
-			* La modifica di tipo add prevede molto pi lavoro, in quanto bisogna inviare il nome dell'applicazione e l'icona
-			*/
-			send_buf = c.getSerializedName(length);
-			if (send_buf != nullptr) {
-				u_long length_net = htonl(u_long(length));				// see SocketStream.cpp (traduzione in formato per la network)
-				socket.sendData(((char*) &length_net), sizeof(int));		// invio dimensione (lunghezza) del nome dell'applicazione aggiunta
-				socket.sendData(send_buf,length);						// invio del nome dell'applicazione
-				length = 0;
-				free(send_buf);
-
-				/* invio dell'icona */
-				send_buf = c.getSerializedIcon(length);
-				if (send_buf != nullptr) {
-					u_long length_net = htonl(u_long(length));			// see SocketStream.cpp (traduzione in formato per la network)
-					socket.sendData(((char*) &length_net), sizeof(int));	// invio dimensione dell'icona dell'applicazione aggiunta
-					socket.sendData(send_buf, length);					// invio dell'icona
-					length = 0;
-					free(send_buf);
-				}
-				else {													// Non  stato allocato nessun buffer => no free in caso di eccezione in sendData.
-					length = 0;
-					noIcon = true;
-					socket.sendData(((char*)&length), sizeof(int));
-				}
+	/* al termine della serializzazione cancello la lista: i batch vengono inviati dal reactor */
+	size_t bytes = broadcastChanges(changeList, logged, readyClients);
+	changeList.clear();
+	Metrics::instance().sendBytes.record((unsigned long) bytes);
+}
+
+/*	Serializzazione ed accodamento di una lista di modifiche per un solo client, con la sua dimensione delle icone e,
+*	se l'ha richiesta, in codifica compatta. Se la serializzazione fallisce il client non puo' piu' ricevere una lista
+*	coerente e viene disconnesso. Restituisce il numero di byte accodati.
+*/
+
+size_t ListHandler::enqueueChanges(std::shared_ptr<SocketStream>& client, std::deque<Change>& changes, bool sequence) {
+	std::vector<std::shared_ptr<SocketStream>> destination(1, client);
+	std::shared_ptr<OutgoingBatch> batch = std::make_shared<OutgoingBatch>();
+	if (serializeChanges(changes, sequence, batch->plain, client->getIconSize(), client->getCompact() ? &client->getStrings() : nullptr))
+		return broadcastBatch(destination, batch);
+	client->setStatus(false);
+	return 0;
+}
+
+/* Invio ad un solo client di una lista di modifiche (gia' filtrate o fuse), in un frame con la sequenza corrente se richiesta */
+
+void ListHandler::sendFiltered(std::shared_ptr<SocketStream>& client, std::deque<Change>& changes, bool sequence) {
+	size_t bytes = enqueueChanges(client, changes, sequence);
+	if (client->getStatus())
+		Metrics::instance().sendBytes.record((unsigned long) bytes);
+}
+
+/*	Modifiche che passano il filtro di una sottoscrizione, in filtered; restituisce il numero di modifiche scartate.
+*	Add, remove ed icu hanno l'applicazione (la remove quella terminata, vedi Change); per il cambio di focus e l'uso delle
+*	risorse l'applicazione viene cercata nella lista corrente. Un cambio di focus verso un'applicazione esclusa dal filtro diventa un cambio di
+*	focus verso il pid 0: il client sa che nessuna delle sue applicazioni ha il focus.
+*/
+
+size_t ListHandler::filterChanges(const Subscription& subscription, const std::deque<Change>& changes, std::deque<Change>& filtered) {
+	size_t discarded = 0;
+	filtered.clear();
+	for (const Change& c : changes) {
+		changeType type = c.getType();
+		if (!subscription.accepts(type)) {
+			discarded++;
+			continue;
+		}
+
+		if (type == chf) {
+			const AppEntry* e = applicationsList.find(c.getPid());
+			if (c.getPid() == 0 || subscription.matches(c.getPid(), (e != nullptr && e->valid) ? &e->app : nullptr))
+				filtered.push_back(c);
+			else
+				filtered.push_back(Change(chf, 0));
+		}
+		else if (type == res) {
+			const AppEntry* e = applicationsList.find(c.getPid());
+			if (subscription.matches(c.getPid(), (e != nullptr && e->valid) ? &e->app : nullptr))
+				filtered.push_back(c);
+			else
+				discarded++;
+		}
+		else if ((type != add && type != rem && type != icu) || subscription.matches(c.getPid(), &c.getApplication()))
+			filtered.push_back(c);
+		else
+			discarded++;
+	}
+	return discarded;
+}
+
+/*	Invio delle modifiche fuse ai client congestionati che hanno smaltito la coda: un solo frame con lo stato finale
+*	e la sequenza corrente. Se il backlog ha superato il limite il client riceve di nuovo la lista completa: viene tolto
+*	dai destinatari ed aggiunto ai client da servire con sendSnapshot in questo stesso aggiornamento.
+*/
+
+void ListHandler::flushBacklogs(std::vector<JoiningClient>& joining) {
+	Metrics& metrics = Metrics::instance();
+	std::deque<Change> changes;
+
+	for (std::map<std::shared_ptr<SocketStream>, ChangeBacklog>::iterator b = backlogs.begin(); b != backlogs.end();) {
+		std::shared_ptr<SocketStream> client = b->first;
+		if (client->getStatus() && isCongested(*client)) {
+			++b;
+			continue;
+		}
+
+		if (!client->getStatus()) {
+			// connessione chiusa: le modifiche vengono scartate
+		}
+		else if (b->second.overflowed()) {
+			metrics.snapshotFallbacks++;
+			{
+				std::lock_guard<std::mutex> lock(clientsMutex);
+				clients.erase(std::remove(clients.begin(), clients.end(), client), clients.end());
 			}
+			JoiningClient j;
+			j.client = client;
+			j.deadline = std::chrono::steady_clock::now();
+			j.resume = false;
+			j.epoch = j.sequence = 0;
+			joining.push_back(j);
+		}
+		else if (!b->second.empty()) {
+			b->second.collect(changes);
+			sendFiltered(client, changes, true);
+		}
+		b = backlogs.erase(b);
+	}
+
+	metrics.backloggedClients = (long long) backlogs.size();
+}
 
+/*	Stato corrente delle applicazioni che non e' nel ChangeLog, per un client che riprende: l'ultimo uso delle risorse inviato
+*	e l'icona in cache (dimensione iconSize) di ogni applicazione, perche' la icu di una add ricevuta con l'icona in estrazione
+*	puo' essere andata persa. Nel ChangeBacklog le icu delle applicazioni aggiunte nel frattempo si annullano con la add.
+*/
+
+void ListHandler::appendCurrentState(std::deque<Change>& changes, int iconSize) {
+	resources.current(applicationsList, changes);
+	IconCache& cache = IconCache::instance();
+	for (const AppEntry& e : applicationsList.getEntries()) {
+		bool waiting;
+		if (e.valid && e.app.Exec_name && cache.requestIcon(*e.app.Exec_name, iconSize, waiting))
+			changes.push_back(Change(icu, e.pid, e.app));
+	}
+}
+
+/*	Invio della lista ai client appena connessi.
+*	Un client che si riconnette e le cui modifiche perse sono ancora nel ChangeLog riceve solo quelle, con l'uso delle risorse
+*	e le icone correnti (vedi appendCurrentState); tutti gli altri
+*	ricevono un reset (il client svuota la lista), la lista completa delle applicazioni, l'ultimo uso delle risorse
+*	inviato, l'applicazione in focus e la sequenza corrente. La lista completa viene serializzata una sola volta per tutti i client senza sottoscrizione;
+*	i client con una sottoscrizione ricevono le modifiche perse o la lista filtrate (vedi filterChanges).
+*/
+
+void ListHandler::sendSnapshot(std::vector<JoiningClient>& joining) {
+	std::vector<std::shared_ptr<SocketStream>> destinations;
+	std::deque<Change> changes;
+
+	for (JoiningClient& j : joining) {
+		if (!j.resume || !log.collect(j.epoch, j.sequence, changes)) {
+			destinations.push_back(j.client);
+			continue;
 		}
 
-		/* al termine dell'invio cancello la lista */
-		changeList.clear();
+		/* le modifiche perse vengono filtrate e fuse: il client riceve lo stato finale, non tutta la storia */
+		size_t missed = changes.size();
+		appendCurrentState(changes, j.client->getIconSize());
+		std::map<std::shared_ptr<SocketStream>, ClientFilter>::iterator f = subscriptions.find(j.client);
+		if (f != subscriptions.end()) {
+			filterChanges(f->second.subscription, changes, filteredChanges);
+			changes.swap(filteredChanges);
+		}
+		ChangeBacklog backlog;
+		backlog.merge(changes);
+		if (backlog.overflowed()) {
+			destinations.push_back(j.client);
+			continue;
+		}
+		backlog.collect(changes);
+
+		Metrics::instance().resumes++;
+		Metrics::instance().resumeMissedChanges += missed;
+		sendFiltered(j.client, changes, true);
 	}
-	catch (std::overflow_error& e) {
-		std::wcerr << e.what() << std::endl;
-		// la memcpy_s fallisce dentro getSerializedName
-		// forziamo la chiusura della connessione
-		socket.closeConnection();
-		changeList.clear();			// la lista  disponibile per altre connessioni
-		socket.setStatus(false);	// termina il metodo UpdateAppList
+
+	if (!destinations.empty()) {
+		changes.clear();
+		changes.push_back(Change(reset, 0));
+		for (const AppEntry& e : applicationsList.getEntries())
+			if (e.valid)
+				changes.push_back(Change(e.pid, e.app));
+		resources.current(applicationsList, changes);
+
+		if (focusedApplication != 0)
+			changes.push_back(Change(chf, focusedApplication));
+
+		/* i client con una sottoscrizione ricevono la lista filtrata, gli altri quella completa */
+		std::chrono::steady_clock::time_point now = std::chrono::steady_clock::now();
+		readyClients.clear();
+		for (std::shared_ptr<SocketStream>& client : destinations) {
+			std::map<std::shared_ptr<SocketStream>, ClientFilter>::iterator f = subscriptions.find(client);
+			if (f == subscriptions.end()) {
+				readyClients.push_back(client);
+				continue;
+			}
+			Metrics::instance().filteredChanges += filterChanges(f->second.subscription, changes, filteredChanges);
+			f->second.lastSent = now;
+			sendFiltered(client, filteredChanges, true);
+		}
+
+		broadcastChanges(changes, true, readyClients);
 	}
-	catch (socket_exception) {
+}
+
+/* Registrazione di un nuovo client: chiamata dal reactor all'accettazione della connessione */
+
+void ListHandler::addClient(std::shared_ptr<SocketStream> client) {
+	JoiningClient j;
+	j.client = client;
+	j.deadline = std::chrono::steady_clock::now() + std::chrono::milliseconds(RESUMETIMEOUT);
+	j.resume = false;
+	j.epoch = j.sequence = 0;
+
+	std::lock_guard<std::mutex> lock(clientsMutex);
+	newClients.push_back(j);
+	clientsCondition.notify_one();
+}
+
+/*	Richiesta di ripresa di un client appena connesso (invocata dal reactor): epoca e sequenza dell'ultima modifica ricevuta
+*	(0 se il client non ha mai ricevuto la lista). Il client viene servito al prossimo aggiornamento.
+*	Se il client ha gia' ricevuto la lista completa (richiesta arrivata dopo RESUMETIMEOUT) la richiesta viene ignorata.
+*/
+
+void ListHandler::resumeClient(SocketStream& client, DWORD epoch, DWORD sequence) {
+	std::lock_guard<std::mutex> lock(clientsMutex);
+	for (JoiningClient& j : newClients)
+		if (j.client.get() == &client) {
+			j.resume = epoch != 0;
+			j.epoch = epoch;
+			j.sequence = sequence;
+			j.deadline = std::chrono::steady_clock::now();
+			clientsCondition.notify_one();
+			return;
+		}
+}
+
+/*	Sottoscrizione di un client (invocata dal reactor): viene applicata dal thread della lista al prossimo aggiornamento,
+*	che viene anticipato (vedi applySubscriptions).
+*/
+
+void ListHandler::subscribeClient(SocketStream& client, const Subscription& subscription) {
+	SubscriptionRequest r;
+	r.client = &client;
+	r.subscription = subscription;
+
+	std::lock_guard<std::mutex> lock(clientsMutex);
+	subscriptionRequests.push_back(r);
+	clientsCondition.notify_one();
+}
 
+/*	Applicazione delle sottoscrizioni ricevute (chiamata con clientsMutex acquisito, dopo aver spostato in joining
+*	i client appena connessi da servire). Un client che non ha ancora ricevuto la lista la ricevera' gia' filtrata;
+*	un client che la sta gia' ricevendo viene tolto dai destinatari e servito di nuovo con la lista completa filtrata
+*	in questo aggiornamento, come un client appena connesso (le modifiche fuse in attesa vengono scartate).
+*	Le sottoscrizioni dei client disconnessi vengono eliminate.
+*/
+
+void ListHandler::applySubscriptions(std::vector<JoiningClient>& joining) {
+	std::chrono::steady_clock::time_point now = std::chrono::steady_clock::now();
+
+	for (SubscriptionRequest& r : subscriptionRequests) {
+		std::shared_ptr<SocketStream> client;
+		bool active = false;
+		for (JoiningClient& j : newClients)
+			if (j.client.get() == r.client)
+				client = j.client;
+		for (JoiningClient& j : joining)
+			if (j.client.get() == r.client)
+				client = j.client;
+		for (std::shared_ptr<SocketStream>& c : clients)
+			if (c.get() == r.client) {
+				client = c;
+				active = true;
+			}
+		if (!client)
+			continue;			// connessione gia' chiusa
+
+		/* stessa sottoscrizione gia' in uso: nulla da fare */
+		std::map<std::shared_ptr<SocketStream>, ClientFilter>::iterator f = subscriptions.find(client);
+		if (f == subscriptions.end() ? r.subscription.isDefault() : f->second.subscription == r.subscription)
+			continue;
+
+		if (r.subscription.isDefault())
+			subscriptions.erase(client);
+		else {
+			ClientFilter& filter = subscriptions[client];
+			filter.subscription = r.subscription;
+			filter.lastSent = now;
+		}
+
+		if (active) {
+			clients.erase(std::remove(clients.begin(), clients.end(), client), clients.end());
+			backlogs.erase(client);
+			JoiningClient j;
+			j.client = client;
+			j.deadline = now;
+			j.resume = false;
+			j.epoch = j.sequence = 0;
+			joining.push_back(j);
+		}
 	}
-	catch (std::exception& e) {
-		std::wcerr << e.what() << std::endl;
+	subscriptionRequests.clear();
+
+	for (std::map<std::shared_ptr<SocketStream>, ClientFilter>::iterator f = subscriptions.begin(); f != subscriptions.end();)
+		if (!f->first->getStatus())
+			f = subscriptions.erase(f);
+		else
+			++f;
+	Metrics::instance().subscribedClients = (long long) subscriptions.size();
+}
+
+/* Istante in cui il primo dei client appena connessi deve essere servito (chiamata con clientsMutex acquisito) */
 
-		/* si rilasciano eventuali risorse quando la send fallisce */
-		if (!noIcon)
-			free(send_buf);
+std::chrono::steady_clock::time_point ListHandler::firstJoinDeadline() {
+	std::chrono::steady_clock::time_point first = std::chrono::steady_clock::time_point::max();
+	for (JoiningClient& j : newClients)
+		first = std::min(first, j.deadline);
+	return first;
+}
 
-		changeList.clear();			// lista disponibile per altre connessioni
+/* Terminazione del ciclo di aggiornamento della lista */
 
-		socket.setStatus(false);	// durante l'invio c' stato un errore, il ciclo dentro UpdateAppList termina.	
+void ListHandler::stop() {
+	std::lock_guard<std::mutex> lock(clientsMutex);
+	stopped = true;
+	clientsCondition.notify_one();
+}
+
+/*	Risposta ad una richiesta di icona: messaggio di tipo ico con hash, lunghezza e byte dell'icona.
+*	Se l'icona non  pi in cache la lunghezza  0 ed il client mantiene l'icona di default.
+*	L'icona viene inviata con un unico batch, per cui non si mescola con le modifiche inviate dal thread della lista.
+*/
+
+static void sendIcon(SocketStream& s, unsigned long long hash) {
+	IconBuffer icon = IconCache::instance().findByHash(hash);
+	FrameBatch batch;
+	int length = icon ? (int) icon->bytes.size() : 0;
+
+	batch.openFrame(frame);
+	batch.appendEnvelope(ico, dimHash + dimWord + length);
+	batch.appendHash(hash);
+	batch.appendLength(length);
+	if (icon)
+		batch.append(icon, icon->bytes.data(), length);
+	batch.closeFrame();
+
+	CompressedBatch compressed;
+	sendToStream(s, batch, compressed);
+}
+
+/*	Risposta all'handshake delle capacita': il server accetta le capacita' richieste che supporta e le comunica al client
+*	con un messaggio di tipo caps (4 byte in formato network). Da questo momento i batch abbastanza grandi possono arrivare
+*	compressi; il client li accetta in qualsiasi momento, per cui non serve sincronizzarsi con il thread della lista.
+*	Con CAPCOMPACT le modifiche successive arrivano in frame packed (vedi CompactEncoding.hpp): la codifica non viene piu'
+*	disattivata, per cui resta tra le capacita' accettate anche se un handshake successivo non la richiede.
+*	Con CAPICONSIZE il client indica anche la dimensione delle icone (limitata a ICONMINSIZE..ICONMAXSIZE), restituita
+*	dopo le capacita'. La dimensione vale per tutta la connessione: l'hash di una add si riferisce all'icona in quella
+*	dimensione, per cui l'handshake va eseguito prima di ricevere la lista (durante l'attesa della richiesta di ripresa).
+*/
+
+static void acceptCapabilities(SocketStream& s, DWORD requested, DWORD iconSize) {
+	DWORD accepted = requested & SERVERCAPS;
+	s.setCompression((accepted & CAPCOMPRESSION) != 0);
+	if (accepted & CAPCOMPACT)
+		s.enableCompact();
+	if (s.getCompact())
+		accepted |= CAPCOMPACT;
+	if (accepted & CAPICONSIZE) {
+		iconSize = std::min<DWORD>(std::max<DWORD>(iconSize, ICONMINSIZE), ICONMAXSIZE);
+		s.setIconSize((int) iconSize);
 	}
+
+	FrameBatch batch;
+	batch.openFrame(frame);
+	batch.appendEnvelope(caps, (accepted & CAPICONSIZE) ? 2 * dimWord : dimWord);
+	batch.appendLength((int) accepted);
+	if (accepted & CAPICONSIZE)
+		batch.appendLength((int) iconSize);
+	batch.closeFrame();
+	s.sendBatch(batch);
 }
 
-/* metodo gestito da un thread secondario (sganciato dal ThreadManager nella funzione ServerManagement)
-*  si occupa di attendere i comandi del client, li decifra, e li invia all'applicazione in foreground come input
+/* Lettura di un DWORD in formato network da un buffer non allineato */
+
+static DWORD readDword(const char* buffer) {
+	DWORD value;
+	memcpy(&value, buffer, sizeof(DWORD));
+	return ntohl(value);
+}
+
+/*	Esecuzione di un comando completo ricevuto dal client (payload di length byte).
+*	I comandi malformati o sconosciuti vengono ignorati, come quelli con una versione del protocollo diversa.
+*	Per i comandi di input (tasti e testo) decoded riceve l'istante in cui il comando e' stato decodificato, subito prima
+*	dell'iniezione, e la funzione restituisce true (vedi CommandsFromClient).
 */
 
-void CommandsFromClient(ListHandler* listHandler, SocketStream* s) {
-	
-	char buffer[1 + sizeof(int)];		// 1 byte per i modificatori e 4 byte per il messaggio key inviato (che  di tipo ulong)
-	INPUT input[8];						// al pi 4 pressioni + 4 rilasci di tasti (3 modificatori e un key).
-	int nOfInput = 0;
+static bool executeCommand(SocketStream& s, ListHandler& listHandler, unsigned char type, const char* payload, DWORD length,
+	std::chrono::steady_clock::time_point& decoded) {
+	switch (type) {
+	case cmdKeys: {
+		/* sequenza di combinazioni di tasti, inviate all'applicazione in foreground con un'unica iniezione (vedi Desktop.cpp) */
+		if (length == 0 || length % CHORDSIZE != 0)
+			return false;
+		std::vector<KeyChord> chords;
+		chords.reserve(length / CHORDSIZE);
+		for (DWORD i = 0; i < length; i += CHORDSIZE)
+			chords.push_back({ payload[i], (int) readDword(payload + i + 1) });
+		decoded = std::chrono::steady_clock::now();
+		sendKeys(chords);
+		return true;
+	}
+	case cmdText: {
+		/* testo UTF-16LE, digitato nell'applicazione in foreground carattere per carattere */
+		if (length == 0 || length % 2 != 0)
+			return false;
+		std::u16string text(length / 2, u'\0');
+		for (DWORD i = 0; i < length / 2; i++)
+			text[i] = (char16_t) ((unsigned char) payload[2 * i] | ((unsigned char) payload[2 * i + 1] << 8));
+		decoded = std::chrono::steady_clock::now();
+		sendText(text);
+		return true;
+	}
+	case cmdIcon: {
+		/* richiesta di un'icona: hash dell'icona (8 byte in formato network) */
+		if (length != HASHSIZE)
+			return false;
+		unsigned long long hash = 0;
+		for (int i = 0; i < HASHSIZE; i++)
+			hash = (hash << 8) | (unsigned char) payload[i];
+		sendIcon(s, hash);
+		return false;
+	}
+	case cmdResume:
+		/* richiesta di ripresa: epoca e sequenza (4 byte ciascuna in formato network) */
+		if (length == 2 * sizeof(DWORD))
+			listHandler.resumeClient(s, readDword(payload), readDword(payload + sizeof(DWORD)));
+		return false;
+	case cmdHello:
+		/* handshake delle capacita': capacita' richieste (4 byte in formato network), con CAPICONSIZE seguite
+		*  dalla dimensione delle icone (4 byte); senza la dimensione la capacita' non viene accettata */
+		if (length == sizeof(DWORD))
+			acceptCapabilities(s, readDword(payload) & ~CAPICONSIZE, ICONSIZE);
+		else if (length == 2 * sizeof(DWORD))
+			acceptCapabilities(s, readDword(payload), readDword(payload + sizeof(DWORD)));
+		return false;
+	case cmdSubscribe: {
+		/* sottoscrizione: tipi di modifica, pid ed espressioni sui nomi (vedi Subscription) */
+		Subscription subscription;
+		if (subscription.parse(payload, length))
+			listHandler.subscribeClient(s, subscription);
+		return false;
+	}
+	default:
+		return false;
+	}
+}
+
+/* Durata in microsecondi tra due istanti (limitata a 32 bit, come nel messaggio echo) */
+
+static DWORD elapsedMicros(std::chrono::steady_clock::time_point from, std::chrono::steady_clock::time_point to) {
+	long long micros = std::chrono::duration_cast<std::chrono::microseconds>(to - from).count();
+	if (micros < 0)
+		return 0;
+	return micros > 0xFFFFFFFFLL ? 0xFFFFFFFF : (DWORD) micros;
+}
 
-	/* Modificatori da gestire */
-	INPUT CtrlDown, ShiftDown, AltDown, CtrlUp, ShiftUp, AltUp;
-	INPUT KeyDown, KeyUp;
+/*	Risposta ad un comando con timestamp: messaggio di tipo echo con il timestamp del client (8 byte, restituito invariato),
+*	la durata dell'attesa (ricezione -> decodifica) e quella dell'iniezione (decodifica -> fine dell'iniezione), in microsecondi.
+*	Il client ricava dal timestamp il tempo totale del comando, e per differenza quello trascorso sulla rete.
+*/
 
-	CtrlDown.type = ShiftDown.type = AltDown.type = KeyDown.type = INPUT_KEYBOARD;						//	evento INPUT_KEYBOARD
-	CtrlUp.type = ShiftUp.type = AltUp.type = KeyUp.type = INPUT_KEYBOARD;
+static void sendEcho(SocketStream& s, unsigned long long timestamp, DWORD queueMicros, DWORD injectMicros) {
+	FrameBatch batch;
+	batch.openFrame(frame);
+	batch.appendEnvelope(echo, dimHash + 2 * dimWord);
+	batch.appendHash(timestamp);
+	batch.appendLength((int) queueMicros);
+	batch.appendLength((int) injectMicros);
+	batch.closeFrame();
+
+	CompressedBatch compressed;
+	sendToStream(s, batch, compressed);
+}
 
-	ShiftUp.ki.dwFlags = CtrlUp.ki.dwFlags = AltUp.ki.dwFlags = KeyUp.ki.dwFlags = KEYEVENTF_KEYUP;		// evento: il key viene rilasciato
-	ShiftDown.ki.dwFlags = CtrlDown.ki.dwFlags = AltDown.ki.dwFlags = KeyDown.ki.dwFlags = 0;			// evento: il key viene premuto
+/* metodo invocato dal reactor (ConnectionManager) ogni volta che arrivano dati da un client
+*  si occupa di estrarre i comandi completi ricevuti, li decifra, e li invia all'applicazione in foreground come input.
+*  Ogni comando ha l'envelope dei messaggi del server (versione, tipo, flag e lunghezza del payload) seguito dal payload:
+*  i comandi ricevuti solo in parte restano nel buffer della connessione fino all'arrivo dei byte mancanti.
+*  Oltre ai tasti (anche sequenze di combinazioni o testo, vedi commandType), il client pu richiedere le icone che non conosce
+*  (vedi sendIcon) e, appena connesso, chiedere di riprendere dall'ultima modifica ricevuta (vedi ListHandler::resumeClient)
+*  o richiedere capacita' opzionali come la compressione (vedi acceptCapabilities); in qualsiasi momento puo' indicare
+*  quali modifiche vuole ricevere (vedi ListHandler::subscribeClient).
+*  Un comando piu' lungo di MAXCOMMAND non puo' essere valido: l'eccezione fa chiudere la connessione al reactor.
+*  Per i comandi di input viene misurata la latenza sul server (ricezione, decodifica, fine dell'iniezione) e registrata
+*  negli istogrammi della connessione; i comandi con il flag FLAGTIMESTAMP hanno il payload preceduto da un timestamp del
+*  client, restituito con i tempi misurati in un messaggio echo (vedi sendEcho).
+*/
 
-	ShiftUp.ki.time = CtrlUp.ki.time = AltUp.ki.time = KeyUp.ki.time = 0 ;								// timestamp: il sistema usa il proprio timestamp
-	ShiftDown.ki.time = CtrlDown.ki.time = AltDown.ki.time = KeyDown.ki.time = 0;		
+void CommandsFromClient(SocketStream& s, ListHandler& listHandler) {
+	
+	char header[ENVELOPESIZE];
+	std::vector<char> command;
+
+	/* si decifrano tutti i comandi completi presenti nel buffer di lettura */
+	while (s.peekData(header, ENVELOPESIZE) != 0) {
+		DWORD length = readDword(header + 4);
+		if (length > MAXCOMMAND)
+			throw socket_exception("Comando troppo lungo");
+
+		command.resize(ENVELOPESIZE + length);
+		if (s.receiveData(command.data(), (int) command.size()) == 0)
+			break;					// comando non ancora completo
+
+		if ((unsigned char) header[0] != PROTOCOLVERSION)
+			continue;
+
+		const char* payload = command.data() + ENVELOPESIZE;
+		u_short flags;
+		memcpy(&flags, header + 2, sizeof(flags));		// header non allineato: niente letture tramite puntatori a u_short
+		bool timed = (ntohs(flags) & FLAGTIMESTAMP) != 0;
+		unsigned long long timestamp = 0;
+		if (timed) {
+			if (length < dimHash)
+				continue;
+			for (size_t i = 0; i < dimHash; i++)
+				timestamp = (timestamp << 8) | (unsigned char) payload[i];
+			payload += dimHash;
+			length -= dimHash;
+		}
 
-	ShiftUp.ki.dwExtraInfo = CtrlUp.ki.dwExtraInfo = AltUp.ki.dwExtraInfo = KeyUp.ki.dwExtraInfo = 0;	// non ci sono info addizionali
-	ShiftDown.ki.dwExtraInfo = CtrlDown.ki.dwExtraInfo = AltDown.ki.dwExtraInfo = KeyDown.ki.dwExtraInfo = 0;
+		std::chrono::steady_clock::time_point received = s.getLastReceive(), decoded;
+		bool input = executeCommand(s, listHandler, (unsigned char) header[1], payload, length, decoded);
+		std::chrono::steady_clock::time_point injected = std::chrono::steady_clock::now();
+		if (!input)
+			decoded = injected;
+
+		DWORD queueMicros = elapsedMicros(received, decoded), injectMicros = elapsedMicros(decoded, injected);
+		if (input) {
+			s.getLatency().record(queueMicros, injectMicros);
+			Metrics& metrics = Metrics::instance();
+			metrics.commandLatency.record(queueMicros + injectMicros);
+			metrics.commandQueue.record(queueMicros);
+			metrics.commandInject.record(injectMicros);
+		}
+		if (timed)
+			sendEcho(s, timestamp, queueMicros, injectMicros);
+	}
+}
 
-	ShiftDown.ki.wVk = ShiftUp.ki.wVk = VK_SHIFT;														// associazione con il proprio key modificatore
-	CtrlDown.ki.wVk = CtrlUp.ki.wVk = VK_CONTROL;
-	AltDown.ki.wVk = AltUp.ki.wVk = VK_MENU;
+/* Funzione eseguita dal thread del reactor: se il ciclo degli eventi fallisce si termina anche l'aggiornamento della lista */
 
+static void ReactorLoop(ConnectionManager& manager, ListHandler& listHandler, std::atomic_bool& continua) {
 	try {
-		/* rimaniamo in attesa dei comandi finch la connessione non viene chiusa */
-		while (s->receiveData(buffer, 1 + sizeof(int)) != 0) {
-			char modifier = buffer[0];				// lettura il primo byte dal buffer che rappresenta la concatenazione di uno o pi modificatori
-			int key = ntohl(*((u_long*)&buffer[1]));// lettura tasto premuto
-			std::wcout << "Input dal client: " << key << ", modifier: " << (u_short)modifier << std::endl;
-
-			nOfInput = 0;
-			/* in input salviamo i modificatori premuti (ricevuti dal client) */
-			if ((modifier & SHIFT) != 0)
-				input[nOfInput++] = ShiftDown;
-			if ((modifier & CTRL) != 0)
-				input[nOfInput++] = CtrlDown;
-			if ((modifier & ALT) != 0)
-				input[nOfInput++] = AltDown;
-
-			/* concateniamo sia la pressione sia il rilascio del tasto */
-			KeyDown.ki.wVk = KeyUp.ki.wVk = key;	// l'associazione  fatta ad hoc in base al tasto ricevuto dal client. 
-			input[nOfInput++] = KeyDown;
-			input[nOfInput++] = KeyUp;
-
-			/* concateniamo i rilasci dei modificatori eventualmente premuti */
-			if ((modifier & SHIFT) != 0)
-				input[nOfInput++] = ShiftUp;
-			if ((modifier & CTRL) != 0)
-				input[nOfInput++] = CtrlUp;
-			if ((modifier & ALT) != 0)
-				input[nOfInput++] = AltUp;
-
-			/* funzione che invia direttamente all'app in foreground un vettore con i modificatori selezionati */
-			int res = SendInput(nOfInput, input, sizeof(INPUT));
-		}	
+		manager.run();
 	}
-	catch (std::exception& e) {
-		std::wcerr << "Client close connection: " << e.what() << std::endl;
+	catch (socket_exception& e) {
+		std::cerr << e.what() << std::endl;
+		continua = false;
+		requestShutdown(-10);
 	}
-	s->setStatus(false);
+	listHandler.stop();
 }
 
 /* Funzione principale, entry point del thread ThreadManager, che si occupa della gestione della lista dell'applicazioni in esecuzione, ovvero:
 * 1. generazione ed aggiornamento della lista delle applicazioni attive.
-* 2. invio al Client degli aggiornamenti (modifiche) delle applicazioni attive.
-* 3. ascolto e ricezione dei comandi inviati dal Client (CommandsFromClient: tramite la generazione di un thread secondario).
+* 2. invio a tutti i Client connessi degli aggiornamenti (modifiche) delle applicazioni attive.
+* 3. ascolto e ricezione dei comandi inviati dai Client (CommandsFromClient: invocata dal reactor, eseguito da un thread secondario).
+* 4. esposizione delle metriche su una porta locale (MetricsServer), se metricsPort non e' 0.
+* Il numero di thread  fisso (questo thread pi quello del reactor) indipendentemente dal numero di client.
 */
 
-void serverManagementList(SocketStream& socket, std::atomic_bool& continua) {
-
-	try {
-		/* finch continua  a true il server rimane attivo in comunicazione con il Client o attesa di esso */
-		
-		while (continua) {
-			
-			socket.waitingForConnection();		// server in attesa di connessione con il client
-			
-			ListHandler listHandler(socket);	// creazione dell'istanza listHandler che gestir lista delle applicazioni
-			
-			std::thread ThreadListener(CommandsFromClient, &listHandler, &socket);		//thread secondario che gestisce i messaggi in ricezione dal client
-
-			std::wcout << "Inizio del servizio Client" << std::endl;
+void serverManagementList(ConnectionManager& manager, std::atomic_bool& continua, long minRefresh, long maxRefresh, int metricsPort,
+	long cpuThreshold, long memoryThreshold) {
+
+	ListHandler listHandler(manager);	// creazione dell'istanza listHandler che gestir lista delle applicazioni
+	if (!listHandler.setRefreshBounds(minRefresh, maxRefresh))
+		std::wcerr << "Limiti dell'intervallo di aggiornamento non validi: si usano quelli predefiniti" << std::endl;
+	if (!listHandler.setResourceThresholds(cpuThreshold, memoryThreshold))
+		std::wcerr << "Soglie dell'uso delle risorse non valide: si usano quelle predefinite" << std::endl;
+
+	/* le metriche sono facoltative: se la porta non e' disponibile il server funziona comunque */
+	std::unique_ptr<MetricsServer> metrics;
+	if (metricsPort > 0)
+		try {
+			metrics.reset(new MetricsServer(metricsPort));
+			std::wcout << "Metriche disponibili su 127.0.0.1:" << metricsPort << std::endl;
+		}
+		catch (std::exception& e) {
+			std::cerr << "Metriche non disponibili: " << e.what() << std::endl;
+		}
 
-			listHandler.UpdateAppList();		//il ThreadManager si occupa di questo metodo finch non termina la connessione
+	manager.setHandlers([&listHandler](std::shared_ptr<SocketStream> client) { listHandler.addClient(client); },
+		[&listHandler](SocketStream& s) { CommandsFromClient(s, listHandler); });
 
-			std::wcout << "Fine della routine del servizio Client" << std::endl;
+	try {
+		std::thread ThreadListener(ReactorLoop, std::ref(manager), std::ref(listHandler), std::ref(continua));		//thread secondario che gestisce le connessioni dei client
 
-			ThreadListener.join();				// si attende la terminazione del thread ThreadListener (che terminer non ricevendo pi dati dal Client)
+		std::wcout << "Inizio del servizio Client" << std::endl;
 
-			socket.closeConnection();
+		try {
+			listHandler.UpdateAppList();	//il ThreadManager si occupa di questo metodo finch il server non viene terminato
+		}
+		catch (std::exception& e) {
+			std::cerr << e.what() << std::endl;
+			IconCache::instance().stopWorkers();		// UpdateAppList interrotta: i worker delle icone non sono stati terminati
 		}
 
+		std::wcout << "Fine della routine del servizio Client" << std::endl;
+
+		manager.stop();
+		ThreadListener.join();				// si attende la terminazione del thread ThreadListener
 	}
-	catch (socket_exception) {
-		PostQuitMessage(-10);
-	}
-	catch (std::exception& e) {
+	catch (std::system_error& e) {
 		std::cerr << e.what() << std::endl;
+		requestShutdown(-10);
 	}
 }
@@ -1,46 +1,122 @@
 #pragma once
-#include "SocketStream.hpp"
-#include <Windows.h>
+#include "ConnectionManager.hpp"
+#include "Platform.hpp"
+#include <atomic>
 #include <thread>
 #include <memory>
 #include <mutex>
+#include <condition_variable>
 #include <deque>
 #include <vector>
 #include <map>
 #include <iostream>
-#include <psapi.h>
 #include "Change.hpp"
+#include "ChangeSource.hpp"
+#include "AppList.hpp"
+#include "ProcessCache.hpp"
+#include "Desktop.hpp"
+#include "RefreshScheduler.hpp"
+#include "ChangeLog.hpp"
+#include "ChangeBacklog.hpp"
+#include "Subscription.hpp"
+#include "ResourceMonitor.hpp"
+#include "MetricsServer.hpp"
 #include <system_error>
 
 
+#define HEARTBEATINTERVAL 2000				// intervallo (ms) senza modifiche dopo il quale si invia un heartbeat (il client attende al piu' 5 s)
+#define RESUMETIMEOUT 200					// attesa massima (ms) della richiesta di ripresa di un client appena connesso
+#define BACKLOGBYTES (256 * 1024)			// byte in attesa di invio oltre i quali un client e' congestionato (vedi ChangeBacklog)
+#define BACKLOGBATCHES (SENDQUEUE / 2)		// batch in coda oltre i quali un client e' congestionato
+
+/*	Tipo di comando inviato dal client: ogni comando ha lo stesso envelope dei messaggi del server (vedi FrameBatch.hpp).
+*	keys: sequenza di combinazioni (1 byte di modificatori + tasto, 4 byte in formato network); text: testo UTF-16LE;
+*	icon: hash dell'icona richiesta; resume: epoca e sequenza dell'ultima modifica ricevuta; hello: capacita' richieste
+*	(con CAPICONSIZE seguite dalla dimensione delle icone, con CAPCOMPACT modifiche in codifica compatta);
+*	subscribe: modifiche che il client vuole ricevere (vedi Subscription).
+*/
+enum commandType { cmdKeys, cmdText, cmdIcon, cmdResume, cmdHello, cmdSubscribe };
+
+/* Client appena connesso, in attesa della lista completa o delle modifiche perse dall'ultima connessione */
+struct JoiningClient {
+	std::shared_ptr<SocketStream> client;
+	std::chrono::steady_clock::time_point deadline;		// istante in cui riceve la lista anche senza richiesta di ripresa
+	bool resume;										// il client ha comunicato l'ultima sequenza ricevuta
+	DWORD epoch;
+	DWORD sequence;
+};
+
+/* Sottoscrizione di un client, con l'istante dell'ultimo invio (un client che filtra tutte le modifiche riceve comunque gli heartbeat) */
+struct ClientFilter {
+	Subscription subscription;
+	std::chrono::steady_clock::time_point lastSent;
+};
+
+/* Sottoscrizione ricevuta dal reactor, applicata dal thread della lista al prossimo aggiornamento */
+struct SubscriptionRequest {
+	SocketStream* client;
+	Subscription subscription;
+};
 
 /* Classe che gestisce la lista delle applicazioni */
 
 class ListHandler {
 private:
 
-	unsigned long refreshTime;							//Tempo di refresh della lista
-	std::map<DWORD, ApplicationItem> applicationsList;	//Lista delle applicazioni indicizzata per pid
+	RefreshScheduler scheduler;							//Scadenze degli aggiornamenti (riconciliazione completa della lista)
+	AppList applicationsList;							//Lista delle applicazioni ordinata per pid
 	DWORD focusedApplication = 0;						//Pid dell'applicazione in foreground
+	ResourceMonitor resources;							//Uso delle risorse delle applicazioni della lista
 	std::deque<Change> changeList;						//Puntatore alla lista delle modifiche
-	SocketStream& socket;
-	void sendToClient();
+	ChangeLog log;										//Ultime modifiche inviate, per i client che si riconnettono
+	std::map<std::shared_ptr<SocketStream>, ChangeBacklog> backlogs;	//Modifiche fuse per i client congestionati
+	std::vector<std::shared_ptr<SocketStream>> readyClients;			//Destinatari del ciclo corrente non congestionati
+	std::vector<std::shared_ptr<SocketStream>> sizeGroup;				//Destinatari con la stessa dimensione delle icone
+	std::map<std::shared_ptr<SocketStream>, ClientFilter> subscriptions;	//Client che ricevono solo una parte delle modifiche
+	std::deque<Change> filteredChanges;					//Modifiche del ciclo corrente che passano il filtro di un client
+	std::vector<std::wstring> completedIcons;			//Eseguibili con l'icona estratta (o scaduta) in background
+	ConnectionManager& manager;
+	std::vector<std::shared_ptr<SocketStream>> clients;		//Client che ricevono gli aggiornamenti della lista
+	std::vector<JoiningClient> newClients;				//Client appena connessi, in attesa della lista completa
+	std::vector<SubscriptionRequest> subscriptionRequests;	//Sottoscrizioni ricevute e non ancora applicate
+	std::mutex clientsMutex;
+	std::condition_variable clientsCondition;			//Segnalata alla connessione di un client o alla terminazione
+	bool stopped = false;
+	bool changePending = false;							//Segnalato dalla sorgente di eventi: la lista potrebbe essere cambiata
+	std::unique_ptr<ChangeSource> changeSource;
+	void notifyChange();
+	void collectIcons();
+	std::chrono::steady_clock::time_point firstJoinDeadline();
+	bool serializeChanges(std::deque<Change>& changes, bool sequence, FrameBatch& batch, int iconSize = ICONSIZE, StringTable* strings = nullptr);
+	size_t broadcastChanges(std::deque<Change>& changes, bool sequence, std::vector<std::shared_ptr<SocketStream>>& destinations);
+	void applySubscriptions(std::vector<JoiningClient>& joining);
+	size_t filterChanges(const Subscription& subscription, const std::deque<Change>& changes, std::deque<Change>& filtered);
+	void sendToClient(std::vector<std::shared_ptr<SocketStream>>& destinations);
+	size_t enqueueChanges(std::shared_ptr<SocketStream>& client, std::deque<Change>& changes, bool sequence);
+	void sendFiltered(std::shared_ptr<SocketStream>& client, std::deque<Change>& changes, bool sequence);
+	void flushBacklogs(std::vector<JoiningClient>& joining);
+	void appendCurrentState(std::deque<Change>& changes, int iconSize);
+	void sendSnapshot(std::vector<JoiningClient>& joining);
 
 public:
-	void buildList(std::map<DWORD, ApplicationItem>& list);
+	static void buildList(std::vector<DWORD>& pids, ProcessEnumerator enumerate = enumerateProcesses);
 	void UpdateAppList();
-	void setRefreshTime(unsigned long time);
-	ListHandler(SocketStream& s, unsigned long refreshTime = 100) : socket(s), refreshTime(refreshTime) {}
+	bool setRefreshBounds(long minMs, long maxMs);
+	bool setResourceThresholds(long cpu, long memory);
+	double getRefreshRate() const;
+	long getRefreshInterval() const;
+	void addClient(std::shared_ptr<SocketStream> client);
+	void resumeClient(SocketStream& client, DWORD epoch, DWORD sequence);
+	void subscribeClient(SocketStream& client, const Subscription& subscription);
+	void stop();
+	ListHandler(ConnectionManager& m) : manager(m), changeSource(createChangeSource()) {}
 };
 
-void serverManagementList(SocketStream& socket, std::atomic_bool& continua);
-
-#ifdef UNICODE
-
-#define splitpath _wsplitpath_s
-
-#else
-
-#define splitpath _splitpath_s
+void CommandsFromClient(SocketStream& s, ListHandler& listHandler);
+void serverManagementList(ConnectionManager& manager, std::atomic_bool& continua,
+	long minRefresh = MINREFRESHINTERVAL, long maxRefresh = MAXREFRESHINTERVAL, int metricsPort = METRICSPORT,
+	long cpuThreshold = CPUTHRESHOLD, long memoryThreshold = MEMORYTHRESHOLD);
 
-#endif
\ No newline at end of file
+/* Richiesta di terminazione del server con il codice indicato: definita dall'applicazione che ospita il server
+*  (l'applicazione nella tray area su Windows, oppure il server headless) */
+void requestShutdown(int code);
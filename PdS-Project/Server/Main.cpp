@@ -11,7 +11,10 @@
 #include <stdarg.h>
 
 /*
-* Server con 3 thread: uno per l'interfaccia, uno per l'invio della lista e l'altro per gestire i comandi
+* Server con 4 thread: uno per l'interfaccia, uno per l'invio della lista, uno (reactor) per gestire le connessioni e i comandi di tutti i client
+* ed uno per ricevere gli eventi di sistema (finestre e focus) che segnalano i cambiamenti della lista.
+* Questo file contiene solo l'applicazione nella tray area: il server vero e proprio (serverManagementList)  comune
+* con il server headless (vedi HeadlessMain.cpp).
 */
 
 /*
@@ -30,9 +33,16 @@ NOTIFYICONDATA NotifyIconData;
 TCHAR Advise[64] = TEXT("Server: In Esecuzione");
 TCHAR ClassName[] = TEXT("Server");
 TCHAR Message[] = TEXT("Il Server  eseguito in background.\n Per terminare l'esecuzione fare click sull'icona nella ToolBar Area");
+DWORD UiThreadId;		// thread dell'interfaccia, che riceve la richiesta di terminazione
 LRESULT CALLBACK WindowProc(HWND, UINT, WPARAM, LPARAM);
 int InitNotifyIconData();
 
+/* Terminazione richiesta dal server (ad esempio per un errore del reactor): il messaggio WM_QUIT con il codice
+*  viene inviato alla coda del thread dell'interfaccia, che esce dal ciclo dei messaggi */
+void requestShutdown(int code) {
+	PostThreadMessage(UiThreadId, WM_QUIT, (WPARAM) code, 0);
+}
+
 /*Parametri della WinMain:
 	* HINSTANCE hThisInstance:  l'handle all'istanza di applicazione, dove un'istanza di applicazione, non  altro che una singola esecuzione 
 	  della nostra applicazione (duale al concetto di oggetto e classe). Infatti, creare una applicazione  equivalente a creare un'istanza di essa
@@ -60,6 +70,7 @@ int WINAPI WinMain(HINSTANCE hThisInstance, HINSTANCE hPrevInstance, LPSTR lpszA
 	_setmode(_fileno(stdout), _O_U16TEXT); //per evitare problemi in wcout
 
 	MSG message;	//messaggio ricevuto dall'applicazione
+	UiThreadId = GetCurrentThreadId();
 	
 	/* Nella funzione WinMain bisogna creare una struttura della classe della finestra di tipo WNDCLASSEX.
 	* Questa struttura contiene informazioni sulla finestra, ad esempio l'icona dell'applicazione, il colore di sfondo della finestra,
@@ -134,10 +145,10 @@ int WINAPI WinMain(HINSTANCE hThisInstance, HINSTANCE hPrevInstance, LPSTR lpszA
 	
 	
 	try {
-		SocketStream socket(PORT);
+		ConnectionManager manager(PORT);
 
 		/* Creazione del thread che gestisce le funzionalit del Server */
-		std::thread ThreadManager(serverManagementList, std::ref(socket), std::ref(continua)); //thread che gestisce la funzione "serverManagementList" di ListHandler.cpp che si occupa della gestione della lista
+		std::thread ThreadManager(serverManagementList, std::ref(manager), std::ref(continua), MINREFRESHINTERVAL, MAXREFRESHINTERVAL, METRICSPORT); //thread che gestisce la funzione "serverManagementList" di ListHandler.cpp che si occupa della gestione della lista
 		
 		/* Loop per estrarre i messaggi dalla coda. Se non ci sono messaggi si blocca.
 		*  Termina il loop se riceve un messaggio di QUIT.
@@ -153,22 +164,12 @@ int WINAPI WinMain(HINSTANCE hThisInstance, HINSTANCE hPrevInstance, LPSTR lpszA
 
 		/* Usciti dal loop, sono concluse le operazioni da fare, quindi si chiude l'applicazione Server */
 
-		if (message.wParam == -10) {
-			continua = false;	//si imposta la variabile booleana a false cos nella funzione func gestita da otherthread si potr uscire dal while
-			ThreadManager.join();
-			throw socket_exception("Socket in secondary thread failed");
-		}
+		continua = false;	//si imposta la variabile booleana a false cos nella funzione func gestita da otherthread si potr uscire dal while
+		manager.stop();		//terminazione del reactor: le connessioni con i client vengono chiuse
+		ThreadManager.join();	//attendo che il thread finisca l'esecuzione
 
-		if (socket.getStatus() == true) {
-			socket.closeConnection();
-			socket.setStatus(false);
-			continua = false;	//si imposta la variabile booleana a false cos nella funzione func gestita da otherthread si potr uscire dal while
-								//attendo che il thread finisca l'esecuzione
-			ThreadManager.join();
-		}
-		else
-			//si permette al thread di operare indipendentemente dal thread principale
-			ThreadManager.detach();
+		if (message.wParam == -10)
+			throw socket_exception("Socket in secondary thread failed");
 	}
 	catch (socket_exception& e) {
 		MessageBox(Hwnd, TEXT("Errore del socket"), ClassName, MB_OK | MB_ICONERROR);
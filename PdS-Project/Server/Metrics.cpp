@@ -0,0 +1,147 @@
+#include "Metrics.hpp"
+#include "Compression.hpp"
+#include <sstream>
+
+void MetricSummary::record(unsigned long value) {
+	std::lock_guard<std::mutex> lock(mutex);
+	histogram.record(value);
+}
+
+/* Campioni di un istogramma come summary (quantili, somma e numero dei valori), con le etichette indicate (anche nessuna) */
+
+static void renderQuantiles(std::ostringstream& s, const char* name, const std::string& labels, const LatencyHistogram& histogram) {
+	std::string prefix = labels.empty() ? "{" : "{" + labels + ",";
+	std::string suffix = labels.empty() ? "" : "{" + labels + "}";
+	const double quantiles[] = { 0.5, 0.9, 0.99 };
+	for (double q : quantiles)
+		s << name << prefix << "quantile=\"" << q << "\"} " << histogram.percentile(q) << "\n";
+	s << name << "_sum" << suffix << " " << histogram.getSum() << "\n";
+	s << name << "_count" << suffix << " " << histogram.getCount() << "\n";
+}
+
+/* Esposizione come summary: quantili, somma e numero dei valori registrati, piu' il massimo come gauge separato */
+
+void MetricSummary::render(std::string& out, const char* name, const char* help) const {
+	std::lock_guard<std::mutex> lock(mutex);
+	std::ostringstream s;
+	s << "# HELP " << name << " " << help << "\n";
+	s << "# TYPE " << name << " summary\n";
+	renderQuantiles(s, name, "", histogram);
+	s << "# TYPE " << name << "_max gauge\n";
+	s << name << "_max " << histogram.getMax() << "\n";
+	out += s.str();
+}
+
+/* Istanza unica delle metriche */
+Metrics& Metrics::instance() {
+	static Metrics metrics;
+	return metrics;
+}
+
+/* Microsecondi trascorsi dall'istante start (limitati a 32 bit) */
+unsigned long Metrics::elapsedMicros(std::chrono::steady_clock::time_point start) {
+	long long micros = std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - start).count();
+	if (micros < 0)
+		return 0;
+	return micros > 0xFFFFFFFFLL ? 0xFFFFFFFFUL : (unsigned long) micros;
+}
+
+/*	Registrazione delle latenze dei comandi di una connessione (vedi SocketStream): restituisce il numero della connessione,
+*	usato come etichetta connection delle metriche fino alla sua rimozione.
+*/
+unsigned long long Metrics::addConnection(const CommandLatency* latency) {
+	std::lock_guard<std::mutex> lock(latenciesMutex);
+	latencies[++nextConnection] = latency;
+	return nextConnection;
+}
+
+void Metrics::removeConnection(unsigned long long connection) {
+	std::lock_guard<std::mutex> lock(latenciesMutex);
+	latencies.erase(connection);
+}
+
+/*	Latenze dei comandi di ogni connessione attiva che ne ha ricevuti, per fase (attesa, iniezione e totale), con l'etichetta
+*	connection. La connessione non puo' essere distrutta durante la lettura: la rimozione attende latenciesMutex.
+*/
+static void renderConnections(std::string& out, const std::map<unsigned long long, const CommandLatency*>& latencies) {
+	const char* names[] = { "pds_connection_command_queue_microseconds", "pds_connection_command_inject_microseconds",
+		"pds_connection_command_latency_microseconds" };
+	const char* helps[] = { "Ricezione -> decodifica dei comandi di input di una connessione",
+		"Decodifica -> fine dell'iniezione dei comandi di input di una connessione", "Latenza dei comandi di input di una connessione" };
+	std::ostringstream stages[3];
+	for (int i = 0; i < 3; i++) {
+		stages[i] << "# HELP " << names[i] << " " << helps[i] << "\n";
+		stages[i] << "# TYPE " << names[i] << " summary\n";
+	}
+
+	LatencyHistogram histograms[3];
+	for (const std::pair<const unsigned long long, const CommandLatency*>& c : latencies) {
+		c.second->snapshot(histograms[0], histograms[1], histograms[2]);
+		if (histograms[2].getCount() == 0)
+			continue;
+		std::string labels = "connection=\"" + std::to_string(c.first) + "\"";
+		for (int i = 0; i < 3; i++)
+			renderQuantiles(stages[i], names[i], labels, histograms[i]);
+	}
+	for (int i = 0; i < 3; i++)
+		out += stages[i].str();
+}
+
+/* Scrittura di un contatore o di un valore istantaneo (intero, o reale come la frequenza degli aggiornamenti) */
+template <typename T>
+static void renderValue(std::string& out, const char* name, const char* type, const char* help, T value) {
+	std::ostringstream s;
+	s << "# HELP " << name << " " << help << "\n";
+	s << "# TYPE " << name << " " << type << "\n";
+	s << name << " " << value << "\n";
+	out += s.str();
+}
+
+/* Tutte le metriche nel formato di esposizione testuale */
+std::string Metrics::render() const {
+	std::string out;
+	buildList.render(out, "pds_buildlist_duration_microseconds", "Durata dell'enumerazione delle applicazioni");
+	diff.render(out, "pds_diff_duration_microseconds", "Durata del confronto con la lista corrente");
+	changesPerTick.render(out, "pds_changes_per_tick", "Modifiche prodotte da ogni aggiornamento della lista");
+	renderValue(out, "pds_ticks_total", "counter", "Aggiornamenti della lista eseguiti", (long long) ticks.load());
+	renderValue(out, "pds_change_queue_depth", "gauge", "Modifiche in attesa di invio all'ultimo aggiornamento", changeQueue.load());
+	renderValue(out, "pds_refresh_rate", "gauge", "Aggiornamenti della lista al secondo", refreshRate.load());
+	renderValue(out, "pds_refresh_interval_ms", "gauge", "Intervallo corrente tra due aggiornamenti della lista", refreshInterval.load());
+	renderValue(out, "pds_change_log_size", "gauge", "Modifiche conservate per la ripresa dei client", changeLogSize.load());
+	renderValue(out, "pds_change_log_sequence", "gauge", "Sequenza dell'ultima modifica registrata", changeLogSequence.load());
+	renderValue(out, "pds_process_cache_hits_total", "counter", "Processi trovati nella cache", (long long) processCacheHits.load());
+	renderValue(out, "pds_process_cache_misses_total", "counter", "Processi letti perche' non in cache", (long long) processCacheMisses.load());
+	resourceSample.render(out, "pds_resource_sample_duration_microseconds", "Durata del campionamento dell'uso delle risorse");
+	renderValue(out, "pds_resource_changes_total", "counter", "Variazioni dell'uso delle risorse inviate ai client", (long long) resourceChanges.load());
+	sendBytes.render(out, "pds_send_bytes", "Byte accodati da ogni invio delle modifiche");
+	sendSyscalls.render(out, "pds_send_syscalls", "Chiamate di sistema di ogni passata di invio del reactor");
+	renderValue(out, "pds_sent_bytes_total", "counter", "Byte inviati o accodati dal reactor", (long long) bytesSent.load());
+	renderValue(out, "pds_compression_input_bytes_total", "counter", "Byte dei batch compressi prima della compressione", (long long) getCompressedInput());
+	renderValue(out, "pds_compression_output_bytes_total", "counter", "Byte dei batch compressi dopo la compressione", (long long) getCompressedOutput());
+	renderValue(out, "pds_pending_bytes", "gauge", "Byte in attesa di invio su tutte le connessioni", pendingBytes.load());
+	renderValue(out, "pds_queued_batches", "gauge", "Batch in coda per l'invio su tutte le connessioni", queuedBatches.load());
+	renderValue(out, "pds_send_queue_overflows_total", "counter", "Connessioni chiuse per coda di invio piena", (long long) queueOverflows.load());
+	renderValue(out, "pds_backlogged_clients", "gauge", "Client congestionati con modifiche fuse in attesa", backloggedClients.load());
+	renderValue(out, "pds_snapshot_fallbacks_total", "counter", "Liste complete inviate a client congestionati", (long long) snapshotFallbacks.load());
+	renderValue(out, "pds_resumes_total", "counter", "Client ripresi dal registro delle modifiche", (long long) resumes.load());
+	renderValue(out, "pds_resume_missed_changes_total", "counter", "Modifiche perse dai client ripresi", (long long) resumeMissedChanges.load());
+	renderValue(out, "pds_subscribed_clients", "gauge", "Client con una sottoscrizione", subscribedClients.load());
+	renderValue(out, "pds_filtered_changes_total", "counter", "Modifiche non inviate per le sottoscrizioni dei client", (long long) filteredChanges.load());
+	renderValue(out, "pds_connections", "gauge", "Client connessi", connections.load());
+	renderValue(out, "pds_accepted_connections_total", "counter", "Connessioni accettate", (long long) acceptedConnections.load());
+	renderValue(out, "pds_closed_connections_total", "counter", "Connessioni chiuse", (long long) closedConnections.load());
+	iconExtraction.render(out, "pds_icon_extraction_duration_microseconds", "Durata dell'estrazione di un'icona non in cache");
+	renderValue(out, "pds_icon_cache_hits_total", "counter", "Icone trovate nella cache", (long long) iconCacheHits.load());
+	renderValue(out, "pds_icon_cache_misses_total", "counter", "Icone non presenti nella cache", (long long) iconCacheMisses.load());
+	renderValue(out, "pds_icon_pending", "gauge", "Estrazioni di icone in coda o in corso", iconPending.load());
+	renderValue(out, "pds_icon_timeouts_total", "counter", "Estrazioni di icone scadute (icona di default)", (long long) iconTimeouts.load());
+	renderValue(out, "pds_icon_stuck_workers", "gauge", "Worker delle icone abbandonati perche' bloccati in un'estrazione", iconStuckWorkers.load());
+	commandLatency.render(out, "pds_command_latency_microseconds", "Latenza dei comandi di input sul server");
+	commandQueue.render(out, "pds_command_queue_microseconds", "Ricezione -> decodifica dei comandi di input");
+	commandInject.render(out, "pds_command_inject_microseconds", "Decodifica -> fine dell'iniezione dei comandi di input");
+	{
+		std::lock_guard<std::mutex> lock(latenciesMutex);
+		renderConnections(out, latencies);
+	}
+	return out;
+}
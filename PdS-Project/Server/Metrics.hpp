@@ -0,0 +1,85 @@
+#pragma once
+#include "LatencyHistogram.hpp"
+#include <atomic>
+#include <mutex>
+#include <string>
+#include <chrono>
+#include <map>
+
+
+/*	Distribuzione di una grandezza misurata nei percorsi critici del server (durate in microsecondi, dimensioni, conteggi).
+*	E' un istogramma protetto da un mutex: ogni grandezza viene registrata quasi sempre da un solo thread, per cui il lock
+*	non e' conteso e la registrazione costa poche decine di nanosecondi.
+*/
+
+class MetricSummary {
+	mutable std::mutex mutex;
+	LatencyHistogram histogram;
+
+public:
+	void record(unsigned long value);
+	void render(std::string& out, const char* name, const char* help) const;
+};
+
+/*	Metriche del server, uniche per tutto il processo (come IconCache).
+*	Contatori e valori istantanei sono atomici; le distribuzioni sono MetricSummary. Le metriche vengono esposte in formato
+*	testuale (formato di esposizione di Prometheus) dal MetricsServer, su una porta locale separata da quella dei client.
+*/
+
+class Metrics {
+	Metrics() {}
+
+	mutable std::mutex latenciesMutex;
+	std::map<unsigned long long, const CommandLatency*> latencies;	// latenze dei comandi delle connessioni attive, per numero
+	unsigned long long nextConnection = 0;							// numero della prossima connessione registrata
+
+public:
+	/* aggiornamento della lista (thread della lista) */
+	MetricSummary buildList;				// durata dell'enumerazione delle applicazioni (us)
+	MetricSummary diff;						// durata del confronto e dell'aggiornamento della lista (us)
+	MetricSummary changesPerTick;			// modifiche prodotte da ogni aggiornamento
+	std::atomic<unsigned long long> ticks{ 0 };
+	std::atomic<long long> changeQueue{ 0 };		// modifiche in attesa di invio all'ultimo aggiornamento
+	std::atomic<double> refreshRate{ 0 };			// aggiornamenti al secondo (vedi RefreshScheduler)
+	std::atomic<long long> refreshInterval{ 0 };	// intervallo corrente tra due aggiornamenti (ms)
+	std::atomic<long long> changeLogSize{ 0 };		// modifiche conservate per la ripresa dei client (vedi ChangeLog)
+	std::atomic<long long> changeLogSequence{ 0 };	// sequenza dell'ultima modifica registrata
+	std::atomic<unsigned long long> processCacheHits{ 0 };		// processi gia' noti trovati nella ProcessCache
+	std::atomic<unsigned long long> processCacheMisses{ 0 };	// processi letti di nuovo (nuovi o riutilizzo del pid)
+	MetricSummary resourceSample;			// durata del campionamento dell'uso delle risorse (us, vedi ResourceMonitor)
+	std::atomic<unsigned long long> resourceChanges{ 0 };	// modifiche res prodotte (variazioni oltre la soglia)
+
+	/* invio ai client */
+	MetricSummary sendBytes;				// byte accodati da ogni invio delle modifiche (tutti i client)
+	MetricSummary sendSyscalls;				// chiamate di sistema di ogni passata di invio dei batch in coda (reactor)
+	std::atomic<unsigned long long> bytesSent{ 0 };
+	std::atomic<long long> pendingBytes{ 0 };		// byte in attesa di invio su tutte le connessioni (reactor)
+	std::atomic<long long> queuedBatches{ 0 };		// batch accodati dal thread della lista e non ancora inviati dal reactor
+	std::atomic<unsigned long long> queueOverflows{ 0 };	// connessioni chiuse perche' la coda dei batch era piena
+	std::atomic<long long> backloggedClients{ 0 };	// client congestionati con modifiche fuse in attesa (vedi ChangeBacklog)
+	std::atomic<unsigned long long> snapshotFallbacks{ 0 };	// client congestionati a cui e' stata inviata di nuovo la lista completa
+	std::atomic<unsigned long long> resumes{ 0 };			// client ripresi dal ChangeLog invece di ricevere la lista completa
+	std::atomic<unsigned long long> resumeMissedChanges{ 0 };	// modifiche perse dai client ripresi (prima della fusione)
+	std::atomic<long long> subscribedClients{ 0 };	// client che ricevono solo una parte delle modifiche (vedi Subscription)
+	std::atomic<unsigned long long> filteredChanges{ 0 };	// modifiche non inviate ad un client perche' escluse dalla sua sottoscrizione
+	std::atomic<long long> connections{ 0 };
+	std::atomic<unsigned long long> acceptedConnections{ 0 };	// connessioni accettate e registrate dal reactor
+	std::atomic<unsigned long long> closedConnections{ 0 };		// connessioni chiuse (dal client, per errore o dal server)
+
+	/* icone e comandi */
+	MetricSummary iconExtraction;			// durata dell'estrazione di un'icona non in cache (us)
+	std::atomic<unsigned long long> iconCacheHits{ 0 };		// icone trovate nella IconCache
+	std::atomic<unsigned long long> iconCacheMisses{ 0 };	// icone non in cache (da estrarre o eseguibile non accessibile)
+	std::atomic<long long> iconPending{ 0 };		// estrazioni affidate ai worker e non ancora terminate (vedi IconCache)
+	std::atomic<unsigned long long> iconTimeouts{ 0 };	// estrazioni scadute: i client hanno ricevuto l'icona di default
+	std::atomic<long long> iconStuckWorkers{ 0 };	// worker abbandonati perche' bloccati in un'estrazione (vedi IconCache)
+	MetricSummary commandLatency;			// ricezione -> fine dell'iniezione dei comandi di input, tutti i client (us)
+	MetricSummary commandQueue;				// ricezione -> decodifica dei comandi di input, tutti i client (us)
+	MetricSummary commandInject;			// decodifica -> fine dell'iniezione dei comandi di input, tutti i client (us)
+
+	static Metrics& instance();
+	static unsigned long elapsedMicros(std::chrono::steady_clock::time_point start);
+	unsigned long long addConnection(const CommandLatency* latency);
+	void removeConnection(unsigned long long connection);
+	std::string render() const;
+};
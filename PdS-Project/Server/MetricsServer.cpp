@@ -0,0 +1,163 @@
+#include "MetricsServer.hpp"
+#include "Metrics.hpp"
+#include "SocketStream.hpp"
+#include <iostream>
+#include <vector>
+#include <system_error>
+
+/* Creazione del socket in ascolto (solo loopback, non bloccante) ed avvio del thread che serve le richieste */
+
+MetricsServer::MetricsServer(int port) : running(true) {
+	listenSocket = socket(AF_INET, SOCK_STREAM, IPPROTO_TCP);
+	if (listenSocket == INVALID_SOCKET)
+		throw socket_exception("Costruzione del socket delle metriche fallita!");
+
+#ifndef _WIN32
+	int reuse = 1;
+	setsockopt(listenSocket, SOL_SOCKET, SO_REUSEADDR, (const char*) &reuse, sizeof(reuse));
+#endif
+
+	struct sockaddr_in addr;
+	ZeroMemory(&addr, sizeof(addr));
+	addr.sin_family = AF_INET;
+	addr.sin_port = htons(port);
+	addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);		// le metriche sono visibili solo dalla macchina del server
+
+	u_long nonBlocking = 1;
+	if (bind(listenSocket, (struct sockaddr*) &addr, sizeof(addr)) != 0 || listen(listenSocket, SOMAXCONN) == SOCKET_ERROR ||
+		ioctlsocket(listenSocket, FIONBIO, &nonBlocking) == SOCKET_ERROR) {
+		closesocket(listenSocket);
+		throw socket_exception("Ascolto sulla porta delle metriche fallito");
+	}
+
+	poller.add(listenSocket, POLLER_READ);
+	try {
+		thread = std::thread(&MetricsServer::run, this);
+	}
+	catch (std::system_error&) {
+		closesocket(listenSocket);
+		throw;
+	}
+}
+
+/* Terminazione del thread e chiusura di tutti i socket */
+MetricsServer::~MetricsServer() {
+	running = false;
+	if (thread.joinable())
+		thread.join();
+	for (auto& r : requests)
+		closesocket(r.first);
+	closesocket(listenSocket);
+}
+
+/* Ciclo del thread delle metriche: nuove connessioni, richieste in arrivo e chiusura delle connessioni scadute */
+
+void MetricsServer::run() {
+	std::vector<PollEvent> ready;
+
+	while (running) {
+		poller.wait(ready, METRICSPOLL);
+
+		for (PollEvent& e : ready) {
+			if (e.fd == listenSocket)
+				acceptConnections();
+			else if (requests.count(e.fd) != 0) {
+				if (requests[e.fd].response.empty())
+					readRequest(e.fd);
+				else
+					writeResponse(e.fd);
+			}
+		}
+
+		std::chrono::steady_clock::time_point now = std::chrono::steady_clock::now();
+		std::vector<SOCKET> expired;
+		for (auto& r : requests)
+			if (r.second.deadline <= now)
+				expired.push_back(r.first);
+		for (SOCKET s : expired)
+			closeRequest(s);
+	}
+}
+
+void MetricsServer::acceptConnections() {
+	while (true) {
+		SOCKET s = accept(listenSocket, NULL, NULL);
+		if (s == INVALID_SOCKET)
+			return;					// coda vuota (o errore temporaneo: la prossima attesa lo ripresenta)
+
+		u_long nonBlocking = 1;
+		if (ioctlsocket(s, FIONBIO, &nonBlocking) == SOCKET_ERROR) {
+			closesocket(s);
+			continue;
+		}
+		requests[s].deadline = std::chrono::steady_clock::now() + std::chrono::milliseconds(METRICSTIMEOUT);
+		poller.add(s, POLLER_READ);
+	}
+}
+
+/*	Lettura della richiesta: si risponde quando sono arrivate tutte le intestazioni (riga vuota) o il client ha chiuso
+*	in scrittura. La richiesta viene letta per intero prima di rispondere, altrimenti la chiusura del socket con dati
+*	non letti interromperebbe la connessione prima che il client riceva la risposta.
+*/
+
+void MetricsServer::readRequest(SOCKET s) {
+	Request& r = requests[s];
+	char buffer[1024];
+
+	while (true) {
+		int n = recv(s, buffer, sizeof(buffer), 0);
+		if (n == 0)
+			break;					// il client ha terminato la richiesta
+		if (n == SOCKET_ERROR) {
+			if (WSAGetLastError() == WSAEWOULDBLOCK)
+				return;				// richiesta non ancora completa
+			closeRequest(s);
+			return;
+		}
+		r.data.append(buffer, n);
+		if (r.data.find("\r\n\r\n") != std::string::npos || r.data.find("\n\n") != std::string::npos)
+			break;
+		if (r.data.size() > METRICSREQUEST) {
+			closeRequest(s);
+			return;
+		}
+	}
+	respond(s);
+}
+
+/*	Preparazione della risposta con tutte le metriche. Il socket resta non bloccante: quello che non viene inviato subito
+*	viene completato quando il socket torna scrivibile, per cui un client che non legge non blocca il thread delle metriche
+*	(la connessione viene chiusa alla scadenza, come per le richieste incomplete).
+*/
+
+void MetricsServer::respond(SOCKET s) {
+	std::string body = Metrics::instance().render();
+	Request& r = requests[s];
+	r.response = "HTTP/1.0 200 OK\r\nContent-Type: text/plain; version=0.0.4\r\nContent-Length: " +
+		std::to_string(body.size()) + "\r\nConnection: close\r\n\r\n" + body;
+	r.deadline = std::chrono::steady_clock::now() + std::chrono::milliseconds(METRICSTIMEOUT);
+	poller.modify(s, POLLER_WRITE);
+	writeResponse(s);
+}
+
+/* Invio di quanto possibile della risposta: la connessione viene chiusa quando e' stata inviata per intero o in caso di errore */
+
+void MetricsServer::writeResponse(SOCKET s) {
+	Request& r = requests[s];
+	while (r.sent < r.response.size()) {
+		int n = send(s, r.response.data() + r.sent, (int) (r.response.size() - r.sent), MSG_NOSIGNAL);
+		if (n == SOCKET_ERROR) {
+			if (WSAGetLastError() == WSAEWOULDBLOCK)
+				return;				// buffer di invio pieno: si riprende quando il socket torna scrivibile
+			break;
+		}
+		r.sent += n;
+	}
+	closeRequest(s);
+}
+
+void MetricsServer::closeRequest(SOCKET s) {
+	poller.remove(s);
+	requests.erase(s);
+	closesocket(s);
+}
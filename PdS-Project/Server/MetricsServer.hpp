@@ -0,0 +1,48 @@
+#pragma once
+#include "Platform.hpp"
+#include "Poller.hpp"
+#include <atomic>
+#include <thread>
+#include <map>
+#include <string>
+#include <chrono>
+
+
+#define METRICSPORT 2001					// porta locale delle metriche (0: metriche non esposte)
+#define METRICSPOLL 500						// timeout (ms) dell'attesa, per controllare la terminazione
+#define METRICSTIMEOUT 5000					// tempo massimo (ms) per ricevere la richiesta e per inviare la risposta
+#define METRICSREQUEST 4096					// dimensione massima della richiesta
+
+/*	Esposizione delle metriche del server (vedi Metrics.hpp) su una porta separata, in ascolto solo su loopback.
+*	Ad ogni connessione risponde con una risposta HTTP/1.0 che contiene tutte le metriche in formato testuale, per cui
+*	si possono leggere con curl o raccogliere con Prometheus. Ha un proprio thread, con un proprio Poller:
+*	le richieste degli operatori non rallentano il reactor dei client.
+*/
+
+class MetricsServer {
+	struct Request {
+		std::string data;
+		std::string response;				// risposta in invio (vuota finche' la richiesta non e' completa)
+		size_t sent = 0;					// byte della risposta gia' inviati
+		std::chrono::steady_clock::time_point deadline;
+	};
+
+	SOCKET listenSocket;
+	Poller poller;
+	std::map<SOCKET, Request> requests;		// connessioni di cui non e' ancora stata inviata la risposta completa
+	std::atomic_bool running;
+	std::thread thread;
+
+	void run();
+	void acceptConnections();
+	void readRequest(SOCKET s);
+	void respond(SOCKET s);
+	void writeResponse(SOCKET s);
+	void closeRequest(SOCKET s);
+
+public:
+	MetricsServer(int port);
+	~MetricsServer();
+	MetricsServer(const MetricsServer&) = delete;
+	MetricsServer& operator=(const MetricsServer&) = delete;
+};
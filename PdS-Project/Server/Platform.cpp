@@ -0,0 +1,78 @@
+#include "Platform.hpp"
+
+#ifndef _WIN32
+
+/*	Su Linux i percorsi sono sequenze di byte, normalmente in UTF-8, mentre il server memorizza i nomi come std::wstring
+*	(UTF-32 su Linux). Le sequenze non valide vengono sostituite con U+FFFD.
+*/
+
+std::wstring fromUtf8(const char* text, size_t len) {
+	std::wstring res;
+	res.reserve(len);
+	const unsigned char* p = (const unsigned char*) text;
+	const unsigned char* end = p + len;
+
+	while (p < end) {
+		unsigned long c = *p++;
+		int extra = 0;
+		if (c < 0x80) {
+			res.push_back((wchar_t) c);
+			continue;
+		}
+		if (c < 0xC0 || c >= 0xF8) {
+			res.push_back(L'\xFFFD');
+			continue;
+		}
+		if (c >= 0xF0) { c &= 0x07; extra = 3; }
+		else if (c >= 0xE0) { c &= 0x0F; extra = 2; }
+		else { c &= 0x1F; extra = 1; }
+
+		if (end - p < extra) {
+			res.push_back(L'\xFFFD');
+			break;
+		}
+		bool valid = true;
+		for (int i = 0; i < extra; i++) {
+			if ((p[i] & 0xC0) != 0x80) {
+				valid = false;
+				break;
+			}
+			c = (c << 6) | (p[i] & 0x3F);
+		}
+		if (!valid) {
+			res.push_back(L'\xFFFD');
+			continue;
+		}
+		p += extra;
+		res.push_back((wchar_t) c);
+	}
+	return res;
+}
+
+std::string toUtf8(const std::wstring& text) {
+	std::string res;
+	res.reserve(text.size());
+	for (wchar_t w : text) {
+		unsigned long c = (unsigned long) w;
+		if (c < 0x80)
+			res.push_back((char) c);
+		else if (c < 0x800) {
+			res.push_back((char) (0xC0 | (c >> 6)));
+			res.push_back((char) (0x80 | (c & 0x3F)));
+		}
+		else if (c < 0x10000) {
+			res.push_back((char) (0xE0 | (c >> 12)));
+			res.push_back((char) (0x80 | ((c >> 6) & 0x3F)));
+			res.push_back((char) (0x80 | (c & 0x3F)));
+		}
+		else {
+			res.push_back((char) (0xF0 | (c >> 18)));
+			res.push_back((char) (0x80 | ((c >> 12) & 0x3F)));
+			res.push_back((char) (0x80 | ((c >> 6) & 0x3F)));
+			res.push_back((char) (0x80 | (c & 0x3F)));
+		}
+	}
+	return res;
+}
+
+#endif
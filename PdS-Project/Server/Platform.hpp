@@ -0,0 +1,55 @@
+#pragma once
+
+/*	Tipi e funzioni di sistema usati dal nucleo del server (lista, modifiche, socket e reactor).
+*	Su Windows sono quelli di Winsock e di <Windows.h>; su Linux vengono definiti qui con lo stesso nome,
+*	in modo che il codice comune non dipenda dalla piattaforma. Le parti che non hanno un equivalente
+*	(enumerazione delle finestre, input da tastiera, icone) sono in Desktop.cpp, IconCache.cpp e ProcessCache.cpp.
+*/
+
+#ifdef _WIN32
+
+#include <winsock2.h>
+#include <ws2tcpip.h>
+#include <Windows.h>
+
+#ifndef MSG_NOSIGNAL
+#define MSG_NOSIGNAL 0						// su Windows la send non genera segnali
+#endif
+
+#else
+
+#include <sys/types.h>
+#include <sys/socket.h>
+#include <sys/ioctl.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <arpa/inet.h>
+#include <unistd.h>
+#include <cerrno>
+#include <cstdint>
+#include <cstring>
+#include <string>
+
+typedef uint32_t DWORD;						// i campi del protocollo hanno la dimensione dei tipi Windows
+typedef DWORD* PDWORD;
+typedef unsigned long long ULONGLONG;
+typedef int SOCKET;
+
+#define INVALID_SOCKET (-1)
+#define SOCKET_ERROR (-1)
+#define WSAEWOULDBLOCK EWOULDBLOCK
+
+#define ZeroMemory(p, n) memset((p), 0, (n))
+#define closesocket(s) close(s)
+#define WSAGetLastError() (errno)
+
+inline int ioctlsocket(SOCKET s, long cmd, u_long* arg) {
+	int value = (int) *arg;
+	return ioctl(s, cmd, &value);
+}
+
+/* Conversione tra i percorsi del file system (UTF-8) e le stringhe del server */
+std::wstring fromUtf8(const char* text, size_t len);
+std::string toUtf8(const std::wstring& text);
+
+#endif
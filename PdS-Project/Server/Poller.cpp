@@ -0,0 +1,158 @@
+#include "Poller.hpp"
+#include "SocketStream.hpp"
+
+#ifndef _WIN32
+#include <unistd.h>
+#include <cerrno>
+#include <cstdint>
+#endif
+
+#define MAXEVENTS 256
+
+#ifdef _WIN32
+
+/*	Implementazione Windows: WSAPoll riceve ad ogni chiamata l'intero vettore dei descrittori.
+*	Per ogni socket si memorizza la sua posizione nel vettore, in modo da poter modificare o rimuovere un socket senza scansionarlo.
+*/
+
+Poller::Poller() {}
+
+Poller::~Poller() {}
+
+/* Conversione dagli eventi del Poller a quelli di WSAPoll */
+static SHORT toPollEvents(int events) {
+	SHORT res = 0;
+	if (events & POLLER_READ)
+		res |= POLLRDNORM;
+	if (events & POLLER_WRITE)
+		res |= POLLWRNORM;
+	return res;
+}
+
+void Poller::add(socket_t fd, int events) {
+	WSAPOLLFD pfd;
+	pfd.fd = fd;
+	pfd.events = toPollEvents(events);
+	pfd.revents = 0;
+	positions[fd] = fds.size();
+	fds.push_back(pfd);
+}
+
+void Poller::modify(socket_t fd, int events) {
+	std::map<socket_t, size_t>::iterator i = positions.find(fd);
+	if (i != positions.end())
+		fds[i->second].events = toPollEvents(events);
+}
+
+/* La rimozione sposta l'ultimo elemento nella posizione liberata (l'ordine dei descrittori non e' rilevante) */
+void Poller::remove(socket_t fd) {
+	std::map<socket_t, size_t>::iterator i = positions.find(fd);
+	if (i == positions.end())
+		return;
+	size_t pos = i->second;
+	positions.erase(i);
+	if (pos != fds.size() - 1) {
+		fds[pos] = fds.back();
+		positions[fds[pos].fd] = pos;
+	}
+	fds.pop_back();
+}
+
+/* Attende al piu' timeout millisecondi e riempie ready con i socket che hanno eventi pendenti */
+int Poller::wait(std::vector<PollEvent>& ready, int timeout) {
+	ready.clear();
+	if (fds.empty())
+		return 0;
+
+	int res = WSAPoll(fds.data(), (ULONG) fds.size(), timeout);
+	if (res == SOCKET_ERROR)
+		throw socket_exception("WSAPoll fallita");
+
+	for (size_t i = 0; i < fds.size() && (int) ready.size() < res; i++) {
+		if (fds[i].revents == 0)
+			continue;
+		PollEvent e;
+		e.fd = fds[i].fd;
+		e.events = 0;
+		if (fds[i].revents & (POLLRDNORM | POLLHUP))
+			e.events |= POLLER_READ;
+		if (fds[i].revents & POLLWRNORM)
+			e.events |= POLLER_WRITE;
+		if (fds[i].revents & (POLLERR | POLLNVAL))
+			e.events |= POLLER_ERROR;
+		ready.push_back(e);
+	}
+	return (int) ready.size();
+}
+
+#else
+
+/*	Implementazione Linux: i descrittori vengono registrati una sola volta nell'istanza epoll,
+*	e epoll_wait restituisce solo quelli pronti (costo indipendente dal numero di connessioni).
+*/
+
+Poller::Poller() : events(MAXEVENTS) {
+	epollFd = epoll_create1(EPOLL_CLOEXEC);
+	if (epollFd < 0)
+		throw socket_exception("Creazione dell'istanza epoll fallita");
+}
+
+Poller::~Poller() {
+	close(epollFd);
+}
+
+/* Conversione dagli eventi del Poller a quelli di epoll */
+static uint32_t toEpollEvents(int events) {
+	uint32_t res = 0;
+	if (events & POLLER_READ)
+		res |= EPOLLIN | EPOLLRDHUP;
+	if (events & POLLER_WRITE)
+		res |= EPOLLOUT;
+	return res;
+}
+
+void Poller::add(socket_t fd, int events) {
+	struct epoll_event e;
+	e.events = toEpollEvents(events);
+	e.data.fd = fd;
+	if (epoll_ctl(epollFd, EPOLL_CTL_ADD, fd, &e) != 0)
+		throw socket_exception("Registrazione del socket in epoll fallita");
+}
+
+void Poller::modify(socket_t fd, int events) {
+	struct epoll_event e;
+	e.events = toEpollEvents(events);
+	e.data.fd = fd;
+	epoll_ctl(epollFd, EPOLL_CTL_MOD, fd, &e);
+}
+
+void Poller::remove(socket_t fd) {
+	epoll_ctl(epollFd, EPOLL_CTL_DEL, fd, NULL);
+}
+
+/* Attende al piu' timeout millisecondi e riempie ready con i socket che hanno eventi pendenti */
+int Poller::wait(std::vector<PollEvent>& ready, int timeout) {
+	ready.clear();
+	int res = epoll_wait(epollFd, events.data(), (int) events.size(), timeout);
+	if (res < 0) {
+		if (errno == EINTR)
+			return 0;
+		throw socket_exception("epoll_wait fallita");
+	}
+
+	for (int i = 0; i < res; i++) {
+		PollEvent e;
+		e.fd = events[i].data.fd;
+		e.events = 0;
+		if (events[i].events & (EPOLLIN | EPOLLRDHUP | EPOLLHUP))
+			e.events |= POLLER_READ;
+		if (events[i].events & EPOLLOUT)
+			e.events |= POLLER_WRITE;
+		if (events[i].events & EPOLLERR)
+			e.events |= POLLER_ERROR;
+		ready.push_back(e);
+	}
+	return res;
+}
+
+#endif
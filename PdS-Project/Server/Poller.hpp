@@ -0,0 +1,47 @@
+#pragma once
+
+#include <vector>
+#include <map>
+
+#ifdef _WIN32
+#include <winsock2.h>
+typedef SOCKET socket_t;
+#else
+#include <sys/epoll.h>
+typedef int socket_t;
+#endif
+
+/* Eventi di I/O che possono essere richiesti al Poller (combinabili in OR) */
+#define POLLER_READ 1
+#define POLLER_WRITE 2
+#define POLLER_ERROR 4
+
+/* Evento restituito dal Poller: socket pronto e tipo di eventi verificati */
+struct PollEvent {
+	socket_t fd;
+	int events;
+};
+
+/*	Classe che incapsula il meccanismo di notifica degli eventi sui socket usato dal reactor.
+*	L'interfaccia e' la stessa su tutte le piattaforme: su Windows viene usata WSAPoll, su Linux epoll.
+*	Non e' thread-safe: deve essere usata solo dal thread che esegue il ciclo degli eventi.
+*/
+
+class Poller {
+private:
+#ifdef _WIN32
+	std::vector<WSAPOLLFD> fds;				// descrittori passati a WSAPoll
+	std::map<socket_t, size_t> positions;	// posizione di ogni socket dentro fds
+#else
+	int epollFd;							// istanza epoll
+	std::vector<struct epoll_event> events;	// eventi restituiti da epoll_wait
+#endif
+
+public:
+	Poller();
+	~Poller();
+	void add(socket_t fd, int events);
+	void modify(socket_t fd, int events);
+	void remove(socket_t fd);
+	int wait(std::vector<PollEvent>& ready, int timeout);
+};
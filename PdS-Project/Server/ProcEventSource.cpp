@@ -0,0 +1,140 @@
+#include "ProcEventSource.hpp"
+#include <sys/socket.h>
+#include <linux/netlink.h>
+#include <linux/connector.h>
+#include <linux/cn_proc.h>
+#include <poll.h>
+#include <unistd.h>
+#include <cstring>
+#include <iostream>
+
+#define RECVSIZE 4096
+
+std::unique_ptr<ChangeSource> createChangeSource() {
+	return std::unique_ptr<ChangeSource>(new ProcEventSource());
+}
+
+ProcEventSource::~ProcEventSource() {
+	stop();
+}
+
+/* Avvio del thread degli eventi: se la sottoscrizione fallisce il thread non viene avviato */
+void ProcEventSource::start(std::function<void()> callback) {
+	if (eventThread.joinable())
+		return;
+	onChange = callback;
+
+	if (pipe(stopPipe) != 0) {
+		stopPipe[0] = stopPipe[1] = -1;
+		std::wcerr << "Creazione della pipe di terminazione fallita: aggiornamento solo periodico" << std::endl;
+		return;
+	}
+	if (!subscribe()) {
+		std::wcerr << "Sottoscrizione agli eventi dei processi fallita: aggiornamento solo periodico" << std::endl;
+		stop();
+		return;
+	}
+	eventThread = std::thread(&ProcEventSource::eventLoop, this);
+}
+
+/* Terminazione del thread degli eventi (tramite la pipe) ed attesa della sua fine */
+void ProcEventSource::stop() {
+	if (eventThread.joinable()) {
+		char c = 0;
+		if (write(stopPipe[1], &c, 1) == 1)
+			eventThread.join();
+		else
+			eventThread.detach();
+	}
+	if (netlinkSocket >= 0)
+		close(netlinkSocket);
+	if (stopPipe[0] >= 0)
+		close(stopPipe[0]);
+	if (stopPipe[1] >= 0)
+		close(stopPipe[1]);
+	netlinkSocket = stopPipe[0] = stopPipe[1] = -1;
+}
+
+/*	Creazione del socket netlink e richiesta al kernel di inviare gli eventi dei processi (PROC_CN_MCAST_LISTEN).
+*	Il messaggio di controllo e' composto da intestazione netlink, intestazione del connector e comando.
+*/
+
+bool ProcEventSource::subscribe() {
+	netlinkSocket = socket(PF_NETLINK, SOCK_DGRAM | SOCK_CLOEXEC, NETLINK_CONNECTOR);
+	if (netlinkSocket < 0)
+		return false;
+
+	struct sockaddr_nl address;
+	memset(&address, 0, sizeof(address));
+	address.nl_family = AF_NETLINK;
+	address.nl_groups = CN_IDX_PROC;
+	address.nl_pid = 0;						// indirizzo assegnato dal kernel
+	if (bind(netlinkSocket, (struct sockaddr*) &address, sizeof(address)) != 0)
+		return false;
+
+	char request[NLMSG_SPACE(sizeof(struct cn_msg) + sizeof(enum proc_cn_mcast_op))] __attribute__((aligned(NLMSG_ALIGNTO)));
+	memset(request, 0, sizeof(request));
+
+	struct nlmsghdr* header = (struct nlmsghdr*) request;
+	header->nlmsg_len = NLMSG_LENGTH(sizeof(struct cn_msg) + sizeof(enum proc_cn_mcast_op));
+	header->nlmsg_type = NLMSG_DONE;
+	header->nlmsg_pid = getpid();
+
+	struct cn_msg* message = (struct cn_msg*) NLMSG_DATA(header);
+	message->id.idx = CN_IDX_PROC;
+	message->id.val = CN_VAL_PROC;
+	message->len = sizeof(enum proc_cn_mcast_op);
+	*(enum proc_cn_mcast_op*) message->data = PROC_CN_MCAST_LISTEN;
+
+	return send(netlinkSocket, header, header->nlmsg_len, 0) == (ssize_t) header->nlmsg_len;
+}
+
+/*	Corpo del thread degli eventi: attesa delle notifiche del kernel (o della richiesta di terminazione).
+*	Un messaggio puo' contenere piu' notifiche: si segnala un solo cambiamento per messaggio, il ListHandler
+*	raggruppa comunque gli eventi ravvicinati.
+*/
+
+void ProcEventSource::eventLoop() {
+	char buffer[RECVSIZE] __attribute__((aligned(NLMSG_ALIGNTO)));
+	struct pollfd fds[2];
+	fds[0].fd = netlinkSocket;
+	fds[0].events = POLLIN;
+	fds[1].fd = stopPipe[0];
+	fds[1].events = POLLIN;
+
+	while (true) {
+		if (poll(fds, 2, -1) < 0) {
+			if (errno == EINTR)
+				continue;
+			return;
+		}
+		if (fds[1].revents != 0)
+			return;
+		if (fds[0].revents == 0)
+			continue;
+
+		ssize_t len = recv(netlinkSocket, buffer, sizeof(buffer), 0);
+		if (len <= 0) {
+			// eventi persi (buffer del socket pieno): si forza un ricalcolo della lista
+			if (len < 0 && errno == ENOBUFS) {
+				onChange();
+				continue;
+			}
+			return;
+		}
+
+		bool changed = false;
+		for (struct nlmsghdr* header = (struct nlmsghdr*) buffer; NLMSG_OK(header, (unsigned) len); header = NLMSG_NEXT(header, len)) {
+			if (header->nlmsg_type == NLMSG_ERROR || header->nlmsg_type == NLMSG_NOOP)
+				continue;
+			struct cn_msg* message = (struct cn_msg*) NLMSG_DATA(header);
+			if (message->id.idx != CN_IDX_PROC || message->id.val != CN_VAL_PROC)
+				continue;
+			struct proc_event* event = (struct proc_event*) message->data;
+			if (event->what == proc_event::PROC_EVENT_FORK || event->what == proc_event::PROC_EVENT_EXEC || event->what == proc_event::PROC_EVENT_EXIT)
+				changed = true;
+		}
+		if (changed)
+			onChange();
+	}
+}
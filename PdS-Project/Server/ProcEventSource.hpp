@@ -0,0 +1,26 @@
+#pragma once
+#include "ChangeSource.hpp"
+#include <thread>
+
+
+/*	Sorgente di eventi Linux basata sul process connector del kernel (socket netlink NETLINK_CONNECTOR).
+*	Il kernel notifica la creazione (fork), il cambio di eseguibile (exec) e la terminazione (exit) di ogni processo:
+*	un thread dedicato riceve le notifiche e le segnala al ListHandler.
+*	La sottoscrizione richiede il privilegio CAP_NET_ADMIN: senza di esso la lista viene aggiornata solo dalla riconciliazione periodica.
+*/
+
+class ProcEventSource : public ChangeSource {
+	std::thread eventThread;
+	int netlinkSocket = -1;
+	int stopPipe[2] = { -1, -1 };			// la scrittura su stopPipe[1] interrompe l'attesa del thread
+	std::function<void()> onChange;
+
+	bool subscribe();
+	void eventLoop();
+
+public:
+	ProcEventSource() {}
+	~ProcEventSource();
+	void start(std::function<void()> onChange) override;
+	void stop() override;
+};
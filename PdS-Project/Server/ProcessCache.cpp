@@ -0,0 +1,249 @@
+#include "ProcessCache.hpp"
+#include "Metrics.hpp"
+#include <cwchar>
+#include <vector>
+#include <algorithm>
+
+#ifdef _WIN32
+
+/* Processo aperto con OpenProcess: l'handle viene chiuso dal distruttore */
+class ProcessHandle {
+	HANDLE process;
+
+public:
+	ProcessHandle(DWORD pid) {
+		/* Si vuole ottenere l'handle del processo tramite il pID ottenuto, ottenendo i giusti permessi per poter ottenere le informazioni sul nome */
+		process = OpenProcess(PROCESS_QUERY_INFORMATION | PROCESS_VM_READ, FALSE, pid);
+	}
+
+	~ProcessHandle() {
+		if (process != NULL)
+			CloseHandle(process);
+	}
+
+	bool isOpen() const {
+		return process != NULL;
+	}
+
+	/* l'istante di creazione distingue il processo attuale da un processo terminato che aveva lo stesso pid */
+	bool getCreationTime(ULONGLONG& time) {
+		FILETIME creation, exit, kernel, user;
+		if (!GetProcessTimes(process, &creation, &exit, &kernel, &user))
+			return false;
+		time = (ULONGLONG(creation.dwHighDateTime) << 32) | creation.dwLowDateTime;
+		return true;
+	}
+
+	/* la funzione QueryFullProcessImageName prende l'handle del process, e estrae il path del processo, salvandolo in file_name, riuscendoci grazie ai "diritti" definiti con OpenProcess */
+	bool getImagePath(wchar_t* file_name, DWORD size) {
+		return QueryFullProcessImageName(process, 0, file_name, &size) != 0;
+	}
+};
+
+#define SEPARATOR L'\\'
+
+#else
+
+#include <cstdio>
+#include <climits>
+
+/*	Processo letto da /proc: lo starttime (campo 22 di /proc/<pid>/stat, in tick dall'avvio del sistema)
+*	ha lo stesso ruolo dell'istante di creazione su Windows.
+*/
+class ProcessHandle {
+	DWORD pid;
+	bool open = false;
+	ULONGLONG startTime = 0;
+
+public:
+	ProcessHandle(DWORD id) : pid(id) {
+		char path[64];
+		char stat[1024];
+		snprintf(path, sizeof(path), "/proc/%u/stat", (unsigned) pid);
+		FILE* f = fopen(path, "r");
+		if (f == NULL)
+			return;
+		size_t len = fread(stat, 1, sizeof(stat) - 1, f);
+		fclose(f);
+		stat[len] = '\0';
+
+		/* il nome del processo (campo 2) e' tra parentesi e puo' contenere spazi: si riparte dall'ultima parentesi chiusa */
+		char* p = strrchr(stat, ')');
+		if (p == NULL)
+			return;
+		/* campi dal 3 (stato) in poi: lo starttime e' il ventesimo dopo la parentesi */
+		for (int field = 3; field < 22 && p != NULL; field++)
+			p = strchr(p + 1, ' ');
+		if (p == NULL)
+			return;
+		startTime = strtoull(p + 1, NULL, 10);
+		open = true;
+	}
+
+	bool isOpen() const {
+		return open;
+	}
+
+	bool getCreationTime(ULONGLONG& time) {
+		time = startTime;
+		return open;
+	}
+
+	/* il percorso dell'eseguibile e' la destinazione del collegamento /proc/<pid>/exe (non leggibile per i thread del kernel) */
+	bool getImagePath(wchar_t* file_name, DWORD size) {
+		char path[64];
+		char target[PATH_MAX];
+		snprintf(path, sizeof(path), "/proc/%u/exe", (unsigned) pid);
+		ssize_t len = readlink(path, target, sizeof(target));
+		if (len <= 0 || len == (ssize_t) sizeof(target))
+			return false;
+		std::wstring wide = fromUtf8(target, len);
+		if (wide.size() >= size)
+			return false;
+		wcscpy(file_name, wide.c_str());
+		return true;
+	}
+};
+
+#define SEPARATOR L'/'
+
+#endif
+
+/*
+Restituisce la copia condivisa del testo: se il testo e' gia' presente non viene allocato nulla
+(la ricerca avviene direttamente sul puntatore, senza costruire una std::wstring).
+*/
+
+InternedString StringPool::intern(const wchar_t* text) {
+	std::map<std::wstring, std::weak_ptr<const std::wstring>, std::less<>>::iterator i = strings.find(text);
+	if (i != strings.end()) {
+		InternedString s = i->second.lock();
+		if (s)
+			return s;
+		strings.erase(i);
+	}
+
+	InternedString s = std::make_shared<const std::wstring>(text);
+	strings.emplace(*s, s);
+	return s;
+}
+
+/* Rimozione delle stringhe non piu' usate da nessuna voce */
+void StringPool::purge() {
+	for (std::map<std::wstring, std::weak_ptr<const std::wstring>, std::less<>>::iterator i = strings.begin(); i != strings.end();) {
+		if (i->second.expired())
+			i = strings.erase(i);
+		else
+			++i;
+	}
+}
+
+size_t StringPool::size() const {
+	return strings.size();
+}
+
+ProcessCache& ProcessCache::instance() {
+	static ProcessCache cache;
+	return cache;
+}
+
+/*
+Informazioni di un processo visibile: se il pid e' in cache e l'istante di creazione coincide non si legge nulla,
+altrimenti (processo nuovo o pid riusato) si legge il percorso dell'eseguibile.
+Restituisce false se non e' possibile accedere al processo: in quel caso l'applicazione non viene inviata ai client.
+*/
+
+bool ProcessCache::resolve(DWORD pid, ApplicationItem& app) {
+	ProcessHandle process(pid);
+	ULONGLONG creationTime;
+	if (!process.isOpen() || !process.getCreationTime(creationTime))
+		return false;
+
+	std::lock_guard<std::mutex> lock(cacheMutex);
+
+	std::unordered_map<DWORD, Entry>::iterator i = entries.find(pid);
+	if (i != entries.end() && i->second.creationTime == creationTime) {
+		hits++;
+		Metrics::instance().processCacheHits++;
+		i->second.lastUse = ++useCounter;
+		app = i->second.app;
+		return i->second.valid;
+	}
+
+	misses++;
+	Metrics::instance().processCacheMisses++;
+	Entry e;
+	e.creationTime = creationTime;
+	e.valid = readProcess(process, e.app);
+	e.lastUse = ++useCounter;
+
+	if (i != entries.end())
+		i->second = e;					// pid riusato da un nuovo processo
+	else {
+		if (entries.size() >= PROCESSCACHESIZE)
+			evict();
+		entries.emplace(pid, e);
+	}
+
+	app = e.app;
+	return e.valid;
+}
+
+/*
+Lettura del percorso completo dell'eseguibile e del nome (nome file + estensione, cioe' l'ultima parte del percorso).
+Il buffer e' sullo stack: l'unica allocazione e' quella delle stringhe internate, se non erano gia' presenti.
+*/
+
+bool ProcessCache::readProcess(ProcessHandle& process, ApplicationItem& app) {
+	wchar_t file_name[MAXPATH];
+	if (!process.getImagePath(file_name, MAXPATH))
+		return false;
+
+	const wchar_t* name = wcsrchr(file_name, SEPARATOR);
+	name = (name != NULL) ? name + 1 : file_name;
+	if (*name == L'\0')
+		return false;
+
+	app.Name = pool.intern(name);
+	app.Exec_name = pool.intern(file_name);
+	return true;
+}
+
+/*
+Rimozione della meta' meno usata delle voci (processi terminati da tempo, pid non piu' visibili),
+seguita dalla rimozione delle stringhe rimaste senza utilizzatori.
+*/
+
+void ProcessCache::evict() {
+	std::vector<unsigned long long> uses;
+	uses.reserve(entries.size());
+	for (std::pair<const DWORD, Entry>& e : entries)
+		uses.push_back(e.second.lastUse);
+
+	std::vector<unsigned long long>::iterator median = uses.begin() + uses.size() / 2;
+	std::nth_element(uses.begin(), median, uses.end());
+	unsigned long long threshold = *median;
+
+	for (std::unordered_map<DWORD, Entry>::iterator i = entries.begin(); i != entries.end();) {
+		if (i->second.lastUse < threshold)
+			i = entries.erase(i);
+		else
+			++i;
+	}
+	pool.purge();
+}
+
+unsigned long long ProcessCache::getHits() {
+	std::lock_guard<std::mutex> lock(cacheMutex);
+	return hits;
+}
+
+unsigned long long ProcessCache::getMisses() {
+	std::lock_guard<std::mutex> lock(cacheMutex);
+	return misses;
+}
+
+size_t ProcessCache::getEntries() {
+	std::lock_guard<std::mutex> lock(cacheMutex);
+	return entries.size();
+}
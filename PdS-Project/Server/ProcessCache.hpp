@@ -0,0 +1,66 @@
+#pragma once
+#include "Platform.hpp"
+#include <string>
+#include <map>
+#include <unordered_map>
+#include <memory>
+#include <mutex>
+#include "Change.hpp"
+
+
+#define PROCESSCACHESIZE 4096				// massimo numero di processi memorizzati (oltre si scartano i meno usati)
+#define MAXPATH 4096						// massima lunghezza (in caratteri) del percorso di un eseguibile
+
+/*	Insieme delle stringhe internate: ogni testo distinto (nome o percorso di un eseguibile) e' memorizzato una sola volta
+*	e condiviso da tutti i processi che lo usano (es. piu' istanze dello stesso programma).
+*	Le stringhe non piu' usate da nessuno vengono rimosse da purge.
+*/
+
+class StringPool {
+	std::map<std::wstring, std::weak_ptr<const std::wstring>, std::less<>> strings;
+
+public:
+	InternedString intern(const wchar_t* text);
+	void purge();
+	size_t size() const;
+};
+
+class ProcessHandle;						// accesso ad un processo del sistema (vedi ProcessCache.cpp)
+
+/*	Cache delle informazioni dei processi, unica per tutto il processo.
+*	Leggere il percorso dell'eseguibile richiede di aprire il processo, interrogarlo e scomporre il percorso: il risultato viene
+*	memorizzato per pid insieme all'istante di creazione del processo (su Linux lo starttime di /proc/<pid>/stat).
+*	Un pid puo' essere riusato dal sistema dopo la terminazione del processo: la voce in cache e' valida solo se l'istante
+*	di creazione coincide, altrimenti il processo viene riletto.
+*	Le voci restano in cache anche quando il processo esce dalla lista (es. una finestra nascosta e poi mostrata di nuovo).
+*/
+
+class ProcessCache {
+	struct Entry {
+		ULONGLONG creationTime;				// istante di creazione del processo (identifica il processo insieme al pid)
+		bool valid;							// false se non e' stato possibile leggere il percorso
+		ApplicationItem app;
+		unsigned long long lastUse;			// contatore di utilizzo, per scartare le voci meno usate
+	};
+
+	std::unordered_map<DWORD, Entry> entries;
+	StringPool pool;
+	unsigned long long useCounter = 0;
+	unsigned long long hits = 0;
+	unsigned long long misses = 0;
+	std::mutex cacheMutex;
+
+	ProcessCache() {}
+	void evict();
+	bool readProcess(ProcessHandle& process, ApplicationItem& app);
+
+public:
+	ProcessCache(const ProcessCache&) = delete;
+	ProcessCache& operator=(const ProcessCache&) = delete;
+
+	static ProcessCache& instance();
+	bool resolve(DWORD pid, ApplicationItem& app);
+	unsigned long long getHits();
+	unsigned long long getMisses();
+	size_t getEntries();
+};
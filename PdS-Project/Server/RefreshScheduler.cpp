@@ -0,0 +1,63 @@
+#include "RefreshScheduler.hpp"
+#include <algorithm>
+
+RefreshScheduler::RefreshScheduler(long minMs, long maxMs) : minInterval(MINREFRESHINTERVAL), maxInterval(MAXREFRESHINTERVAL),
+	interval(MINREFRESHINTERVAL), lastTick(clock::now()), windowStart(lastTick), rate(0) {
+	setBounds(minMs, maxMs);
+}
+
+/* Impostazione dei limiti dell'intervallo: i valori non validi vengono ignorati (restituisce false) */
+bool RefreshScheduler::setBounds(long minMs, long maxMs) {
+	if (minMs < 1 || maxMs < minMs || maxMs > REFRESHLIMIT)
+		return false;
+	minInterval = minMs;
+	maxInterval = maxMs;
+	interval = minMs;
+	return true;
+}
+
+/* Scadenza del prossimo aggiornamento in assenza di eventi */
+std::chrono::steady_clock::time_point RefreshScheduler::nextDeadline() const {
+	return lastTick + std::chrono::milliseconds(interval.load());
+}
+
+/* Istante minimo del prossimo aggiornamento: gli eventi che arrivano prima vengono gestiti insieme */
+std::chrono::steady_clock::time_point RefreshScheduler::earliestTick() const {
+	return lastTick + std::chrono::milliseconds(minInterval.load());
+}
+
+/*	Registrazione di un aggiornamento iniziato all'istante now: se la lista e' cambiata l'intervallo torna al minimo,
+*	altrimenti raddoppia (fino al massimo). Viene aggiornata anche la frequenza effettiva.
+*/
+
+void RefreshScheduler::tick(clock::time_point now, bool changed) {
+	lastTick = now;
+	if (changed)
+		interval = minInterval.load();
+	else
+		interval = std::min(interval.load() * 2, maxInterval.load());
+
+	windowTicks++;
+	std::chrono::milliseconds elapsed = std::chrono::duration_cast<std::chrono::milliseconds>(now - windowStart);
+	if (elapsed.count() >= RATEWINDOW) {
+		rate = windowTicks * 1000.0 / elapsed.count();
+		windowTicks = 0;
+		windowStart = now;
+	}
+}
+
+long RefreshScheduler::getInterval() const {
+	return interval;
+}
+
+long RefreshScheduler::getMinInterval() const {
+	return minInterval;
+}
+
+long RefreshScheduler::getMaxInterval() const {
+	return maxInterval;
+}
+
+double RefreshScheduler::getRate() const {
+	return rate;
+}
@@ -0,0 +1,39 @@
+#pragma once
+#include <chrono>
+#include <atomic>
+
+
+#define MINREFRESHINTERVAL 10				// intervallo (ms) dopo un cambiamento: anche gli eventi ravvicinati vengono raggruppati in questo intervallo
+#define MAXREFRESHINTERVAL 1000				// intervallo (ms) massimo della riconciliazione quando la lista e' stabile
+#define REFRESHLIMIT 60000					// massimo valore accettato per i limiti dell'intervallo
+#define RATEWINDOW 1000						// finestra (ms) su cui viene misurata la frequenza effettiva degli aggiornamenti
+
+/*	Pianificazione degli aggiornamenti della lista con scadenze assolute (orologio monotono).
+*	L'intervallo tra due aggiornamenti si adatta all'attivita': dopo un cambiamento (applicazioni nuove o terminate,
+*	cambio del focus) torna al minimo, mentre finche' la lista resta stabile raddoppia ad ogni aggiornamento fino al massimo.
+*	In questo modo la latenza e' bassa quando la lista cambia, e a riposo il thread della lista si sveglia raramente.
+*	I limiti e la frequenza effettiva possono essere letti da altri thread.
+*/
+
+class RefreshScheduler {
+	typedef std::chrono::steady_clock clock;
+
+	std::atomic<long> minInterval;			// limiti dell'intervallo (ms)
+	std::atomic<long> maxInterval;
+	std::atomic<long> interval;				// intervallo corrente (ms)
+	clock::time_point lastTick;				// inizio dell'ultimo aggiornamento
+	clock::time_point windowStart;			// inizio della finestra di misura della frequenza
+	unsigned long windowTicks = 0;
+	std::atomic<double> rate;				// aggiornamenti al secondo nell'ultima finestra
+
+public:
+	RefreshScheduler(long minMs = MINREFRESHINTERVAL, long maxMs = MAXREFRESHINTERVAL);
+	bool setBounds(long minMs, long maxMs);
+	clock::time_point nextDeadline() const;
+	clock::time_point earliestTick() const;
+	void tick(clock::time_point now, bool changed);
+	long getInterval() const;
+	long getMinInterval() const;
+	long getMaxInterval() const;
+	double getRate() const;
+};
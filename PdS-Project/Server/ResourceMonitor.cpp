@@ -0,0 +1,183 @@
+#include "ResourceMonitor.hpp"
+#include "Metrics.hpp"
+#include <algorithm>
+#include <thread>
+#include <cstring>
+
+#ifdef _WIN32
+#include <winternl.h>
+#pragma comment(lib, "ntdll.lib")
+#ifndef STATUS_INFO_LENGTH_MISMATCH
+#define STATUS_INFO_LENGTH_MISMATCH ((NTSTATUS) 0xC0000004L)
+#endif
+#define USERTIMEOFFSET 32					// UserTime e KernelTime nei campi riservati di SYSTEM_PROCESS_INFORMATION
+#define KERNELTIMEOFFSET 40
+#else
+#include <fcntl.h>
+#include <cstdio>
+#endif
+
+ResourceMonitor::ResourceMonitor() {
+	lastSample = nextSample = std::chrono::steady_clock::now();
+	processors = std::max(1u, std::thread::hardware_concurrency());
+}
+
+/* Soglie di variazione: CPU in centesimi di punto percentuale, working set in KB. Restituisce false se non sono valide */
+
+bool ResourceMonitor::setThresholds(long cpu, long memory) {
+	if (cpu < 0 || cpu > 10000 || memory < 0)
+		return false;
+	cpuThreshold = (DWORD) cpu;
+	memoryThreshold = (DWORD) memory;
+	return true;
+}
+
+/* Istante del prossimo campionamento, incluso nell'attesa del thread della lista */
+
+std::chrono::steady_clock::time_point ResourceMonitor::nextDeadline() const {
+	return nextSample;
+}
+
+#ifdef _WIN32
+
+/*	Lettura di tutti i processi del sistema con una sola chiamata: NtQuerySystemInformation restituisce per ogni processo
+*	tempi di CPU e working set, senza aprire handle. Il buffer viene riusato e cresce solo se i processi aumentano.
+*	Vengono tenuti solo i processi della lista delle applicazioni.
+*/
+
+bool ResourceMonitor::readSamples(const AppList& apps) {
+	samples.clear();
+	ULONG needed = 0;
+	NTSTATUS status;
+	while ((status = NtQuerySystemInformation(SystemProcessInformation, buffer.data(), (ULONG) buffer.size(), &needed)) == STATUS_INFO_LENGTH_MISMATCH)
+		buffer.resize(needed + needed / 4);		// margine per i processi creati tra le due chiamate
+	if (status != 0)
+		return false;
+
+	size_t offset = 0;
+	while (true) {
+		const SYSTEM_PROCESS_INFORMATION* p = (const SYSTEM_PROCESS_INFORMATION*) (buffer.data() + offset);
+		DWORD pid = (DWORD) (ULONG_PTR) p->UniqueProcessId;
+		const AppEntry* e = apps.find(pid);
+		if (e != nullptr && e->valid) {
+			LARGE_INTEGER user, kernel;
+			memcpy(&user, p->Reserved1 + USERTIMEOFFSET, sizeof(user));
+			memcpy(&kernel, p->Reserved1 + KERNELTIMEOFFSET, sizeof(kernel));
+			samples.push_back({ pid, (ULONGLONG) (user.QuadPart + kernel.QuadPart), (ULONGLONG) p->WorkingSetSize });
+		}
+		if (p->NextEntryOffset == 0)
+			break;
+		offset += p->NextEntryOffset;
+	}
+	return true;
+}
+
+#else
+
+/*	Su Linux non esiste un'interrogazione unica: per ogni applicazione della lista viene letto /proc/<pid>/stat con una sola
+*	read in un buffer riusato (tempi utente e kernel in tick, resident set in pagine). I processi terminati nel frattempo
+*	vengono saltati: la loro remove arrivera' con il prossimo aggiornamento della lista.
+*/
+
+bool ResourceMonitor::readSamples(const AppList& apps) {
+	static const long ticks = sysconf(_SC_CLK_TCK);
+	static const long page = sysconf(_SC_PAGESIZE);
+	samples.clear();
+	if (buffer.size() < 1024)
+		buffer.resize(1024);
+
+	char path[32];
+	for (const AppEntry& e : apps.getEntries()) {
+		if (!e.valid)
+			continue;
+		snprintf(path, sizeof(path), "/proc/%u/stat", (unsigned) e.pid);
+		int fd = open(path, O_RDONLY | O_CLOEXEC);
+		if (fd < 0)
+			continue;
+		ssize_t n = read(fd, buffer.data(), buffer.size() - 1);
+		close(fd);
+		if (n <= 0)
+			continue;
+		buffer[n] = '\0';
+
+		/* il nome del processo (tra parentesi) puo' contenere spazi e parentesi: i campi seguono l'ultima ')' */
+		const char* fields = strrchr(buffer.data(), ')');
+		unsigned long long utime, stime;
+		long long rss;
+		if (fields == nullptr || sscanf(fields + 1, " %*c %*d %*d %*d %*d %*d %*u %*u %*u %*u %*u %llu %llu %*d %*d %*d %*d %*d %*d %*u %*u %lld",
+			&utime, &stime, &rss) != 3)
+			continue;
+		samples.push_back({ e.pid, (utime + stime) * 10000000ULL / (ULONGLONG) ticks, (ULONGLONG) (rss > 0 ? rss : 0) * (ULONGLONG) page });
+	}
+	return true;
+}
+
+#endif
+
+/* Distanza tra due valori sufficiente per una nuova modifica (con soglia 0 basta che il valore sia cambiato) */
+
+static bool movedPast(DWORD value, DWORD sent, DWORD threshold) {
+	DWORD distance = value > sent ? value - sent : sent - value;
+	return distance != 0 && distance >= threshold;
+}
+
+/*	Campionamento, se e' trascorso RESOURCEINTERVAL dal precedente: in changes una modifica res per ogni applicazione
+*	il cui uso delle risorse si e' allontanato dall'ultimo valore inviato di almeno una soglia. Al primo campione di
+*	un'applicazione manca il riferimento per la CPU: la prima modifica arriva al campione successivo.
+*/
+
+void ResourceMonitor::sample(const AppList& apps, std::deque<Change>& changes) {
+	std::chrono::steady_clock::time_point now = std::chrono::steady_clock::now();
+	if (now < nextSample)
+		return;
+	nextSample = now + std::chrono::milliseconds(RESOURCEINTERVAL);
+	ULONGLONG elapsed = (ULONGLONG) std::chrono::duration_cast<std::chrono::microseconds>(now - lastSample).count() * 10;	// unita' da 100 ns
+	lastSample = now;
+
+	Metrics& metrics = Metrics::instance();
+	if (!readSamples(apps))
+		return;
+	metrics.resourceSample.record(Metrics::elapsedMicros(now));
+
+	for (const ResourceSample& s : samples) {
+		std::map<DWORD, Usage>::iterator i = usage.find(s.pid);
+		if (i == usage.end()) {
+			usage[s.pid].cpuTime = s.cpuTime;
+			continue;
+		}
+
+		/* tempo di CPU diminuito: pid riusato da un altro processo tra due campioni, si riparte da questo valore */
+		Usage& u = i->second;
+		ULONGLONG cpuTime = s.cpuTime >= u.cpuTime ? s.cpuTime - u.cpuTime : 0;
+		u.cpuTime = s.cpuTime;
+
+		ResourceUsage current;
+		current.cpu = elapsed == 0 ? 0 : (DWORD) std::min<ULONGLONG>(cpuTime * 10000 / (elapsed * processors), 10000);
+		current.memory = (DWORD) std::min<ULONGLONG>(s.workingSet / 1024, 0xFFFFFFFFULL);
+		if (u.announced && !movedPast(current.cpu, u.sent.cpu, cpuThreshold) && !movedPast(current.memory, u.sent.memory, memoryThreshold))
+			continue;
+
+		u.announced = true;
+		u.sent = current;
+		changes.push_back(Change(s.pid, current));
+		metrics.resourceChanges++;
+	}
+}
+
+/* Applicazione terminata: se il pid viene riusato, il nuovo processo riparte senza valori inviati */
+
+void ResourceMonitor::remove(DWORD pid) {
+	usage.erase(pid);
+}
+
+/* Ultimo valore inviato per ogni applicazione della lista, per i client che ricevono la lista completa */
+
+void ResourceMonitor::current(const AppList& apps, std::deque<Change>& changes) const {
+	for (const AppEntry& e : apps.getEntries()) {
+		if (!e.valid)
+			continue;
+		std::map<DWORD, Usage>::const_iterator i = usage.find(e.pid);
+		if (i != usage.end() && i->second.announced)
+			changes.push_back(Change(e.pid, i->second.sent));
+	}
+}
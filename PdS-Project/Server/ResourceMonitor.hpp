@@ -0,0 +1,55 @@
+#pragma once
+#include "Change.hpp"
+#include "AppList.hpp"
+#include <deque>
+#include <map>
+#include <vector>
+#include <chrono>
+
+
+#define RESOURCEINTERVAL 1000				// intervallo (ms) tra due campionamenti dell'uso delle risorse
+#define CPUTHRESHOLD 100					// variazione minima della CPU (centesimi di punto percentuale) per inviare una modifica
+#define MEMORYTHRESHOLD 1024				// variazione minima del working set (KB) per inviare una modifica
+
+/* Campione di un processo: tempo di CPU totale (utente + kernel, in unita' da 100 ns) e working set (byte) */
+struct ResourceSample {
+	DWORD pid;
+	ULONGLONG cpuTime;
+	ULONGLONG workingSet;
+};
+
+/*	Uso delle risorse (CPU e memoria) delle applicazioni della lista, inviato ai client con le modifiche di tipo res.
+*	Ogni RESOURCEINTERVAL ms tutti i processi vengono letti con una sola interrogazione del sistema
+*	(NtQuerySystemInformation su Windows, una lettura di /proc/<pid>/stat per ogni applicazione su Linux), senza aprire
+*	un handle per processo. La CPU e' la percentuale della capacita' di tutti i processori usata dall'ultimo campione.
+*	Per non inviare un flusso continuo di piccole variazioni, la modifica di un'applicazione viene prodotta solo quando
+*	CPU o working set si allontanano dall'ultimo valore inviato di almeno la soglia (vedi setThresholds).
+*	Viene usato solo dal thread della lista: i pid sono quelli della lista delle applicazioni (AppList).
+*/
+
+class ResourceMonitor {
+	struct Usage {
+		ULONGLONG cpuTime;					// tempo di CPU all'ultimo campione
+		bool announced = false;				// il valore sent e' stato inviato ai client
+		ResourceUsage sent = {};			// ultimo valore inviato
+	};
+
+	std::map<DWORD, Usage> usage;			// applicazioni campionate almeno una volta, per pid
+	std::vector<ResourceSample> samples;	// vettore riusato ad ogni campionamento
+	std::vector<char> buffer;				// buffer riusato per l'interrogazione del sistema
+	std::chrono::steady_clock::time_point lastSample;
+	std::chrono::steady_clock::time_point nextSample;
+	DWORD cpuThreshold = CPUTHRESHOLD;
+	DWORD memoryThreshold = MEMORYTHRESHOLD;
+	unsigned processors;
+
+	bool readSamples(const AppList& apps);
+
+public:
+	ResourceMonitor();
+	bool setThresholds(long cpu, long memory);
+	std::chrono::steady_clock::time_point nextDeadline() const;
+	void sample(const AppList& apps, std::deque<Change>& changes);
+	void remove(DWORD pid);
+	void current(const AppList& apps, std::deque<Change>& changes) const;
+};
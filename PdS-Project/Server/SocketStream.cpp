@@ -1,108 +1,46 @@
-#pragma once
-#define MAXLENGTH 2048
+#define RECVLENGTH 4096
 #include "SocketStream.hpp"
+#include "IconCache.hpp"
+#include "Metrics.hpp"
 #include <iostream>
+#include <cstring>
+#include <algorithm>
 
-/* Costruttore della classe che si occupa:
-*  1. Inizializzare la libreria Winsock
-*  2. definire il Socket del Server (tipo di indirizzi, tipo di protocollo)
-*  3. binding del socket con la struttura dati che contiene indirizzi e porta (per poter permettere al S.O. di poter inoltrare correttamente al Server i messaggi) 
-*  4. setting del socket in modalit di ascolto per attendere eventuali connessioni.
+/*	Costruttore della classe: riceve il socket restituito dalla accept (vedi ConnectionManager) e lo imposta come non bloccante,
+*	in modo che send e recv non sospendano mai il thread chiamante.
+*	Viene inoltre disabilitato l'algoritmo di Nagle (TCP_NODELAY): le modifiche di un ciclo vengono gi raccolte
+*	in un'unica scrittura (sendBatch), per cui non serve che il kernel ritardi l'invio in attesa di altri dati.
 */
 
-SocketStream::SocketStream(int port) {
-
-	/* Impostazione dei socket come non validi per default */
-	serverSocket = INVALID_SOCKET;
-	clientSocket = INVALID_SOCKET;
-
-	/* Inizializzazione libreria Winsock con metodo WSAStartup, con parametri:
-	*  - wVersionRequested: Una WORD che indica la versione che bisogna inizializzare. Il BYTE di minor importanza indica il numero 
-	*  - di versione maggiore mentre il BYTE pi significativo indica il numero di versione minore. Usiamo Winsock 2.2.
-	*  - lpWSAData: Un puntatore alla struttura WSADATA che riceve i dettagli della libreria Winsock.
-	*/
-
-	iResult = WSAStartup(MAKEWORD(2, 2), &wsaData);
-	if (iResult != 0)
-		throw socket_exception("Inizializzazione librerie Winsock fallita!");
-
-	/* Per inviare e ricevere dati abbiamo bisogno di creare un socket. Dopo che il S.O. ne ha creato uno per noi ci ritorna un intero che 
-	*  lo identifica. Per contenere l'intero viene utilizzato il tipo di dato SOCKET. Per farlo dobbiamo chiamare la funzione di nome 
-	*  socket definita con i seguenti parametri:
-	*  - __in  int af: indica il tipo di indirizzi che utilizza (con AF_INET si intende indirizzi IPv4).
-	*  - __in  int type: il tipo di protocollo di trasporto da utilizzare (con SOCK_STREAM si specifica di voler usare protocolli che simulano il flusso dati di TCP).
-	*  - __in  int protocol: indica strettamente il tipo di protocollo da usare (se TCP o UDP).
-	*/
-
-	serverSocket = socket(AF_INET, SOCK_STREAM, IPPROTO_TCP);
-	if (serverSocket == INVALID_SOCKET)
-		throw socket_exception("Costruzione del socket fallita!");
-
-	/* Preparazione della struttura per fare il binding:
-	*  L'applicazione server deve rimanere in ascolto per nuove connessioni da un client, per far questo, bisogna dire al S.O. quali sono 
-	*  i pacchetti destinati a noi (applicazione server). Quindi dobbiamo settare una porta per la nostra applicazione, per far in modo che 
-	*  i messaggi dei client che specificano la nostra porta vengono inoltrati a noi. Questo lavoro  fatto dalla funzione di Bind.
-	*/
-
-	ZeroMemory(&sockAddr, sizeof(sockAddr));		// Riempie di "zeri" una certa struttura dati passata come parametro, in questo caso sockAddr
-	
-	sockAddr.sin_family = AF_INET;					// Tipologia di famiglia che indirizza.
-	sockAddr.sin_port = htons(port);				// Numero della porta scelta dal server (e che i client dovranno specificare per parlare con esso)
-	sockAddr.sin_addr.s_addr = htonl(INADDR_ANY);	// Indirizzo locale (con INADDR_ANY non  necessario specificarne uno). Utile quando ci sono pi interfacce su server ect..
-
-	/* La funzione bind prende come parametri:
-	*  - __in  SOCKET s: Il socket da bindare.
-	*  - __in  const struct sockaddr *name: il puntatore a una struttura sockaddr che contiene le informazioni sulla porta e l'indirizzo locale.
-	*  - __in  int namelen: La lunghezza in byte della struttura sockaddr
-	*/
-	if (bind(serverSocket, (struct sockaddr*) &sockAddr, sizeof(sockAddr)) != 0) {
-		closesocket(serverSocket);
-		throw socket_exception("Ascolto fallito da parte del Server");
+SocketStream::SocketStream(SOCKET s) : clientSocket(s), isConnected(true), compression(false), iconSize(ICONSIZE), compact(false) {
+	u_long nonBlocking = 1;
+	if (ioctlsocket(clientSocket, FIONBIO, &nonBlocking) == SOCKET_ERROR) {
+		closesocket(clientSocket);
+		clientSocket = INVALID_SOCKET;
+		throw socket_exception("Impostazione del socket non bloccante fallita");
 	}
 
-	/* Dopo aver effettuato il binding tra il socket e la struttura sockAddr che memorizza la porta e le altre informazioni, bisogna mettere
-	* il socket in posizione d'ascolto con la funzione Listen che specifica:
-	* il socket da mettere in ascolto.
-	* lunghezza della coda di connessioni che possono essere messe in attesa (impostiamo a 0 perch non vogliamo una coda).
-	*/
-
-	if (listen(serverSocket, PENDINGQUEUE) == SOCKET_ERROR) {
-		closesocket(serverSocket);
-		throw socket_exception("Ascolto fallito");
+	int noDelay = 1;
+	if (setsockopt(clientSocket, IPPROTO_TCP, TCP_NODELAY, (const char*) &noDelay, sizeof(noDelay)) == SOCKET_ERROR) {
+		closesocket(clientSocket);
+		clientSocket = INVALID_SOCKET;
+		throw socket_exception("Impostazione di TCP_NODELAY fallita");
 	}
 
+	/* le latenze dei comandi della connessione sono esposte dalle metriche finche' la connessione esiste */
+	metricsConnection = Metrics::instance().addConnection(&latency);
 }
 
-/*	Dopo che il Socket  stato inizializzato ed impostato in ascolto,  possibile instaurare una connessione con il client. Per poter iniziare
-*	a gestire una connessione con un Client bisogna far utilizzo della funzione Accept che  integrata dentro il seguente metodo, che si occupa
-*   della procedura d'instaurazione della comunicazione con un Client (se esso non c', si mette in attesa).
-*/
-
-void SocketStream::waitingForConnection() {
-
-	/* La funzione accept accetta una connessione in entrata su un certo socket.
-	*  Se al momento della chiamata non c' nessuno in attesa la funzione blocca fino a che un client non si connette.
-	*  I suoi parametri sono: 
-	*  - SOCKET s: Identificatore di un socket messo in stato di Listen tramite la funzione listen.
-	*  - sockaddr* addr: Indirizzo dell'entit che vuole connettersi ( opzionale, pu essere inviato anche un parametro nullo, come effettivamente avviene nel nostro caso).
-	*  - int* addrlen: Lunghezza dell'indirizzo dell'entit che vuole connettersi.
-	*
-	*  Il valore di ritorno dalla funzione accept  un socket che identifica il client, con il quale  possibile inviare e ricevere dati
-	*  Nel nostro caso, la accept accetta la connessione da parte del client sul socket del server che era messo in stato di Listen.
-	*/
-
-	clientSocket = accept(serverSocket, (struct sockaddr*)&clientSockAddr, &clientAddrLen);
-
-	if (clientSocket == INVALID_SOCKET) {
-		closesocket(serverSocket);
-		throw socket_exception("Accettazione del Client fallita!");
-	}
-
-	/* A questo punto la connessione  stata accettata dal ListenSocket, pertanto possiamo affermare che il client  connesso
-	*  Impostiamo lo stato del socket come connesso, per indicare che c' una connessione attiva su di esso
-	*/
+/* Il distruttore chiude il socket se non e' gia' stato chiuso */
+SocketStream::~SocketStream() {
+	Metrics::instance().removeConnection(metricsConnection);
+	if (clientSocket != INVALID_SOCKET)
+		closesocket(clientSocket);
+}
 
-	setStatus(true);
+/* Funzione che restituisce il socket associato alla connessione */
+SOCKET SocketStream::getSocket() {
+	return clientSocket;
 }
 
 /* Funzione che imposta lo stato della connessione (se il socket del server  connesso o meno ad un client) */
@@ -115,60 +53,344 @@ bool SocketStream::getStatus(){
 	return isConnected;
 }
 
+/* Il client ha richiesto i batch compressi (handshake delle capacita', vedi CommandsFromClient) */
+bool SocketStream::getCompression() {
+	return compression;
+}
+
+void SocketStream::setCompression(bool enabled) {
+	compression = enabled;
+}
+
+/* Dimensione delle icone inviate al client: ICONSIZE se il client non ne ha indicata una (vedi acceptCapabilities) */
+int SocketStream::getIconSize() {
+	return iconSize;
+}
+
+void SocketStream::setIconSize(int size) {
+	iconSize = size;
+}
+
+/*	Codifica compatta delle modifiche: una volta attivata resta attiva per tutta la connessione, perche' la tabella
+*	dei nomi del client deve restare allineata a quella del server (vedi StringTable).
+*/
+bool SocketStream::getCompact() {
+	return compact;
+}
+
+void SocketStream::enableCompact() {
+	compact = true;
+}
+
+StringTable& SocketStream::getStrings() {
+	return strings;
+}
+
 /* Funzione che chiude la connessione del socket (Non permette altre comunicazioni con quel client) */
 void SocketStream::closeConnection() {
-	if ((closesocket(clientSocket)) == SOCKET_ERROR) {
+	std::lock_guard<std::mutex> lock(writeMutex);
+	if (clientSocket == INVALID_SOCKET)
+		return;
+	SOCKET s = clientSocket;
+	clientSocket = INVALID_SOCKET;
+	if ((closesocket(s)) == SOCKET_ERROR) {
 		throw socket_exception("Socket close failed");		//Se la chiusura del socket fallisce si lancia un'eccezione
 	}
 }
 
-/* Dopo che si  instaurata una connessione tra Server e il Client (quindi dopo l'invocazione del costruttore e del metodo waitingForConnection() 
+/* Dopo che si  instaurata una connessione tra Server e il Client (quindi dopo la accept del ConnectionManager)
 *  Il Server  in grado di inviare e ricevere i dati dal Client tramite le funzioni send e recv implementate nei seguenti metodi.
+*  I dati da inviare vengono accodati nel buffer di scrittura e si tenta subito di inviarli: quello che il kernel non accetta
+*  resta in coda e verr inviato dal reactor con flush(). La funzione non blocca mai il chiamante.
 */
 
 void SocketStream::sendData(char* buffer, int len) {
-	int nOfLeft = len;					// nOfLeft = numero di dati rimasti da scambiare (inizialmente pari alla lunghezza totale del buffer)
+	std::lock_guard<std::mutex> lock(writeMutex);
+
+	if (!isConnected || clientSocket == INVALID_SOCKET)
+		throw socket_exception("Connessione chiusa");
 
+	// un client che non legge i dati non puo' far crescere la coda indefinitamente
+	if (writeBuffer.size() - writeOffset + len > MAXPENDING) {
+		isConnected = false;
+		throw socket_exception("Client troppo lento: coda di invio piena");
+	}
+
+	writeBuffer.insert(writeBuffer.end(), buffer, buffer + len);
+	sendPending();
+}
 
-	while (nOfLeft > 0) {				// finch c' qualche dato da scambiare
+/* Invio dei dati in coda: chiamata dal reactor quando il socket torna scrivibile. Restituisce true se la coda  vuota. */
+bool SocketStream::flush() {
+	std::lock_guard<std::mutex> lock(writeMutex);
+	if (clientSocket == INVALID_SOCKET)
+		return true;
+	sendPending();
+	return writeOffset == writeBuffer.size();
+}
 
-		// si verifica che la dimensione (lunghezza) dei dati non sia superiore all'upper bound. In quel caso si "spezza" l'invio in pi invii.
-		if (nOfLeft <= MAXLENGTH)
-			/*	Il metodo send invia i dati al socket connesso (specificato). I parametri sono:
-			*	- Socket che  ritornato dalla accept (che  quello connesso al socket del Server), a cui vanno inviati i dati. 
-			*	- Puntatore al buffer da inviare.
-			*	- Numero di bytes da inviare.
-			*	- Specifica di modalit con cui devono essere inviati i dati.
-			*/
-			iResult = send(clientSocket, buffer, nOfLeft, 0);
-		else
-			iResult = send(clientSocket, buffer, MAXLENGTH, 0);
+/* Indica se ci sono dati in attesa di essere inviati */
+bool SocketStream::hasPendingData() {
+	std::lock_guard<std::mutex> lock(writeMutex);
+	return writeOffset != writeBuffer.size();
+}
 
-		if (iResult == SOCKET_ERROR)
+/* Numero di byte in attesa di invio (profondita' della coda di scrittura) */
+size_t SocketStream::getPendingBytes() {
+	std::lock_guard<std::mutex> lock(writeMutex);
+	return writeBuffer.size() - writeOffset;
+}
+
+/*	Accodamento di un batch prodotto dal thread della lista (unico produttore): non esegue chiamate di sistema, per cui
+*	un client lento non rallenta l'aggiornamento della lista. Il batch viene inviato dal reactor (sendQueued).
+*	Restituisce false se la coda e' piena: il reactor non riesce a smaltire i batch di questa connessione.
+*/
+
+bool SocketStream::enqueue(std::shared_ptr<const OutgoingBatch> batch) {
+	return outgoing.push(std::move(batch));
+}
+
+/*	Invio dei batch in coda, eseguito dal reactor (unico consumatore): ogni batch viene inviato compresso se il client
+*	lo ha richiesto e se la versione compressa esiste. Restituisce il numero di byte inviati o accodati.
+*/
+
+size_t SocketStream::sendQueued() {
+	std::shared_ptr<const OutgoingBatch> batch;
+	size_t bytes = 0;
+	while (outgoing.pop(batch)) {
+		const FrameBatch& frames = (compression && !batch->compressed.empty()) ? batch->compressed : batch->plain;
+		sendBatch(frames);
+		bytes += frames.getBytes();
+	}
+	return bytes;
+}
+
+/* Numero di batch in coda per l'invio */
+size_t SocketStream::getQueuedBatches() {
+	return outgoing.size();
+}
+
+/*	Invio di un intero batch di modifiche (vedi FrameBatch).
+*	Se non ci sono dati in coda i segmenti vengono passati direttamente al kernel con un'unica scrittura vettoriale, senza copiarli:
+*	solo la parte che il kernel non accetta subito viene copiata nel buffer di scrittura e completata dal reactor.
+*	Se invece la coda non  vuota il batch viene accodato, per non alterare l'ordine dei messaggi.
+*/
+
+void SocketStream::sendBatch(const FrameBatch& batch) {
+	std::lock_guard<std::mutex> lock(writeMutex);
+
+	if (!isConnected || clientSocket == INVALID_SOCKET)
+		throw socket_exception("Connessione chiusa");
+
+	if (writeBuffer.size() - writeOffset + batch.getBytes() > MAXPENDING) {
+		isConnected = false;
+		throw socket_exception("Client troppo lento: coda di invio piena");
+	}
+
+	const std::vector<Segment>& segments = batch.getSegments();
+	size_t index = 0;		// primo segmento non ancora inviato
+	int offset = 0;			// byte gi inviati di segments[index]
+
+	if (writeOffset == writeBuffer.size() && sendVector(segments, index, offset))
+		return;
+
+	/* il resto del batch viene accodato */
+	for (; index < segments.size(); index++, offset = 0)
+		writeBuffer.insert(writeBuffer.end(), segments[index].data + offset, segments[index].data + segments[index].len);
+}
+
+/*	Scrittura vettoriale dei segmenti a partire da segments[index] (di cui offset byte sono gi stati inviati).
+*	WSASend (sendmsg su Linux) riceve un vettore di buffer (scatter-gather): il kernel compone i segmenti senza copie intermedie nel processo.
+*	Aggiorna index ed offset in base ai byte accettati e restituisce true se tutti i segmenti sono stati inviati,
+*	false se il buffer del kernel  pieno (da chiamare con writeMutex acquisito).
+*/
+
+bool SocketStream::sendVector(const std::vector<Segment>& segments, size_t& index, int& offset) {
+#ifdef _WIN32
+	WSABUF buffers[MAXSEGMENTS];
+#else
+	struct iovec buffers[MAXSEGMENTS];
+#endif
+
+	while (index < segments.size()) {
+		DWORD count = 0;
+		for (size_t i = index; i < segments.size() && count < MAXSEGMENTS; i++, count++) {
+			int skip = (i == index) ? offset : 0;
+#ifdef _WIN32
+			buffers[count].buf = (char*) segments[i].data + skip;
+			buffers[count].len = segments[i].len - skip;
+#else
+			buffers[count].iov_base = (char*) segments[i].data + skip;
+			buffers[count].iov_len = segments[i].len - skip;
+#endif
+		}
+
+		DWORD sent = 0;
+		sendCalls++;
+#ifdef _WIN32
+		if (WSASend(clientSocket, buffers, count, &sent, 0, NULL, NULL) == SOCKET_ERROR) {
+#else
+		struct msghdr message;
+		ZeroMemory(&message, sizeof(message));
+		message.msg_iov = buffers;
+		message.msg_iovlen = count;
+		ssize_t res = sendmsg(clientSocket, &message, MSG_NOSIGNAL);	// MSG_NOSIGNAL: nessun SIGPIPE se il client ha chiuso
+		if (res >= 0)
+			sent = (DWORD) res;
+		else {
+#endif
+			if (WSAGetLastError() == WSAEWOULDBLOCK)
+				return false;
+			isConnected = false;
 			throw socket_exception("Invio fallito");
+		}
+
+		/* avanzamento sui segmenti completamente inviati */
+		size_t last = index + count;
+		while (sent > 0) {
+			DWORD left = segments[index].len - offset;
+			if (sent < left) {
+				offset += sent;
+				break;
+			}
+			sent -= left;
+			index++;
+			offset = 0;
+		}
+
+		// il kernel ha accettato solo una parte dei dati: il buffer di invio  pieno
+		if (index < last)
+			return false;
+	}
+	return true;
+}
+
+/*	Invio di quanto possibile dal buffer di scrittura (da chiamare con writeMutex acquisito).
+*	Il socket  non bloccante, per cui non serve spezzare i dati: il kernel accetta quanto pu e restituisce il numero di byte presi.
+*/
+
+void SocketStream::sendPending() {
 
-		/*	Se  andata a buon fine, la send ritorna il numero di byte inviati, pertanto bisogna aggiornare il numero di byte ancora da inviare, 
-		*	rimuovendo quelli appena inviati. Bisogna anche spostare il puntatore al buffer, per fare in modo che la prossima volta invii nuovi
-		*	dati, non quelli gi inviati.
+	while (writeOffset < writeBuffer.size()) {		// finch c' qualche dato da scambiare
+		int nOfLeft = (int) (writeBuffer.size() - writeOffset);
+
+		/*	Il metodo send invia i dati al socket connesso (specificato). I parametri sono:
+		*	- Socket che  ritornato dalla accept (che  quello connesso al socket del Server), a cui vanno inviati i dati.
+		*	- Puntatore al buffer da inviare.
+		*	- Numero di bytes da inviare.
+		*	- Specifica di modalit con cui devono essere inviati i dati.
 		*/
-		nOfLeft -= iResult;
-		buffer += iResult;
+		sendCalls++;
+		int iResult = send(clientSocket, writeBuffer.data() + writeOffset, nOfLeft, MSG_NOSIGNAL);
+
+		if (iResult == SOCKET_ERROR) {
+			// il buffer del kernel  pieno: i dati restano in coda fino al prossimo flush
+			if (WSAGetLastError() == WSAEWOULDBLOCK)
+				return;
+			isConnected = false;
+			throw socket_exception("Invio fallito");
+		}
+
+		/*	Se  andata a buon fine, la send ritorna il numero di byte inviati, pertanto bisogna aggiornare
+		*	la posizione del primo byte ancora da inviare, per fare in modo che la prossima volta invii nuovi dati, non quelli gi inviati.
+		*/
+		writeOffset += iResult;
 	}
+
+	writeBuffer.clear();
+	writeOffset = 0;
 }
 
+/*	Lettura di tutti i dati disponibili sul socket, che vengono accodati nel buffer di lettura.
+*	I dati vengono ricevuti direttamente in coda al buffer (senza copie intermedie); i byte gia' consumati dai comandi
+*	vengono eliminati una sola volta per lettura, e la capacita' del buffer viene mantenuta tra una lettura e l'altra.
+*	Si legge al piu' fino a MAXREADBUFFER byte non consumati: un client che invia dati senza sosta non fa crescere il buffer
+*	oltre questo limite (il Poller segnala di nuovo il socket finche' restano dati da leggere).
+*	Restituisce il numero di byte letti, 0 se il client ha chiuso la connessione, -1 se non c'era nulla da leggere.
+*/
+
+int SocketStream::fillReadBuffer() {
+	int total = 0;
+
+	if (readOffset > 0) {
+		readBuffer.erase(readBuffer.begin(), readBuffer.begin() + readOffset);
+		readOffset = 0;
+	}
+
+	/* un buffer pieno contiene sempre un comando completo o uno piu' lungo di MAXCOMMAND, che fa chiudere la connessione:
+	*  se e' ancora pieno qui, il client ha inviato dati che non possono essere consumati */
+	if (readBuffer.size() >= MAXREADBUFFER)
+		throw socket_exception("Buffer di lettura pieno");
+
+	while (readBuffer.size() < MAXREADBUFFER) {
+		/*	 In maniera analoga recv  la funzione che permette di ricevere dati da un socket connesso.
+		*	 Parametri:
+		*	 - ClientSocket: Socket tornato dall'accept (quello connesso al socket del Server)
+		*    - buffer: Un puntatore al buffer che deve ricevere i dati in arrivo
+		*    - len: Lunghezza del buffer di ricezione
+		*    - 0: Flag
+		*/
+		size_t used = readBuffer.size();
+		int length = (int) std::min<size_t>(RECVLENGTH, MAXREADBUFFER - used);
+		readBuffer.resize(used + length);
+		int iResult = recv(clientSocket, readBuffer.data() + used, length, 0);
+		readBuffer.resize(used + (iResult > 0 ? iResult : 0));
+		if (iResult == SOCKET_ERROR) {
+			if (WSAGetLastError() == WSAEWOULDBLOCK)
+				return total > 0 ? total : -1;
+			throw socket_exception("Recv failed");
+		}
+		if (iResult == 0)
+			return total;
+
+		if (total == 0)
+			lastReceive = std::chrono::steady_clock::now();		// inizio della latenza dei comandi ricevuti (vedi CommandsFromClient)
+		total += iResult;
+	}
+
+	/* buffer pieno: i dati rimasti nel socket vengono letti dopo che i comandi ricevuti sono stati consumati */
+	return total;
+}
+
+/*	Estrazione di un messaggio di len byte dal buffer di lettura.
+*	Se non sono ancora arrivati len byte restituisce 0 e lascia i dati nel buffer (il messaggio verr completato dalle letture successive).
+*/
+
 int SocketStream::receiveData(char* buffer, int len) {
+	if ((int) (readBuffer.size() - readOffset) < len)
+		return 0;
+
+	memcpy(buffer, readBuffer.data() + readOffset, len);
+	readOffset += len;
+	if (readOffset == readBuffer.size()) {
+		readBuffer.clear();				// buffer consumato: la capacita' resta disponibile
+		readOffset = 0;
+	}
+	// Se la lettura avr avuto successo, essa restituir il numero di byte letti
+	return len;
+}
+
+/* Lettura di len byte dal buffer di lettura senza consumarli (ad esempio per decidere la lunghezza del messaggio dal primo byte) */
+
+int SocketStream::peekData(char* buffer, int len) {
+	if ((int) (readBuffer.size() - readOffset) < len)
+		return 0;
+
+	memcpy(buffer, readBuffer.data() + readOffset, len);
+	return len;
+}
+
+/* Numero di chiamate send/WSASend effettuate sulla connessione (usato per confrontare le modalit di invio) */
+unsigned long long SocketStream::getSendCalls() {
+	std::lock_guard<std::mutex> lock(writeMutex);
+	return sendCalls;
+}
+
+/* Istante dell'ultima lettura con dati: usato solo dal reactor, che esegue anche le letture */
+std::chrono::steady_clock::time_point SocketStream::getLastReceive() {
+	return lastReceive;
+}
 
-	/*	 In maniera analoga recv  la funzione che permette di ricevere dati da un socket connesso.
-	*	 Parametri:
-	*	 - ClientSocket: Socket tornato dall'accept (quello connesso al socket del Server)
-	*    - buffer: Un puntatore al buffer che deve ricevere i dati in arrivo
-	*    - len: Lunghezza del buffer di ricezione
-	*    - 0: Flag
-	*/
-
-	iResult = recv(clientSocket, buffer, len, 0); 
-	if (iResult == SOCKET_ERROR)
-		throw socket_exception("Recv failed");
-	// Se la receive avr avuto successo, essa restituir il numero di byte ricevuti, e lo stesso far receivedata
-	return iResult;
+CommandLatency& SocketStream::getLatency() {
+	return latency;
 }
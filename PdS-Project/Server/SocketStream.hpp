@@ -1,35 +1,93 @@
 #pragma once
-#include <winsock2.h>
-#include <ws2tcpip.h>
+#include "Platform.hpp"
 #include <stdexcept>
 #include <atomic>
+#include <mutex>
+#include <vector>
+#include <memory>
+#include <chrono>
+#include "Poller.hpp"
+#include "FrameBatch.hpp"
+#include "CompactEncoding.hpp"
+#include "LatencyHistogram.hpp"
+#include "SpscQueue.hpp"
 
 
-#define PENDINGQUEUE 0
+#define MAXPENDING (16 * 1024 * 1024)		// massimo numero di byte in attesa di invio per una connessione
+#define MAXSEGMENTS 1024					// massimo numero di segmenti per una singola scrittura vettoriale
+#define SENDQUEUE 64						// massimo numero di batch in coda per una connessione (vedi SocketStream::enqueue)
+#define MAXCOMMAND (64 * 1024)				// dimensione massima del payload di un comando inviato dal client
+#define MAXREADBUFFER (ENVELOPESIZE + MAXCOMMAND)	// massimo numero di byte ricevuti e non consumati per una connessione
 
-/* Classe che contiene tutte le informazioni necessarie per permettere la comunicazione client server tramite socket */
+/*	Batch di un ciclo di aggiornamento, serializzato una sola volta e condiviso da tutte le connessioni destinatarie.
+*	compressed e' vuoto se nessun destinatario ha chiesto la compressione o se questa non riduce il batch.
+*/
+
+struct OutgoingBatch {
+	FrameBatch plain;
+	FrameBatch compressed;
+};
+
+/*	Classe che rappresenta la connessione con un singolo client.
+*	Il socket e' non bloccante: i dati che il kernel non accetta subito restano nel buffer di scrittura
+*	e vengono inviati dal reactor (ConnectionManager) quando il socket torna scrivibile.
+*	Allo stesso modo i dati ricevuti vengono accumulati nel buffer di lettura finche' non formano un messaggio completo:
+*	il buffer non supera MAXREADBUFFER byte, lo spazio di un comando valido di dimensione massima.
+*/
 
 class SocketStream {
-	WSADATA wsaData;						// per poter usare le Winsock bisogna inizializzare la libreria
-	SOCKET serverSocket;					// socket (oggetto che rappresenta una connessione) in attesa di comandi
 	SOCKET clientSocket;					// socket per la comunicazione con il client
-	struct sockaddr_in	sockAddr, clientSockAddr;	// struttura dati che contiene informazioni sulla famiglia di indirizzi (se Ipv4 o Ipv6), indirizzo IP locale e Porta 
-	socklen_t clientAddrLen = sizeof(clientSockAddr);
-	std::atomic_int iResult;
-	std::atomic_bool isConnected = false;	// stato del socket
+	std::vector<char> readBuffer;			// dati ricevuti e non ancora consumati
+	size_t readOffset = 0;					// primo byte di readBuffer non ancora consumato
+	std::vector<char> writeBuffer;			// dati accodati e non ancora accettati dal kernel
+	size_t writeOffset = 0;					// primo byte di writeBuffer non ancora inviato
+	std::mutex writeMutex;					// sendData (thread della lista) e flush (reactor) possono essere concorrenti
+	std::atomic_bool isConnected;			// stato della connessione
+	std::atomic_bool compression;			// il client accetta batch compressi (vedi Compression.hpp)
+	std::atomic_int iconSize;				// dimensione (pixel) delle icone richiesta dal client (vedi IconCache)
+	std::atomic_bool compact;				// il client riceve le modifiche in codifica compatta (vedi CompactEncoding.hpp)
+	StringTable strings;					// nomi gia' inviati in codifica compatta (solo thread della lista)
+	unsigned long long sendCalls = 0;		// numero di chiamate di sistema di invio effettuate
+	std::chrono::steady_clock::time_point lastReceive;	// istante dell'ultima lettura che ha ricevuto dati
+	CommandLatency latency;					// latenze dei comandi di input ricevuti su questa connessione
+	unsigned long long metricsConnection;	// numero della connessione nelle metriche delle latenze (vedi Metrics)
+	SpscQueue<std::shared_ptr<const OutgoingBatch>, SENDQUEUE> outgoing;	// batch prodotti dal thread della lista ed inviati dal reactor
+
+	void sendPending();
+	bool sendVector(const std::vector<Segment>& segments, size_t& index, int& offset);
 
 public:
-	SocketStream(int port);
-	void waitingForConnection();
+	SocketStream(SOCKET s);
+	~SocketStream();
+	SOCKET getSocket();
 	bool getStatus();
 	void setStatus(bool status);
+	bool getCompression();
+	void setCompression(bool enabled);
+	int getIconSize();
+	void setIconSize(int size);
+	bool getCompact();
+	void enableCompact();
+	StringTable& getStrings();
 	void closeConnection();
 	void sendData(char* buffer, int len);
+	void sendBatch(const FrameBatch& batch);
+	bool enqueue(std::shared_ptr<const OutgoingBatch> batch);
+	size_t sendQueued();
+	size_t getQueuedBatches();
+	bool flush();
+	bool hasPendingData();
+	size_t getPendingBytes();
+	int fillReadBuffer();
 	int receiveData(char* buffer, int len);
+	int peekData(char* buffer, int len);
+	unsigned long long getSendCalls();
+	std::chrono::steady_clock::time_point getLastReceive();
+	CommandLatency& getLatency();
 };
 
 
 class socket_exception : public std::runtime_error {
 public:
 	socket_exception(const char* message) : runtime_error(message) {};
-};
\ No newline at end of file
+};
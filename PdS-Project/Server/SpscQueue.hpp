@@ -0,0 +1,58 @@
+#pragma once
+#include <atomic>
+#include <cstddef>
+#include <utility>
+
+
+#define CACHELINE 64						// dimensione di una linea di cache: gli indici dei due thread sono separati da una linea intera
+
+/*	Coda limitata senza lock per un solo produttore ed un solo consumatore (buffer circolare di N elementi, N potenza di 2).
+*	Il produttore scrive solo tail ed il consumatore solo head: ogni indice viene pubblicato con una store release e letto
+*	dall'altro thread con una load acquire, per cui l'elemento scritto e' visibile prima che l'indice avanzi.
+*	push non blocca mai: con la coda piena restituisce false ed e' il produttore a decidere cosa fare.
+*/
+
+template <typename T, size_t N>
+class SpscQueue {
+	static_assert(N >= 2 && (N & (N - 1)) == 0, "La capacita' della coda deve essere una potenza di 2");
+
+	T items[N];
+	std::atomic<size_t> head{ 0 };			// prossimo elemento da estrarre (consumatore)
+	char padding[CACHELINE];				// head e tail non condividono la linea di cache (niente false sharing tra i thread)
+	std::atomic<size_t> tail{ 0 };			// prossima posizione libera (produttore)
+
+public:
+	SpscQueue() {}
+	SpscQueue(const SpscQueue&) = delete;
+	SpscQueue& operator=(const SpscQueue&) = delete;
+
+	/* Inserimento (solo dal thread produttore): false se la coda e' piena */
+	bool push(T item) {
+		size_t t = tail.load(std::memory_order_relaxed);
+		if (t - head.load(std::memory_order_acquire) == N)
+			return false;
+		items[t & (N - 1)] = std::move(item);
+		tail.store(t + 1, std::memory_order_release);
+		return true;
+	}
+
+	/* Estrazione (solo dal thread consumatore): false se la coda e' vuota. L'elemento lasciato nella coda viene azzerato */
+	bool pop(T& item) {
+		size_t h = head.load(std::memory_order_relaxed);
+		if (h == tail.load(std::memory_order_acquire))
+			return false;
+		item = std::move(items[h & (N - 1)]);
+		items[h & (N - 1)] = T();
+		head.store(h + 1, std::memory_order_release);
+		return true;
+	}
+
+	/* Numero di elementi in coda (approssimato se letto mentre l'altro thread lavora) */
+	size_t size() const {
+		return tail.load(std::memory_order_acquire) - head.load(std::memory_order_acquire);
+	}
+
+	bool empty() const {
+		return size() == 0;
+	}
+};
@@ -0,0 +1,123 @@
+#include "Subscription.hpp"
+#include <algorithm>
+#include <cstring>
+#include <cwctype>
+
+/* Lettura di un DWORD in formato network dal payload, se ci sono ancora almeno 4 byte */
+
+static bool readDword(const char* payload, DWORD length, DWORD& offset, DWORD& value) {
+	if (length - offset < sizeof(DWORD))
+		return false;
+	memcpy(&value, payload + offset, sizeof(DWORD));
+	value = ntohl(value);
+	offset += sizeof(DWORD);
+	return true;
+}
+
+/*	Lettura della sottoscrizione dal payload del comando: restituisce false (e la sottoscrizione non va usata)
+*	se il payload e' malformato. Le espressioni vengono convertite in minuscolo una sola volta, qui.
+*/
+
+bool Subscription::parse(const char* payload, DWORD length) {
+	DWORD offset = 0, count;
+	if (!readDword(payload, length, offset, types) || !readDword(payload, length, offset, count))
+		return false;
+	if (count > (length - offset) / sizeof(DWORD))
+		return false;
+	pids.resize(count);
+	for (DWORD& pid : pids)
+		readDword(payload, length, offset, pid);
+	std::sort(pids.begin(), pids.end());
+
+	if (!readDword(payload, length, offset, count))
+		return false;
+	patterns.clear();
+	for (DWORD i = 0; i < count; i++) {
+		DWORD bytes;
+		if (!readDword(payload, length, offset, bytes) || bytes % 2 != 0 || bytes > length - offset)
+			return false;
+
+		/* testo UTF-16LE: su Linux (wchar_t a 32 bit) le coppie surrogate vengono ricomposte */
+		std::wstring pattern;
+		for (DWORD j = 0; j < bytes; j += 2) {
+			unsigned long c = (unsigned char) payload[offset + j] | ((unsigned char) payload[offset + j + 1] << 8);
+			if (sizeof(wchar_t) > 2 && c >= 0xD800 && c < 0xDC00 && j + 3 < bytes) {
+				unsigned long low = (unsigned char) payload[offset + j + 2] | ((unsigned char) payload[offset + j + 3] << 8);
+				if (low >= 0xDC00 && low < 0xE000) {
+					c = 0x10000 + ((c - 0xD800) << 10) + (low - 0xDC00);
+					j += 2;
+				}
+			}
+			pattern.push_back((wchar_t) std::towlower((wint_t) c));
+		}
+		patterns.push_back(pattern);
+		offset += bytes;
+	}
+	return offset == length;
+}
+
+/* La sottoscrizione non filtra nulla: il client riceve le stesse modifiche dei client senza sottoscrizione */
+
+bool Subscription::isDefault() const {
+	DWORD filtered = (1 << add) | (1 << rem) | (1 << chf) | (1 << res);
+	return (types & filtered) == filtered && pids.empty() && patterns.empty();
+}
+
+/* Tipo di modifica richiesto: l'icona estratta (icu) segue la add; gli altri messaggi non vengono mai filtrati */
+
+bool Subscription::accepts(changeType type) const {
+	if (type == icu)
+		type = add;
+	if (type != add && type != rem && type != chf && type != res)
+		return true;
+	return (types & (1 << type)) != 0;
+}
+
+/*	Confronto di un nome con un'espressione (gia' in minuscolo): * corrisponde a qualsiasi sequenza di caratteri,
+*	? ad un carattere qualsiasi. Dopo un * che non porta ad una corrispondenza si riprova un carattere piu' avanti.
+*/
+
+static bool wildcardMatch(const std::wstring& pattern, const std::wstring& text) {
+	size_t p = 0, t = 0, star = std::wstring::npos, mark = 0;
+	while (t < text.size()) {
+		if (p < pattern.size() && (pattern[p] == L'?' || pattern[p] == (wchar_t) std::towlower((wint_t) text[t]))) {
+			p++;
+			t++;
+		}
+		else if (p < pattern.size() && pattern[p] == L'*') {
+			star = p++;
+			mark = t;
+		}
+		else if (star != std::wstring::npos) {
+			p = star + 1;
+			t = ++mark;
+		}
+		else
+			return false;
+	}
+	while (p < pattern.size() && pattern[p] == L'*')
+		p++;
+	return p == pattern.size();
+}
+
+/*	Applicazione richiesta dalla sottoscrizione: pid tra quelli indicati, oppure nome o percorso che soddisfano
+*	un'espressione. Senza pid ed espressioni tutte le applicazioni sono richieste. app puo' essere nullptr (applicazione
+*	non nella lista, es. focus su un processo senza finestre visibili): in quel caso conta solo il pid.
+*/
+
+bool Subscription::matches(DWORD pid, const ApplicationItem* app) const {
+	if (pids.empty() && patterns.empty())
+		return true;
+	if (std::binary_search(pids.begin(), pids.end(), pid))
+		return true;
+	if (app == nullptr)
+		return false;
+	for (const std::wstring& pattern : patterns)
+		if ((app->Name && wildcardMatch(pattern, *app->Name)) || (app->Exec_name && wildcardMatch(pattern, *app->Exec_name)))
+			return true;
+	return false;
+}
+
+bool Subscription::operator==(const Subscription& other) const {
+	return types == other.types && pids == other.pids && patterns == other.patterns;
+}
@@ -0,0 +1,29 @@
+#pragma once
+#include "Change.hpp"
+#include <string>
+#include <vector>
+
+
+#define SUBSCRIBEALL 0xFFFFFFFF				// tipi di modifica di una sottoscrizione che non filtra nulla
+
+/*	Sottoscrizione di un client: quali modifiche alla lista vuole ricevere (vedi il comando subscribe in ListHandler.hpp).
+*	Il filtro riguarda solo le modifiche add, remove, change_focus e res; gli altri messaggi (heartbeat, reset, sequenza, icone...)
+*	vengono sempre inviati. Una modifica passa il filtro se il suo tipo e' tra quelli richiesti e, se la sottoscrizione
+*	indica pid o espressioni, se il pid e' tra quelli indicati oppure il nome o il percorso dell'eseguibile soddisfano
+*	una delle espressioni (caratteri jolly * e ?, senza distinzione tra maiuscole e minuscole).
+*	Il payload del comando contiene, in formato network: i tipi richiesti (4 byte, bit 1 << changeType), il numero di pid
+*	ed i pid (4 byte ciascuno), il numero di espressioni e per ognuna la lunghezza in byte ed il testo UTF-16LE.
+*/
+
+class Subscription {
+	DWORD types = SUBSCRIBEALL;				// tipi di modifica richiesti (bit 1 << changeType)
+	std::vector<DWORD> pids;				// pid richiesti, ordinati
+	std::vector<std::wstring> patterns;		// espressioni sui nomi, in minuscolo
+
+public:
+	bool parse(const char* payload, DWORD length);
+	bool isDefault() const;
+	bool accepts(changeType type) const;
+	bool matches(DWORD pid, const ApplicationItem* app) const;
+	bool operator==(const Subscription& other) const;
+};
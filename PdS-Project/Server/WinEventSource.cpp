@@ -0,0 +1,87 @@
+#include "WinEventSource.hpp"
+#include <iostream>
+
+WinEventSource* WinEventSource::active = nullptr;
+
+std::unique_ptr<ChangeSource> createChangeSource() {
+	return std::unique_ptr<ChangeSource>(new WinEventSource());
+}
+
+WinEventSource::~WinEventSource() {
+	stop();
+}
+
+/* Avvio del thread degli hook: la funzione ritorna solo dopo che gli hook sono stati installati (o l'installazione e' fallita) */
+void WinEventSource::start(std::function<void()> callback) {
+	if (hookThread.joinable())
+		return;
+	onChange = callback;
+	active = this;
+	ready = false;
+	hookThread = std::thread(&WinEventSource::hookLoop, this);
+
+	std::unique_lock<std::mutex> lock(startMutex);
+	startCondition.wait(lock, [this]() { return ready; });
+}
+
+/* Terminazione del ciclo dei messaggi del thread degli hook (WM_QUIT) ed attesa della sua fine */
+void WinEventSource::stop() {
+	if (!hookThread.joinable())
+		return;
+	PostThreadMessage(hookThreadId, WM_QUIT, 0, 0);
+	hookThread.join();
+	active = nullptr;
+}
+
+/*	Callback degli hook, eseguita nel thread degli hook.
+*	Gli eventi sulle finestre riguardano anche controlli, cursori e menu: si considerano solo quelli relativi ad una finestra
+*	(OBJID_WINDOW) nel suo complesso (CHILDID_SELF). Per la creazione e la comparsa si richiede inoltre che sia una finestra
+*	di primo livello; la distruzione non si puo' filtrare allo stesso modo perche' la finestra non esiste piu'.
+*/
+
+void CALLBACK WinEventSource::eventProc(HWINEVENTHOOK hook, DWORD event, HWND hwnd, LONG idObject, LONG idChild, DWORD eventThread, DWORD eventTime) {
+	if (active == nullptr)
+		return;
+
+	if (event != EVENT_SYSTEM_FOREGROUND) {
+		if (hwnd == NULL || idObject != OBJID_WINDOW || idChild != CHILDID_SELF)
+			return;
+		if (event != EVENT_OBJECT_DESTROY && GetAncestor(hwnd, GA_ROOT) != hwnd)
+			return;
+	}
+
+	active->onChange();
+}
+
+/* Corpo del thread degli hook: installazione degli hook e ciclo dei messaggi fino a WM_QUIT */
+void WinEventSource::hookLoop() {
+	MSG msg;
+
+	// la coda dei messaggi del thread viene creata alla prima chiamata di una funzione dei messaggi
+	PeekMessage(&msg, NULL, WM_USER, WM_USER, PM_NOREMOVE);
+	hookThreadId = GetCurrentThreadId();
+
+	DWORD flags = WINEVENT_OUTOFCONTEXT | WINEVENT_SKIPOWNPROCESS;
+	HWINEVENTHOOK foregroundHook = SetWinEventHook(EVENT_SYSTEM_FOREGROUND, EVENT_SYSTEM_FOREGROUND, NULL, eventProc, 0, 0, flags);
+	HWINEVENTHOOK windowHook = SetWinEventHook(EVENT_OBJECT_CREATE, EVENT_OBJECT_HIDE, NULL, eventProc, 0, 0, flags);
+
+	// senza hook la lista viene aggiornata solo dalla riconciliazione periodica
+	if (foregroundHook == NULL || windowHook == NULL)
+		std::wcerr << "Installazione degli hook WinEvent fallita: aggiornamento solo periodico" << std::endl;
+
+	{
+		std::lock_guard<std::mutex> lock(startMutex);
+		ready = true;
+	}
+	startCondition.notify_one();
+
+	while (GetMessage(&msg, NULL, 0, 0) > 0) {
+		TranslateMessage(&msg);
+		DispatchMessage(&msg);
+	}
+
+	if (foregroundHook != NULL)
+		UnhookWinEvent(foregroundHook);
+	if (windowHook != NULL)
+		UnhookWinEvent(windowHook);
+}
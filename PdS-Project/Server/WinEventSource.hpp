@@ -0,0 +1,33 @@
+#pragma once
+#include "ChangeSource.hpp"
+#include <Windows.h>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+
+
+/*	Sorgente di eventi Windows basata sugli hook WinEvent (SetWinEventHook).
+*	Gli hook "out of context" vengono notificati tramite la coda dei messaggi del thread che li ha installati:
+*	la classe avvia quindi un thread dedicato con il proprio ciclo dei messaggi.
+*	Eventi osservati: cambio della finestra in foreground, creazione, distruzione, comparsa e scomparsa delle finestre.
+*/
+
+class WinEventSource : public ChangeSource {
+	std::thread hookThread;
+	DWORD hookThreadId = 0;
+	std::function<void()> onChange;
+	std::mutex startMutex;
+	std::condition_variable startCondition;	// segnalata quando il thread ha installato gli hook
+	bool ready = false;
+
+	static WinEventSource* active;			// la callback degli hook non riceve un contesto: una sola sorgente attiva per processo
+
+	static void CALLBACK eventProc(HWINEVENTHOOK hook, DWORD event, HWND hwnd, LONG idObject, LONG idChild, DWORD eventThread, DWORD eventTime);
+	void hookLoop();
+
+public:
+	WinEventSource() {}
+	~WinEventSource();
+	void start(std::function<void()> onChange) override;
+	void stop() override;
+};
@@ -0,0 +1,60 @@
+#include "Tests.hpp"
+#include "../Server/AppList.hpp"
+
+/* Lettura simulata dei processi: il nome e' il pid, i pid multipli di 10 non sono leggibili (es. processi di sistema) */
+static int resolved = 0;
+
+static bool resolveProcess(DWORD pid, ApplicationItem& app) {
+	resolved++;
+	if (pid % 10 == 0)
+		return false;
+	app.Name = std::make_shared<const std::wstring>(std::to_wstring(pid));
+	app.Exec_name = app.Name;
+	return true;
+}
+
+static std::vector<DWORD> pidsOf(const AppList& list) {
+	std::vector<DWORD> pids;
+	for (const AppEntry& e : list.getEntries())
+		pids.push_back(e.pid);
+	return pids;
+}
+
+/* Confronto con la lista vuota, aggiornamenti con processi nuovi e terminati, lista invariata e processi non leggibili */
+void runAppListTests() {
+	AppList list;
+	ListDelta delta;
+
+	list.diff({ 3, 5, 10 }, delta);
+	CHECK((delta.added == std::vector<DWORD>{ 3, 5, 10 }));
+	CHECK(delta.removed.empty());
+	list.apply(delta, resolveProcess);
+	CHECK((pidsOf(list) == std::vector<DWORD>{ 3, 5, 10 }));
+	CHECK(resolved == 3);
+	CHECK(list.find(10) != nullptr && !list.find(10)->valid);
+	CHECK(list.find(5) != nullptr && list.find(5)->valid && *list.find(5)->app.Name == L"5");
+	CHECK(list.find(4) == nullptr);
+
+	/* stessa enumerazione: nessuna differenza, nessun processo riletto */
+	list.diff({ 3, 5, 10 }, delta);
+	CHECK(delta.empty());
+	list.apply(delta, resolveProcess);
+	CHECK(resolved == 3);
+
+	/* un processo terminato in testa, uno nuovo in mezzo ed uno in coda: solo i nuovi vengono letti */
+	list.diff({ 4, 5, 10, 12 }, delta);
+	CHECK((delta.added == std::vector<DWORD>{ 4, 12 }));
+	CHECK((delta.removed == std::vector<DWORD>{ 3 }));
+	list.apply(delta, resolveProcess);
+	CHECK((pidsOf(list) == std::vector<DWORD>{ 4, 5, 10, 12 }));
+	CHECK(resolved == 5);
+	CHECK(list.find(3) == nullptr);
+	CHECK(*list.find(5)->app.Name == L"5");		// gli elementi che restano conservano le informazioni lette
+
+	/* tutti i processi terminati */
+	list.diff({}, delta);
+	CHECK((delta.removed == std::vector<DWORD>{ 4, 5, 10, 12 }));
+	CHECK(delta.added.empty());
+	list.apply(delta, resolveProcess);
+	CHECK(list.size() == 0);
+}
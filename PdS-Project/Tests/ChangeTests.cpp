@@ -0,0 +1,89 @@
+#include "Tests.hpp"
+#include "../Server/ChangeBacklog.hpp"
+#include "../Server/ChangeLog.hpp"
+
+static ApplicationItem application(const wchar_t* name) {
+	ApplicationItem app;
+	app.Name = std::make_shared<const std::wstring>(name);
+	app.Exec_name = app.Name;
+	return app;
+}
+
+static std::deque<Change> mergeAndCollect(ChangeBacklog& backlog, const std::deque<Change>& changes) {
+	std::deque<Change> collected;
+	backlog.merge(changes);
+	backlog.collect(collected);
+	return collected;
+}
+
+/*	Fusione delle modifiche: add + remove si annullano, remove + add (pid riusato) restano nell'ordine remove, add;
+*	dei cambi di focus e dell'uso delle risorse resta l'ultimo, la icu si annulla con la add, la remove annulla icu e res.
+*/
+void runChangeBacklogTests() {
+	ChangeBacklog backlog;
+	ResourceUsage low = { 100, 2048 }, high = { 5000, 4096 };
+
+	std::deque<Change> out = mergeAndCollect(backlog, { Change(1, application(L"a")), Change(rem, 1), Change(heartbeat, 0) });
+	CHECK(out.empty());
+	CHECK(backlog.empty());
+
+	out = mergeAndCollect(backlog, { Change(rem, 2), Change(2, application(L"b")), Change(chf, 2), Change(chf, 3) });
+	CHECK(out.size() == 3);
+	CHECK(out.size() == 3 && out[0].getType() == rem && out[0].getPid() == 2);
+	CHECK(out.size() == 3 && out[1].getType() == add && out[1].getPid() == 2 && *out[1].getApplication().Name == L"b");
+	CHECK(out.size() == 3 && out[2].getType() == chf && out[2].getPid() == 3);
+
+	out = mergeAndCollect(backlog, { Change(4, application(L"c")), Change(icu, 4, application(L"c")), Change(icu, 5, application(L"d")) });
+	CHECK(out.size() == 2);
+	CHECK(out.size() == 2 && out[0].getType() == add && out[0].getPid() == 4);
+	CHECK(out.size() == 2 && out[1].getType() == icu && out[1].getPid() == 5);
+
+	out = mergeAndCollect(backlog, { Change(6, low), Change(6, high), Change(7, low), Change(rem, 7) });
+	CHECK(out.size() == 2);
+	CHECK(out.size() == 2 && out[0].getType() == rem && out[0].getPid() == 7);
+	CHECK(out.size() == 2 && out[1].getType() == res && out[1].getPid() == 6 && out[1].getUsage().cpu == high.cpu &&
+		out[1].getUsage().memory == high.memory);
+
+	/* la fusione avviene anche tra cicli diversi */
+	backlog.merge({ Change(8, application(L"e")) });
+	backlog.merge({ Change(rem, 8) });
+	CHECK(backlog.empty());
+
+	/* oltre BACKLOGSIZE applicazioni le modifiche vengono scartate */
+	std::deque<Change> many;
+	for (DWORD pid = 1; pid <= BACKLOGSIZE + 1; pid++)
+		many.push_back(Change(rem, pid));
+	ChangeBacklog full;
+	full.merge(many);
+	CHECK(full.overflowed());
+	CHECK(full.size() == 0);
+}
+
+/*	Limiti della ripresa: le modifiche successive ad una sequenza sono disponibili solo se sono ancora tutte nel registro,
+*	con la stessa epoca e una sequenza non successiva all'ultima registrata.
+*/
+void runChangeLogTests() {
+	ChangeLog log(4);
+	std::deque<Change> missed;
+	CHECK(log.getEpoch() != 0);
+	CHECK(log.collect(log.getEpoch(), 0, missed) && missed.empty());
+
+	for (DWORD pid = 1; pid <= 6; pid++)
+		CHECK(log.append(Change(chf, pid)) == pid);
+	CHECK(log.size() == 4);
+	CHECK(log.getLastSequence() == 6);
+
+	CHECK(log.collect(log.getEpoch(), 2, missed));
+	CHECK(missed.size() == 4);
+	CHECK(missed.size() == 4 && missed.front().getPid() == 3 && missed.back().getPid() == 6);
+
+	CHECK(log.collect(log.getEpoch(), 5, missed));
+	CHECK(missed.size() == 1 && missed.front().getPid() == 6);
+
+	CHECK(log.collect(log.getEpoch(), 6, missed) && missed.empty());
+
+	CHECK(!log.collect(log.getEpoch(), 1, missed));			// modifica 2 gia' scartata
+	CHECK(!log.collect(log.getEpoch(), 7, missed));			// sequenza mai inviata
+	CHECK(!log.collect(log.getEpoch() + 1, 5, missed));		// altra esecuzione del server
+	CHECK(missed.empty());
+}
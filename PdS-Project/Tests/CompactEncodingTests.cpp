@@ -0,0 +1,72 @@
+#include "Tests.hpp"
+#include "../Server/CompactEncoding.hpp"
+
+static std::vector<unsigned char> varint(DWORD value) {
+	char field[MAXVARINT];
+	int n = writeVarint(field, value);
+	return std::vector<unsigned char>(field, field + n);
+}
+
+static std::vector<unsigned char> utf8(const std::wstring& text) {
+	std::vector<char> out(text.size() * MAXUTF8 + 1);
+	int n = encodeUtf8(text, out.data());
+	return std::vector<unsigned char>(out.begin(), out.begin() + n);
+}
+
+static std::vector<unsigned char> unsignedBytes(const FrameBatch& batch) {
+	std::vector<char> bytes = batchBytes(batch);
+	return std::vector<unsigned char>(bytes.begin(), bytes.end());
+}
+
+/*	Varint (limiti di ogni lunghezza), differenze zigzag (anche oltre lo zero), UTF-8 (blocchi ASCII, caratteri di 2, 3 e 4 byte,
+*	surrogati isolati) e tabella dei nomi (testo alla prima occorrenza, poi l'indice).
+*/
+void runCompactEncodingTests() {
+	typedef std::vector<unsigned char> Bytes;
+
+	CHECK((varint(0) == Bytes{ 0x00 }));
+	CHECK((varint(127) == Bytes{ 0x7F }));
+	CHECK((varint(128) == Bytes{ 0x80, 0x01 }));
+	CHECK((varint(300) == Bytes{ 0xAC, 0x02 }));
+	CHECK((varint(0xFFFFFFFF) == Bytes{ 0xFF, 0xFF, 0xFF, 0xFF, 0x0F }));
+
+	FrameBatch batch;
+	appendVarint(batch, 16384);
+	appendVarint(batch, 1);
+	CHECK((unsignedBytes(batch) == Bytes{ 0x80, 0x80, 0x01, 0x01 }));
+
+	CHECK(zigzagDelta(5, 5) == 0);
+	CHECK(zigzagDelta(4, 5) == 1);
+	CHECK(zigzagDelta(6, 5) == 2);
+	CHECK(zigzagDelta(3, 5) == 3);
+	CHECK(zigzagDelta(0, 0xFFFFFFFF) == 2);		// differenza +1 attraverso lo zero
+	CHECK(zigzagDelta(0xFFFFFFFF, 0) == 1);		// differenza -1
+
+	CHECK(utf8(L"").empty());
+	CHECK((utf8(L"notepad.exe") == Bytes{ 'n', 'o', 't', 'e', 'p', 'a', 'd', '.', 'e', 'x', 'e' }));
+	CHECK((utf8(L"caff\u00E8") == Bytes{ 'c', 'a', 'f', 'f', 0xC3, 0xA8 }));
+	CHECK((utf8(L"\u20AC 5") == Bytes{ 0xE2, 0x82, 0xAC, ' ', '5' }));
+	CHECK((utf8(L"ab\U0001F600cd") == Bytes{ 'a', 'b', 0xF0, 0x9F, 0x98, 0x80, 'c', 'd' }));
+	CHECK((utf8(std::wstring(1, (wchar_t) 0xD800) + L"x") == Bytes{ 0xEF, 0xBF, 0xBD, 'x' }));
+
+	/* primo nome: testo memorizzato; stesso nome: indice; secondo nome: indice successivo */
+	StringTable strings;
+	FrameBatch names;
+	strings.appendString(names, L"app");
+	strings.appendString(names, L"app");
+	strings.appendString(names, L"b\u00E8");
+	strings.appendString(names, L"b\u00E8");
+	CHECK((unsignedBytes(names) == Bytes{ STRINGSTORED, 3, 'a', 'p', 'p', STRINGREFERENCE, STRINGSTORED, 3, 'b', 0xC3, 0xA8,
+		STRINGREFERENCE + 1 }));
+	CHECK(strings.size() == 2);
+
+	/* tabella piena: i nomi nuovi vengono inviati come testo non memorizzato */
+	StringTable full;
+	FrameBatch ignored;
+	for (int i = 0; i < STRINGTABLESIZE; i++)
+		full.appendString(ignored, std::to_wstring(i));
+	FrameBatch literal;
+	full.appendString(literal, L"z");
+	CHECK((unsignedBytes(literal) == Bytes{ STRINGLITERAL, 1, 'z' }));
+	CHECK(full.size() == STRINGTABLESIZE);
+}
@@ -0,0 +1,88 @@
+#include "Tests.hpp"
+#include "../Server/Compression.hpp"
+#include "../Server/Change.hpp"
+#include <cstring>
+
+/* Compressione e decompressione di un blocco: restituisce true se i dati tornano identici */
+static bool roundTrip(const std::vector<char>& data) {
+	std::vector<char> compressed(compressBound((int) data.size()));
+	int len = compressBlock(data.data(), (int) data.size(), compressed.data(), (int) compressed.size());
+	if (len <= 0)
+		return false;
+	std::vector<char> plain(data.size() + 1);
+	int n = decompressBlock(compressed.data(), len, plain.data(), (int) plain.size());
+	return n == (int) data.size() && memcmp(plain.data(), data.data(), data.size()) == 0;
+}
+
+static DWORD readDword(const char* p) {
+	DWORD v;
+	memcpy(&v, p, sizeof(v));
+	return ntohl(v);
+}
+
+/*	Blocchi LZ4: dati ripetuti, casuali, piu' corti di un riferimento e con riferimenti sovrapposti ai byte prodotti;
+*	blocchi non validi; compressione di un frame (standard e packed) con il tipo dell'envelope conservato.
+*/
+void runCompressionTests() {
+	std::vector<char> empty, tiny = { 'a', 'b', 'c' }, run(5000, 'x'), text, noise(4096);
+	for (int i = 0; i < 200; i++)
+		for (const char* w = "notepad.exe explorer.exe "; *w; w++)
+			text.push_back(*w);
+	unsigned state = 12345;
+	for (char& c : noise) {
+		state = state * 1103515245 + 12345;
+		c = (char) (state >> 16);
+	}
+
+	CHECK(roundTrip(empty));
+	CHECK(roundTrip(tiny));
+	CHECK(roundTrip(run));
+	CHECK(roundTrip(text));
+	CHECK(roundTrip(noise));
+
+	/* i dati ripetuti si riducono, quelli casuali non superano compressBound */
+	std::vector<char> out(compressBound((int) run.size()));
+	CHECK(compressBlock(run.data(), (int) run.size(), out.data(), (int) out.size()) < 100);
+	CHECK(compressBlock(run.data(), (int) run.size(), out.data(), 10) == 0);
+
+	/* blocchi non validi: riferimento prima dell'inizio dei dati, letterali oltre la fine, destinazione troppo piccola */
+	char plain[64];
+	const char before[] = { 0x10, 'a', 0x05, 0x00 };
+	const char truncated[] = { (char) 0x50, 'a', 'b' };
+	CHECK(decompressBlock(before, sizeof(before), plain, sizeof(plain)) == -1);
+	CHECK(decompressBlock(truncated, sizeof(truncated), plain, sizeof(plain)) == -1);
+	int len = compressBlock(text.data(), (int) text.size(), out.data(), (int) out.size());
+	CHECK(decompressBlock(out.data(), len, plain, sizeof(plain)) == -1);
+
+	/* frame compressi: stesso tipo del frame in chiaro, flag FLAGCOMPRESSED e payload originale ricostruito */
+	for (unsigned char type : { (unsigned char) frame, (unsigned char) packed }) {
+		FrameBatch batch, compressed;
+		batch.openFrame(type);
+		batch.append(text.data(), (int) text.size());
+		batch.closeFrame();
+		CHECK(compressBatch(batch, compressed));
+
+		std::vector<char> bytes = batchBytes(compressed);
+		CHECK(bytes.size() > ENVELOPESIZE + sizeof(DWORD));
+		if (bytes.size() <= ENVELOPESIZE + sizeof(DWORD))
+			continue;
+		u_short flags;
+		memcpy(&flags, bytes.data() + 2, sizeof(flags));
+		CHECK((unsigned char) bytes[1] == type);
+		CHECK((ntohs(flags) & FLAGCOMPRESSED) != 0);
+		CHECK(readDword(bytes.data() + 4) == bytes.size() - ENVELOPESIZE);
+		CHECK(readDword(bytes.data() + ENVELOPESIZE) == text.size());
+
+		std::vector<char> restored(text.size());
+		int n = decompressBlock(bytes.data() + ENVELOPESIZE + sizeof(DWORD), (int) (bytes.size() - ENVELOPESIZE - sizeof(DWORD)),
+			restored.data(), (int) restored.size());
+		CHECK(n == (int) text.size() && restored == text);
+	}
+
+	/* un frame piccolo resta in chiaro */
+	FrameBatch small, unused;
+	small.openFrame(frame);
+	small.append(tiny.data(), (int) tiny.size());
+	small.closeFrame();
+	CHECK(!compressBatch(small, unused));
+}
@@ -0,0 +1,88 @@
+#include "Tests.hpp"
+#include "../Server/Subscription.hpp"
+
+/* Payload del comando subscribe, in formato network (vedi Subscription.hpp) */
+static void appendDword(std::string& payload, DWORD value) {
+	for (int shift = 24; shift >= 0; shift -= 8)
+		payload.push_back((char) (value >> shift));
+}
+
+static std::string subscribePayload(DWORD types, const std::vector<DWORD>& pids, const std::vector<std::u16string>& patterns) {
+	std::string payload;
+	appendDword(payload, types);
+	appendDword(payload, (DWORD) pids.size());
+	for (DWORD pid : pids)
+		appendDword(payload, pid);
+	appendDword(payload, (DWORD) patterns.size());
+	for (const std::u16string& p : patterns) {
+		appendDword(payload, (DWORD) (p.size() * 2));
+		for (char16_t c : p) {
+			payload.push_back((char) (c & 0xFF));
+			payload.push_back((char) (c >> 8));
+		}
+	}
+	return payload;
+}
+
+static ApplicationItem application(const wchar_t* name, const wchar_t* path) {
+	ApplicationItem app;
+	app.Name = std::make_shared<const std::wstring>(name);
+	app.Exec_name = std::make_shared<const std::wstring>(path);
+	return app;
+}
+
+/*	Lettura del payload (valido, troncato, con byte in eccesso o lunghezze non valide), tipi richiesti, pid ed espressioni
+*	con caratteri jolly, senza distinzione tra maiuscole e minuscole.
+*/
+void runSubscriptionTests() {
+	Subscription s;
+	CHECK(s.isDefault());
+
+	std::string payload = subscribePayload((1 << add) | (1 << rem), { 42, 7 }, { u"NOTE*", u"*\\bin\\?ash" });
+	CHECK(s.parse(payload.data(), (DWORD) payload.size()));
+	CHECK(!s.isDefault());
+	CHECK(s.accepts(add) && s.accepts(rem) && s.accepts(icu));
+	CHECK(!s.accepts(chf) && !s.accepts(res));
+	CHECK(s.accepts(heartbeat) && s.accepts(seq) && s.accepts(reset));
+
+	ApplicationItem notepad = application(L"Notepad.exe", L"C:\\Windows\\notepad.exe");
+	ApplicationItem bash = application(L"bash", L"/usr/BIN/bash");
+	ApplicationItem other = application(L"calc", L"C:\\Windows\\calc.exe");
+	CHECK(s.matches(1, &notepad));
+	CHECK(!s.matches(2, &bash));
+	CHECK(!s.matches(3, &other));
+	CHECK(s.matches(7, &other) && s.matches(42, nullptr));
+	CHECK(!s.matches(3, nullptr));
+
+	ApplicationItem slashBash = application(L"bash", L"C:\\tools\\BIN\\bash");
+	CHECK(s.matches(4, &slashBash));
+
+	/* stessa sottoscrizione con i pid in altro ordine */
+	Subscription same;
+	std::string reordered = subscribePayload((1 << add) | (1 << rem), { 7, 42 }, { u"NOTE*", u"*\\bin\\?ash" });
+	CHECK(same.parse(reordered.data(), (DWORD) reordered.size()) && same == s);
+
+	/* sottoscrizione di tutti i tipi senza filtri: equivale a nessuna sottoscrizione */
+	Subscription all;
+	std::string everything = subscribePayload(SUBSCRIBEALL, {}, {});
+	CHECK(all.parse(everything.data(), (DWORD) everything.size()) && all.isDefault() && all.matches(9, nullptr));
+
+	/* payload malformati */
+	Subscription bad;
+	CHECK(!bad.parse(payload.data(), (DWORD) payload.size() - 1));
+	std::string extra = payload + "x";
+	CHECK(!bad.parse(extra.data(), (DWORD) extra.size()));
+	CHECK(!bad.parse(payload.data(), 6));
+	std::string manyPids;
+	appendDword(manyPids, SUBSCRIBEALL);
+	appendDword(manyPids, 1000);
+	appendDword(manyPids, 1);
+	CHECK(!bad.parse(manyPids.data(), (DWORD) manyPids.size()));
+	std::string oddPattern;
+	appendDword(oddPattern, SUBSCRIBEALL);
+	appendDword(oddPattern, 0);
+	appendDword(oddPattern, 1);
+	appendDword(oddPattern, 3);
+	oddPattern += "abc";
+	CHECK(!bad.parse(oddPattern.data(), (DWORD) oddPattern.size()));
+}
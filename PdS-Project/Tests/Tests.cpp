@@ -0,0 +1,67 @@
+#ifdef _WIN32
+#pragma comment(lib,"Ws2_32.lib")
+#endif
+#include "Tests.hpp"
+#include "../Server/FrameBatch.hpp"
+#include <iostream>
+#include <cstring>
+
+/*	Test di unita' del nucleo del server: confronto ed aggiornamento della lista (AppListTests.cpp), fusione delle modifiche
+*	e ripresa (ChangeTests.cpp), compressione (CompressionTests.cpp), codifica compatta (CompactEncodingTests.cpp)
+*	e sottoscrizioni (SubscriptionTests.cpp). Senza parametri vengono eseguiti tutti i gruppi, altrimenti solo quello indicato
+*	(ogni gruppo e' un test distinto di ctest). Il programma termina con 1 se almeno una verifica fallisce.
+*	Uso: UnitTests [AppList|ChangeBacklog|ChangeLog|Compression|CompactEncoding|Subscription]
+*/
+
+static int checks = 0;
+static int failures = 0;
+
+bool checkCondition(bool ok, const char* expression, const char* file, int line) {
+	checks++;
+	if (!ok) {
+		failures++;
+		std::cerr << file << ":" << line << ": verifica fallita: " << expression << std::endl;
+	}
+	return ok;
+}
+
+std::vector<char> batchBytes(const FrameBatch& batch) {
+	std::vector<char> bytes;
+	for (const Segment& s : batch.getSegments())
+		bytes.insert(bytes.end(), s.data, s.data + s.len);
+	return bytes;
+}
+
+struct TestGroup {
+	const char* name;
+	void (*run)();
+};
+
+static const TestGroup groups[] = {
+	{ "AppList", runAppListTests },
+	{ "ChangeBacklog", runChangeBacklogTests },
+	{ "ChangeLog", runChangeLogTests },
+	{ "Compression", runCompressionTests },
+	{ "CompactEncoding", runCompactEncodingTests },
+	{ "Subscription", runSubscriptionTests },
+};
+
+int main(int argc, char* argv[]) {
+	const char* only = argc > 1 ? argv[1] : nullptr;
+	bool found = false;
+	for (const TestGroup& g : groups) {
+		if (only != nullptr && strcmp(only, g.name) != 0)
+			continue;
+		found = true;
+		int before = failures;
+		g.run();
+		std::cout << g.name << ": " << (failures == before ? "ok" : "FALLITO") << std::endl;
+	}
+
+	if (!found) {
+		std::cerr << "Gruppo di test sconosciuto: " << only << std::endl;
+		return 1;
+	}
+	std::cout << checks << " verifiche, " << failures << " fallite" << std::endl;
+	return failures == 0 ? 0 : 1;
+}
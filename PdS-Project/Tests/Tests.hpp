@@ -0,0 +1,23 @@
+#pragma once
+#include <vector>
+#include <string>
+
+/*	Verifica di una condizione: un fallimento viene riportato con file, riga ed espressione, e il test prosegue
+*	con le verifiche successive (vedi checkCondition in Tests.cpp).
+*/
+#define CHECK(condition) checkCondition((condition), #condition, __FILE__, __LINE__)
+
+bool checkCondition(bool ok, const char* expression, const char* file, int line);
+
+/* Byte di un batch nell'ordine di invio (i segmenti concatenati) */
+class FrameBatch;
+std::vector<char> batchBytes(const FrameBatch& batch);
+
+/* Gruppi di test disponibili */
+
+void runAppListTests();
+void runChangeBacklogTests();
+void runChangeLogTests();
+void runCompressionTests();
+void runCompactEncodingTests();
+void runSubscriptionTests();